@@ -68,6 +68,7 @@
 #include	"display.h"		// OLED display
 #include	"spi.h"
 #include	"w25q.h"		// Flash
+#include	"cgiCache.h"	// CGI responses cache statistics
 
 #define		AASUN_VERSION		((1u << 16) | 18u)
 
@@ -153,6 +154,55 @@ uint32_t	AASunVersion	(void)
 	return AASUN_VERSION ;
 }
 
+//--------------------------------------------------------------------------------
+//	Take a consistent copy of the live values, for the HTTP servers (LAN and WIFI)
+//	Called every second by the AASun task, which computes these values.
+//	The copy is written to the snapshot not in use, then published by switching liveSnapIx:
+//	a reader has 1 second to use the snapshot it got from liveSnapGet()
+
+void	liveSnapTake (void)
+{
+	uint32_t	ix = liveSnapIx ^ 1u ;
+	liveSnap_t	* pSnap = & liveSnap [ix] ;
+	uint32_t	ii ;
+
+	pSnap->generation  = liveSnap [liveSnapIx].generation + 1u ;
+	pSnap->statusWord  = statusWord ;
+	pSnap->computed    = computedData ;
+	pSnap->energyWh    = energyWh ;
+	pSnap->dayEnergyWh = dayEnergyWh ;
+	pSnap->meterVolt   = meterVolt ;
+	pSnap->meterBase   = meterBase ;
+	pSnap->meterPapp   = meterPapp ;
+
+	for (ii = 0 ; ii < PULSE_COUNTER_MAX ; ii++)
+	{
+		pSnap->pulsePower [ii] = (pulseCounter [ii].pulsePeriodCount * pulseCounter [ii].pulsePowerCoef) >> PULSE_P_SHIFT ;
+	}
+
+	for (ii = 0 ; ii < TEMP_SENSOR_MAX ; ii++)
+	{
+		pSnap->temp [ii] = 200 << TEMP_SENSOR_SHIFT ;	// Invalid temperature
+	}
+	for (ii = 0 ; ii < TEMP_SENSOR_MAX ; ii++)
+	{
+		if (pTempSensors->sensors[ii].present != 0  &&  pTempSensors->sensors[ii].rank < TEMP_SENSOR_MAX)
+		{
+			pSnap->temp [pTempSensors->sensors[ii].rank] = pTempSensors->sensors[ii].rawTemp ;
+		}
+	}
+
+	liveSnapIx = ix ;
+}
+
+//--------------------------------------------------------------------------------
+//	Returns the last complete snapshot of the live values
+
+const liveSnap_t *	liveSnapGet (void)
+{
+	return & liveSnap [liveSnapIx] ;
+}
+
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
 //	The core AASUn task: the meter task
@@ -725,10 +775,7 @@ void	AASun ()
 	}
 
 	// Initialize energy counters and power history
-	readTotalEnergyCounters () ;		// Read permanent energy counters
-	memset (& energyJ,     0, sizeof (energyJ)) ;
-	memset (& dayEnergyWh, 0, sizeof (dayEnergyWh)) ;
-	dayEnergyWh.date = timeGetDayDate (& localTime) ;
+	// They are kept through a warm reset, else the day is restored from the flash day journal
 	if (! histoInit ())
 	{
 		aaPuts ("histoInit error\n") ;
@@ -1052,6 +1099,7 @@ void	AASun ()
 					energyJ.energyDiverted2 -= (3600 << POWER_DIVERTER_SHIFT) ;
 				}
 			}
+			warmStateSave () ;		// The energy counters are valid through a warm reset
 
 			// Check the diverting rules and select the appropriate channel
 			diverterNext () ;
@@ -1123,6 +1171,10 @@ void	AASun ()
 				}
 			}
 
+			// Publish the live values for the HTTP servers
+			liveSnapTake () ;
+			wizLanSignal () ;		// The event stream subscribers are served now
+
 			// Update the display after all data are updated
 			pageUpdate () ;
 
@@ -1312,6 +1364,9 @@ aaPrintf ("in         Get input values\n") ;
 aaPrintf ("out n v    Set output n to value v\n") ;
 aaPrintf ("f x        Flash test: i z w r m\n") ;
 aaPrintf ("df  a      Dump flash\n") ;
+aaPrintf ("mfs        Display MFS cache statistics\n") ;
+aaPrintf ("cgi        Display CGI cache statistics\n") ;
+aaPrintf ("wbench     W5500 SPI throughput benchmark\n") ;
 			aaPrintf ("q         Quit\n") ;
 		}
 
@@ -2423,8 +2478,8 @@ aaPrintf ("df  a      Dump flash\n") ;
 		{
 			// reset			=> MCU reset
 			// reset boot		=> Go to MCU internal downloader
+			// The power history of the day is kept in RAM and in the day journal
 			writeTotalEnergyCounters () ;				// Save of total energy counters
-			histoWrite (& dayEnergyWh, powerHistory) ;	// Save this day power history
 			if (pArg1 != NULL  &&  0 == strcmp ("boot", pArg1))
 			{
 				bspJumpToBootLoader () ;
@@ -2659,6 +2714,21 @@ aaPrintf ("df  a      Dump flash\n") ;
 			}
 		}
 
+		else if (0 == strcmp ("mfs", pCmd))		// MFS cache statistics
+		{
+			mfsCacheStat () ;
+		}
+
+		else if (0 == strcmp ("cgi", pCmd))		// CGI responses cache statistics
+		{
+			cgiCacheStat () ;
+		}
+
+		else if (0 == strcmp ("wbench", pCmd))	// W5500 SPI throughput, delegated to the LAN task
+		{
+			wizBench (0) ;
+		}
+
 		else if (0 == strcmp ("ti", pCmd))		// Display task info
 		{
 			displaytaskInfo (taskInfo) ;
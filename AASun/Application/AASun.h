@@ -144,6 +144,24 @@ typedef struct
 
 } computedData_t ;
 
+// A consistent copy of the live values, taken every second by the AASun task for the HTTP servers
+// There are 2 snapshots: the AASun task writes one while the servers read the other (see liveSnapTake)
+
+typedef struct
+{
+	uint32_t			generation ;		// Incremented every second
+	uint32_t			statusWord ;
+	computedData_t		computed ;
+	uint32_t			pulsePower [PULSE_COUNTER_MAX] ;	// Power of the pulse counters in W
+	energyCounters_t	energyWh ;
+	energyCounters_t	dayEnergyWh ;
+	int32_t				meterVolt ;
+	int32_t				meterBase ;
+	int32_t				meterPapp ;
+	int32_t				temp [TEMP_SENSOR_MAX] ;			// Raw temperature by sensor rank, 200 << TEMP_SENSOR_SHIFT if not present
+
+} liveSnap_t ;
+
 //--------------------------------------------------------------------------------
 //	Diverter descriptor: information to manage a diverting channel
 
@@ -201,9 +219,10 @@ EXTERN	int32_t			powerIntFactor ;	// (Derivative parameter is not used)
 EXTERN	eData_t			acquiredData ;		// Temporary buffer for AASun task
 EXTERN	computedData_t	computedData ;		// Computed by the AASun task every second
 
-EXTERN	energyCounters_t energyJ ;			// Energy accumulator in Joule
-EXTERN	energyCounters_t energyWh ;			// Energy total in Wh
-EXTERN	energyCounters_t dayEnergyWh ;		// Energy daily in Wh
+// Energy counters and power history are not initialized, to survive a warm reset (see histoInit)
+EXTERN	energyCounters_t energyJ     BSP_ATTR_NOINIT ;	// Energy accumulator in Joule
+EXTERN	energyCounters_t energyWh    BSP_ATTR_NOINIT ;	// Energy total in Wh
+EXTERN	energyCounters_t dayEnergyWh BSP_ATTR_NOINIT ;	// Energy daily in Wh
 
 EXTERN	int32_t			meterPapp ;			// Apparent power from the meter (Linky)
 EXTERN	int32_t			meterBase ;			// Energy total from meter
@@ -216,12 +235,15 @@ EXTERN	uint8_t			timeIsUpdated ;		// 0 Idle
 
 EXTERN	tempSensors_t	* pTempSensors ;
 
-EXTERN	powerH_t		powerHistory [POWER_HISTO_MAX_WHEADER] ;
-EXTERN	powerH_t		powerHistoryTemp ;		// To accumulate data for the current history period
-EXTERN	uint32_t		powerHistoIx ;
+EXTERN	powerH_t		powerHistory [POWER_HISTO_MAX_WHEADER] BSP_ATTR_NOINIT ;
+EXTERN	powerH_t		powerHistoryTemp BSP_ATTR_NOINIT ;		// To accumulate data for the current history period
+EXTERN	uint32_t		powerHistoIx     BSP_ATTR_NOINIT ;
 
 EXTERN	int32_t			aaSunVariable		[AASUNVAR_MAX] ;
 
+EXTERN	liveSnap_t		liveSnap [2] ;		// Snapshots of the live values
+EXTERN	uint32_t		liveSnapIx ;		// Index of the last complete snapshot in liveSnap[]
+
 EXTERN	uint32_t		wifiSoftwareVersion ;	// Version of the WIFI interface software
 EXTERN	uint32_t		wifiModeAP ;			// True if the WIFI interface is in "Access Point" mode
 
@@ -234,6 +256,8 @@ extern "C" {
 
 // in AASun.c
 uint32_t	AASunVersion			(void) ;
+void		liveSnapTake			(void) ;
+const liveSnap_t *	liveSnapGet		(void) ;
 
 // In adc.c
 void		adcDmaInit				(uint32_t bufferSize, uint16_t * pBuffer) ;
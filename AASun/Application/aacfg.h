@@ -90,7 +90,7 @@ typedef enum
 #define	AA_TASK_MAX						8u
 
 //	Max count of mutexes managed by the kernel
-#define	AA_MUTEX_MAX					4u
+#define	AA_MUTEX_MAX					5u
 
 //	Max count of semaphores  managed by the kernel
 #define	AA_SEM_MAX						6u
@@ -0,0 +1,229 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	cfgJournal.c	Journal of a structure in 2 alternate flash sectors, with delta records
+					Used for the configuration parameters.
+					Depends only on w25q.h: it is tested on the host with the flash emulator
+					(mfs/w25qTest/src/cfgJournalTest.c)
+
+	When		Who	What
+	18/10/26	ac	Creation, from cfgParameters.c
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<string.h>
+
+#include	"w25q.h"
+#include	"cfgJournal.h"
+
+//--------------------------------------------------------------------------------
+//	Each sector begins with a full record of the structure, followed by delta records
+//	which contain only the modified part of the structure.
+//	When a sector is full, the structure is written as a full record in the other sector
+//	(compaction). The old sector is erased only when it becomes the target of the next compaction,
+//	so a valid structure is always available in the flash, even after a reset during a write.
+
+//--------------------------------------------------------------------------------
+
+uint32_t	cfgSum (const void * pData, uint32_t length)
+{
+	const uint32_t	* pUint = (const uint32_t *) pData ;
+	uint32_t		cks = 0 ;
+	uint32_t		ii ;
+
+	for (ii = 0 ; ii < length / 4 ; ii++)
+	{
+		cks += * pUint++ ;
+	}
+	return cks ;
+}
+
+//--------------------------------------------------------------------------------
+//	Read and check the record at address
+//	Returns true if the record is valid, then * pHdr contains its header
+//	If the record is not valid, pHdr->magic allows to know if the place is free
+
+static	bool	cfgRecCheck (cfgJournal_t * pJournal, uint32_t address, uint32_t sectorEnd, cfgRecHdr_t * pHdr)
+{
+	uint32_t	buffer [16] ;
+	uint32_t	cks, remain, nn ;
+
+	W25Q_Read (pHdr, address, sizeof (cfgRecHdr_t)) ;
+	if ((pHdr->magic != CFGREC_FULL  &&  pHdr->magic != CFGREC_DELTA)  ||
+		 pHdr->length == 0  ||  (pHdr->length & 3u) != 0  ||  (pHdr->offset & 3u) != 0  ||
+		 pHdr->offset + pHdr->length > pJournal->size  ||
+		 address + sizeof (cfgRecHdr_t) + pHdr->length > sectorEnd)
+	{
+		return false ;
+	}
+
+	// Check the sum of the header and the data
+	cks     = cfgSum (pHdr, sizeof (cfgRecHdr_t)) ;
+	address += sizeof (cfgRecHdr_t) ;
+	remain  = pHdr->length ;
+	while (remain != 0)
+	{
+		nn = (remain > sizeof (buffer)) ? sizeof (buffer) : remain ;
+		W25Q_Read (buffer, address, nn) ;
+		cks     += cfgSum (buffer, nn) ;
+		address += nn ;
+		remain  -= nn ;
+	}
+	return cks == 0u ;
+}
+
+//--------------------------------------------------------------------------------
+//	Load the journal to pJournal->pFlash: the last full record, then the following deltas
+//	Returns false if there is no valid journal in the flash
+
+bool	cfgJournalLoad (cfgJournal_t * pJournal)
+{
+	cfgRecHdr_t		hdr ;
+	uint32_t		address, sectorEnd ;
+	uint32_t		ii ;
+
+	// Find the sector with the most recent full record
+	pJournal->sectorAddr = CFGJ_NO_SECTOR ;
+	for (ii = 0 ; ii < 2 ; ii++)
+	{
+		if (cfgRecCheck (pJournal, pJournal->sectors [ii], pJournal->sectors [ii] + W25Q_SECTOR_SIZE, & hdr)  &&
+			hdr.magic == CFGREC_FULL  &&  hdr.length == pJournal->size  &&
+			(pJournal->sectorAddr == CFGJ_NO_SECTOR  ||  hdr.seq > pJournal->seq))
+		{
+			pJournal->sectorAddr = pJournal->sectors [ii] ;
+			pJournal->seq        = hdr.seq ;
+		}
+	}
+	if (pJournal->sectorAddr == CFGJ_NO_SECTOR)
+	{
+		return false ;
+	}
+
+	address   = pJournal->sectorAddr + sizeof (cfgRecHdr_t) ;
+	sectorEnd = pJournal->sectorAddr + W25Q_SECTOR_SIZE ;
+	W25Q_Read (pJournal->pFlash, address, pJournal->size) ;
+	address += pJournal->size ;
+
+	// Apply the deltas
+	while (address + sizeof (cfgRecHdr_t) <= sectorEnd)
+	{
+		if (! cfgRecCheck (pJournal, address, sectorEnd, & hdr)  ||  hdr.magic != CFGREC_DELTA  ||  hdr.seq != pJournal->seq + 1u)
+		{
+			if (hdr.magic != CFGREC_FREE)
+			{
+				// Damaged record (reset during write): no more append in this sector
+				address = sectorEnd ;
+			}
+			break ;
+		}
+		W25Q_Read ((uint8_t *) pJournal->pFlash + hdr.offset, address + sizeof (cfgRecHdr_t), hdr.length) ;
+		pJournal->seq = hdr.seq ;
+		address += sizeof (cfgRecHdr_t) + hdr.length ;
+	}
+	pJournal->nextAddr = address ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Write a record from pData, then verify it
+
+static	bool	cfgRecWrite (cfgJournal_t * pJournal, const void * pData, uint32_t address, uint16_t magic, uint32_t offset, uint32_t length)
+{
+	cfgRecHdr_t		hdr ;
+	const uint8_t	* pRecData = (const uint8_t *) pData + offset ;
+
+	hdr.magic    = magic ;
+	hdr.length   = (uint16_t) length ;
+	hdr.offset   = (uint16_t) offset ;
+	hdr.reserved = 0 ;
+	hdr.seq      = pJournal->seq + 1u ;
+	hdr.ckSum    = 0 ;
+	hdr.ckSum    = 0u - (cfgSum (& hdr, sizeof (hdr)) + cfgSum (pRecData, length)) ;
+
+	W25Q_Write (& hdr, address, sizeof (hdr)) ;
+	W25Q_Write (pRecData, address + sizeof (hdr), length) ;
+
+	if (! cfgRecCheck (pJournal, address, (address & ~(W25Q_SECTOR_SIZE - 1u)) + W25Q_SECTOR_SIZE, & hdr))
+	{
+		return false ;
+	}
+	memcpy ((uint8_t *) pJournal->pFlash + offset, pRecData, length) ;
+	pJournal->seq      = hdr.seq ;
+	pJournal->nextAddr = address + sizeof (hdr) + length ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Write the full structure at the beginning of the other sector
+
+static	bool	cfgCompact (cfgJournal_t * pJournal, const void * pData)
+{
+	uint32_t	address ;
+
+	address = (pJournal->sectorAddr == pJournal->sectors [1]) ? pJournal->sectors [0] : pJournal->sectors [1] ;
+	W25Q_EraseSector (address) ;
+	if (! cfgRecWrite (pJournal, pData, address, CFGREC_FULL, 0, pJournal->size))
+	{
+		return false ;
+	}
+	pJournal->sectorAddr = address ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Write the structure pData to the journal
+//	Only the modified part of the structure is appended to the journal
+//	Returns false on write error
+
+bool	cfgJournalWrite (cfgJournal_t * pJournal, const void * pData)
+{
+	const uint32_t		* pNew = (const uint32_t *) pData ;
+	const uint32_t		* pOld = (const uint32_t *) pJournal->pFlash ;
+	uint32_t			ii, first, last ;
+	bool				bOk = false ;
+
+	if (pJournal->sectorAddr == CFGJ_NO_SECTOR)
+	{
+		// No journal yet
+		return cfgCompact (pJournal, pData) ;
+	}
+
+	// Find the modified words
+	first = pJournal->cmpSize / 4 ;
+	last  = 0 ;
+	for (ii = 0 ; ii < pJournal->cmpSize / 4 ; ii++)
+	{
+		if (pNew [ii] != pOld [ii])
+		{
+			if (first > ii)
+			{
+				first = ii ;
+			}
+			last = ii ;
+		}
+	}
+
+	if (first > last)
+	{
+		bOk = true ;	// Nothing modified
+	}
+	else if (pJournal->nextAddr + sizeof (cfgRecHdr_t) + (last - first + 1) * 4 <= pJournal->sectorAddr + W25Q_SECTOR_SIZE)
+	{
+		bOk = cfgRecWrite (pJournal, pData, pJournal->nextAddr, CFGREC_DELTA, first * 4, (last - first + 1) * 4) ;
+	}
+	if (! bOk)
+	{
+		// The sector is full, or write error
+		bOk = cfgCompact (pJournal, pData) ;
+	}
+	return bOk ;
+}
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	cfgJournal.h	Journal of a structure in 2 alternate flash sectors, with delta records
+
+	When		Who	What
+	18/10/26	ac	Creation, from cfgParameters.c
+
+----------------------------------------------------------------------
+*/
+#if ! defined CFGJOURNAL_H_
+#define CFGJOURNAL_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#define	CFGREC_FULL			0xCF01u		// Record magic values
+#define	CFGREC_DELTA		0xCF02u
+#define	CFGREC_FREE			0xFFFFu		// Erased flash
+#define	CFGJ_NO_SECTOR		0xFFFFFFFFu
+
+typedef struct
+{
+	uint16_t	magic ;			// CFGREC_FULL or CFGREC_DELTA
+	uint16_t	length ;		// Byte count of the data following this header, multiple of 4
+	uint16_t	offset ;		// Offset of the data in the structure
+	uint16_t	reserved ;
+	uint32_t	seq ;			// Sequence number of the record
+	uint32_t	ckSum ;			// The 32 bits sum of the header and the data is 0
+
+} cfgRecHdr_t ;
+
+// Size of a sector which contains the full record of a structure and at least 1 delta of 1 word
+#define	CFGJ_SECTOR_MIN(size)	(2u * sizeof (cfgRecHdr_t) + (size) + 4u)
+
+typedef struct
+{
+	uint32_t	sectors [2] ;	// The addresses of the 2 sectors
+	void		* pFlash ;		// The structure as written in the flash, to compute deltas
+	uint32_t	size ;			// Size of the structure, multiple of 4
+	uint32_t	cmpSize ;		// Byte count compared to find the delta: a trailing check sum may be excluded
+
+	uint32_t	sectorAddr ;	// The sector which contain the current structure, or CFGJ_NO_SECTOR
+	uint32_t	nextAddr ;		// Address of the next record to write in this sector
+	uint32_t	seq ;			// Sequence number of the last record
+
+} cfgJournal_t ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The caller owns the flash: W25Q_SpiTake()
+uint32_t	cfgSum				(const void * pData, uint32_t length) ;
+bool		cfgJournalLoad		(cfgJournal_t * pJournal) ;
+bool		cfgJournalWrite		(cfgJournal_t * pJournal, const void * pData) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// CFGJOURNAL_H_
@@ -14,13 +14,21 @@
 	When		Who	What
 	08/02/23	ac	Creation
 	16/07/23	ac	Add power history
+	18/10/26	ac	Configuration journal on 2 alternate sectors, with delta records
+	18/10/26	ac	Energy counters and power history kept through warm reset, day journal for cold boot
+	18/10/26	ac	The configuration journal is moved to cfgJournal.c, to be tested on the host
+	18/10/26	ac	The warm restart magic includes the layout of the no init variables
+	18/10/26	ac	The energy counter slots are moved to cfgSlots.c, their next slot is also found at warm restart
 
 ----------------------------------------------------------------------
 */
 
 #include	"AASun.h"
 #include	"w25q.h"
+#include	"cfgJournal.h"
+#include	"cfgSlots.h"
 #include	"string.h"
+#include	<stddef.h>		// offsetof
 
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
@@ -80,9 +88,10 @@ static const configParameters_t cfgDefault =
 //--------------------------------------------------------------------------------
 //	Flash topology: where to write items  (flash sector size: W25Q_SECTOR_SIZE = 4096)
 
-// The configuration offset in FLASH must not cross a sector boundary
-#define	FLASH_CFG_ADDR			(0u * W25Q_SECTOR_SIZE)						// Offset off the configuration in FLASH
-#define	FLASH_CFG_SECTOR		(FLASH_CFG_ADDR & ~(W25Q_SECTOR_SIZE-1))	// The offset of the sector which contain the cfg
+// The configuration journal uses 2 sectors alternately
+// FLASH_CFG_ADDR is also the place of the configuration written by previous software versions
+#define	FLASH_CFG_ADDR			(0u * W25Q_SECTOR_SIZE)						// Offset off the configuration sector A in FLASH
+#define	FLASH_CFG2_ADDR			(2u * W25Q_SECTOR_SIZE)						// Offset off the configuration sector B in FLASH
 
 // Total energy counters
 #define	FLASH_ENERGY_ADDR		(1u * W25Q_SECTOR_SIZE)						// Offset off the energy total in FLASH
@@ -94,15 +103,50 @@ static const configParameters_t cfgDefault =
 #define	FLASH_HISTO_ADDR		(8u * W25Q_SECTOR_SIZE)						// Offset off the history data in FLASH
 #define	FLASH_HISTO_SECTOR		(FLASH_HISTO_ADDR & ~(W25Q_SECTOR_SIZE-1))	// The offset of the sector which contain the history data
 
+// Day journal: 4 sectors
+#define	FLASH_DAYJ_ADDR			(3u * W25Q_SECTOR_SIZE)						// Offset off the day journal in FLASH
+#define	FLASH_DAYJ_SECTORS		4u
+#define	FLASH_DAYJ_SLOTSIZE		128u										// 1 page program per record
+#define	FLASH_DAYJ_SLOTCOUNT	((FLASH_DAYJ_SECTORS * W25Q_SECTOR_SIZE) / FLASH_DAYJ_SLOTSIZE)
+
 //--------------------------------------------------------------------------------
 
 configParameters_t aaSunCfg ;
 
-static	int32_t		energyNextWriteIx ; 	// The next index to write total energy counters
+// The total energy counters (cfgSlots.c)
+static	cfgSlots_t	energySlots =
+{
+	.sectorAddr = FLASH_ENERGY_SECTOR,
+	.slotSize   = FLASH_ENERGY_SLOTSIZE,
+	.slotCount  = FLASH_ENERGY_SLOTCOUNT,
+	.version    = ENERGYCNT_VERSION,
+} ;
+
 static	uint32_t	histoNextWriteIx ; 		// The next sector index to write history data
+static	uint32_t	dayJNextIx ; 			// The next slot index to write in the day journal
+static	bool		histoRestored ;			// The power history of a previous run has been restored at boot
+
+//--------------------------------------------------------------------------------
+//	Configuration journal (cfgJournal.c)
+//	A sector must contain a full record and at least 1 delta, else every write is a compaction
+
+STATIC_ASSERT_MSG (CFGJ_SECTOR_MIN (sizeof (configParameters_t)) <= W25Q_SECTOR_SIZE, configParameters_t_too_large) ;
+
+static	configParameters_t	cfgFlash ;		// The configuration as written in the flash, to compute deltas
+
+static	cfgJournal_t		cfgJournal =
+{
+	{ FLASH_CFG_ADDR, FLASH_CFG2_ADDR },
+	& cfgFlash,
+	sizeof (configParameters_t),
+	sizeof (configParameters_t) - 4u,		// The check sum is not part of the delta
+	CFGJ_NO_SECTOR,
+	0,
+	0
+} ;
 
 //--------------------------------------------------------------------------------
-// Read configuration from flash
+// Read configuration written by previous software versions: one structure at FLASH_CFG_ADDR
 
 static bool	readCfg_ (void)
 {
@@ -201,7 +245,13 @@ void	readCfg (void)
 	forceRuleRemoveAll () ;
 
 	W25Q_SpiTake () ;
-	if (readCfg_ () == 0u)
+	if (cfgJournalLoad (& cfgJournal))
+	{
+		aaSunCfg = cfgFlash ;
+		aaSunCfg.ckSum = 0u - (cfgSum (& aaSunCfg, sizeof (aaSunCfg)) - aaSunCfg.ckSum) ;
+	}
+	if ((cfgJournal.sectorAddr != CFGJ_NO_SECTOR  &&  aaSunCfg.version != CFGPARAM_VERSION)  ||
+		(cfgJournal.sectorAddr == CFGJ_NO_SECTOR  &&  readCfg_ () == 0u))
 	{
 		// Cfg in FLASH is invalid, use default values
 		aaSunCfg = cfgDefault ;
@@ -219,10 +269,10 @@ void	readCfg (void)
 
 //--------------------------------------------------------------------------------
 //	Write current configuration to FLASH
+//	Only the modified part of the configuration is appended to the journal
 
 bool	writeCfg (void)
 {
-	uint32_t			* pUint ;
 	uint32_t			ii, cks ;
 	bool				bOk ;
 
@@ -251,23 +301,13 @@ bool	writeCfg (void)
 	aaSunCfg.ckSum = 0 ;
 
 	// Compute the check sum
-	cks = 0 ;
-	pUint = (uint32_t *) & aaSunCfg ;
-	for (ii = 0 ; ii < sizeof (aaSunCfg) / 4 ; ii++)
-	{
-		cks += * pUint++ ;
-	}
+	cks = cfgSum (& aaSunCfg, sizeof (aaSunCfg)) ;
 	aaSunCfg.ckSum = 0u - cks ;
 
-	// Write the structure
 	W25Q_SpiTake () ;
-	W25Q_EraseSector (FLASH_CFG_SECTOR) ;
-	W25Q_Write (& aaSunCfg, FLASH_CFG_ADDR, sizeof (aaSunCfg)) ;
+	bOk = cfgJournalWrite (& cfgJournal, & aaSunCfg) ;
 	W25Q_SpiGive () ;
 
-	// Read the configuration to verify the write
-// TODO Do not read to this place (overrides the real cfg)
-	bOk = readCfg_ () ;
 	if (bOk)
 	{
 		statusWClear (STSW_NOT_FLASHCFG) ;	// The configuration in the flash is OK
@@ -298,63 +338,21 @@ void		defaultCfg (void)
 //	If we write 1 struct every half hour, the life of the Flash is:
 //	(100000 * 32) / (24 * 2) = 66666 days, or 182 years
 
-//--------------------------------------------------------------------------------
-//	Find the slot index in the FLASH sector of the last written energy struct
-//	Returns true  if found, then *pIx contain the slot index of the energy struct
-//	Returns false if not found
-
-static	bool energyFindLast (uint32_t * pIx)
-{
-	uint32_t	ii ;
-	uint32_t	data[2] ;	// Date + version
-	uint32_t	addr ;
-	uint32_t	last;
-
-	// Find the first virgin slot
-	// When the flash is erased the read value if FFFFFFFF
-	addr = FLASH_ENERGY_ADDR ;
-	last = 0 ;
-	for (ii = 0 ; ii < FLASH_ENERGY_SLOTCOUNT ; ii++)
-	{
-		W25Q_Read (& data, addr, sizeof (data)) ;
-		if (data [0] == 0xFFFFFFFF)
-		{
-			break ;
-		}
-		last = data [1] ;
-		addr += FLASH_ENERGY_SLOTSIZE ;
-	}
-	if (ii == 0)
-	{
-		// Not found: the sector is empty (freshly erased)
-		energyNextWriteIx = 0 ;
-		return false ;
-	}
-	energyNextWriteIx = ii ;
-	* pIx = ii - 1 ;
-	if (last == ENERGYCNT_VERSION)
-	{
-		return true ;	// Found
-	}
-	return false ; 		// Not found: bad version
-}
-
 //--------------------------------------------------------------------------------
 //	Read total energy counters from flash
 
 bool	readTotalEnergyCounters	(void)
 {
-	uint32_t	ix ;
+	uint32_t	addr ;
 	bool		res ;
 
 	W25Q_SpiTake () ;
 
 	// Find the last written energy struct
-	res = energyFindLast (& ix) ;
+	res = cfgSlotsFind (& energySlots, & addr) ;
 	if (res)
 	{
-		ix = FLASH_ENERGY_ADDR + (ix * FLASH_ENERGY_SLOTSIZE) ;
-		W25Q_Read (& energyWh, ix, sizeof (energyWh)) ;
+		W25Q_Read (& energyWh, addr, sizeof (energyWh)) ;
 	}
 	else
 	{
@@ -371,21 +369,9 @@ bool	readTotalEnergyCounters	(void)
 
 void	writeTotalEnergyCounters	(void)
 {
-	uint32_t	addr ;
-
 	W25Q_SpiTake () ;
-
-	if (energyNextWriteIx == FLASH_ENERGY_SLOTCOUNT)
-	{
-		// The sector is full: erase then write
-		W25Q_EraseSector (FLASH_ENERGY_SECTOR) ;
-		energyNextWriteIx = 0 ;
-	}
-
 	energyWh.version = ENERGYCNT_VERSION ;
-	addr = FLASH_ENERGY_ADDR + (energyNextWriteIx * FLASH_ENERGY_SLOTSIZE) ;
-	W25Q_Write (& energyWh, addr, sizeof (energyWh)) ;
-	energyNextWriteIx++ ;
+	cfgSlotsWrite (& energySlots, & energyWh, sizeof (energyWh)) ;
 	W25Q_SpiGive () ;
 }
 
@@ -425,6 +411,243 @@ static	void	powerHistoReset (void)
 	}
 }
 
+//--------------------------------------------------------------------------------
+//	Warm restart
+//	energyJ, energyWh, dayEnergyWh and the power history are in no init RAM (see AASun.h)
+//	They survive a reset without power loss (watchdog, reset command), and a firmware update
+//	if the new firmware has the same layout of these variables: the magic includes their
+//	addresses and sizes, ENERGYCNT_VERSION and POWER_HISTO_MAGIC (see warmMagic())
+//	warmState holds their CRC, it is checked at boot to know if they are still valid:
+//	- crcEnergy is updated every second by warmStateSave()
+//	- crcHisto  is updated when powerHistory changes (every history period)
+
+#define	WARM_MAGIC		(0x5741524Du + ENERGYCNT_VERSION)	// "WARM"
+
+typedef struct
+{
+	uint32_t		magic ;
+	uint32_t		crcEnergy ;		// Energy counters, powerHistoryTemp and powerHistoIx
+	uint32_t		crcHisto ;		// powerHistory
+
+} warmState_t ;
+
+static	warmState_t		warmState BSP_ATTR_NOINIT ;
+
+//--------------------------------------------------------------------------------
+//	CRC-32 (IEEE 802.3), can be chained: crc = warmCrc (crc, ...)
+
+static	uint32_t	warmCrc (uint32_t crc, const void * pData, uint32_t length)
+{
+	const uint8_t	* pByte = (const uint8_t *) pData ;
+	uint32_t		ii ;
+
+	crc = ~crc ;
+	while (length-- != 0u)
+	{
+		crc ^= * pByte++ ;
+		for (ii = 0 ; ii < 8u ; ii++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u))) ;
+		}
+	}
+	return ~crc ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	uint32_t	warmEnergyCrc (void)
+{
+	uint32_t	crc ;
+
+	crc = warmCrc (0,   & energyJ,          sizeof (energyJ)) ;
+	crc = warmCrc (crc, & energyWh,         sizeof (energyWh)) ;
+	crc = warmCrc (crc, & dayEnergyWh,      sizeof (dayEnergyWh)) ;
+	crc = warmCrc (crc, & powerHistoryTemp, sizeof (powerHistoryTemp)) ;
+	crc = warmCrc (crc, & powerHistoIx,     sizeof (powerHistoIx)) ;
+	return crc ;
+}
+
+//--------------------------------------------------------------------------------
+//	The magic of this firmware: WARM_MAGIC and the layout of the no init variables
+
+static	uint32_t	warmMagic (void)
+{
+	const uint32_t	layout [] =
+	{
+		(uint32_t) (uintptr_t) & warmState,			sizeof (warmState),
+		(uint32_t) (uintptr_t) & energyJ,			sizeof (energyJ),
+		(uint32_t) (uintptr_t) & energyWh,			sizeof (energyWh),
+		(uint32_t) (uintptr_t) & dayEnergyWh,		sizeof (dayEnergyWh),
+		(uint32_t) (uintptr_t) & powerHistoryTemp,	sizeof (powerHistoryTemp),
+		(uint32_t) (uintptr_t) & powerHistoIx,		sizeof (powerHistoIx),
+		(uint32_t) (uintptr_t) powerHistory,		sizeof (powerHistory),
+		POWER_HISTO_MAGIC
+	} ;
+
+	return warmCrc (WARM_MAGIC, layout, sizeof (layout)) ;
+}
+
+//--------------------------------------------------------------------------------
+//	To call after every update of the energy counters (every second)
+
+void	warmStateSave (void)
+{
+	warmState.crcEnergy = warmEnergyCrc () ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	warmHistoSave (void)
+{
+	warmState.crcHisto = warmCrc (0, powerHistory, sizeof (powerHistory)) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Returns true if the no init RAM contains valid energy counters and power history
+
+static	bool	warmStateCheck (void)
+{
+	return	warmState.magic == warmMagic ()  &&
+			powerHistoIx != 0u  &&  powerHistoIx < POWER_HISTO_MAX_WHEADER  &&
+			pHistoHeader->magic == POWER_HISTO_MAGIC  &&
+			warmState.crcEnergy == warmEnergyCrc ()  &&
+			warmState.crcHisto  == warmCrc (0, powerHistory, sizeof (powerHistory)) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Day journal
+//	At the end of every power history period a record is appended to the journal,
+//	so after a cold boot the power history and the daily energy of the day are restored.
+//	The last period of the day is not journaled: the day is written to the flash history.
+//	Slot 0 is the 1st record of the day. At day change the journal restarts at slot 0,
+//	a sector is erased when the 1st record is written in it.
+//	So at most 15 minutes of data are lost on power failure.
+//	A day uses 96 slots, the more slots allow for daylight saving jump back.
+//	The sectors are erased 1 time per day: 100000 days of life.
+
+#define	DAYJ_MAGIC		0xDA7A0001u
+
+typedef struct
+{
+	uint32_t			magic ;
+	int32_t				date ;			// Date of the day
+	uint32_t			ix ;			// Index in powerHistory of this period
+	powerH_t			power ;			// The power history of this period
+	energyCounters_t	dayEnergy ;		// The daily energy counters at the end of this period
+	uint32_t			ckSum ;
+
+} dayJRec_t ;
+
+STATIC_ASSERT_MSG (sizeof (dayJRec_t) <= FLASH_DAYJ_SLOTSIZE, dayJRec_t_too_large) ;
+
+//--------------------------------------------------------------------------------
+
+static	bool	dayJBlank (const dayJRec_t * pRec)
+{
+	const uint32_t	* pUint = (const uint32_t *) pRec ;
+	uint32_t		ii ;
+
+	for (ii = 0 ; ii < sizeof (dayJRec_t) / 4 ; ii++)
+	{
+		if (* pUint++ != 0xFFFFFFFFu)
+		{
+			return false ;
+		}
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	bool	dayJValid (const dayJRec_t * pRec)
+{
+	return	pRec->magic == DAYJ_MAGIC  &&
+			pRec->ix != 0u  &&  pRec->ix < POWER_HISTO_MAX  &&
+			pRec->ckSum == cfgSum (pRec, offsetof (dayJRec_t, ckSum)) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Find the end of the journal, and if bApply restore the power history and dayEnergyWh
+//	Records which are torn (power failure while writing) or of an older day are ignored
+//	Returns true if the journal contains at least 1 record
+
+static	bool	dayJournalLoad (bool bApply)
+{
+	dayJRec_t	rec ;
+	uint32_t	slot ;
+	int32_t		date = 0 ;
+	bool		res = false ;
+
+	dayJNextIx = 0 ;
+	W25Q_SpiTake () ;
+	for (slot = 0 ; slot < FLASH_DAYJ_SLOTCOUNT ; slot++)
+	{
+		W25Q_Read (& rec, FLASH_DAYJ_ADDR + (slot * FLASH_DAYJ_SLOTSIZE), sizeof (rec)) ;
+		if (dayJBlank (& rec))
+		{
+			break ;		// End of the journal
+		}
+		if (! dayJValid (& rec)  ||  (res  &&  rec.date != date))
+		{
+			continue ;
+		}
+		res  = true ;
+		date = rec.date ;
+		dayJNextIx = slot + 1u ;
+		if (bApply)
+		{
+			powerHistory [rec.ix] = rec.power ;
+			dayEnergyWh  = rec.dayEnergy ;
+			powerHistoIx = rec.ix + 1u ;
+		}
+	}
+	W25Q_SpiGive () ;
+
+	if (res  &&  bApply)
+	{
+		pHistoHeader->date = date ;
+	}
+	return res ;
+}
+
+//--------------------------------------------------------------------------------
+//	Append the power history of the period ix and the daily energy counters to the journal
+
+static	void	dayJournalAppend (uint32_t ix)
+{
+	dayJRec_t	rec ;
+	uint32_t	addr ;
+
+	W25Q_SpiTake () ;
+	while (dayJNextIx < FLASH_DAYJ_SLOTCOUNT)
+	{
+		addr = FLASH_DAYJ_ADDR + (dayJNextIx * FLASH_DAYJ_SLOTSIZE) ;
+		dayJNextIx++ ;
+		if ((addr & (W25Q_SECTOR_SIZE - 1u)) == 0u)
+		{
+			W25Q_EraseSector (addr) ;		// 1st slot of the sector: erase the records of older days
+		}
+		else
+		{
+			W25Q_Read (& rec, addr, sizeof (rec)) ;
+			if (! dayJBlank (& rec))
+			{
+				continue ;		// Torn record: use the next slot
+			}
+		}
+
+		rec.magic     = DAYJ_MAGIC ;
+		rec.date      = pHistoHeader->date ;
+		rec.ix        = ix ;
+		rec.power     = powerHistory [ix] ;
+		rec.dayEnergy = dayEnergyWh ;
+		rec.ckSum     = cfgSum (& rec, offsetof (dayJRec_t, ckSum)) ;
+		W25Q_Write (& rec, addr, sizeof (rec)) ;
+		break ;
+	}
+	W25Q_SpiGive () ;
+}
+
 //--------------------------------------------------------------------------------
 // If power history is not running:
 // then start power history
@@ -434,9 +657,12 @@ void	histoStart (void)
 {
 	uint32_t	count ;
 	uint32_t	ix, ss ;
+	uint32_t	date ;
 	bool		bStarted ;
+	bool		bKeepTemp = false ;
 
 	bStarted = statusWTest (STSW_PWR_HISTO_ON) ;	// true if the power history is already started
+	date     = timeGetDayDate (& localTime) ;
 
 	// Compute how many seconds to the end of the period: POWER_HISTO_PERIOD - ((mm*60+ss) % POWER_HISTO_PERIOD)
 	ss = (localTime.mm * 60) + localTime.ss ;
@@ -468,18 +694,49 @@ if (ix >= POWER_HISTO_MAX)
 }
 	ix++ ;	// To skip the header (with the date)
 
+	if (! bStarted)
+	{
+		if (histoRestored  &&  pHistoHeader->date == (int32_t) date)
+		{
+			// Continue the day restored at boot
+			bStarted  = true ;
+			bKeepTemp = (ix == powerHistoIx) ;	// Same period: keep the power accumulated before the reset
+		}
+		else
+		{
+			if (histoRestored)
+			{
+				// The restored day is over: save it to the flash history, if not already done
+				energyCounters_t	counters ;
+
+				if (! histoRead (0, & counters, NULL)  ||  counters.date != pHistoHeader->date)
+				{
+					histoWrite (& dayEnergyWh, powerHistory) ;
+				}
+				memset (& dayEnergyWh, 0, sizeof (dayEnergyWh)) ;
+				powerHistoReset () ;
+			}
+			dayJNextIx = 0 ;	// New day journal
+		}
+		histoRestored = false ;
+	}
+
 	if (bStarted  &&  ix < powerHistoIx)
 	{
 		// Jump back, clear the data ((daylight saving: 1 hour history lost)
 		memset (& powerHistory [ix], 0, ((powerHistoIx - ix) + 1) * sizeof (powerH_t)) ;
 	}
 	powerHistoIx  = ix ;
-	memset (& powerHistoryTemp, 0, sizeof (powerHistoryTemp)) ;
+	if (! bKeepTemp)
+	{
+		memset (& powerHistoryTemp, 0, sizeof (powerHistoryTemp)) ;
+	}
 aaPrintf ("ix:%u\n", ix) ;
 
 	// Set the date in the header
-	pHistoHeader->date = timeGetDayDate (& localTime) ;
+	pHistoHeader->date = date ;
 	dayEnergyWh.date = pHistoHeader->date ;
+	warmHistoSave () ;
 
 	statusWSet (STSW_PWR_HISTO_ON) ;
 }
@@ -541,6 +798,11 @@ void	histoNext (void)
 					pPowerHistory->powerPulse [0], pPowerHistory->powerPulse [1]) ;
 		}
 
+		if (powerHistoIx != POWER_HISTO_MAX)
+		{
+			dayJournalAppend (powerHistoIx) ;
+		}
+
 		// Next history record, if it is the last in the day, then write to flash
 		powerHistoIx ++ ;
 		if (powerHistoIx == POWER_HISTO_MAX_WHEADER)
@@ -555,11 +817,13 @@ void	histoNext (void)
 			// Reset daily power counters
 			powerHistoReset () ;
 			pHistoHeader->date = dayEnergyWh.date ; // Set the date in the power header
+			dayJNextIx = 0 ;						// New day journal
 		}
 		else
 		{
 			memset (& powerHistoryTemp, 0, sizeof (powerHistoryTemp)) ;
 		}
+		warmHistoSave () ;
 	}
 }
 
@@ -716,17 +980,51 @@ void	histoErase		(void)
 }
 
 //--------------------------------------------------------------------------------
+//	Initialize energy counters and power history
+//	After a warm reset they are still valid in no init RAM
+//	Else the total energy counters are read from flash, the day is restored from the day journal
 
 bool	histoInit (void)
 {
-	bool	res ;
+	bool		res ;
+	uint32_t	bootDate = timeGetDayDate (& localTime) ;	// The time is not known yet
 
 	res = histoFindNext (& histoNextWriteIx) ;
 	if (! res)
 	{
 		histoNextWriteIx = 0 ;
 	}
-	powerHistoReset () ;
+
+	if (warmStateCheck ())
+	{
+		uint32_t	addr ;
+
+		aaPuts ("Warm restart: energy counters kept\n") ;
+
+		// Only find the next slot to write the energy counters, and the end of the journal
+		W25Q_SpiTake () ;
+		(void) cfgSlotsFind (& energySlots, & addr) ;
+		W25Q_SpiGive () ;
+		(void) dayJournalLoad (false) ;
+	}
+	else
+	{
+		readTotalEnergyCounters () ;		// Read permanent energy counters
+		memset (& energyJ,     0, sizeof (energyJ)) ;
+		memset (& dayEnergyWh, 0, sizeof (dayEnergyWh)) ;
+		dayEnergyWh.date = bootDate ;
+		powerHistoReset () ;
+		if (dayJournalLoad (true))
+		{
+			aaPuts ("Power history restored from the day journal\n") ;
+		}
+	}
+	// The date of the power history is 0 or the boot date if the time was never known
+	histoRestored = pHistoHeader->date != 0  &&  pHistoHeader->date != (int32_t) bootDate ;
+
+	warmHistoSave () ;
+	warmStateSave () ;
+	warmState.magic = warmMagic () ;
 
 	return res ;
 }
@@ -740,13 +1038,22 @@ bool	histoInit (void)
 
 void	histoFlashErase (void)
 {
+	uint32_t	ii ;
+
 	// Erase history area
 	histoErase () ;
 
 	// Erase total energy area
 	W25Q_SpiTake () ;
-	W25Q_EraseSector (FLASH_ENERGY_ADDR) ;
+	cfgSlotsErase (& energySlots) ;
+
+	// Erase day journal area
+	for (ii = 0 ; ii < FLASH_DAYJ_SECTORS ; ii++)
+	{
+		W25Q_EraseSector (FLASH_DAYJ_ADDR + (ii * W25Q_SECTOR_SIZE)) ;
+	}
 	W25Q_SpiGive () ;
+	dayJNextIx = 0 ;
 }
 
 //--------------------------------------------------------------------------------
@@ -366,6 +366,7 @@ bool		histoCheckRank				(uint32_t rank, uint32_t * pAddrs) ;
 void		histoErase					(void) ;
 
 void		histoFlashErase				(void) ;
+void		warmStateSave				(void) ;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,93 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	cfgSlots.c	Records of a structure written in the successive slots of a flash sector
+				Used for the total energy counters.
+				Depends only on w25q.h: it is tested on the host with the flash emulator
+				(mfs/w25qTest/src/cfgSlotsTest.c)
+
+	When		Who	What
+	18/10/26	ac	Creation, from cfgParameters.c
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#include	"w25q.h"
+#include	"cfgSlots.h"
+
+//--------------------------------------------------------------------------------
+//	Each write uses the next free slot of the sector, the last written slot is the current record.
+//	When all the slots are written the sector is erased.
+//	nextIx must be known before any write, even if the record is not read (warm restart):
+//	a slot already written can't be programmed again.
+
+//--------------------------------------------------------------------------------
+//	Find the last written slot, and the next slot to write
+//	Returns true  if found, then *pAddr contain the address of the record
+//	Returns false if not found, or if the record has not the expected version
+
+bool	cfgSlotsFind (cfgSlots_t * pSlots, uint32_t * pAddr)
+{
+	uint32_t	ii ;
+	uint32_t	data[2] ;	// Date + version
+	uint32_t	addr ;
+	uint32_t	last;
+
+	// Find the first virgin slot
+	// When the flash is erased the read value if FFFFFFFF
+	addr = pSlots->sectorAddr ;
+	last = 0 ;
+	for (ii = 0 ; ii < pSlots->slotCount ; ii++)
+	{
+		W25Q_Read (& data, addr, sizeof (data)) ;
+		if (data [0] == 0xFFFFFFFF)
+		{
+			break ;
+		}
+		last = data [1] ;
+		addr += pSlots->slotSize ;
+	}
+	pSlots->nextIx = ii ;
+	if (ii == 0)
+	{
+		// Not found: the sector is empty (freshly erased)
+		return false ;
+	}
+	* pAddr = addr - pSlots->slotSize ;
+	if (last == pSlots->version)
+	{
+		return true ;	// Found
+	}
+	return false ; 		// Not found: bad version
+}
+
+//--------------------------------------------------------------------------------
+//	Write the record in the next slot of the sector
+
+void	cfgSlotsWrite (cfgSlots_t * pSlots, const void * pData, uint32_t size)
+{
+	if (pSlots->nextIx >= pSlots->slotCount)
+	{
+		// The sector is full: erase then write
+		cfgSlotsErase (pSlots) ;
+	}
+	W25Q_Write (pData, pSlots->sectorAddr + (pSlots->nextIx * pSlots->slotSize), size) ;
+	pSlots->nextIx++ ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	cfgSlotsErase (cfgSlots_t * pSlots)
+{
+	W25Q_EraseSector (pSlots->sectorAddr) ;
+	pSlots->nextIx = 0 ;
+}
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,48 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	cfgSlots.h	Records of a structure written in the successive slots of a flash sector
+
+	When		Who	What
+	18/10/26	ac	Creation, from cfgParameters.c
+
+----------------------------------------------------------------------
+*/
+#if ! defined CFGSLOTS_H_
+#define CFGSLOTS_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+// The 1st word of a record is never 0xFFFFFFFF, the 2nd is the version of the structure
+typedef struct
+{
+	uint32_t	sectorAddr ;	// The address of the sector
+	uint32_t	slotSize ;
+	uint32_t	slotCount ;
+	uint32_t	version ;		// The version of the records to find
+
+	uint32_t	nextIx ;		// The next slot to write
+
+} cfgSlots_t ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The caller owns the flash: W25Q_SpiTake()
+bool		cfgSlotsFind		(cfgSlots_t * pSlots, uint32_t * pAddr) ;
+void		cfgSlotsWrite		(cfgSlots_t * pSlots, const void * pData, uint32_t size) ;
+void		cfgSlotsErase		(cfgSlots_t * pSlots) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// CFGSLOTS_H_
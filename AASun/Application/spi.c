@@ -10,6 +10,8 @@
 	When		Who	What
 	07/12/22	ac	Creation
 	06/09/23	ac	Set pull down on W5500 MISO (get data 0 when the chip is physically absent)
+	18/10/26	ac	Add W5500 full duplex DMA read
+	18/10/26	ac	Add flash full duplex DMA read, W5500 DMA write can run while the CPU does something else
 
 ----------------------------------------------------------------------
 */
@@ -323,10 +325,13 @@ void	spiScreenDmaXfer (uint32_t bufferSize, uint8_t * pBuffer)
 
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
-//	W5500 Write DMA initialization: memory to SPI
+//	W5500 DMA initialization
+//	Write: memory to SPI
+//	Read:  SPI to memory, full duplex: the write channel sends the dummy bytes which generate the clock
 //	Doesn't use interrupt
 
 #define	W5500_WR_DMA_CHANNEL		LL_DMA_CHANNEL_5
+#define	W5500_RD_DMA_CHANNEL		LL_DMA_CHANNEL_6
 
 void	spiW5500DmaInit (void)
 {
@@ -345,6 +350,17 @@ void	spiW5500DmaInit (void)
 	// Only 1 DMA on this MCU so DMA channel is also MUX channel
 	((dmaMux_t *) DMAMUX1)->CCR [W5500_WR_DMA_CHANNEL] = LL_DMAMUX_REQ_SPI2_TX ;
 
+	// The read channel has the higher priority: a received byte must be removed before the next one
+	LL_DMA_ConfigTransfer  (DMA1, W5500_RD_DMA_CHANNEL,
+							LL_DMA_DIRECTION_PERIPH_TO_MEMORY |
+							LL_DMA_MODE_NORMAL                |
+							LL_DMA_PERIPH_NOINCREMENT         |
+							LL_DMA_MEMORY_INCREMENT           |
+							LL_DMA_PDATAALIGN_BYTE            |
+							LL_DMA_MDATAALIGN_BYTE            |
+							LL_DMA_PRIORITY_HIGH) ;
+
+	((dmaMux_t *) DMAMUX1)->CCR [W5500_RD_DMA_CHANNEL] = LL_DMAMUX_REQ_SPI2_RX ;
 }
 
 //--------------------------------------------------------------------------------
@@ -353,10 +369,19 @@ void	spiW5500DmaInit (void)
 // SPI should not be disabled/enabled because it causes noise on the CLK signal
 
 void	spiW5500WriteDmaXfer (uint32_t bufferSize, uint8_t * pBuffer)
+{
+	spiW5500WriteDmaStart (bufferSize, pBuffer) ;
+	spiW5500WriteDmaWait () ;
+}
+
+//--------------------------------------------------------------------------------
+// Start DMA, doesn't wait: spiW5500WriteDmaWait() must be called before the next SPI access
+// The buffer must remain unmodified until then
+
+void	spiW5500WriteDmaStart (uint32_t bufferSize, uint8_t * pBuffer)
 {
 	dma_t			* pDma = (dma_t *) DMA1 ;
 	dmaStream_t		* pStream = & pDma->stream [W5500_WR_DMA_CHANNEL] ;
-	uint32_t		tcMask ;
 
 	// Set DMA data parameter
 	pStream->CNDTR = bufferSize ;
@@ -371,6 +396,16 @@ void	spiW5500WriteDmaXfer (uint32_t bufferSize, uint8_t * pBuffer)
 
 	// Enable SPI DMA => this starts the transfer
 	w5500Spi->CR2 |= SPI_CR2_TXDMAEN ;
+}
+
+//--------------------------------------------------------------------------------
+// Wait for the end of the transfer started by spiW5500WriteDmaStart()
+
+void	spiW5500WriteDmaWait (void)
+{
+	dma_t			* pDma = (dma_t *) DMA1 ;
+	dmaStream_t		* pStream = & pDma->stream [W5500_WR_DMA_CHANNEL] ;
+	uint32_t		tcMask ;
 
 	// Wait for the end of DMA (~128 us)
 	tcMask = 1 << (1 + (4 * W5500_WR_DMA_CHANNEL)) ;		// TC bit in ISR
@@ -398,3 +433,145 @@ void	spiW5500WriteDmaXfer (uint32_t bufferSize, uint8_t * pBuffer)
 		(void) w5500Spi->DR ;
 	}
 }
+
+//--------------------------------------------------------------------------------
+// Start the read and write DMA then wait the read TC
+// CS must be set and the command sent before this function call
+
+void	spiW5500ReadDmaXfer (uint32_t bufferSize, uint8_t * pBuffer)
+{
+	static const uint8_t	dummy = 0u ;
+	dma_t			* pDma = (dma_t *) DMA1 ;
+	dmaStream_t		* pRxStream = & pDma->stream [W5500_RD_DMA_CHANNEL] ;
+	dmaStream_t		* pTxStream = & pDma->stream [W5500_WR_DMA_CHANNEL] ;
+	uint32_t		tcMask ;
+
+	// Empty RX FIFO
+	while ((w5500Spi->SR & SPI_SR_RXNE) != 0)
+	{
+		(void) w5500Spi->DR ;
+	}
+
+	// Set DMA data parameter
+	pRxStream->CNDTR = bufferSize ;
+	pRxStream->CMAR  = (uint32_t) pBuffer ;
+	pRxStream->CPAR  = (uint32_t) & w5500Spi->DR ;
+
+	pTxStream->CNDTR = bufferSize ;
+	pTxStream->CMAR  = (uint32_t) & dummy ;
+	pTxStream->CPAR  = (uint32_t) & w5500Spi->DR ;
+	pTxStream->CCR  &= ~DMA_CCR_MINC ;					// Always the same dummy byte
+
+	// Clear DMA channels flags
+	pDma->IFCR = (DMA_FLAG_ALLIF << (W5500_RD_DMA_CHANNEL << 2u)) | (DMA_FLAG_ALLIF << (W5500_WR_DMA_CHANNEL << 2u)) ;
+
+	// Enable RX before TX, so no received byte is lost
+	pRxStream->CCR |= DMA_CCR_EN ;
+	w5500Spi->CR2  |= SPI_CR2_RXDMAEN ;
+
+	// Enable TX DMA => this starts the transfer
+	pTxStream->CCR |= DMA_CCR_EN ;
+	w5500Spi->CR2  |= SPI_CR2_TXDMAEN ;
+
+	// Wait for the end of the read DMA: all bytes are received, so the SPI is idle
+	tcMask = 1 << (1 + (4 * W5500_RD_DMA_CHANNEL)) ;		// TC bit in ISR
+	while ((pDma->ISR & tcMask) == 0)
+	{
+	}
+	while ((w5500Spi->SR & SPI_SR_BSY) != 0u)
+	{
+	}
+
+	// Disable DMA channels, restore the write channel configuration
+	pRxStream->CCR &= ~DMA_CCR_EN ;
+	pTxStream->CCR &= ~DMA_CCR_EN ;
+	pTxStream->CCR |= DMA_CCR_MINC ;
+
+	// Disable SPI DMA
+	w5500Spi->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN) ;
+}
+
+//--------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------
+//	Flash Read DMA: SPI to memory, full duplex
+//	The screen channel (SPI1 TX) sends the dummy bytes, its configuration is restored at the end.
+//	The caller owns flashSpi, so the screen doesn't use its channel.
+//	Doesn't use interrupt
+
+#define	FLASH_RD_DMA_CHANNEL		LL_DMA_CHANNEL_7
+
+void	spiFlashDmaInit (void)
+{
+	LL_AHB1_GRP1_EnableClock (LL_AHB1_GRP1_PERIPH_DMA1) ;
+
+	LL_DMA_ConfigTransfer  (DMA1, FLASH_RD_DMA_CHANNEL,
+							LL_DMA_DIRECTION_PERIPH_TO_MEMORY |
+							LL_DMA_MODE_NORMAL                |
+							LL_DMA_PERIPH_NOINCREMENT         |
+							LL_DMA_MEMORY_INCREMENT           |
+							LL_DMA_PDATAALIGN_BYTE            |
+							LL_DMA_MDATAALIGN_BYTE            |
+							LL_DMA_PRIORITY_HIGH) ;
+
+	((dmaMux_t *) DMAMUX1)->CCR [FLASH_RD_DMA_CHANNEL] = LL_DMAMUX_REQ_SPI1_RX ;
+}
+
+//--------------------------------------------------------------------------------
+// Start the read and write DMA then wait the read TC
+// CS must be set and the command sent before this function call
+
+void	spiFlashReadDmaXfer (uint32_t bufferSize, uint8_t * pBuffer)
+{
+	static const uint8_t	dummy = 0x55u ;
+	dma_t			* pDma = (dma_t *) DMA1 ;
+	dmaStream_t		* pRxStream = & pDma->stream [FLASH_RD_DMA_CHANNEL] ;
+	dmaStream_t		* pTxStream = & pDma->stream [SCR_DMA_CHANNEL] ;
+	uint32_t		txCcr = pTxStream->CCR ;
+	uint32_t		txMux = ((dmaMux_t *) DMAMUX1)->CCR [SCR_DMA_CHANNEL] ;
+	uint32_t		tcMask ;
+
+	// Empty RX FIFO
+	while ((flashSpi->SR & SPI_SR_RXNE) != 0)
+	{
+		(void) flashSpi->DR ;
+	}
+
+	// Set DMA data parameter
+	pRxStream->CNDTR = bufferSize ;
+	pRxStream->CMAR  = (uint32_t) pBuffer ;
+	pRxStream->CPAR  = (uint32_t) & flashSpi->DR ;
+
+	pTxStream->CCR   = DMA_CCR_DIR ;				// Memory to SPI, bytes, no increment: always the same dummy byte
+	pTxStream->CNDTR = bufferSize ;
+	pTxStream->CMAR  = (uint32_t) & dummy ;
+	pTxStream->CPAR  = (uint32_t) & flashSpi->DR ;
+	((dmaMux_t *) DMAMUX1)->CCR [SCR_DMA_CHANNEL] = LL_DMAMUX_REQ_SPI1_TX ;
+
+	// Clear DMA channels flags
+	pDma->IFCR = (DMA_FLAG_ALLIF << (FLASH_RD_DMA_CHANNEL << 2u)) | (DMA_FLAG_ALLIF << (SCR_DMA_CHANNEL << 2u)) ;
+
+	// Enable RX before TX, so no received byte is lost
+	pRxStream->CCR |= DMA_CCR_EN ;
+	flashSpi->CR2  |= SPI_CR2_RXDMAEN ;
+
+	// Enable TX DMA => this starts the transfer
+	pTxStream->CCR |= DMA_CCR_EN ;
+	flashSpi->CR2  |= SPI_CR2_TXDMAEN ;
+
+	// Wait for the end of the read DMA: all bytes are received, so the SPI is idle
+	tcMask = 1 << (1 + (4 * FLASH_RD_DMA_CHANNEL)) ;		// TC bit in ISR
+	while ((pDma->ISR & tcMask) == 0)
+	{
+	}
+	while ((flashSpi->SR & SPI_SR_BSY) != 0u)
+	{
+	}
+
+	// Disable DMA channels, restore the screen channel configuration
+	pRxStream->CCR &= ~DMA_CCR_EN ;
+	pTxStream->CCR  = txCcr & ~DMA_CCR_EN ;
+	((dmaMux_t *) DMAMUX1)->CCR [SCR_DMA_CHANNEL] = txMux ;
+
+	// Disable SPI DMA
+	flashSpi->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN) ;
+}
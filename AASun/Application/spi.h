@@ -54,9 +54,16 @@ uint32_t	spiTxRxByte				(SPI_TypeDef * pSpi, uint32_t byte) ;
 void		spiScreenDmaInit		(void) ;
 void		spiScreenDmaXfer		(uint32_t bufferSize, uint8_t * pBuffer) ;
 
-// W5500 DMA (TX only)
+// W5500 DMA
 void		spiW5500DmaInit			(void) ;
 void		spiW5500WriteDmaXfer	(uint32_t bufferSize, uint8_t * pBuffer) ;
+void		spiW5500WriteDmaStart	(uint32_t bufferSize, uint8_t * pBuffer) ;
+void		spiW5500WriteDmaWait	(void) ;
+void		spiW5500ReadDmaXfer		(uint32_t bufferSize, uint8_t * pBuffer) ;
+
+// Flash DMA (read only)
+void		spiFlashDmaInit			(void) ;
+void		spiFlashReadDmaXfer		(uint32_t bufferSize, uint8_t * pBuffer) ;
 
 #ifdef __cplusplus
 }
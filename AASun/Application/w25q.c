@@ -8,6 +8,10 @@
 
 	When		Who	What
 	23/02/23	ac	Creation
+	18/10/26	ac	Sector and block erase can be suspended to allow other tasks to read the flash
+	18/10/26	ac	Add stream read with DMA
+	18/10/26	ac	The erase is no longer suspended by any W25Q_SpiTake(): the flash has an owner,
+					only W25Q_SpiTakeRead() readers can suspend an erase, outside the erased range
 
 ----------------------------------------------------------------------
 */
@@ -43,9 +47,14 @@
 #define W25Q_POWERDOWN_RELEASE	0xAB
 #define W25Q_RESET_ENABLE		0x66
 #define W25Q_RESET				0x99
+#define W25Q_SUSPEND			0x75	// Erase/Program suspend
+#define W25Q_RESUME				0x7A	// Erase/Program resume
 
 #define	W25Q_SR1_BUSY			0x01	// Erase/Write in Progress
 #define	W25Q_SR1_WEL			0x02	// Write Enable Latch
+#define	W25Q_SR2_SUS			0x80	// Erase/Program suspended
+
+#define	W25Q_TSUS_US			20		// Suspend latency, and min time from resume to next suspend
 
 #define	W25Q_BLOCK_SIZE			(64*1024)
 
@@ -57,31 +66,102 @@
 
 // All this is resolved into constants at compile time to get the minimal code.
 
+#if (! defined csSet)		// The host test of mfs/w25qTest provides its own chip select
 #define	csSet()		CS_PORT->BSRR = (1u << (CS_PIN + 16))		// Set chip select to active   state: 0
 #define	csClear()	CS_PORT->BSRR = (1u << CS_PIN)				// Set chip select to inactive state: 1
+#endif
 
 #define	W25Q_SPI_DIV		LL_SPI_BAUDRATEPRESCALER_DIV2		// To get 32 MHz from 64 MHz
 
+//--------------------------------------------------------------------------------
+//	Flash owner and sector/block erase state
+//	W25Q_SpiTake() gives the flash to a task until W25Q_SpiGive(): its sequences of
+//	erase, write and read are not interleaved with the accesses of other tasks.
+//	While the owner waits for the end of an erase the SPI is released, but the flash is not.
+//	Only a W25Q_SpiTakeRead() reader can then use the flash: the erase is suspended
+//	until W25Q_SpiGiveRead() if the range to read is outside the erased range.
+
+#define	W25Q_ERASE_NONE			0		// No erase in progress
+#define	W25Q_ERASE_RUN			1		// Erase in progress, the SPI is released by the flash owner
+#define	W25Q_ERASE_SUSPENDED	2		// Erase suspended by a reader which owns the SPI
+
+static	volatile uint8_t	eraseState = W25Q_ERASE_NONE ;
+static	volatile uint32_t	eraseAddress ;	// The range being erased
+static	volatile uint32_t	eraseSize ;
+
+static	aaMutexId_t			w25qMutexId = AA_INVALID_MUTEX ;	// The owner of the flash
+
+static	void	eraseSuspend	(void) ;
+static	void	eraseResume		(void) ;
+
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
 //	This doesn't initialize the GPIO or the SPI
 //	It configure the SPI for FLASH communication: the SPI is shared among many devices
 
-void	W25Q_SpiTake 	(void)
+static	void	spiTakeRaw 	(void)
 {
 	spiTake        (flashSpi) ;
 	spiSetBaudRate (flashSpi, W25Q_SPI_DIV) ;
 	spiModeDuplex  (flashSpi) ;
 }
 
+//	Take the flash for any sequence of accesses
+
+void	W25Q_SpiTake 	(void)
+{
+	aaMutexTake (w25qMutexId, AA_INFINITE) ;
+	spiTakeRaw () ;
+}
+
 void	W25Q_SpiGive	(void)
 {
 	spiGive (flashSpi) ;
+	aaMutexGive (w25qMutexId) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Take the flash to read data which is not modified by the sequences of the flash owner,
+//	E.G.: the MFS. The caller only reads the range [address, address + size[
+//	If the owner waits for the end of an erase outside this range, the erase is suspended.
+//	If the range overlaps the erased range, wait for the end of the erase.
+
+void	W25Q_SpiTakeRead	(uint32_t address, uint32_t size)
+{
+	spiTakeRaw () ;
+	while (eraseState == W25Q_ERASE_RUN  &&
+		   address < eraseAddress + eraseSize  &&  address + size > eraseAddress)
+	{
+		spiGive (flashSpi) ;
+		aaTaskDelay (1) ;
+		spiTakeRaw () ;
+	}
+	if (eraseState == W25Q_ERASE_RUN)
+	{
+		eraseSuspend () ;
+	}
+}
+
+void	W25Q_SpiGiveRead	(void)
+{
+	if (eraseState == W25Q_ERASE_SUSPENDED)
+	{
+		eraseResume () ;
+	}
+	spiGive (flashSpi) ;
 }
 
 void	W25Q_Init (void)
 {
 	csClear () ;
+	if (w25qMutexId == AA_INVALID_MUTEX)
+	{
+		// Initialize only once
+		if (AA_ENONE != aaMutexCreate (& w25qMutexId))
+		{
+			AA_ASSERT (0) ;
+		}
+	}
 }
 
 //--------------------------------------------------------------------------------
@@ -123,6 +203,84 @@ void	W25Q_WaitWhileBusy (void)
 	csClear () ;
 }
 
+//--------------------------------------------------------------------------------
+//	Suspend the erase in progress. Read and page program are allowed while suspended.
+//	If the erase ended before the suspend command, the command is ignored by the flash.
+
+static	void	eraseSuspend (void)
+{
+	uint32_t	sr2 ;
+
+	csSet () ;
+	spiTxRxByte (flashSpi, W25Q_SUSPEND) ;
+	csClear () ;
+	bspDelayUs (W25Q_TSUS_US) ;
+
+	while ((W25Q_ReadSR1 () & W25Q_SR1_BUSY) != 0u)
+	{
+	}
+
+	csSet () ;
+	spiTxRxByte (flashSpi, W25Q_READ_SR2) ;
+	sr2 = spiTxRxByte (flashSpi, 0) ;
+	csClear () ;
+
+	if ((sr2 & W25Q_SR2_SUS) != 0u)
+	{
+		eraseState = W25Q_ERASE_SUSPENDED ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	eraseResume (void)
+{
+	csSet () ;
+	spiTxRxByte (flashSpi, W25Q_RESUME) ;
+	csClear () ;
+	eraseState = W25Q_ERASE_RUN ;
+
+	// A new suspend is not allowed before tSUS,
+	// and this guarantees the erase progress when reads are frequent
+	bspDelayUs (W25Q_TSUS_US) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Wait for the end of a sector or block erase
+//	The SPI is released while waiting, so W25Q_SpiTakeRead() readers can access the flash
+
+static	void	waitEraseEnd (void)
+{
+	uint32_t	sr1 ;
+
+	eraseState = W25Q_ERASE_RUN ;
+	do
+	{
+		spiGive (flashSpi) ;
+		aaTaskDelay (1) ;
+		spiTakeRaw () ;
+		sr1 = W25Q_ReadSR1 () ;
+	} while ((sr1 & W25Q_SR1_BUSY) != 0u) ;
+	eraseState = W25Q_ERASE_NONE ;
+}
+
+//--------------------------------------------------------------------------------
+//	Start a sector or block erase, and wait for its end
+
+static	void	eraseStart (uint8_t cmd, uint32_t address, uint32_t size)
+{
+	eraseAddress = address ;
+	eraseSize    = size ;
+	W25Q_WriteEnable () ;
+	csSet () ;
+	spiTxRxByte (flashSpi, cmd) ;
+	spiTxRxByte (flashSpi, (address >> 16) & 0xFF) ;
+	spiTxRxByte (flashSpi, (address >>  8) & 0xFF) ;
+	spiTxRxByte (flashSpi, (address & 0xFF)) ;
+	csClear () ;
+	waitEraseEnd () ;
+}
+
 //--------------------------------------------------------------------------------
 //	Returns 1  if the flash is erase/write busy, else 0
 
@@ -212,6 +370,31 @@ void	W25Q_Read	(void * pBuffer, uint32_t address, uint32_t byteCount)
 	csClear () ;
 }
 
+//--------------------------------------------------------------------------------
+//	Stream read: a continuous read of the flash in several parts, using DMA
+//	The caller must own the SPI (W25Q_SpiTake) from W25Q_ReadStreamStart() to W25Q_ReadStreamEnd()
+
+void	W25Q_ReadStreamStart	(uint32_t address)
+{
+	csSet () ;
+	spiTxRxByte (flashSpi, W25Q_READ) ;
+	spiTxRxByte (flashSpi, (address >> 16) & 0xFF) ;
+	spiTxRxByte (flashSpi, (address >>  8) & 0xFF) ;
+	spiTxRxByte (flashSpi, (address & 0xFF)) ;
+}
+
+void	W25Q_ReadStream	(void * pBuffer, uint32_t byteCount)
+{
+	AA_ASSERT (pBuffer != 0 &&  byteCount != 0) ;
+
+	spiFlashReadDmaXfer (byteCount, (uint8_t *) pBuffer) ;
+}
+
+void	W25Q_ReadStreamEnd	(void)
+{
+	csClear () ;
+}
+
 //--------------------------------------------------------------------------------
 //	Pages addresses are aligned on page size
 //	The address range to write must not cross a page boundary
@@ -279,19 +462,13 @@ void	W25Q_Write	(const void * pBuffer, uint32_t address, uint32_t byteCount)
 //--------------------------------------------------------------------------------
 //	address must be a multiple of W25Q_SECTOR_SIZE
 //	Erase time from 60 to 400 ms
+//	Sector and block erases are suspended when a reader calls W25Q_SpiTakeRead()
 
 void		W25Q_EraseSector	(uint32_t address)
 {
 	AA_ASSERT ((address & (W25Q_SECTOR_SIZE - 1u)) == 0u) ;
 
-	W25Q_WriteEnable () ;
-	csSet () ;
-	spiTxRxByte (flashSpi, W25Q_SECTOR_ERASE) ;
-	spiTxRxByte (flashSpi, (address >> 16) & 0xFF) ;
-	spiTxRxByte (flashSpi, (address >>  8) & 0xFF) ;
-	spiTxRxByte (flashSpi, (address & 0xFF)) ;
-	csClear () ;
-	W25Q_WaitWhileBusy () ;
+	eraseStart (W25Q_SECTOR_ERASE, address, W25Q_SECTOR_SIZE) ;
 }
 
 //--------------------------------------------------------------------------------
@@ -302,14 +479,7 @@ void		W25Q_EraseBlock32	(uint32_t address)
 {
 	AA_ASSERT ((address & ((32*1024) - 1u)) == 0u) ;
 
-	W25Q_WriteEnable () ;
-	csSet () ;
-	spiTxRxByte (flashSpi, W25Q_BLOCK32_ERASE) ;
-	spiTxRxByte (flashSpi, (address >> 16) & 0xFF) ;
-	spiTxRxByte (flashSpi, (address >>  8) & 0xFF) ;
-	spiTxRxByte (flashSpi, (address & 0xFF)) ;
-	csClear () ;
-	W25Q_WaitWhileBusy () ;
+	eraseStart (W25Q_BLOCK32_ERASE, address, 32*1024) ;
 }
 
 //--------------------------------------------------------------------------------
@@ -320,18 +490,12 @@ void		W25Q_EraseBlock64	(uint32_t address)
 {
 	AA_ASSERT ((address & ((64*1024) - 1u)) == 0u) ;
 
-	W25Q_WriteEnable () ;
-	csSet () ;
-	spiTxRxByte (flashSpi, W25Q_BLOCK64_ERASE) ;
-	spiTxRxByte (flashSpi, (address >> 16) & 0xFF) ;
-	spiTxRxByte (flashSpi, (address >>  8) & 0xFF) ;
-	spiTxRxByte (flashSpi, (address & 0xFF)) ;
-	csClear () ;
-	W25Q_WaitWhileBusy () ;
+	eraseStart (W25Q_BLOCK64_ERASE, address, 64*1024) ;
 }
 
 //--------------------------------------------------------------------------------
 //	Erase time up to 100 s
+//	The chip erase can't be suspended
 
 void		W25Q_EraseChip		(void)
 {
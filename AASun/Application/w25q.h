@@ -7,6 +7,7 @@
 
 	When		Who	What
 	23/02/23	ac	Creation
+	18/10/26	ac	Add W25Q_SpiTakeRead()/W25Q_SpiGiveRead()
 
 ----------------------------------------------------------------------
 */
@@ -24,6 +25,8 @@ extern "C" {
 void		W25Q_Init			(void) ;
 void		W25Q_SpiTake		(void) ;
 void		W25Q_SpiGive		(void) ;
+void		W25Q_SpiTakeRead	(uint32_t address, uint32_t size) ;
+void		W25Q_SpiGiveRead	(void) ;
 
 uint32_t	W25Q_ReadDeviceId	(void) ;
 uint32_t	W25Q_ReadSR1		(void) ;
@@ -31,6 +34,9 @@ void		W25Q_WriteSR1		(uint8_t sr1) ;
 uint32_t	W25Q_WriteEnable	(void) ;
 void		W25Q_WriteDisable	(void) ;
 void		W25Q_Read			(void * pBuffer, uint32_t address, uint32_t byteCount) ;
+void		W25Q_ReadStreamStart(uint32_t address) ;
+void		W25Q_ReadStream		(void * pBuffer, uint32_t byteCount) ;
+void		W25Q_ReadStreamEnd	(void) ;
 void		W25Q_Write			(const void * pBuffer, uint32_t address, uint32_t byteCount) ;
 void		W25Q_WritePage		(const uint8_t * pBuffer, uint32_t address, uint32_t byteCount) ;
 void		W25Q_EraseSector	(uint32_t address) ;
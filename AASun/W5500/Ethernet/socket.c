@@ -314,7 +314,8 @@ int8_t disconnect(uint8_t sn)
 	return SOCK_OK;
 }
 
-int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
+// AdAstra: common to send() and send_fill(): the data come from buf, or are written to the TX memory by fill
+static int32_t send_common(uint8_t sn, uint8_t * buf, uint16_t len, send_fill_t fill, void * arg)
 {
    uint8_t tmp=0;
    uint16_t freesize=0;
@@ -366,7 +367,14 @@ int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
       if( (sock_io_mode & (1<<sn)) && (len > freesize) ) return SOCK_BUSY;
       if(len <= freesize) break;
    }
-   wiz_send_data(sn, buf, len);
+   if(fill)
+   {
+      uint16_t ptr = getSn_TX_WR(sn);
+      fill(sn, ptr, len, arg);
+      setSn_TX_WR(sn, (uint16_t)(ptr + len));
+   }
+   else
+      wiz_send_data(sn, buf, len);
    #if _WIZCHIP_ == 5200
       sock_next_rd[sn] = getSn_TX_RD(sn) + len;
    #endif
@@ -384,6 +392,17 @@ int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
    return (int32_t)len;
 }
 
+int32_t send(uint8_t sn, uint8_t * buf, uint16_t len)
+{
+   return send_common(sn, buf, len, 0, 0);
+}
+
+// AdAstra
+int32_t send_fill(uint8_t sn, uint16_t len, send_fill_t fill, void * arg)
+{
+   return send_common(sn, 0, len, fill, arg);
+}
+
 
 int32_t recv(uint8_t sn, uint8_t * buf, uint16_t len)
 {
@@ -251,6 +251,22 @@ int8_t  disconnect(uint8_t sn);
  */
 int32_t send(uint8_t sn, uint8_t * buf, uint16_t len);
 
+// AdAstra: the function which writes len bytes to the socket sn TX memory, at the W5500 TX pointer ptr
+typedef void (*send_fill_t)(uint8_t sn, uint16_t ptr, uint16_t len, void * arg);
+
+/**
+ * @ingroup WIZnet_socket_APIs
+ * @brief	AdAstra: send() without source buffer.
+ * @details The data are written to the socket TX memory by the fill function, at the W5500 TX pointer ptr.
+ *          This allows to copy the data straight from another device (e.g. a flash) to the W5500.
+ * @param sn Socket number. It should be <b>0 ~ @ref \_WIZCHIP_SOCK_NUM_</b>.
+ * @param len The byte length of data to send, fill must write exactly len bytes.
+ * @param fill The function which writes the data.
+ * @param arg Provided to fill.
+ * @return	The same as send().
+ */
+int32_t send_fill(uint8_t sn, uint16_t len, send_fill_t fill, void * arg);
+
 /**
  * @ingroup WIZnet_socket_APIs
  * @brief	Receive data from the connected peer.
@@ -0,0 +1,181 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	cgiCache.c	Cache of the CGI GET responses, common to the LAN and WIFI servers
+
+	When		Who	What
+	18/10/26	ac	Creation
+	18/10/26	ac	The key is the parameter string, not only its hash
+
+----------------------------------------------------------------------
+
+	The live values change once per second (see liveSnapTake), so a CGI response
+	can be served again to every client which requests it during the same second.
+	A response is identified by its CGI descriptor and the request parameters.
+	The hash of the parameters speeds up the search, the parameters are compared
+	to avoid serving the response of another request with the same hash.
+
+	The parameters and the responses are stored one after the other in a small memory pool.
+	When the generation of the live values snapshot changes the whole cache is discarded,
+	so there is no need to free individual responses.
+	The POST CGI modify the configuration: they discard the whole cache too.
+	A configuration modified from the console is seen by the web pages within 1 second.
+
+	The LAN and WIFI servers both run in the low priority task: no exclusive access is needed.
+
+----------------------------------------------------------------------
+*/
+
+#include	<string.h>
+#include	"aa.h"
+#include	"aaprintf.h"
+#include	"AASun.h"
+#include	"cgiCache.h"
+
+typedef struct
+{
+	const void	* pDesc ;		// The CGI descriptor
+	uint32_t	hash ;			// Hash of the request parameters
+	uint16_t	offset ;		// Offset of the parameters in cachePool, followed by the response
+	uint16_t	paramLen ;		// Length of the parameters
+	uint16_t	len ;			// Length of the response
+
+} cgiCacheSlot_t ;
+
+static	cgiCacheSlot_t	cacheSlots [CGI_CACHE_SLOTS] ;
+static	uint8_t			cachePool [CGI_CACHE_POOL] ;
+static	uint32_t		cacheSlotCount ;		// Count of used slots
+static	uint32_t		cachePoolUsed ;			// Count of used bytes in cachePool
+static	uint32_t		cacheGeneration ;		// The snapshot generation of the cached responses
+static	cgiCacheStat_t	cacheStat ;
+
+//--------------------------------------------------------------------------------
+//	Discard the responses of a previous second
+
+static	void	cacheCheckGeneration (void)
+{
+	uint32_t	generation = liveSnapGet ()->generation ;
+
+	if (generation != cacheGeneration)
+	{
+		cacheGeneration = generation ;
+		cgiCacheFlush () ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Copy the request parameters to the key, and compute their FNV-1a hash
+//	Must be called before the parameters are parsed: findParam() modifies the string
+//	Returns false if the parameters are too long to be cached
+
+bool	cgiCacheKey (cgiCacheKey_t * pKey, const char * pUriData)
+{
+	uint32_t	hash = 2166136261u ;
+	uint32_t	len  = 0 ;
+
+	while (pUriData [len] != 0)
+	{
+		if (len == CGI_CACHE_PARAM_MAX)
+		{
+			return false ;
+		}
+		pKey->params [len] = pUriData [len] ;
+		hash ^= (uint8_t) pUriData [len++] ;
+		hash *= 16777619u ;
+	}
+	pKey->hash = hash ;
+	pKey->len  = (uint16_t) len ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Copy a cached response to buf
+//	Returns false if the response is not in the cache
+
+bool	cgiCacheGet (const void * pDesc, const cgiCacheKey_t * pKey, uint8_t * buf, uint32_t lenMax, uint32_t * pLen)
+{
+	cgiCacheSlot_t	* pSlot = cacheSlots ;
+	uint32_t		ii ;
+
+	cacheCheckGeneration () ;
+	for (ii = 0 ; ii < cacheSlotCount ; ii++, pSlot++)
+	{
+		if (pSlot->pDesc == pDesc  &&  pSlot->hash == pKey->hash  &&  pSlot->paramLen == pKey->len  &&
+			pSlot->len <= lenMax  &&  memcmp (& cachePool [pSlot->offset], pKey->params, pKey->len) == 0)
+		{
+			memcpy (buf, & cachePool [pSlot->offset + pSlot->paramLen], pSlot->len) ;
+			* pLen = pSlot->len ;
+			cacheStat.hit++ ;
+			return true ;
+		}
+	}
+	cacheStat.miss++ ;
+	return false ;
+}
+
+//--------------------------------------------------------------------------------
+//	Add a response to the cache, if there is room for it
+
+void	cgiCachePut (const void * pDesc, const cgiCacheKey_t * pKey, const uint8_t * buf, uint32_t len)
+{
+	cgiCacheSlot_t	* pSlot ;
+
+	cacheCheckGeneration () ;
+	if (len == 0  ||  cacheSlotCount == CGI_CACHE_SLOTS  ||  cachePoolUsed + pKey->len + len > CGI_CACHE_POOL)
+	{
+		cacheStat.full++ ;
+		return ;
+	}
+
+	pSlot = & cacheSlots [cacheSlotCount++] ;
+	pSlot->pDesc    = pDesc ;
+	pSlot->hash     = pKey->hash ;
+	pSlot->offset   = (uint16_t) cachePoolUsed ;
+	pSlot->paramLen = pKey->len ;
+	pSlot->len      = (uint16_t) len ;
+	memcpy (& cachePool [cachePoolUsed], pKey->params, pKey->len) ;
+	cachePoolUsed += pKey->len ;
+	memcpy (& cachePool [cachePoolUsed], buf, len) ;
+	cachePoolUsed += len ;
+	cacheStat.store++ ;
+}
+
+//--------------------------------------------------------------------------------
+//	Discard all the cached responses
+
+void	cgiCacheFlush (void)
+{
+	if (cacheSlotCount != 0)
+	{
+		cacheStat.flush++ ;
+	}
+	cacheSlotCount = 0 ;
+	cachePoolUsed  = 0 ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	cgiCacheGetStat (cgiCacheStat_t * pStat)
+{
+	* pStat = cacheStat ;
+}
+
+//--------------------------------------------------------------------------------
+//	Display the CGI cache statistics
+
+void	cgiCacheStat (void)
+{
+	uint32_t	total = cacheStat.hit + cacheStat.miss ;
+
+	aaPrintf ("CGI cache: %u slots, %u bytes, used %u/%u\n",
+			CGI_CACHE_SLOTS, CGI_CACHE_POOL, cacheSlotCount, cachePoolUsed) ;
+	aaPrintf ("  hit %u, miss %u (%u%% hit), store %u, full %u, flush %u\n",
+			cacheStat.hit, cacheStat.miss, (total == 0) ? 0 : (cacheStat.hit * 100u) / total,
+			cacheStat.store, cacheStat.full, cacheStat.flush) ;
+}
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,64 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	cgiCache.h	Cache of the CGI GET responses, common to the LAN and WIFI servers
+
+	When		Who	What
+	18/10/26	ac	Creation
+	18/10/26	ac	The key is the parameter string, not only its hash
+
+----------------------------------------------------------------------
+*/
+
+#if ! defined CGICACHE_H_
+#define CGICACHE_H_
+//-----------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#define	CGI_CACHE_POOL		1024u		// Size of the memory for the cached responses
+#define	CGI_CACHE_SLOTS		6u			// Max count of cached responses
+#define	CGI_CACHE_PARAM_MAX	64u			// Max length of the request parameters of a cached response
+
+// The key of a response: the request parameters and their hash
+typedef struct
+{
+	uint32_t	hash ;
+	uint16_t	len ;
+	char		params [CGI_CACHE_PARAM_MAX] ;
+
+} cgiCacheKey_t ;
+
+typedef struct
+{
+	uint32_t	hit ;
+	uint32_t	miss ;
+	uint32_t	store ;			// Responses stored
+	uint32_t	full ;			// Responses not stored: no free slot or not enough memory
+	uint32_t	flush ;			// New second or configuration modified: all responses discarded
+
+} cgiCacheStat_t ;
+
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool		cgiCacheKey			(cgiCacheKey_t * pKey, const char * pUriData) ;
+bool		cgiCacheGet			(const void * pDesc, const cgiCacheKey_t * pKey, uint8_t * buf, uint32_t lenMax, uint32_t * pLen) ;
+void		cgiCachePut			(const void * pDesc, const cgiCacheKey_t * pKey, const uint8_t * buf, uint32_t len) ;
+void		cgiCacheFlush		(void) ;
+void		cgiCacheGetStat		(cgiCacheStat_t * pStat) ;
+void		cgiCacheStat		(void) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//-----------------------------------------------------------------------------
+#endif	// CGICACHE_H_
@@ -66,14 +66,17 @@ extern "C" {
 #define		STATUS_UNAUTH		401
 #define		STATUS_FORBIDDEN	403
 #define		STATUS_NOT_FOUND	404
+#define		STATUS_NOT_ACCEPT	406		/* AdAstra: the client doesn't accept the gzip file */
 #define		STATUS_INT_SERR		500
 #define		STATUS_NOT_IMPL		501
 #define		STATUS_BAD_GATEWAY	502
 #define		STATUS_SERV_UNAVAIL	503
 
 /* HTML Doc. for ERROR */
-static const char  	ERROR_HTML_PAGE[] = "HTTP/1.1 404 Not Found\r\nContent-Type: text/html\r\nContent-Length: 78\r\n\r\n<HTML>\r\n<BODY>\r\nSorry, the page you requested was not found.\r\n</BODY>\r\n</HTML>\r\n\0";
-static const char 	ERROR_REQUEST_PAGE[] = "HTTP/1.1 400 OK\r\nContent-Type: text/html\r\nContent-Length: 50\r\n\r\n<HTML>\r\n<BODY>\r\nInvalid request.\r\n</BODY>\r\n</HTML>\r\n\0";
+/* AdAstra: Content-Length is the exact length of the body: the connection is kept alive after an error */
+static const char  	ERROR_HTML_PAGE[] = "HTTP/1.1 404 Not Found\r\nContent-Type: text/html\r\nContent-Length: 80\r\n\r\n<HTML>\r\n<BODY>\r\nSorry, the page you requested was not found.\r\n</BODY>\r\n</HTML>\r\n\0";
+static const char 	ERROR_REQUEST_PAGE[] = "HTTP/1.1 400 OK\r\nContent-Type: text/html\r\nContent-Length: 52\r\n\r\n<HTML>\r\n<BODY>\r\nInvalid request.\r\n</BODY>\r\n</HTML>\r\n\0";
+static const char 	ERROR_NOT_ACCEPT_PAGE[] = "HTTP/1.1 406 Not Acceptable\r\nContent-Type: text/html\r\nVary: Accept-Encoding\r\nContent-Length: 80\r\n\r\n<HTML>\r\n<BODY>\r\nThis file is only available gzip compressed.\r\n</BODY>\r\n</HTML>\r\n\0";
 
 /* HTML Doc. for CGI result  */
 #define HTML_HEADER "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: "
@@ -114,6 +117,12 @@ static const char 	ERROR_REQUEST_PAGE[] = "HTTP/1.1 400 OK\r\nContent-Type: text
 /* Response head for CGI */
 #define RES_CGIHEAD_OK	"HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: "
 
+/* Response head for CGI, the content type comes from the CGI descriptor (see cgiFind()) */
+#define RES_CGIHEAD_TYPE	"HTTP/1.1 200 OK\r\nContent-Type: "
+#define RES_CGIHEAD_MAX		96		/* Max size of the CGI response head, with the longest content type */
+#define RES_CGIHEAD_CHUNKED	"\r\nTransfer-Encoding: chunked\r\n\r\n"	/* Ends the head of a streamed CGI response (see httpStream.c) */
+#define RES_CGIHEAD_CLOSE	"\r\nConnection: close\r\n\r\n"	/* Ends the head of a streamed CGI response to HTTP/1.0: not chunked */
+
 /* Response head for TTF, Font */
 #define RES_TTFHEAD_OK	"HTTP/1.1 200 OK\r\nContent-Type: application/x-font-truetype\r\nContent-Length: "
 
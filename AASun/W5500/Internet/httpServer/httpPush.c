@@ -0,0 +1,185 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	httpPush.c	Push of the live values to the web pages (Server-Sent Events)
+
+	When		Who	What
+	18/10/26	ac	Creation
+
+----------------------------------------------------------------------
+
+	A web page requests HTTP_PUSH_URI with an EventSource. The connection remains open
+	and the server sends the snapshot.cgi JSON as an event each time a new live values
+	snapshot is available (once per second):
+		data: {...}\n\n
+
+	The events are built by http_get_cgi_handler_common(), so the JSON formatting is
+	done once per second for all the subscribers and the polling clients (see cgiCache.c).
+
+	The count of subscribers is limited to HTTP_PUSH_MAX, a refused client gets a 503 error
+	and then polls snapshot.cgi (see common.js).
+	An event is sent only if the previous SEND is done and the socket TX buffer has enough
+	free space, the server never waits for a client. If a client can't receive the events for
+	HTTP_PUSH_STALL_MS it is dropped.
+
+	The WIFI server has no push, the pages poll snapshot.cgi. But while they poll, AASun
+	pushes the snapshot.cgi JSON to the ESP32 (WM_ID_LIVE, see wifi.c), which answers
+	the polls from its mirror without UART exchange.
+
+----------------------------------------------------------------------
+*/
+
+#include	<string.h>
+#include	"aa.h"
+#include	"socket.h"
+#include	"AASun.h"
+#include	"httpServer.h"
+#include	"httpUtil.h"
+#include	"httpPush.h"
+
+#define	PUSH_HEAD		"HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n"
+#define	PUSH_BUSY		"HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n"
+#define	PUSH_DATA		"data: "
+#define	PUSH_END		"\n\n"
+
+typedef struct
+{
+	uint8_t		bUsed ;
+	uint8_t		sn ;			// The W5500 socket of the subscriber
+	uint32_t	generation ;	// Generation of the last snapshot sent
+	uint32_t	sentTick ;		// Time of the last event sent, or of the subscription
+
+} pushSub_t ;
+
+static	pushSub_t	pushSubs [HTTP_PUSH_MAX] ;
+
+//--------------------------------------------------------------------------------
+
+static	pushSub_t *	pushFind (uint8_t sn)
+{
+	uint32_t	ii ;
+
+	for (ii = 0 ; ii < HTTP_PUSH_MAX ; ii++)
+	{
+		if (pushSubs [ii].bUsed != 0  &&  pushSubs [ii].sn == sn)
+		{
+			return & pushSubs [ii] ;
+		}
+	}
+	return NULL ;
+}
+
+//--------------------------------------------------------------------------------
+//	Subscribe the socket to the events
+//	Returns 1 if the socket is a subscriber, 0 if it is refused (503 is sent)
+
+uint8_t	httpPushOpen (uint8_t sn)
+{
+	char		head [sizeof (PUSH_HEAD) + 20] ;
+	uint32_t	len ;
+	uint32_t	ii ;
+
+	for (ii = 0 ; ii < HTTP_PUSH_MAX ; ii++)
+	{
+		if (pushSubs [ii].bUsed == 0)
+		{
+			break ;
+		}
+	}
+	if (ii == HTTP_PUSH_MAX)
+	{
+		send (sn, (uint8_t *) PUSH_BUSY, sizeof (PUSH_BUSY) - 1u) ;
+		return 0 ;
+	}
+
+	len = aaSnPrintf (head, sizeof (head), PUSH_HEAD "retry: %u\n\n", HTTP_PUSH_RETRY_MS) ;
+	if (send (sn, (uint8_t *) head, (uint16_t) len) <= 0)
+	{
+		return 0 ;
+	}
+
+	pushSubs [ii].bUsed      = 1 ;
+	pushSubs [ii].sn         = sn ;
+	pushSubs [ii].generation = liveSnapGet ()->generation - 1u ;	// Send the current values now
+	pushSubs [ii].sentTick   = aaGetTickCount () ;
+	return 1 ;
+}
+
+//--------------------------------------------------------------------------------
+//	Called by the HTTP server for a subscriber socket
+//	buf is a work buffer of size bytes
+//	Returns 0 if the connection must be closed
+
+uint8_t	httpPushRun (uint8_t sn, uint8_t * buf, uint32_t size)
+{
+	pushSub_t	* pSub = pushFind (sn) ;
+	uint32_t	generation = liveSnapGet ()->generation ;
+	uint32_t	len ;
+	uint16_t	rxLen ;
+	char		param [1] = { 0 } ;
+
+	if (pSub == NULL)
+	{
+		return 0 ;
+	}
+
+	// The client doesn't send anything: discard the received data
+	rxLen = getSn_RX_RSR (sn) ;
+	if (rxLen != 0)
+	{
+		wiz_recv_ignore (sn, rxLen) ;
+		setSn_CR (sn, Sn_CR_RECV) ;
+		while (getSn_CR (sn)) ;
+	}
+
+	if (pSub->generation == generation)
+	{
+		return 1 ;		// Nothing new
+	}
+
+	// Slow client: wait for the previous SEND
+	if ((getSn_IR (sn) & Sn_IR_SENDOK) == 0)
+	{
+		return (aaGetTickCount () - pSub->sentTick) < HTTP_PUSH_STALL_MS ;
+	}
+
+	// Build the event: the JSON of snapshot.cgi between PUSH_DATA and PUSH_END
+	len = sizeof (PUSH_DATA) - 1u ;
+	memcpy (buf, PUSH_DATA, len) ;
+	if (HTTP_OK != http_get_cgi_handler_common ((uint8_t *) "snapshot.cgi", param, buf + len,
+					size - len - sizeof (PUSH_END), & len, NULL))
+	{
+		return 0 ;
+	}
+	len += sizeof (PUSH_DATA) - 1u ;
+	memcpy (buf + len, PUSH_END, sizeof (PUSH_END) - 1u) ;
+	len += sizeof (PUSH_END) - 1u ;
+
+	// Slow client: wait for enough room in the TX buffer, send() would wait
+	if (getSn_TX_FSR (sn) < len  ||  send (sn, buf, (uint16_t) len) <= 0)
+	{
+		return (aaGetTickCount () - pSub->sentTick) < HTTP_PUSH_STALL_MS ;
+	}
+	pSub->generation = generation ;
+	pSub->sentTick   = aaGetTickCount () ;
+	return 1 ;
+}
+
+//--------------------------------------------------------------------------------
+//	The socket is closed: remove the subscriber, if any
+
+void	httpPushClose (uint8_t sn)
+{
+	pushSub_t	* pSub = pushFind (sn) ;
+
+	if (pSub != NULL)
+	{
+		pSub->bUsed = 0 ;
+	}
+}
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,41 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	httpPush.h	Push of the live values to the web pages (Server-Sent Events)
+
+	When		Who	What
+	18/10/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#if ! defined HTTPPUSH_H_
+#define HTTPPUSH_H_
+//-----------------------------------------------------------------------------
+
+#include	<stdint.h>
+
+#define	HTTP_PUSH_URI			"live.cgi"	// The event stream request
+#define	HTTP_PUSH_MAX			2u			// Max count of subscribers, the other HTTP sockets remain for the requests
+#define	HTTP_PUSH_STALL_MS		5000u		// A client which can't receive the updates for this time is dropped
+#define	HTTP_PUSH_RETRY_MS		3000u		// Reconnection delay advertised to the client
+
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint8_t		httpPushOpen		(uint8_t sn) ;
+uint8_t		httpPushRun			(uint8_t sn, uint8_t * buf, uint32_t size) ;
+void		httpPushClose		(uint8_t sn) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//-----------------------------------------------------------------------------
+#endif	// HTTPPUSH_H_
@@ -8,6 +8,8 @@
 #include "httpServer.h"
 #include "httpParser.h"
 #include "httpUtil.h"
+#include "httpPush.h"
+#include "wizLan.h"		// AdAstra: wizSendFile()
 
 #ifdef	_USE_SDCARD_
 #include "ff.h" 	// header file for FatFs library (FAT file system)
@@ -21,9 +23,12 @@
  * Private types/enumerations/variables
  ****************************************************************************/
 static uint8_t HTTPSock_Num[_WIZCHIP_SOCK_NUM_] = {0, };
+static uint8_t HTTPSock_Cnt = 0;					/**< AdAstra: count of HTTP sockets */
 static st_http_request * http_request;				/**< Pointer to received HTTP request */
 static st_http_request * parsed_http_request;		/**< Pointer to parsed HTTP request */
 static uint8_t * http_response;						/**< Pointer to HTTP response */
+static char http_if_none_match[HTTP_ETAG_SIZE];		/**< AdAstra: If-None-Match value of the request, or empty */
+static uint8_t http_accept_gzip;					/**< AdAstra: 1 if the Accept-Encoding of the request allows gzip */
 
 // ## For Debugging
 //static uint8_t uri_buf[128];
@@ -58,11 +63,18 @@ void httpServer_Sockinit(uint8_t cnt, const uint8_t * socklist);
 static uint8_t getHTTPSocketNum(uint8_t seqnum);
 static int8_t getHTTPSequenceNum(uint8_t socket);
 static int8_t http_disconnect(uint8_t sn);
+static uint16_t http_recv_request(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * keep_alive);
+static uint8_t http_idle_timeout(uint8_t seqnum);
+static void http_get_if_none_match(char * request);
+static void http_get_accept_gzip(char * request);
+#ifdef _USE_FLASH_
+static void http_file_etag(mfsFile_t * pFile, char * etag);
+#endif
 
 static void http_process_handler(uint8_t s, st_http_request * p_http_request);
 static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t body_len, uint16_t http_status);
 static void send_http_response_body(uint8_t s, uint8_t * uri_name, uint8_t * buf, uint32_t start_addr, uint32_t file_len);
-static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body, uint16_t file_len);
+static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body, uint16_t file_len, const char * content_type);
 
 /*****************************************************************************
  * Public functions
@@ -82,6 +94,7 @@ void httpServer_Sockinit(uint8_t cnt, const uint8_t * socklist)
 		// Mapping the H/W socket numbers to the sequential index numbers
 		HTTPSock_Num[i] = socklist[i];
 	}
+	HTTPSock_Cnt = cnt;
 }
 
 static uint8_t getHTTPSocketNum(uint8_t seqnum)
@@ -108,6 +121,8 @@ void httpServer_init(uint8_t * tx_buf, uint8_t * rx_buf, uint8_t cnt, const uint
 
 	// H/W Socket number mapping
 	httpServer_Sockinit(cnt, socklist);
+
+	cgiTableCheck () ;		// AdAstra: the CGI table must be sorted
 }
 
 
@@ -145,6 +160,8 @@ void httpServer_run(uint8_t seqnum)
 			if(getSn_IR(s) & Sn_IR_CON)
 			{
 				setSn_IR(s, Sn_IR_CON);
+				// AdAstra: start the idle timeout of the new connection
+				HTTPSock_Status[seqnum].idle_tick = aaGetTickCount();
 			}
 
 #ifdef _HTTPSERVER_DEBUG_
@@ -159,18 +176,19 @@ void httpServer_run(uint8_t seqnum)
 //					if ((len = getSn_RX_RSR(s)) > 1)
 					if ((len = getSn_RX_RSR(s)) > 0)
 					{
-						if (len > DATA_BUF_SIZE) len = DATA_BUF_SIZE;
-						len = recv(s, (uint8_t *)http_request, len);
-
-						// AdAstra: check if recv return value is an error number
-						if ((int16_t)len < 0)
+						// AdAstra: the RX buffer may hold a partial request, or several requests (pipelining).
+						// Only the 1st complete request is removed from the socket RX buffer.
+						if (len > DATA_BUF_SIZE - 1) len = DATA_BUF_SIZE - 1;
+						len = http_recv_request(s, (uint8_t *)http_request, len, & HTTPSock_Status[seqnum].keep_alive);
+						if (len == 0)
 						{
-							aaPrintf ("recv error %d\n", (int32_t)(int16_t)len) ;
-							return ;
+							// The request is not complete: wait for the remaining data
+							if (http_idle_timeout(seqnum)) http_disconnect(s);
+							break;
 						}
 
-						*(((uint8_t *)http_request) + len) = '\0';
-
+						http_get_if_none_match((char *)http_request);
+						http_get_accept_gzip((char *)http_request);
 						parse_http_request(parsed_http_request, (uint8_t *)http_request);
 #ifdef _HTTPSERVER_DEBUG_
 						getSn_DIPR(s, destip);
@@ -198,11 +216,21 @@ void httpServer_run(uint8_t seqnum)
 							}
 						}
 
+						if(HTTPSock_Status[seqnum].sock_status == STATE_HTTP_PUSH)
+							break;	// AdAstra: the socket is now an event stream subscriber
 						if(HTTPSock_Status[seqnum].file_len > 0)
 							HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_INPROC;
 						else
 							HTTPSock_Status[seqnum].sock_status = STATE_HTTP_RES_DONE; // Send the 'HTTP response' end
 					}
+					else if (http_idle_timeout(seqnum))
+					{
+						// AdAstra: close the idle persistent connection
+#ifdef _HTTPSERVER_DEBUG_
+						printf("> HTTPSocket[%d] : keep-alive timeout\r\n", s);
+#endif
+						http_disconnect(s);
+					}
 					break;
 
 				case STATE_HTTP_RES_INPROC :
@@ -234,7 +262,24 @@ printf("%u\r\n", aaGetTickCount ());
 #ifdef _USE_WATCHDOG_
 					HTTPServer_WDT_Reset();
 #endif
-					http_disconnect(s);
+					// AdAstra: keep the connection open for the next requests of the client
+					if (HTTPSock_Status[seqnum].keep_alive)
+						HTTPSock_Status[seqnum].idle_tick = aaGetTickCount();
+					else
+						http_disconnect(s);
+					break;
+
+				case STATE_HTTP_PUSH :
+					// AdAstra: send the live values to the event stream subscriber
+					if(!httpPushRun(s, pHTTP_TX, DATA_BUF_SIZE))
+					{
+#ifdef _HTTPSERVER_DEBUG_
+						printf("> HTTPSocket[%d] : [State] STATE_HTTP_PUSH: drop the subscriber\r\n", s);
+#endif
+						httpPushClose(s);
+						HTTPSock_Status[seqnum].sock_status = STATE_HTTP_IDLE;
+						http_disconnect(s);
+					}
 					break;
 
 				default :
@@ -246,6 +291,7 @@ printf("%u\r\n", aaGetTickCount ());
 #ifdef _HTTPSERVER_DEBUG_
 		printf("> HTTPSocket[%d] : ClOSE_WAIT\r\n", s);	// if a peer requests to close the current connection
 #endif
+			httpPushClose(s);	// AdAstra
 			disconnect(s);
 			break;
 
@@ -260,10 +306,12 @@ printf("%u\r\n", aaGetTickCount ());
 #endif
 			}
 			// https://github.com/Wiznet/ioLibrary_Driver/issues/80
+			httpPushClose(s);	// AdAstra
 			HTTPSock_Status[seqnum].file_len    = 0;
 			HTTPSock_Status[seqnum].file_offset = 0;
 			HTTPSock_Status[seqnum].file_start  = 0;
 			HTTPSock_Status[seqnum].sock_status = STATE_HTTP_IDLE;
+			HTTPSock_Status[seqnum].keep_alive  = 0;
 			break;
 
 		case SOCK_INIT:
@@ -283,11 +331,46 @@ printf("%u\r\n", aaGetTickCount ());
 #endif
 }
 
+// AdAstra: returns 1 if a socket has work which doesn't raise a W5500 interrupt:
+// a response in progress, or a request already received (pipelining)
+uint8_t httpServer_busy(void)
+{
+	uint8_t i;
+	uint8_t s;
+
+	for(i = 0; i < HTTPSock_Cnt; i++)
+	{
+		s = getHTTPSocketNum(i);
+		if(getSn_SR(s) != SOCK_ESTABLISHED)
+			continue;
+
+		switch(HTTPSock_Status[i].sock_status)
+		{
+			case STATE_HTTP_RES_INPROC :
+			case STATE_HTTP_RES_DONE :
+				return 1;
+
+			case STATE_HTTP_IDLE :
+				if(getSn_RX_RSR(s) > 0)
+					return 1;
+				break;
+
+			default :
+				break;
+		}
+	}
+	return 0;
+}
+
 ////////////////////////////////////////////
 // Private Functions
 ////////////////////////////////////////////
 static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t body_len, uint16_t http_status)
 {
+#ifdef _USE_FLASH_
+	int8_t get_seqnum;
+#endif
+
 	switch(http_status)
 	{
 		case STATUS_OK: 		// HTTP/1.1 200 OK
@@ -297,6 +380,20 @@ static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t
 			printf("> HTTPSocket[%d] : HTTP Response Header - STATUS_OK\r\n", s);
 #endif
 				make_http_response_head((char*)http_response, content_type, body_len);
+#ifdef _USE_FLASH_
+				// AdAstra: MFS file: add the ETag, and the encoding of a compressed file
+				get_seqnum = getHTTPSequenceNum(s);
+				if(get_seqnum != -1 && HTTPSock_Status[get_seqnum].storage_type == DATAFLASH)
+				{
+					mfsFile_t * pFile = &HTTPSock_Status[get_seqnum].mfsFile;
+					char etag[HTTP_ETAG_SIZE];
+					uint32_t len = strlen((char *)http_response) - 2;	// Remove the ending empty line
+
+					http_file_etag(pFile, etag);
+					snprintf((char *)http_response + len, DATA_BUF_SIZE - len, "ETag: %s\r\nCache-Control: no-cache\r\n%s\r\n",
+							etag, mfsIsGzip(pFile) ? "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n" : "");
+				}
+#endif
 			}
 			else
 			{
@@ -307,6 +404,24 @@ static void send_http_response_header(uint8_t s, uint8_t content_type, uint32_t
 				http_status = 0;
 			}
 			break;
+#ifdef _USE_FLASH_
+		case STATUS_NOT_MODIF:	// HTTP/1.1 304 Not Modified
+			// AdAstra: the client has this version of the file in its cache
+#ifdef _HTTPSERVER_DEBUG_
+			printf("> HTTPSocket[%d] : HTTP Response Header - STATUS_NOT_MODIF\r\n", s);
+#endif
+			get_seqnum = getHTTPSequenceNum(s);
+			snprintf((char *)http_response, DATA_BUF_SIZE, "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n%s\r\n", http_if_none_match,
+					(get_seqnum != -1 && mfsIsGzip(&HTTPSock_Status[get_seqnum].mfsFile)) ? "Vary: Accept-Encoding\r\n" : "");
+			break;
+		case STATUS_NOT_ACCEPT:	// HTTP/1.1 406 Not Acceptable
+			// AdAstra: the file is gzip compressed, and the client doesn't accept gzip
+#ifdef _HTTPSERVER_DEBUG_
+			printf("> HTTPSocket[%d] : HTTP Response Header - STATUS_NOT_ACCEPT\r\n", s);
+#endif
+			memcpy(http_response, ERROR_NOT_ACCEPT_PAGE, sizeof(ERROR_NOT_ACCEPT_PAGE));
+			break;
+#endif
 		case STATUS_BAD_REQ: 	// HTTP/1.1 400 OK
 #ifdef _HTTPSERVER_DEBUG_
 			printf("> HTTPSocket[%d] : HTTP Response Header - STATUS_BAD_REQ\r\n", s);
@@ -416,11 +531,12 @@ static void send_http_response_body(uint8_t s, uint8_t * uri_name, uint8_t * buf
 #ifdef _USE_FLASH_
 	if (HTTPSock_Status[get_seqnum].storage_type == DATAFLASH)
 	{
-		// Data read from external data flash memory: read_from_flashbuf(addr, &buf[0], send_len);
+		// AdAstra: the data are copied from the flash to the socket TX memory, buf is not used
 		uint32_t offset = HTTPSock_Status[get_seqnum].file_start + HTTPSock_Status[get_seqnum].file_offset;
-		mfsSeek	(& HTTPSock_Status[get_seqnum].mfsFile, offset, MFS_SEEK_SET) ;
-		mfsRead (& HTTPSock_Status[get_seqnum].mfsFile, buf, send_len) ;
-		*(buf+send_len+1) = 0; // Insert '/0' for indicates the 'End of String' (null terminated)
+		int32_t len = wizSendFile(s, & HTTPSock_Status[get_seqnum].mfsFile, offset, send_len);
+		if (len > 0)
+			HTTPSock_Status[get_seqnum].file_offset += len;
+		send_len = 0;	// Already sent
 	}
 	else
 #endif
@@ -466,7 +582,7 @@ static void send_http_response_body(uint8_t s, uint8_t * uri_name, uint8_t * buf
 	}
 }
 
-static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body, uint16_t file_len)
+static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body, uint16_t file_len, const char * content_type)
 {
 	uint16_t send_len = 0;
 
@@ -477,7 +593,7 @@ static void send_http_response_cgi(uint8_t s, uint8_t * buf, uint8_t * http_body
 //	send_len = snprintf((char *)buf, DATA_BUF_SIZE, "%s%d\r\n\r\n%s", RES_CGIHEAD_OK, file_len, http_body);
 
 	// This allows to send binary data
-	send_len = snprintf((char *)buf, DATA_BUF_SIZE, "%s%d\r\n\r\n", RES_CGIHEAD_OK, file_len);
+	send_len = snprintf((char *)buf, DATA_BUF_SIZE, "%s%s\r\nContent-Length: %d\r\n\r\n", RES_CGIHEAD_TYPE, content_type, file_len);
 	memcpy (buf+send_len, http_body, file_len) ;
 	send_len += file_len ;
 
@@ -498,6 +614,150 @@ static int8_t http_disconnect(uint8_t sn)
 	return SOCK_OK;
 }
 
+// AdAstra: read the 1st complete HTTP request (header + body) of the socket RX buffer.
+// The data is first read without removing it from the socket, then only the request is removed:
+// the following pipelined requests remain in the socket RX buffer.
+// buf size must be len+1. Returns the size of the request, 0 if it is not complete.
+static uint16_t http_recv_request(uint8_t sn, uint8_t * buf, uint16_t len, uint8_t * keep_alive)
+{
+	char * pEnd;
+	char * pLength;
+	uint32_t size;
+
+	WIZCHIP_READ_BUF(((uint32_t)getSn_RX_RD(sn) << 8) + (WIZCHIP_RXBUF_BLOCK(sn) << 3), buf, len);
+	buf[len] = '\0';
+
+	*keep_alive = 1;
+	pEnd = strstr((char *)buf, "\r\n\r\n");
+	if(pEnd == NULL)
+	{
+		if(len < DATA_BUF_SIZE - 1) return 0;
+		// The header does not fit in the buffer: process it truncated, then close the connection
+		*keep_alive = 0;
+		size = len;
+	}
+	else
+	{
+		pEnd[2] = '\0';	// Only search the header
+		size = (uint32_t)(pEnd + 4 - (char *)buf);
+		pLength = strstr((char *)buf, "Content-Length: ");
+		if(pLength) size += strtoul(pLength + 16, NULL, 10);
+		if(strstr((char *)buf, "Connection: close") || strstr((char *)buf, "HTTP/1.0\r\n")) *keep_alive = 0;
+		pEnd[2] = '\r';
+
+		if(size > len)
+		{
+			if(len < DATA_BUF_SIZE - 1) return 0;	// Wait for the end of the body
+			*keep_alive = 0;
+			size = len;
+		}
+	}
+	buf[size] = '\0';
+
+	wiz_recv_ignore(sn, (uint16_t)size);
+	setSn_CR(sn, Sn_CR_RECV);
+	while(getSn_CR(sn));
+
+	return (uint16_t)size;
+}
+
+// AdAstra: copy the If-None-Match value of the request header to http_if_none_match.
+// Must be called before parse_http_request() which modifies the request.
+static void http_get_if_none_match(char * request)
+{
+	char * pStr = strstr(request, "\r\nIf-None-Match: ");
+	uint32_t len = 0;
+
+	if(pStr)
+	{
+		pStr += 17;
+		len = strcspn(pStr, "\r\n");
+		if(len >= HTTP_ETAG_SIZE) len = 0;	// Not one of our tags
+		memcpy(http_if_none_match, pStr, len);
+	}
+	http_if_none_match[len] = '\0';
+}
+
+// AdAstra: set http_accept_gzip from the Accept-Encoding value of the request header.
+// Without Accept-Encoding any coding is acceptable. A coding with q=0 is not acceptable,
+// gzip takes precedence over *.
+// Must be called before parse_http_request() which modifies the request.
+static void http_get_accept_gzip(char * request)
+{
+	char * pStr = strstr(request, "\r\nAccept-Encoding: ");
+	char * pEnd;
+	int8_t gzip = -1, star = -1;	// -1: not in the list, 0: not acceptable, 1: acceptable
+	int8_t * pCoding;
+	uint32_t len;
+	int8_t accept;
+
+	http_accept_gzip = 1;
+	if(!pStr) return;
+
+	pStr += 19;
+	pEnd = pStr + strcspn(pStr, "\r\n");
+	while(pStr < pEnd)
+	{
+		// A coding: name, then optional parameters up to ','
+		pStr += strspn(pStr, " \t,");
+		len = strcspn(pStr, " \t;,\r\n");
+		accept = 1;
+		pCoding = NULL;
+		if(len == 4 && strncasecmp(pStr, "gzip", 4) == 0) pCoding = &gzip;
+		else if(len == 1 && *pStr == '*') pCoding = &star;
+		pStr += len;
+
+		while(pStr < pEnd && *pStr != ',')
+		{
+			if((pStr[0] == 'q' || pStr[0] == 'Q') && pStr[1] == '=')
+			{
+				// q=0, q=0.0 ... : not acceptable
+				pStr += 2;
+				if(*pStr == '0')
+				{
+					pStr++;
+					if(*pStr == '.') pStr += 1 + strspn(pStr + 1, "0");
+					accept = (*pStr >= '1' && *pStr <= '9');
+				}
+				continue;
+			}
+			pStr++;
+		}
+		if(pCoding) *pCoding = accept;
+	}
+	http_accept_gzip = (gzip != -1) ? gzip : (star == 1);
+}
+
+#ifdef _USE_FLASH_
+// AdAstra: the ETag of a MFS file, quotes included
+static void http_file_etag(mfsFile_t * pFile, char * etag)
+{
+	uint32_t crc, address;
+
+	mfsGetFileTag(pFile, &crc, &address);
+	snprintf(etag, HTTP_ETAG_SIZE, "\"%08X-%X\"", crc, address);
+}
+#endif
+
+// AdAstra: returns 1 if the connection is idle for too long.
+// The timeout is shorter when all the HTTP sockets are connected.
+static uint8_t http_idle_timeout(uint8_t seqnum)
+{
+	uint32_t idle = aaGetTickCount() - HTTPSock_Status[seqnum].idle_tick;
+	uint8_t i;
+
+	if(idle > HTTP_KEEPALIVE_MS) return 1;
+	if(idle > HTTP_KEEPALIVE_BUSY_MS)
+	{
+		for(i = 0; i < HTTPSock_Cnt; i++)
+		{
+			if(getSn_SR(getHTTPSocketNum(i)) == SOCK_LISTEN) return 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
 
 static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 {
@@ -527,6 +787,7 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 	switch (p_http_request->METHOD)
 	{
 		case METHOD_ERR :
+			HTTPSock_Status[get_seqnum].keep_alive = 0;	// AdAstra: the request framing may be lost
 			http_status = STATUS_BAD_REQ;
 			send_http_response_header(s, 0, 0, http_status);
 #ifdef _HTTPSERVER_DEBUG_
@@ -535,6 +796,10 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 			break;
 
 		case METHOD_HEAD :
+			// AdAstra: the body is sent after the header even for HEAD: the client must not
+			// read it as the response of a next request
+			HTTPSock_Status[get_seqnum].keep_alive = 0;
+			/* no break */
 		case METHOD_GET :
 #ifdef _HTTPSERVER_DEBUG_
       printf("HTTPSocket[%d] : http_process_handler():: METHOD_GET\r\n", s);
@@ -555,11 +820,36 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 
 			if(p_http_request->TYPE == PTYPE_CGI)
 			{
-				uint32_t lenMax = DATA_BUF_SIZE - (strlen (RES_CGIHEAD_OK) + 8) ;
-				content_found = http_get_cgi_handler(uri_name, pHTTP_TX, lenMax, & file_len);
-				if(content_found && (file_len <= lenMax))
+				uint32_t lenMax = DATA_BUF_SIZE - RES_CGIHEAD_MAX ;
+				const cgiDesc_t * pDesc = cgiFind((char *)uri_name);
+				httpStream_t stream;
+
+				// AdAstra: event stream of the live values
+				if(!strcmp((char *)uri_name, HTTP_PUSH_URI))
 				{
-					send_http_response_cgi(s, http_response, pHTTP_TX, (uint16_t)file_len);
+					if(httpPushOpen(s)) HTTPSock_Status[get_seqnum].sock_status = STATE_HTTP_PUSH;
+					break;
+				}
+
+				// AdAstra: the CGI may stream its response directly to the socket (chunked)
+				// If the connection is closed after the response (HTTP/1.0, Connection: close) the stream
+				// is not chunked: HTTP/1.0 clients don't know this encoding, the close ends the body
+				hsInit(&stream, s, (pDesc != NULL) ? pDesc->contentType : CGI_TYPE_TEXT, HTTPSock_Status[get_seqnum].keep_alive != 0);
+				content_found = http_get_cgi_handler(uri_name, pHTTP_TX, lenMax, & file_len, &stream);
+				if(stream.total != 0)
+				{
+					// Streamed response: terminate it even if the CGI failed, the header may be already sent
+					if(!hsEnd(&stream))
+					{
+						// Aborted: the body is not terminated and the socket TX memory may hold
+						// the start of a chunk past Sn_TX_WR, the connection can't be reused
+						HTTPSock_Status[get_seqnum].keep_alive = 0;
+						http_disconnect(s);
+					}
+				}
+				else if(content_found && (file_len <= lenMax))
+				{
+					send_http_response_cgi(s, http_response, pHTTP_TX, (uint16_t)file_len, pDesc->contentType);
 				}
 				else
 				{
@@ -630,6 +920,27 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 					printf("> HTTPSocket[%d] : Find Content [%s] ok - Start [%ld] len [ %ld ]byte\r\n", s, uri_name, content_addr, file_len);
 #endif
 					http_status = STATUS_OK;
+#ifdef _USE_FLASH_
+					// AdAstra: the MFS only has the gzip variant of a compressed file
+					if(HTTPSock_Status[get_seqnum].storage_type == DATAFLASH &&
+					   mfsIsGzip(&HTTPSock_Status[get_seqnum].mfsFile) && !http_accept_gzip)
+					{
+						mfsClose(&HTTPSock_Status[get_seqnum].mfsFile);
+						http_status = STATUS_NOT_ACCEPT;
+					}
+					// AdAstra: conditional GET, don't send the file if the client has it in its cache
+					else if(http_if_none_match[0] != 0 && HTTPSock_Status[get_seqnum].storage_type == DATAFLASH)
+					{
+						char etag[HTTP_ETAG_SIZE];
+
+						http_file_etag(&HTTPSock_Status[get_seqnum].mfsFile, etag);
+						if(!strcmp(etag, http_if_none_match))
+						{
+							mfsClose(&HTTPSock_Status[get_seqnum].mfsFile);
+							http_status = STATUS_NOT_MODIF;
+						}
+					}
+#endif
 				}
 
 				// Send HTTP header
@@ -666,9 +977,9 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 #ifdef _HTTPSERVER_DEBUG_
 				printf("> HTTPSocket[%d] : [CGI: %s] / Response len [ %ld ]byte\r\n", s, content_found?"Content found":"Content not found", file_len);
 #endif
-				if(content_found && (file_len <= (DATA_BUF_SIZE-(strlen(RES_CGIHEAD_OK)+8))))
+				if(content_found && (file_len <= (DATA_BUF_SIZE-RES_CGIHEAD_MAX)))
 				{
-					send_http_response_cgi(s, pHTTP_TX, http_response, (uint16_t)file_len);
+					send_http_response_cgi(s, pHTTP_TX, http_response, (uint16_t)file_len, cgiFind((char *)uri_name)->contentType);
 
 					// Reset the H/W for apply to the change configuration information
 					if(content_found == HTTP_RESET) HTTPServer_ReStart();
@@ -688,6 +999,7 @@ static void http_process_handler(uint8_t s, st_http_request * p_http_request)
 #ifdef _HTTPSERVER_DEBUG_
       printf("HTTPSocket[%d] : http_process_handler():: STATUS_BAD_REQ\r\n", s);
 #endif
+			HTTPSock_Status[get_seqnum].keep_alive = 0;
 			http_status = STATUS_BAD_REQ;
 			send_http_response_header(s, 0, 0, http_status);
 			break;
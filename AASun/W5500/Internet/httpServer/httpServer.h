@@ -51,6 +51,7 @@ extern "C" {
 #define STATE_HTTP_REQ_DONE    		2           /* The end of HTTP request parse */
 #define STATE_HTTP_RES_INPROC  		3           /* Sending the HTTP response to HTTP client (in progress) */
 #define STATE_HTTP_RES_DONE    		4           /* The end of HTTP response send (HTTP transaction ended) */
+#define STATE_HTTP_PUSH    			5           /* AdAstra: the socket is an event stream subscriber (httpPush.c) */
 
 /*********************************************
 * HTTP Simple Return Value
@@ -69,6 +70,20 @@ extern "C" {
 *********************************************/
 #define HTTP_MAX_TIMEOUT_SEC		3			// Sec.
 
+/*********************************************
+* AdAstra: HTTP persistent connections (keep-alive)
+* An idle connection is closed after HTTP_KEEPALIVE_MS.
+* When no HTTP socket is listening anymore the idle connections are closed
+* after HTTP_KEEPALIVE_BUSY_MS, to let the other clients connect.
+*********************************************/
+#define HTTP_KEEPALIVE_MS			5000		// ms
+#define HTTP_KEEPALIVE_BUSY_MS		1000		// ms
+
+/*********************************************
+* AdAstra: size of an ETag: "CRC-address" with quotes (see http_file_etag)
+*********************************************/
+#define HTTP_ETAG_SIZE				24
+
 typedef enum
 {
    NONE,		///< Web storage none
@@ -85,6 +100,8 @@ typedef struct _st_http_socket
 	uint32_t 		file_len;
 	uint32_t 		file_offset; // (start addr + sent size...)
 	StorageType		storage_type; // Storage type; Code flash, SDcard, Data flash ...
+	uint32_t		idle_tick;	// AdAstra: tick of the connection or of the end of the last response
+	uint8_t			keep_alive;	// AdAstra: keep the connection open after the response
 
 #ifdef _USE_FLASH_
     mfsFile_t       mfsFile ;	// Every socket can use 1 file
@@ -105,6 +122,7 @@ typedef struct _httpServer_webContent
 void httpServer_init(uint8_t * tx_buf, uint8_t * rx_buf, uint8_t cnt, const uint8_t * socklist);
 void reg_httpServer_cbfunc(void(*mcu_reset)(void), void(*wdt_reset)(void));
 void httpServer_run(uint8_t seqnum);
+uint8_t httpServer_busy(void);
 
 void reg_httpServer_webContent(uint8_t * content_name, uint8_t * content);
 uint8_t find_userReg_webContent(uint8_t * content_name, uint16_t * content_num, uint32_t * file_len);
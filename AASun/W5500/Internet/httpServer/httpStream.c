@@ -0,0 +1,486 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	httpStream.c	Streaming writer of HTTP responses
+
+	When		Who	What
+	18/10/26	ac	Creation
+	18/10/26	ac	Fragment stream for the WIFI responses larger than a UART frame
+	18/10/26	ac	Not chunked stream for HTTP/1.0 clients
+
+----------------------------------------------------------------------
+
+	The CGI responses are built in a 2 KB buffer, so a large response
+	(e.g. the full day of power history) can't be sent in one request.
+	A stream writes the response while it is produced, directly to the W5500 socket TX buffer:
+	- The response header is written on the 1st write, with "Transfer-Encoding: chunked".
+	- A chunk begins with a placeholder for its size line, then the data is appended with wiz_send_data().
+	  No SEND command is issued for these small writes.
+	- When the chunk is full (HTTP_STREAM_CHUNK), or at the end of the response, the size line
+	  is patched in the TX buffer, and send() writes the chunk trailing CRLF and issues the SEND.
+	  Using send() keeps the socket.c SEND_OK handling consistent.
+	- A new chunk is opened only when the previous SEND is done (the W5500 must not have its TX
+	  buffer written during a SEND), and data is written only when the TX buffer has enough free space.
+	  The wait is done with aaTaskDelay(), and aborted after HTTP_MAX_TIMEOUT_SEC.
+
+	HTTP/1.0 doesn't know the chunked encoding. If the connection is closed at the end of the
+	response the body is not chunked: the header has "Connection: close" and no length,
+	the data is written without size line. A "chunk" is then only the unit of SEND: at its
+	close the socket TX write pointer is moved back to its start, and send_fill() issues the SEND
+	of the data already in the TX buffer.
+
+	Small writes are gathered in the stream buffer (HTTP_STREAM_BUF) to avoid one SPI transaction per byte.
+
+	A memory stream writes to a buffer, for the WIFI server which needs the whole response.
+	If the buffer is too small the stream is in error.
+	A fragment stream writes to a buffer too, but when it is full the function given at the
+	initialization empties it: the WIFI server sends it as a fragment of the response.
+	The function can change pMem and memSize for the next fragment.
+
+----------------------------------------------------------------------
+*/
+
+#include	<string.h>
+#include	"aa.h"
+#include	"socket.h"
+#include	"httpServer.h"
+#include	"httpParser.h"
+#include	"httpStream.h"
+
+#if (_WIZCHIP_ != 5500)
+	#error "httpStream: the chunk size line patch is only implemented for the W5500"
+#endif
+
+static	const char	hsChunkTrailer [] = "\r\n" ;
+static	const char	hsLastChunk    [] = "\r\n0\r\n\r\n" ;	// Trailer of the last chunk + last (empty) chunk
+
+#define	HS_TIMEOUT		(HTTP_MAX_TIMEOUT_SEC * 1000u)		// In ticks (ms)
+
+#define	HS_IS_SOCKET(pStream)	((pStream)->sn < HTTP_STREAM_FRAGMENT)
+
+//--------------------------------------------------------------------------------
+//	Check the socket is still connected and the wait is not too long
+//	Returns false if the stream must be aborted
+
+static	bool	hsCheck (httpStream_t * pStream, uint32_t startTick)
+{
+	uint8_t		sr = getSn_SR (pStream->sn) ;
+
+	if (sr != SOCK_ESTABLISHED  &&  sr != SOCK_CLOSE_WAIT)
+	{
+		pStream->bError = 1u ;
+		return false ;
+	}
+	if ((getSn_IR (pStream->sn) & Sn_IR_TIMEOUT) != 0u  ||  (aaGetTickCount () - startTick) > HS_TIMEOUT)
+	{
+		pStream->bError = 1u ;
+		return false ;
+	}
+	aaTaskDelay (1) ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Wait for the end of the previous SEND command
+//	The SEND_OK flag is not cleared: this will be done by the next send()
+
+static	bool	hsWaitSendOk (httpStream_t * pStream)
+{
+	uint32_t	startTick = aaGetTickCount () ;
+
+	if (pStream->bSending != 0u)
+	{
+		while ((getSn_IR (pStream->sn) & Sn_IR_SENDOK) == 0u)
+		{
+			if (! hsCheck (pStream, startTick))
+			{
+				return false ;
+			}
+		}
+		pStream->bSending = 0u ;
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Back-pressure: wait for len free bytes in the socket TX buffer
+//	The room for the trailer of the last chunk is always reserved
+
+static	bool	hsWaitRoom (httpStream_t * pStream, uint32_t len)
+{
+	uint32_t	startTick = aaGetTickCount () ;
+
+	len += sizeof (hsLastChunk) - 1u ;
+	while (getSn_TX_FSR (pStream->sn) < len)
+	{
+		if (! hsCheck (pStream, startTick))
+		{
+			return false ;
+		}
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	The send_fill() function of a not chunked stream: the data is already in the TX buffer
+
+static	void	hsFillKept (uint8_t sn, uint16_t ptr, uint16_t len, void * arg)
+{
+	(void) sn ;
+	(void) ptr ;
+	(void) len ;
+	(void) arg ;
+}
+
+//--------------------------------------------------------------------------------
+//	Write the response header, if not already done
+
+static	bool	hsStart (httpStream_t * pStream)
+{
+	uint32_t	len ;
+	const char	* pEnd = (pStream->bChunked != 0u) ? RES_CGIHEAD_CHUNKED : RES_CGIHEAD_CLOSE ;
+	uint32_t	endLen = strlen (pEnd) ;
+
+	if (pStream->bStarted == 0u)
+	{
+		len = strlen (pStream->contentType) ;
+		if (! hsWaitRoom (pStream, sizeof (RES_CGIHEAD_TYPE) + len + endLen))
+		{
+			return false ;
+		}
+		wiz_send_data (pStream->sn, (uint8_t *) RES_CGIHEAD_TYPE, sizeof (RES_CGIHEAD_TYPE) - 1u) ;
+		wiz_send_data (pStream->sn, (uint8_t *) pStream->contentType, (uint16_t) len) ;
+		wiz_send_data (pStream->sn, (uint8_t *) pEnd, (uint16_t) endLen) ;
+		pStream->bStarted = 1u ;
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Open a chunk: write the response header if needed, then the placeholder of the size line
+//	Not chunked: the header is sent with the data of the 1st chunk
+
+static	bool	hsChunkOpen (httpStream_t * pStream)
+{
+	if (! hsWaitSendOk (pStream))
+	{
+		return false ;
+	}
+	pStream->chunkPtr = getSn_TX_WR (pStream->sn) ;
+	if (! hsStart (pStream))
+	{
+		return false ;
+	}
+	if (pStream->bChunked == 0u)
+	{
+		return true ;
+	}
+	if (! hsWaitRoom (pStream, HTTP_STREAM_SIZELINE))
+	{
+		return false ;
+	}
+	pStream->chunkPtr = getSn_TX_WR (pStream->sn) ;
+	wiz_send_data (pStream->sn, (uint8_t *) "0000\r\n", HTTP_STREAM_SIZELINE) ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Close the current chunk: patch its size line, then send it
+//	pTrailer is hsChunkTrailer, or hsLastChunk at the end of the response
+//	Not chunked: there is no size line and no trailer, only the SEND of the data
+
+static	void	hsChunkClose (httpStream_t * pStream, const char * pTrailer, uint32_t trailerLen)
+{
+	static	const char	hexDigits [] = "0123456789ABCDEF" ;
+	uint8_t		sizeLine [HTTP_STREAM_SIZELINE] ;
+	uint32_t	len = pStream->chunkLen ;
+
+	if (pStream->bChunked == 0u)
+	{
+		len = (uint16_t) (getSn_TX_WR (pStream->sn) - pStream->chunkPtr) ;
+		setSn_TX_WR (pStream->sn, pStream->chunkPtr) ;
+		if (send_fill (pStream->sn, (uint16_t) len, hsFillKept, NULL) < 0)
+		{
+			pStream->bError = 1u ;
+		}
+		pStream->bSending = 1u ;
+		pStream->chunkLen = 0u ;
+		return ;
+	}
+
+	// The size line: 4 hex digits, leading zeros are allowed
+	sizeLine [0] = hexDigits [(len >> 12) & 0x0Fu] ;
+	sizeLine [1] = hexDigits [(len >>  8) & 0x0Fu] ;
+	sizeLine [2] = hexDigits [(len >>  4) & 0x0Fu] ;
+	sizeLine [3] = hexDigits [ len        & 0x0Fu] ;
+	sizeLine [4] = '\r' ;
+	sizeLine [5] = '\n' ;
+	WIZCHIP_WRITE_BUF (((uint32_t) pStream->chunkPtr << 8) + (WIZCHIP_TXBUF_BLOCK (pStream->sn) << 3),
+					   sizeLine, HTTP_STREAM_SIZELINE) ;
+
+	// The room for the trailer is reserved by hsWaitRoom(), and the previous SEND is done:
+	// send() will not block
+	if (send (pStream->sn, (uint8_t *) pTrailer, (uint16_t) trailerLen) < 0)
+	{
+		pStream->bError = 1u ;
+	}
+	pStream->bSending = 1u ;
+	pStream->chunkLen = 0u ;
+}
+
+//--------------------------------------------------------------------------------
+//	Write to the socket TX buffer, by chunks
+
+static	void	hsSocketWrite (httpStream_t * pStream, const uint8_t * pData, uint32_t len)
+{
+	uint32_t	size ;
+
+	while (len != 0u  &&  pStream->bError == 0u)
+	{
+		if (pStream->chunkLen == 0u  &&  ! hsChunkOpen (pStream))
+		{
+			break ;
+		}
+
+		size = HTTP_STREAM_CHUNK - pStream->chunkLen ;
+		if (size > len)
+		{
+			size = len ;
+		}
+		if (! hsWaitRoom (pStream, size))
+		{
+			break ;
+		}
+		wiz_send_data (pStream->sn, (uint8_t *) pData, (uint16_t) size) ;
+		pStream->chunkLen += size ;
+		pData += size ;
+		len   -= size ;
+
+		if (pStream->chunkLen == HTTP_STREAM_CHUNK)
+		{
+			hsChunkClose (pStream, hsChunkTrailer, sizeof (hsChunkTrailer) - 1u) ;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Write to the buffer of a memory or fragment stream
+
+static	void	hsMemWrite (httpStream_t * pStream, const uint8_t * pData, uint32_t len)
+{
+	uint32_t	size ;
+
+	while (len != 0u)
+	{
+		if (pStream->memLen == pStream->memSize)
+		{
+			if (pStream->sn == HTTP_STREAM_MEMORY)
+			{
+				pStream->bError = 1u ;		// Overflow
+				return ;
+			}
+			pStream->pFlush (pStream) ;
+			if (pStream->bError != 0u)
+			{
+				return ;
+			}
+		}
+
+		size = pStream->memSize - pStream->memLen ;
+		if (size > len)
+		{
+			size = len ;
+		}
+		memcpy (pStream->pMem + pStream->memLen, pData, size) ;
+		pStream->memLen += size ;
+		pData += size ;
+		len   -= size ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Copy the gathered bytes to the socket
+
+static	void	hsFlush (httpStream_t * pStream)
+{
+	if (pStream->bufLen != 0u)
+	{
+		hsSocketWrite (pStream, pStream->buf, pStream->bufLen) ;
+		pStream->bufLen = 0u ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Initialize a stream to a connected socket
+//	bChunked false: HTTP/1.0, the caller closes the connection at the end of the response
+
+void	hsInit (httpStream_t * pStream, uint8_t sn, const char * contentType, bool bChunked)
+{
+	memset (pStream, 0, sizeof (httpStream_t)) ;
+	pStream->sn          = sn ;
+	pStream->contentType = contentType ;
+	pStream->bChunked    = bChunked ? 1u : 0u ;
+}
+
+//--------------------------------------------------------------------------------
+//	Initialize a stream to a memory buffer
+
+void	hsInitMem (httpStream_t * pStream, uint8_t * pBuffer, uint32_t size, const char * contentType)
+{
+	memset (pStream, 0, sizeof (httpStream_t)) ;
+	pStream->sn          = HTTP_STREAM_MEMORY ;
+	pStream->contentType = contentType ;
+	pStream->pMem        = pBuffer ;
+	pStream->memSize     = size ;
+}
+
+//--------------------------------------------------------------------------------
+//	Initialize a stream to a memory buffer which is emptied by pFlush when it is full
+
+void	hsInitFragment (httpStream_t * pStream, uint8_t * pBuffer, uint32_t size, const char * contentType,
+						void (* pFlush) (httpStream_t * pStream))
+{
+	hsInitMem (pStream, pBuffer, size, contentType) ;
+	pStream->sn     = HTTP_STREAM_FRAGMENT ;
+	pStream->pFlush = pFlush ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	hsWrite (httpStream_t * pStream, const void * pData, uint32_t len)
+{
+	if (pStream->bError != 0u)
+	{
+		return ;
+	}
+
+	if (! HS_IS_SOCKET (pStream))
+	{
+		hsMemWrite (pStream, pData, len) ;
+		if (pStream->bError != 0u)
+		{
+			return ;
+		}
+	}
+	else if (len >= HTTP_STREAM_BUF)
+	{
+		// Large write: directly to the socket
+		hsFlush (pStream) ;
+		hsSocketWrite (pStream, pData, len) ;
+	}
+	else
+	{
+		if (pStream->bufLen + len > HTTP_STREAM_BUF)
+		{
+			hsFlush (pStream) ;
+		}
+		memcpy (& pStream->buf [pStream->bufLen], pData, len) ;
+		pStream->bufLen += len ;
+	}
+	pStream->total += len ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	hsPuts (httpStream_t * pStream, const char * pStr)
+{
+	hsWrite (pStream, pStr, strlen (pStr)) ;
+}
+
+//--------------------------------------------------------------------------------
+//	The output function used by hsPrintf()
+
+void	hsPutc (char cc, uintptr_t arg)
+{
+	httpStream_t	* pStream = (httpStream_t *) arg ;
+
+	if (HS_IS_SOCKET (pStream)  &&  pStream->bufLen < HTTP_STREAM_BUF)
+	{
+		// Fast path
+		pStream->buf [pStream->bufLen++] = (uint8_t) cc ;
+		pStream->total++ ;
+		return ;
+	}
+	hsWrite (pStream, & cc, 1u) ;
+}
+
+//--------------------------------------------------------------------------------
+//	End of the response
+//	For a socket stream, send the last chunk. For a fragment stream the last fragment
+//	remains in the buffer: the caller sends it
+//	Returns false if the stream is in error
+
+bool	hsEnd (httpStream_t * pStream)
+{
+	if (HS_IS_SOCKET (pStream))
+	{
+		hsFlush (pStream) ;
+		if (pStream->bError == 0u)
+		{
+			if (pStream->chunkLen != 0u)
+			{
+				hsChunkClose (pStream, hsLastChunk, sizeof (hsLastChunk) - 1u) ;
+			}
+			else if (pStream->bChunked == 0u)
+			{
+				// Not chunked: nothing ends the body, only an empty response needs its header
+				if (pStream->bStarted == 0u  &&  hsChunkOpen (pStream))
+				{
+					hsChunkClose (pStream, NULL, 0u) ;
+				}
+			}
+			else if (hsWaitSendOk (pStream)  &&  hsStart (pStream))
+			{
+				// No open chunk: only the last chunk, without the trailer of the previous chunk
+				if (send (pStream->sn, (uint8_t *) & hsLastChunk [2], sizeof (hsLastChunk) - 3u) < 0)
+				{
+					pStream->bError = 1u ;
+				}
+				pStream->bSending = 1u ;
+			}
+		}
+	}
+	return pStream->bError == 0u ;
+}
+
+//--------------------------------------------------------------------------------
+//	JSON writer
+
+void	hsJsonBegin (httpStream_t * pStream)
+{
+	hsWrite (pStream, "{", 1u) ;
+	pStream->bComma = 0u ;
+}
+
+void	hsJsonKey (httpStream_t * pStream, const char * pKey)
+{
+	if (pStream->bComma != 0u)
+	{
+		hsWrite (pStream, ",", 1u) ;
+	}
+	pStream->bComma = 1u ;
+	hsPrintf (pStream, "\"%s\":", pKey) ;
+}
+
+void	hsJsonInt (httpStream_t * pStream, const char * pKey, int32_t value)
+{
+	hsJsonKey (pStream, pKey) ;
+	hsPrintf (pStream, "\"%d\"", value) ;
+}
+
+void	hsJsonStr (httpStream_t * pStream, const char * pKey, const char * pValue)
+{
+	hsJsonKey (pStream, pKey) ;
+	hsPrintf (pStream, "\"%s\"", pValue) ;
+}
+
+void	hsJsonEnd (httpStream_t * pStream)
+{
+	hsWrite (pStream, "}", 1u) ;
+}
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,96 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	httpStream.h	Streaming writer of HTTP responses
+					The body is written directly to the W5500 socket TX buffer
+					using the HTTP/1.1 chunked transfer encoding, or without encoding
+					if the connection is closed at the end of the response (HTTP/1.0).
+					A stream can also write to a memory buffer (WIFI CGI responses).
+
+	When		Who	What
+	18/10/26	ac	Creation
+	18/10/26	ac	Fragment stream: memory buffer emptied by a function when it is full
+	18/10/26	ac	Not chunked stream for HTTP/1.0
+
+----------------------------------------------------------------------
+*/
+
+#if ! defined HTTPSTREAM_H_
+#define HTTPSTREAM_H_
+//-----------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	"aaprintf.h"
+
+// Max size of the body of a chunk. A chunk, with its size line and its CRLF,
+// must fit in the socket TX buffer (2 KB)
+#define	HTTP_STREAM_CHUNK		1024u
+
+// Size of the chunk size line: 4 hex digits + CRLF
+#define	HTTP_STREAM_SIZELINE	6u
+
+// Small writes are gathered in the stream before being copied to the socket
+#define	HTTP_STREAM_BUF			64u
+
+// The socket number of a stream which writes to a memory buffer
+#define	HTTP_STREAM_MEMORY		0xFFu
+
+// The socket number of a stream which writes to a memory buffer emptied by pFlush when it is full
+#define	HTTP_STREAM_FRAGMENT	0xFEu
+
+typedef struct httpStream_s
+{
+	const char	* contentType ;
+	uint8_t		* pMem ;		// Memory stream: the buffer
+	uint32_t	memSize ;		// Memory stream: size of the buffer
+	uint32_t	memLen ;		// Memory stream: count of bytes in the buffer
+	void		(* pFlush) (struct httpStream_s * pStream) ;	// Fragment stream: empties the buffer, sets memLen to 0
+	uint32_t	total ;			// Count of body bytes written
+	uint16_t	chunkPtr ;		// Socket TX pointer of the size line of the current chunk (not chunked: of its data)
+	uint16_t	chunkLen ;		// Count of bytes in the current chunk, 0 if no chunk is open
+	uint8_t		sn ;			// W5500 socket
+	uint8_t		bChunked ;		// Socket stream: chunked encoding, else the body ends with the connection
+	uint8_t		bStarted ;		// The response header has been written
+	uint8_t		bSending ;		// A SEND command is in progress
+	uint8_t		bError ;		// Socket closed, timeout or memory overflow: the following writes are ignored
+	uint8_t		bComma ;		// JSON: a value has been written, the next one needs a comma
+	uint8_t		bufLen ;		// Count of bytes in buf
+	uint8_t		buf [HTTP_STREAM_BUF] ;
+
+} httpStream_t ;
+
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void		hsInit			(httpStream_t * pStream, uint8_t sn, const char * contentType, bool bChunked) ;
+void		hsInitMem		(httpStream_t * pStream, uint8_t * pBuffer, uint32_t size, const char * contentType) ;
+void		hsInitFragment	(httpStream_t * pStream, uint8_t * pBuffer, uint32_t size, const char * contentType,
+							 void (* pFlush) (httpStream_t * pStream)) ;
+void		hsWrite			(httpStream_t * pStream, const void * pData, uint32_t len) ;
+void		hsPuts			(httpStream_t * pStream, const char * pStr) ;
+void		hsPutc			(char cc, uintptr_t arg) ;
+bool		hsEnd			(httpStream_t * pStream) ;
+
+// Formatted write: hsPrintf (pStream, fmt, ...)
+#define		hsPrintf(pStream, ...)	aaPrintfEx (hsPutc, (uintptr_t) (pStream), __VA_ARGS__)
+
+// JSON writer: the values are written as strings, like all the AASun CGI
+void		hsJsonBegin		(httpStream_t * pStream) ;
+void		hsJsonKey		(httpStream_t * pStream, const char * pKey) ;
+void		hsJsonInt		(httpStream_t * pStream, const char * pKey, int32_t value) ;
+void		hsJsonStr		(httpStream_t * pStream, const char * pKey, const char * pValue) ;
+void		hsJsonEnd		(httpStream_t * pStream) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//-----------------------------------------------------------------------------
+#endif	// HTTPSTREAM_H_
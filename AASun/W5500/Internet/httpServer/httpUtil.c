@@ -19,6 +19,7 @@
 #include "display.h"
 
 #include "aautils.h"
+#include "cgiCache.h"
 
 // To extract POST data
 static	const char contentTag [] = "Content-Length: " ;
@@ -55,551 +56,793 @@ static	bool findParam (char * pUri, char * pName, char * pValue, char ** ppSave)
 }
 
 //------------------------------------------------------------------
+// JSON formatting of the live values, from a snapshot (see liveSnapTake)
+// Used by the individual CGIs and by snapshot.cgi
 
-uint8_t http_get_cgi_handler_common (uint8_t * uri_name, char * pUriData, uint8_t * buf, uint32_t lenMax, uint32_t * file_len)
+static	uint32_t	jsonVolt (char * buf, uint32_t lenMax, const liveSnap_t * pSnap)
 {
-	uint8_t ret = HTTP_OK;
-	uint16_t len = 0;
-
-	char	midName [16] ;
-	char	midValue [16] ;
-	char	* pSaveParam ;
-
-	// Find 1st parameter which is the message id
-	findParam (pUriData, midName, midValue, & pSaveParam) ;
-
-	// Find 2nd parameter
-//	findParam (NULL, name2, value2, & pSaveParam) ;
-
-	if (strcmp ((const char *) uri_name, "volt.cgi") == 0)
-	{
-		len = aaSnPrintf((char*)buf, lenMax,
-							"{\"vRms\":\"%ld\","
-							"\"i1Rms\":\"%ld\","
-							"\"p1Real\":\"%ld\","
-							"\"p1App\":\"%ld\","
-							"\"cPhi1\":\"%ld\","
-							"\"i2Rms\":\"%ld\","
-							"\"p2Real\":\"%ld\","
-							"\"p2App\":\"%ld\","
-							"\"cPhi2\":\"%ld\","
-							"\"pDiv\":\"%lu\","
-							"\"Counter1\":\"%lu\","
-							"\"Counter2\":\"%lu\""
+	const computedData_t	* pData = & pSnap->computed ;
+
+	return aaSnPrintf(buf, lenMax,
+						"{\"vRms\":\"%ld\","
+						"\"i1Rms\":\"%ld\","
+						"\"p1Real\":\"%ld\","
+						"\"p1App\":\"%ld\","
+						"\"cPhi1\":\"%ld\","
+						"\"i2Rms\":\"%ld\","
+						"\"p2Real\":\"%ld\","
+						"\"p2App\":\"%ld\","
+						"\"cPhi2\":\"%ld\","
+						"\"pDiv\":\"%lu\","
+						"\"Counter1\":\"%lu\","
+						"\"Counter2\":\"%lu\""
 #if (defined IX_I3)
-							",\"i3Rms\":\"%ld\","
-							"\"p3Real\":\"%ld\","
-							"\"p3App\":\"%ld\","
-							"\"cPhi3\":\"%ld\""
+						",\"i3Rms\":\"%ld\","
+						"\"p3Real\":\"%ld\","
+						"\"p3App\":\"%ld\","
+						"\"cPhi3\":\"%ld\""
 #endif
 #if (defined IX_I4)
-							",\"i4Rms\":\"%ld\","
-							"\"p4Real\":\"%ld\","
-							"\"p4App\":\"%ld\","
-							"\"cPhi4\":\"%ld\""
+						",\"i4Rms\":\"%ld\","
+						"\"p4Real\":\"%ld\","
+						"\"p4App\":\"%ld\","
+						"\"cPhi4\":\"%ld\""
 #endif
-							"}",
-							 	 computedData.vRms >> VOLT_SHIFT,
-								 computedData.iData[0].iRms,		// x 2^I_SHIFT
-							 	 computedData.iData[0].powerReal >> POWER_SHIFT,
-							 	 computedData.iData[0].powerApp  >> POWER_SHIFT,
-							 	 computedData.iData[0].cosPhi,					// x 1000
-								 computedData.iData[1].iRms,		// x 2^I_SHIFT
-							 	 computedData.iData[1].powerReal >> POWER_SHIFT,
-							 	 computedData.iData[1].powerApp  >> POWER_SHIFT,
-							 	 computedData.iData[1].cosPhi,					// x 1000
-							 	 computedData.powerDiverted	>> POWER_DIVERTER_SHIFT,
-								 (pulseCounter [0].pulsePeriodCount* pulseCounter [0].pulsePowerCoef) >> PULSE_P_SHIFT,
-								 (pulseCounter [1].pulsePeriodCount* pulseCounter [1].pulsePowerCoef) >> PULSE_P_SHIFT
+						"}",
+						 	 pData->vRms >> VOLT_SHIFT,
+							 pData->iData[0].iRms,		// x 2^I_SHIFT
+						 	 pData->iData[0].powerReal >> POWER_SHIFT,
+						 	 pData->iData[0].powerApp  >> POWER_SHIFT,
+						 	 pData->iData[0].cosPhi,					// x 1000
+							 pData->iData[1].iRms,		// x 2^I_SHIFT
+						 	 pData->iData[1].powerReal >> POWER_SHIFT,
+						 	 pData->iData[1].powerApp  >> POWER_SHIFT,
+						 	 pData->iData[1].cosPhi,					// x 1000
+						 	 pData->powerDiverted	>> POWER_DIVERTER_SHIFT,
+							 pSnap->pulsePower [0],
+							 pSnap->pulsePower [1]
 #if (defined IX_I3)
-								 , computedData.iData[2].iRms,		// x 2^I_SHIFT
-							 	 computedData.iData[2].powerReal >> POWER_SHIFT,
-							 	 computedData.iData[2].powerApp  >> POWER_SHIFT,
-							 	 computedData.iData[2].cosPhi					// x 1000
+							 , pData->iData[2].iRms,		// x 2^I_SHIFT
+						 	 pData->iData[2].powerReal >> POWER_SHIFT,
+						 	 pData->iData[2].powerApp  >> POWER_SHIFT,
+						 	 pData->iData[2].cosPhi					// x 1000
 #endif
 #if (defined IX_I4)
-								 , computedData.iData[3].iRms,		// x 2^I_SHIFT
-							 	 computedData.iData[3].powerReal >> POWER_SHIFT,
-							 	 computedData.iData[3].powerApp  >> POWER_SHIFT,
-							 	 computedData.iData[3].cosPhi					// x 1000
+							 , pData->iData[3].iRms,		// x 2^I_SHIFT
+						 	 pData->iData[3].powerReal >> POWER_SHIFT,
+						 	 pData->iData[3].powerApp  >> POWER_SHIFT,
+						 	 pData->iData[3].cosPhi					// x 1000
 #endif
-						) ;
-		if (len >= lenMax)
-		{
-			// Buffer too small
-			ret = HTTP_FAILED ;
-			len = 0 ;
-		}
-	}
-	else if (strcmp ((const char *) uri_name, "energy.cgi") == 0)
-	{
-		energyCounters_t	energy ;
-		energyCounters_t	* pE = NULL ;
-		uint32_t			index ;
-
-		switch (midValue [0])
-		{
-			case 'T':		// Total energy
-				pE = & energyWh ;
-				break ;
-
-			case 'D':		// Today energy
-				pE = & dayEnergyWh ;
-				break ;
-
-			case 'H':		// History energy
-				// Get index parameter
-				findParam (NULL, midName, midValue, & pSaveParam) ;
-				index = strtoul (midValue, NULL, 10)  ;
-				pE = & energy ;
-				pE->date = -1 ;		// Avoid empty response. date 0 signals an error
-				if (index < HISTO_MAX-1)
-				{
-					// On return *pE is ok or -1
-					histoRead (index, pE, NULL) ;
-				}
-				break ;
+					) ;
+}
 
-			default:
-				break ;
-		}
-		if (pE != NULL)
-		{
-			len = aaSnPrintf((char*)buf, lenMax,
-					"{\"date\":\"%ld\""
-					",\"e0\":\"%ld\""
-					",\"e1\":\"%ld\""
-					",\"e2\":\"%ld\""
-					",\"e3\":\"%ld\""
-					",\"e4\":\"%ld\""
+static	uint32_t	jsonEnergy (char * buf, uint32_t lenMax, const energyCounters_t * pE)
+{
+	return aaSnPrintf(buf, lenMax,
+				"{\"date\":\"%ld\""
+				",\"e0\":\"%ld\""
+				",\"e1\":\"%ld\""
+				",\"e2\":\"%ld\""
+				",\"e3\":\"%ld\""
+				",\"e4\":\"%ld\""
 #if (defined IX_I3)
-					",\"e5\":\"%ld\""
+				",\"e5\":\"%ld\""
 #endif
 #if (defined IX_I4)
-					",\"e6\":\"%ld\""
+				",\"e6\":\"%ld\""
 #endif
-					",\"e7\":\"%ld\""
-					",\"e8\":\"%ld\"}",
+				",\"e7\":\"%ld\""
+				",\"e8\":\"%ld\"}",
 
-					pE->date, pE->energyImported, pE->energyExported,
-					pE->energyDiverted1, pE->energyDiverted2,
-					pE->energy2,
+				pE->date, pE->energyImported, pE->energyExported,
+				pE->energyDiverted1, pE->energyDiverted2,
+				pE->energy2,
 #if (defined IX_I3)
-					pE->energy3,
+				pE->energy3,
 #endif
 #if (defined IX_I4)
-					pE->energy4,
+				pE->energy4,
 #endif
-					(pE->energyPulse [0] * pulseCounter [0].pulseEnergyCoef) >> PULSE_E_SHIFT,
-					(pE->energyPulse [1] * pulseCounter [1].pulseEnergyCoef) >> PULSE_E_SHIFT) ;
-		}
-		else
-		{
-			// Invalid request
-			ret = HTTP_FAILED ;
-			len = 0 ;
-		}
+				(pE->energyPulse [0] * pulseCounter [0].pulseEnergyCoef) >> PULSE_E_SHIFT,
+				(pE->energyPulse [1] * pulseCounter [1].pulseEnergyCoef) >> PULSE_E_SHIFT) ;
+}
+
+static	uint32_t	jsonMeter (char * buf, uint32_t lenMax, const liveSnap_t * pSnap)
+{
+	return aaSnPrintf(buf, lenMax,
+			"{\"volt\":\"%ld\","
+			"\"cnt\":\"%ld\","
+			"\"pApp\":\"%ld\"}",
+			pSnap->meterVolt, pSnap->meterBase, pSnap->meterPapp) ;
+}
+
+// All the temperature sensors
+
+static	uint32_t	jsonTemperature (char * buf, uint32_t lenMax, const liveSnap_t * pSnap)
+{
+	uint32_t	len ;
+	uint32_t	rank ;
+
+	buf [0] = '{' ;
+	buf [1] = 0 ;
+	len = 1 ;
+	for (rank = 0 ; rank < TEMP_SENSOR_MAX ; rank++)
+	{
+		len += aaSnPrintf(buf+len, lenMax-len,
+				"\"temp%u\":\"%ld\",",
+				rank+1, pSnap->temp [rank]) ;
+	}
+	len += aaSnPrintf(buf+len, lenMax-len,
+			"\"factor\":\"%ld\"}",
+			1 << TEMP_SENSOR_SHIFT) ;
+	return len ;
+}
+
+//------------------------------------------------------------------
+// volt.cgi
+
+static	uint8_t	cgiVoltFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint8_t		ret = HTTP_OK ;
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	len = jsonVolt ((char *) buf, lenMax, liveSnapGet ()) ;
+	if (len >= lenMax)
+	{
+		// Buffer too small
+		ret = HTTP_FAILED ;
+		len = 0 ;
 	}
-	else if (strcmp ((const char *) uri_name, "meter.cgi") == 0)	// Linky
+
+	* pLen = len ;
+	return ret ;
+}
+
+//------------------------------------------------------------------
+// energy.cgi
+
+static	uint8_t	cgiEnergyFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint8_t		ret = HTTP_OK ;
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+	char		* midValue = pCgi->midValue ;
+	char		midName [16] ;
+
+	energyCounters_t	energy ;
+	const energyCounters_t	* pE = NULL ;
+	uint32_t			index ;
+
+	switch (midValue [0])
 	{
-		len = aaSnPrintf((char*)buf, lenMax,
-				"{\"volt\":\"%ld\","
-				"\"cnt\":\"%ld\","
-				"\"pApp\":\"%ld\"}",
-				meterVolt, meterBase, meterPapp) ;
+		case 'T':		// Total energy
+			pE = & liveSnapGet ()->energyWh ;
+			break ;
+
+		case 'D':		// Today energy
+			pE = & liveSnapGet ()->dayEnergyWh ;
+			break ;
+
+		case 'H':		// History energy
+			// Get index parameter
+			findParam (NULL, midName, midValue, & pCgi->pSave) ;
+			index = strtoul (midValue, NULL, 10)  ;
+			energy.date = -1 ;		// Avoid empty response. date 0 signals an error
+			if (index < HISTO_MAX-1)
+			{
+				// On return energy is ok or -1
+				histoRead (index, & energy, NULL) ;
+			}
+			pE = & energy ;
+			break ;
+
+		default:
+			break ;
 	}
-	else if (strcmp ((const char *) uri_name, "statusWord.cgi") == 0)
+	if (pE != NULL)
 	{
-		len = aaSnPrintf((char*)buf, lenMax,
-				"{\"SW\":\"%lu\"}",
-				statusWord) ;
+		len = jsonEnergy ((char *) buf, lenMax, pE) ;
 	}
-	else if (strcmp ((const char *) uri_name, "config.cgi") == 0)
+	else
 	{
-		// Send all the configuration parameters
-		len = aaSnPrintf((char*)buf, lenMax,
-				"{\"vCal\":\"%ld\""
-				",\"phaseCal\":\"%ld\""
-				",\"i1Cal\":\"%ld\""
-				",\"i1Offset\":\"%ld\""
-				",\"i2Cal\":\"%ld\""
-				",\"i2Offset\":\"%ld\""
+		// Invalid request
+		ret = HTTP_FAILED ;
+		len = 0 ;
+	}
+
+	* pLen = len ;
+	return ret ;
+}
+
+//------------------------------------------------------------------
+// meter.cgi: Linky
+
+static	uint8_t	cgiMeterFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	len = jsonMeter ((char *) buf, lenMax, liveSnapGet ()) ;
+
+	* pLen = len ;
+	return HTTP_OK ;
+}
+
+//------------------------------------------------------------------
+// statusWord.cgi
+
+static	uint8_t	cgiStatusWordFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	len = aaSnPrintf((char*)buf, lenMax,
+			"{\"SW\":\"%lu\"}",
+			liveSnapGet ()->statusWord) ;
+
+	* pLen = len ;
+	return HTTP_OK ;
+}
+
+//------------------------------------------------------------------
+// config.cgi
+
+static	uint8_t	cgiConfigFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint8_t		ret = HTTP_OK ;
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	// Send all the configuration parameters
+	len = aaSnPrintf((char*)buf, lenMax,
+			"{\"vCal\":\"%ld\""
+			",\"phaseCal\":\"%ld\""
+			",\"i1Cal\":\"%ld\""
+			",\"i1Offset\":\"%ld\""
+			",\"i2Cal\":\"%ld\""
+			",\"i2Offset\":\"%ld\""
 #if (defined IX_I3)
-				",\"i3Cal\":\"%ld\""
-				",\"i3Offset\":\"%ld\""
+			",\"i3Cal\":\"%ld\""
+			",\"i3Offset\":\"%ld\""
 #endif
 #if (defined IX_I4)
-				",\"i4Cal\":\"%ld\""
-				",\"i4Offset\":\"%ld\""
+			",\"i4Cal\":\"%ld\""
+			",\"i4Offset\":\"%ld\""
 #endif
-				,
-				voltCal,
-				phaseCal,
-				aaSunCfg.iSensor [0].iCal,
-				aaSunCfg.iSensor [0].iAdcOffset,
-				aaSunCfg.iSensor [1].iCal,
-				aaSunCfg.iSensor [1].iAdcOffset
+			,
+			voltCal,
+			phaseCal,
+			aaSunCfg.iSensor [0].iCal,
+			aaSunCfg.iSensor [0].iAdcOffset,
+			aaSunCfg.iSensor [1].iCal,
+			aaSunCfg.iSensor [1].iAdcOffset
 #if (defined IX_I3)
-				,aaSunCfg.iSensor [2].iCal,
-				aaSunCfg.iSensor [2].iAdcOffset
+			,aaSunCfg.iSensor [2].iCal,
+			aaSunCfg.iSensor [2].iAdcOffset
 #endif
 #if (defined IX_I4)
-				,aaSunCfg.iSensor [3].iCal,
-				aaSunCfg.iSensor [3].iAdcOffset
+			,aaSunCfg.iSensor [3].iCal,
+			aaSunCfg.iSensor [3].iAdcOffset
 #endif
-				) ;
+			) ;
 
-		len += aaSnPrintf((char*)buf + len, lenMax-len,
-				",\"p1Cal\":\"%ld\""
-				",\"p1Offset\":\"%ld\""
-				",\"p2Cal\":\"%ld\""
-				",\"p2Offset\":\"%ld\""
+	len += aaSnPrintf((char*)buf + len, lenMax-len,
+			",\"p1Cal\":\"%ld\""
+			",\"p1Offset\":\"%ld\""
+			",\"p2Cal\":\"%ld\""
+			",\"p2Offset\":\"%ld\""
 #if (defined IX_I3)
-				",\"p3Cal\":\"%ld\""
-				",\"p3Offset\":\"%ld\""
+			",\"p3Cal\":\"%ld\""
+			",\"p3Offset\":\"%ld\""
 #endif
 #if (defined IX_I4)
-				",\"p4Cal\":\"%ld\""
-				",\"p4Offset\":\"%ld\""
+			",\"p4Cal\":\"%ld\""
+			",\"p4Offset\":\"%ld\""
 #endif
-				",\"pMax1\":\"%ld\""
-				",\"pVolt1\":\"230\""
-				",\"pMargin1\":\"%ld\""
-				",\"pMax2\":\"%ld\""
-				",\"pVolt2\":\"230\""
-				",\"pMargin2\":\"%ld\""
-				,
-				aaSunCfg.iSensor [0].powerCal,
-				aaSunCfg.iSensor [0].powerOffset >> POWER_SHIFT,
-				aaSunCfg.iSensor [1].powerCal,
-				aaSunCfg.iSensor [1].powerOffset >> POWER_SHIFT,
+			",\"pMax1\":\"%ld\""
+			",\"pVolt1\":\"230\""
+			",\"pMargin1\":\"%ld\""
+			",\"pMax2\":\"%ld\""
+			",\"pVolt2\":\"230\""
+			",\"pMargin2\":\"%ld\""
+			,
+			aaSunCfg.iSensor [0].powerCal,
+			aaSunCfg.iSensor [0].powerOffset >> POWER_SHIFT,
+			aaSunCfg.iSensor [1].powerCal,
+			aaSunCfg.iSensor [1].powerOffset >> POWER_SHIFT,
 #if (defined IX_I3)
-				aaSunCfg.iSensor [2].powerCal,
-				aaSunCfg.iSensor [2].powerOffset >> POWER_SHIFT,
+			aaSunCfg.iSensor [2].powerCal,
+			aaSunCfg.iSensor [2].powerOffset >> POWER_SHIFT,
 #endif
 #if (defined IX_I4)
-				aaSunCfg.iSensor [3].powerCal,
-				aaSunCfg.iSensor [3].powerOffset >> POWER_SHIFT,
+			aaSunCfg.iSensor [3].powerCal,
+			aaSunCfg.iSensor [3].powerOffset >> POWER_SHIFT,
 #endif
-				powerDiv [0].powerDiverter230,
-				powerDiv [0].powerMargin >> POWER_SHIFT,
-				powerDiv [1].powerDiverter230,
-				powerDiv [1].powerMargin >> POWER_SHIFT) ;
-
-		len += aaSnPrintf((char*)buf + len, lenMax-len,
-				",\"cksP\":\"%ld\""
-				",\"cksI\":\"%ld\""
-				",\"ckdP\":\"%ld\""
-				",\"ckdI\":\"%ld\"",
-				(syncPropFactor * 10000 + SPID_SCALE_FACTOR / 2) / SPID_SCALE_FACTOR,
-				(syncIntFactor * 10000 + SPID_SCALE_FACTOR / 2) / SPID_SCALE_FACTOR,
-				powerPropFactor,
-				powerIntFactor) ;
-
-		len += aaSnPrintf((char*)buf + len, lenMax-len,
-				",\"counter1\":\"%lu\""
-				",\"counter2\":\"%lu\""
-				",\"cfp\":\"%lu\""
-				",\"display\":\"%s\"",
-				pulseCounter [0].pulsepkWh,
-				pulseCounter [1].pulsepkWh,
-				aaSunCfg.favoritePage,
-				aaSunCfg.displayController == DISPLAY_NONE ? "None" :
-				aaSunCfg.displayController == DISPLAY_SH1106 ? "SH1106" : "SSD1306") ;
-
-		len += aaSnPrintf((char*)buf + len, lenMax-len,
-				",\"clip\":\"%lu\""
-				",\"clmask\":\"%lu\""
-				",\"clgw\":\"%lu\""
-				",\"cldns\":\"%lu\"",
-				aaSunCfg.lanCfg.ip  [0] << 24 | aaSunCfg.lanCfg.ip  [1] << 16 | aaSunCfg.lanCfg.ip  [2] << 8 | aaSunCfg.lanCfg.ip  [3],
-				aaSunCfg.lanCfg.sn  [0] << 24 | aaSunCfg.lanCfg.sn  [1] << 16 | aaSunCfg.lanCfg.sn  [2] << 8 | aaSunCfg.lanCfg.sn  [3],
-				aaSunCfg.lanCfg.gw  [0] << 24 | aaSunCfg.lanCfg.gw  [1] << 16 | aaSunCfg.lanCfg.gw  [2] << 8 | aaSunCfg.lanCfg.gw  [3],
-				aaSunCfg.lanCfg.dns [0] << 24 | aaSunCfg.lanCfg.dns [1] << 16 | aaSunCfg.lanCfg.dns [2] << 8 | aaSunCfg.lanCfg.dns [3]) ;
-
-		len += aaSnPrintf((char*)buf + len, lenMax-len,
-				",\"n0\":\"%s\""
-				",\"n1\":\"%s\""
-				",\"n2\":\"%s\""
-				",\"n3\":\"%s\""
-				",\"n4\":\"%s\""
+			powerDiv [0].powerDiverter230,
+			powerDiv [0].powerMargin >> POWER_SHIFT,
+			powerDiv [1].powerDiverter230,
+			powerDiv [1].powerMargin >> POWER_SHIFT) ;
+
+	len += aaSnPrintf((char*)buf + len, lenMax-len,
+			",\"cksP\":\"%ld\""
+			",\"cksI\":\"%ld\""
+			",\"ckdP\":\"%ld\""
+			",\"ckdI\":\"%ld\"",
+			(syncPropFactor * 10000 + SPID_SCALE_FACTOR / 2) / SPID_SCALE_FACTOR,
+			(syncIntFactor * 10000 + SPID_SCALE_FACTOR / 2) / SPID_SCALE_FACTOR,
+			powerPropFactor,
+			powerIntFactor) ;
+
+	len += aaSnPrintf((char*)buf + len, lenMax-len,
+			",\"counter1\":\"%lu\""
+			",\"counter2\":\"%lu\""
+			",\"cfp\":\"%lu\""
+			",\"display\":\"%s\"",
+			pulseCounter [0].pulsepkWh,
+			pulseCounter [1].pulsepkWh,
+			aaSunCfg.favoritePage,
+			aaSunCfg.displayController == DISPLAY_NONE ? "None" :
+			aaSunCfg.displayController == DISPLAY_SH1106 ? "SH1106" : "SSD1306") ;
+
+	len += aaSnPrintf((char*)buf + len, lenMax-len,
+			",\"clip\":\"%lu\""
+			",\"clmask\":\"%lu\""
+			",\"clgw\":\"%lu\""
+			",\"cldns\":\"%lu\"",
+			aaSunCfg.lanCfg.ip  [0] << 24 | aaSunCfg.lanCfg.ip  [1] << 16 | aaSunCfg.lanCfg.ip  [2] << 8 | aaSunCfg.lanCfg.ip  [3],
+			aaSunCfg.lanCfg.sn  [0] << 24 | aaSunCfg.lanCfg.sn  [1] << 16 | aaSunCfg.lanCfg.sn  [2] << 8 | aaSunCfg.lanCfg.sn  [3],
+			aaSunCfg.lanCfg.gw  [0] << 24 | aaSunCfg.lanCfg.gw  [1] << 16 | aaSunCfg.lanCfg.gw  [2] << 8 | aaSunCfg.lanCfg.gw  [3],
+			aaSunCfg.lanCfg.dns [0] << 24 | aaSunCfg.lanCfg.dns [1] << 16 | aaSunCfg.lanCfg.dns [2] << 8 | aaSunCfg.lanCfg.dns [3]) ;
+
+	len += aaSnPrintf((char*)buf + len, lenMax-len,
+			",\"n0\":\"%s\""
+			",\"n1\":\"%s\""
+			",\"n2\":\"%s\""
+			",\"n3\":\"%s\""
+			",\"n4\":\"%s\""
 //#if (defined IX_I3)
-				",\"n5\":\"%s\""
+			",\"n5\":\"%s\""
 //#endif
 //#if (defined IX_I4)
-				",\"n6\":\"%s\""
+			",\"n6\":\"%s\""
 //#endif
-				",\"n7\":\"%s\""
-				",\"n8\":\"%s\"}",
-				aaSunCfg.eName [0],
-				aaSunCfg.eName [1],
-				aaSunCfg.eName [2],
-				aaSunCfg.eName [3],
-				aaSunCfg.eName [4],
+			",\"n7\":\"%s\""
+			",\"n8\":\"%s\"}",
+			aaSunCfg.eName [0],
+			aaSunCfg.eName [1],
+			aaSunCfg.eName [2],
+			aaSunCfg.eName [3],
+			aaSunCfg.eName [4],
 //#if (defined IX_I3)
-				aaSunCfg.eName [5],
+			aaSunCfg.eName [5],
 //#endif
 //#if (defined IX_I4)
-				aaSunCfg.eName [6],
+			aaSunCfg.eName [6],
 //#endif
-				aaSunCfg.eName [7],
-				aaSunCfg.eName [8]) ;
+			aaSunCfg.eName [7],
+			aaSunCfg.eName [8]) ;
 
 
-		if (len >= lenMax)
+	if (len >= lenMax)
+	{
+		// Buffer too small
+		ret = HTTP_FAILED ;
+		len = 0 ;
+	}
+
+	* pLen = len ;
+	return ret ;
+}
+
+//------------------------------------------------------------------
+// temperature.cgi: Temperature sensors
+
+static	uint8_t	cgiTemperatureFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint8_t		ret = HTTP_OK ;
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+	char		* midValue = pCgi->midValue ;
+
+	uint32_t	rank ;
+	uint32_t	ii ;
+	int32_t		temperature ;
+
+	// Argument: "mid=N" where N is the sensor index (not the rank) '1' to '4' or 'All'
+	// Returns raw temperature value: signed binary << TEMP_SENSOR_SHIFT
+	// Invalid sensor returns 200C << TEMP_SENSOR_SHIFT
+
+	// Internally temperature index starts at 0. The user index starts at 1.
+	if (midValue [0] >= '1'  &&  midValue [0] <= (0x30 + TEMP_SENSOR_MAX))
+	{
+		rank = midValue [0] - 0x30 - 1 ;
+		temperature = 200 << TEMP_SENSOR_SHIFT ;	// default: invalid temperature
+		for (ii = 0 ; ii < TEMP_SENSOR_MAX ; ii++)
 		{
-			// Buffer too small
-			ret = HTTP_FAILED ;
-			len = 0 ;
+			if (pTempSensors->sensors[ii].rank == rank  &&  pTempSensors->sensors[ii].present != 0)
+			{
+				temperature =  pTempSensors->sensors[ii].rawTemp ;
+				break ;
+			}
 		}
+		len = aaSnPrintf((char*)buf, lenMax,
+				"\"temp%u\":\"%ld\","
+				"\"factor\":\"%ld\"}",
+				rank + 1, temperature,
+				1 << TEMP_SENSOR_SHIFT) ;
 	}
-	else if (strcmp ((const char *) uri_name, "temperature.cgi") == 0)	// Temperature sensors
+	else if (midValue [0] == 'A')
+	{
+		len = jsonTemperature ((char *) buf, lenMax, liveSnapGet ()) ;
+	}
+	else
 	{
-		uint32_t	rank ;
-		uint32_t	ii ;
-		int32_t		temperature ;
+aaPrintf ("Unknown MID '%s'\n", midValue) ;
+		ret = HTTP_FAILED ;
+		len = 0 ;
+	}
+
+	* pLen = len ;
+	return ret ;
+}
 
-		// Argument: "mid=N" where N is the sensor index (not the rank) '1' to '4' or 'All'
-		// Returns raw temperature value: signed binary << TEMP_SENSOR_SHIFT
-		// Invalid sensor returns 200C << TEMP_SENSOR_SHIFT
+//------------------------------------------------------------------
+// powerHisto.cgi: Power history data
+
+static	uint8_t	cgiPowerHistoFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint8_t		ret = HTTP_OK ;
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	char		* midValue = pCgi->midValue ;
+	char		midName [16] ;
 
-		// Internally temperature index starts at 0. The user index starts at 1.
-		if (midValue [0] >= '1'  &&  midValue [0] <= (0x30 + TEMP_SENSOR_MAX))
+	uint32_t	mid = strtoul (midValue, NULL, 10) ;
+	uint32_t	index ;
+	uint32_t	count ;
+	uint32_t	offset ;
+	uint32_t	size ;
+
+	// The mid is 1 to 7
+	// This http server have a buffer of only 2 kB, not enough for the full history.
+	// Then the server allows to acquire it in 2 parts.
+	// On LAN the response can be streamed to the socket: the full history is sent in one request (mid 5 to 7).
+	// On WIFI it is streamed to the UART in several frames (fragment stream).
+	enum
+	{
+		todayPart1     = 1,
+		todayPart2     = 2,
+		yesterdayPart1 = 3,
+		yesterdayPart2 = 4,
+		todayFull      = 5,		// Streamed only
+		dayFull        = 6,		// Streamed only
+		daysFull       = 7		// Streamed only: 'count' days from 'index'
+	};
+
+	// Get the history index (useless for today)
+	findParam (NULL, midName, midValue, & pCgi->pSave) ;
+	index = strtoul (midValue, NULL, 10)  ;
+
+	if (mid >= todayFull)
+	{
+		httpStream_t	* pStream = pCgi->pStream ;
+
+		if (pStream == NULL  ||  pStream->sn == HTTP_STREAM_MEMORY)
 		{
-			rank = midValue [0] - 0x30 - 1 ;
-			temperature = 200 << TEMP_SENSOR_SHIFT ;	// default: invalid temperature
-			for (ii = 0 ; ii < TEMP_SENSOR_MAX ; ii++)
-			{
-				if (pTempSensors->sensors[ii].rank == rank  &&  pTempSensors->sensors[ii].present != 0)
-				{
-					temperature =  pTempSensors->sensors[ii].rawTemp ;
-					break ;
-				}
-			}
-			len = aaSnPrintf((char*)buf, lenMax,
-					"\"temp%u\":\"%ld\","
-					"\"factor\":\"%ld\"}",
-					rank + 1, temperature,
-					1 << TEMP_SENSOR_SHIFT) ;
+			return HTTP_FAILED ;	// Too large for a memory buffer
+		}
+
+		if (mid == todayFull)
+		{
+			hsWrite (pStream, powerHistory, sizeof (powerH_t) * POWER_HISTO_MAX_WHEADER) ;
+			* pLen = 0 ;
+			return HTTP_OK ;
+		}
+
+		// Get the count of days
+		count = 1 ;
+		if (mid == daysFull  &&  findParam (NULL, midName, midValue, & pCgi->pSave))
+		{
+			count = strtoul (midValue, NULL, 10)  ;
+		}
+		if (count == 0  ||  ! histoCheckRank (index, NULL))
+		{
+			// Data not found
+			* (int32_t *) buf = -1 ;	// Fake data: avoid empty response
+			hsWrite (pStream, buf, 4) ;
+			* pLen = 0 ;
+			return HTTP_OK ;
 		}
-		else if (midValue [0] == 'A')
+
+		// Read the days from the flash by pieces: buf is free now that the parameters are decoded
+		for ( ; count != 0  &&  histoCheckRank (index, NULL) ; count--, index++)
 		{
-			buf [0] = '{' ;
-			buf [1] = 0 ;
-			len = 1 ;
-			for (ii = 0 ; ii < TEMP_SENSOR_MAX ; ii++)
+			for (offset = 0 ; offset < sizeof (powerH_t) * POWER_HISTO_MAX_WHEADER ; offset += size)
 			{
-				temperature = 200 << TEMP_SENSOR_SHIFT ;
-				if (pTempSensors->sensors[ii].present != 0)
+				size = sizeof (powerH_t) * POWER_HISTO_MAX_WHEADER - offset ;
+				if (size > HTTP_STREAM_CHUNK)
 				{
-					temperature =  pTempSensors->sensors[ii].rawTemp ;
+					size = HTTP_STREAM_CHUNK ;
 				}
-				len += aaSnPrintf((char*)buf+len, lenMax-len,
-						"\"temp%u\":\"%ld\",",
-						pTempSensors->sensors[ii].rank+1, temperature) ;
+				histoPowerRead (buf, index, offset, size) ;
+				hsWrite (pStream, buf, size) ;
 			}
-			len += aaSnPrintf((char*)buf+len, lenMax-len,
-					"\"factor\":\"%ld\"}",
-					1 << TEMP_SENSOR_SHIFT) ;
-		}
-		else
-		{
-aaPrintf ("Unknown MID '%s'\n", midValue) ;
-			ret = HTTP_FAILED ;
-			len = 0 ;
 		}
+		* pLen = 0 ;
+		return HTTP_OK ;
 	}
-	else if (strcmp ((const char *) uri_name, "powerHisto.cgi") == 0)	// Power history data
+
+	switch (mid)
 	{
-		uint32_t	mid = strtoul (midValue, NULL, 10) ;
-		uint32_t	index ;
+		case todayPart1:
+			len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER / 2) ;
+			memcpy (buf, powerHistory, len) ;
+			break ;
 
-		// The mid is 1 to 4
-		// This http server have a buffer of only 2 kB, not enough for the full history.
-		// Then the server allows to acquire it in 2 parts.
-		enum
-		{
-			todayPart1     = 1,
-			todayPart2     = 2,
-			yesterdayPart1 = 3,
-			yesterdayPart2 = 4
-		};
+		case todayPart2:
+			len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER - (POWER_HISTO_MAX_WHEADER / 2)) ;
+			memcpy (buf, & powerHistory [POWER_HISTO_MAX_WHEADER / 2], len) ;
+			break ;
 
-		// Get the history index (useless for today)
-		findParam (NULL, midName, midValue, & pSaveParam) ;
-		index = strtoul (midValue, NULL, 10)  ;
+		case yesterdayPart1:
+			len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER / 2) ;
+			if (! histoPowerRead (buf, index, 0, len))
+			{
+				len = 4 ;	// Data not found
+				* (int32_t *) buf = -1 ;	// Fake data: avoid empty response
+			}
+			break ;
 
-		switch (mid)
-		{
-			case todayPart1:
-				len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER / 2) ;
-				memcpy (buf, powerHistory, len) ;
-				break ;
+		case yesterdayPart2:
+			len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER - (POWER_HISTO_MAX_WHEADER / 2)) ;
+			if (! histoPowerRead (buf, index, sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER / 2), len))
+			{
+				len = 4 ;	// Data not found
+				* (int32_t *) buf = -1 ;	// Fake data: avoid empty response
+			}
+			break ;
 
-			case todayPart2:
-				len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER - (POWER_HISTO_MAX_WHEADER / 2)) ;
-				memcpy (buf, & powerHistory [POWER_HISTO_MAX_WHEADER / 2], len) ;
-				break ;
+		default:
+			len = 0 ;
+	}
+	if (len == 0)
+	{
+		ret = HTTP_FAILED ;		// Data not found
+	}
 
-			case yesterdayPart1:
-				len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER / 2) ;
-				if (! histoPowerRead (buf, index, 0, len))
-				{
-					len = 4 ;	// Data not found
-					* (int32_t *) buf = -1 ;	// Fake data: avoid empty response
-				}
-				break ;
+	* pLen = len ;
+	return ret ;
+}
 
-			case yesterdayPart2:
-				len = sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER - (POWER_HISTO_MAX_WHEADER / 2)) ;
-				if (! histoPowerRead (buf, index, sizeof (powerH_t) * (POWER_HISTO_MAX_WHEADER / 2), len))
-				{
-					len = 4 ;	// Data not found
-					* (int32_t *) buf = -1 ;	// Fake data: avoid empty response
-				}
-				break ;
+//------------------------------------------------------------------
+// version.cgi
 
-			default:
-				len = 0 ;
-		}
-		if (len == 0)
-		{
-			ret = HTTP_FAILED ;		// Data not found
-		}
-	}
+static	uint8_t	cgiVersionFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	len = aaSnPrintf((char*)buf, lenMax,
+			"{\"soft\":\"%ld\""
+			",\"wifi\":\"%ld\""
+			",\"wifiAP\":\"%ld\"}",
+			AASunVersion (),
+			wifiSoftwareVersion,
+			wifiModeAP) ;
+
+	* pLen = len ;
+	return HTTP_OK ;
+}
 
-	else if (strcmp ((const char *) uri_name, "version.cgi") == 0)
-	{
-		len = aaSnPrintf((char*)buf, lenMax,
-				"{\"soft\":\"%ld\""
-				",\"wifi\":\"%ld\""
-				",\"wifiAP\":\"%ld\"}",
-				AASunVersion (),
-				wifiSoftwareVersion,
-				wifiModeAP) ;
-	}
-
-	else if (strcmp ((const char *) uri_name, "enames.cgi") == 0)
-	{
-		len = aaSnPrintf ((char*) buf, lenMax,
-				"{\"n0\":\"%s\""
-				",\"n1\":\"%s\""
-				",\"n2\":\"%s\""
-				",\"n3\":\"%s\""
-				",\"n4\":\"%s\""
+//------------------------------------------------------------------
+// enames.cgi
+
+static	uint8_t	cgiENamesFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	len = aaSnPrintf ((char*) buf, lenMax,
+			"{\"n0\":\"%s\""
+			",\"n1\":\"%s\""
+			",\"n2\":\"%s\""
+			",\"n3\":\"%s\""
+			",\"n4\":\"%s\""
 #if (defined IX_I3)
-				",\"n5\":\"%s\""
+			",\"n5\":\"%s\""
 #endif
 #if (defined IX_I4)
-				",\"n6\":\"%s\""
+			",\"n6\":\"%s\""
 #endif
-				",\"n7\":\"%s\""
-				",\"n8\":\"%s\"}",
-
-				aaSunCfg.eName [0],
-				aaSunCfg.eName [1],
-				aaSunCfg.eName [2],
-				aaSunCfg.eName [3],
-				aaSunCfg.eName [4],
+			",\"n7\":\"%s\""
+			",\"n8\":\"%s\"}",
+
+			aaSunCfg.eName [0],
+			aaSunCfg.eName [1],
+			aaSunCfg.eName [2],
+			aaSunCfg.eName [3],
+			aaSunCfg.eName [4],
 #if (defined IX_I3)
-				aaSunCfg.eName [5],
+			aaSunCfg.eName [5],
 #endif
 #if (defined IX_I4)
-				aaSunCfg.eName [6],
+			aaSunCfg.eName [6],
 #endif
-				aaSunCfg.eName [7],
-				aaSunCfg.eName [8]) ;
-	}
+			aaSunCfg.eName [7],
+			aaSunCfg.eName [8]) ;
 
-	else if (strcmp ((const char *) uri_name, "divrules.cgi") == 0)	// Diverting rules
+	* pLen = len ;
+	return HTTP_OK ;
+}
+
+//------------------------------------------------------------------
+// snapshot.cgi: All the live values of the web pages in one response
+// Built from one snapshot, so all the values are from the same second.
+// The sections have the format of volt.cgi, meter.cgi, temperature.cgi/?mid=All,
+// energy.cgi/?mid=Total, energy.cgi/?mid=Day and dfstatus.cgi
+
+static	uint8_t	cgiSnapshotFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint8_t		ret = HTTP_OK ;
+	uint32_t	len = 0 ;
+	char		* buf = (char *) pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	const liveSnap_t	* pSnap = liveSnapGet () ;
+
+	len  = aaSnPrintf (buf, lenMax,
+			"{\"gen\":\"%lu\",\"SW\":\"%lu\",\"volt\":",
+			pSnap->generation, pSnap->statusWord) ;
+	len += jsonVolt        (buf + len, lenMax - len, pSnap) ;
+	len += aaSnPrintf      (buf + len, lenMax - len, ",\"meter\":") ;
+	len += jsonMeter       (buf + len, lenMax - len, pSnap) ;
+	len += aaSnPrintf      (buf + len, lenMax - len, ",\"temp\":") ;
+	len += jsonTemperature (buf + len, lenMax - len, pSnap) ;
+	len += aaSnPrintf      (buf + len, lenMax - len, ",\"eTotal\":") ;
+	len += jsonEnergy      (buf + len, lenMax - len, & pSnap->energyWh) ;
+	len += aaSnPrintf      (buf + len, lenMax - len, ",\"eDay\":") ;
+	len += jsonEnergy      (buf + len, lenMax - len, & pSnap->dayEnergyWh) ;
+	len += aaSnPrintf      (buf + len, lenMax - len, ",\"df\":") ;
+	len += forceJsonStatus (buf + len, lenMax - len) ;
+	len += aaSnPrintf      (buf + len, lenMax - len, "}") ;
+
+	if (len >= lenMax)
 	{
-		char	* pStr = (char *) buf ;
+		// Buffer too small
+		ret = HTTP_FAILED ;
+		len = 0 ;
+	}
+
+	* pLen = len ;
+	return ret ;
+}
+
+//------------------------------------------------------------------
+// divrules.cgi: Diverting rules
+
+static	uint8_t	cgiDivRulesFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
 
-		strcpy (pStr, "{\"rule1\":\"") ;
-		len = strlen (pStr) ;
-		len += divRulePrint (& aaSunCfg.diverterRule[0], pStr + len, 128) ;
+	char	* pStr = (char *) buf ;
 
-		strcpy (pStr + len, "\",\"rule2\":\"") ;
-		len += 11 ;
-		len += divRulePrint (& aaSunCfg.diverterRule[1], pStr + len, 128) ;
-		strcpy (pStr + len, "\"}") ;
-		len += 2 ;
+	strcpy (pStr, "{\"rule1\":\"") ;
+	len = strlen (pStr) ;
+	len += divRulePrint (& aaSunCfg.diverterRule[0], pStr + len, 128) ;
+
+	strcpy (pStr + len, "\",\"rule2\":\"") ;
+	len += 11 ;
+	len += divRulePrint (& aaSunCfg.diverterRule[1], pStr + len, 128) ;
+	strcpy (pStr + len, "\"}") ;
+	len += 2 ;
 //aaPuts (pStr) ; aaPutChar ('\n') ;
-	}
 
-	else if (strcmp ((const char *) uri_name, "forcerules.cgi") == 0)	// Forcing rules
-	{
-		char			* pStr = (char *) buf ;
-		forceRules_t	* pForce = aaSunCfg.forceRules ;
+	* pLen = len ;
+	return HTTP_OK ;
+}
 
-		// Send only valid forcing
-		* pStr = '{' ;
-		len = 1 ;
-		for (uint32_t ii = 0 ; ii < FORCE_MAX ; ii++)
-		{
-			if (forceRuleIsValid (pForce))
-			{
-				if (len != 1)
-				{
-					// This is not the 1st forcing: prepend a comma
-					pStr [len] = ',' ;
-					len++ ;
-				}
-				len += aaSnPrintf (pStr + len, 128, "\"start%u\":\"", ii) ;
-				len += forceRulePrint (pForce, true, pStr + len, 128) ;
-				len += aaSnPrintf (pStr + len, 128, "\",\"stop%u\":\"", ii) ;
-				len += forceRulePrint (pForce, false, pStr + len, 128) ;
-				pStr [len++] = '"' ;
-			}
-			pForce++ ;
-		}
-		pStr[len++] = '}' ;
-//aaPrintf (" %d %s\n", len, pStr) ;
-	}
+//------------------------------------------------------------------
+// forcerules.cgi: Forcing rules
 
-	else if (strcmp ((const char *) uri_name, "dfstatus.cgi") == 0)	// All forcing/diverting status
+// Streamed: all the rules are sent whatever their length
+
+static	uint8_t	cgiForceRulesFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	httpStream_t	* pStream = pCgi->pStream ;
+	forceRules_t	* pForce = aaSunCfg.forceRules ;
+	char			* pStr = (char *) pCgi->buf + pCgi->lenMax - 128 ;	// To print a rule
+	char			key [16] ;
+
+	// The rules are printed at the end of buf: out of the memory stream area
+	if (pStream->sn == HTTP_STREAM_MEMORY)
 	{
-		len = forceJsonStatus ((char *) buf, lenMax) ;
+		pStream->memSize = pCgi->lenMax - 128 ;
 	}
 
-	else if (strcmp ((const char *) uri_name, "variable.cgi") == 0)	// All variable Vx + Anti-legionella
+	// Send only valid forcing
+	hsJsonBegin (pStream) ;
+	for (uint32_t ii = 0 ; ii < FORCE_MAX ; ii++)
 	{
-		buf [0] = '{' ;
-		len = 1u ;
-		for (uint32_t ii = 0 ; ii < AASUNVAR_MAX ; ii++)
-		{
-			len += aaSnPrintf ((char *) buf + len, 128, "\"V%u\":", ii+1) ;
-			len += aaSnPrintf ((char *) buf + len, 128, "\"%d\",", aaSunVariable [ii]) ;
-		}
-		if (aaSunCfg.alFlag == 0)
+		if (forceRuleIsValid (pForce))
 		{
-			// Anti-legionella OFF
-			len += aaSnPrintf ((char *) buf + len, 128, "\"alSensor\":\"Off\",") ;
-		}
-		else if ((aaSunCfg.alFlag & AL_FLAG_INPUT) != 0)
-		{
-			// Anti-legionella In
-			len += aaSnPrintf ((char *) buf + len, 128, "\"alSensor\":\"I%c\",", '1' + (aaSunCfg.alFlag & AL_FLAG_NUMMASK)) ;
-			len += aaSnPrintf ((char *) buf + len, 128, "\"alValue\":\"%d\",", aaSunCfg.alValue) ;
-		}
-		else
-		{
-			// Anti-legionella Tn
-			len += aaSnPrintf ((char *) buf + len, 128, "\"alSensor\":\"T%c\",", '1' + (aaSunCfg.alFlag & AL_FLAG_NUMMASK)) ;
-			len += aaSnPrintf ((char *) buf + len, 128, "\"alValue\":\"%d\",", aaSunCfg.alValue) ;
+			aaSnPrintf (key, sizeof (key), "start%u", ii) ;
+			forceRulePrint (pForce, true, pStr, 128) ;
+			hsJsonStr (pStream, key, pStr) ;
+
+			aaSnPrintf (key, sizeof (key), "stop%u", ii) ;
+			forceRulePrint (pForce, false, pStr, 128) ;
+			hsJsonStr (pStream, key, pStr) ;
 		}
-		buf [len-1] = '}' ;	// Replace the last ',' with '}'
-//aaPrintf ("%d %s\n", len, buf) ;
+		pForce++ ;
 	}
+	hsJsonEnd (pStream) ;
+
+	* pLen = 0 ;
+	return HTTP_OK ;
+}
+
+//------------------------------------------------------------------
+// dfstatus.cgi: All forcing/diverting status
+
+static	uint8_t	cgiDfStatusFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
+	uint32_t	lenMax = pCgi->lenMax ;
+
+	len = forceJsonStatus ((char *) buf, lenMax) ;
+
+	* pLen = len ;
+	return HTTP_OK ;
+}
+
+//------------------------------------------------------------------
+// variable.cgi: All variable Vx + Anti-legionella
+
+static	uint8_t	cgiVariableFn (cgiGetParam_t * pCgi, uint32_t * pLen)
+{
+	uint32_t	len = 0 ;
+	uint8_t		* buf = pCgi->buf ;
 
+	buf [0] = '{' ;
+	len = 1u ;
+	for (uint32_t ii = 0 ; ii < AASUNVAR_MAX ; ii++)
+	{
+		len += aaSnPrintf ((char *) buf + len, 128, "\"V%u\":", ii+1) ;
+		len += aaSnPrintf ((char *) buf + len, 128, "\"%d\",", aaSunVariable [ii]) ;
+	}
+	if (aaSunCfg.alFlag == 0)
+	{
+		// Anti-legionella OFF
+		len += aaSnPrintf ((char *) buf + len, 128, "\"alSensor\":\"Off\",") ;
+	}
+	else if ((aaSunCfg.alFlag & AL_FLAG_INPUT) != 0)
+	{
+		// Anti-legionella In
+		len += aaSnPrintf ((char *) buf + len, 128, "\"alSensor\":\"I%c\",", '1' + (aaSunCfg.alFlag & AL_FLAG_NUMMASK)) ;
+		len += aaSnPrintf ((char *) buf + len, 128, "\"alValue\":\"%d\",", aaSunCfg.alValue) ;
+	}
 	else
 	{
-		// CGI file not found
-		ret = HTTP_FAILED;
+		// Anti-legionella Tn
+		len += aaSnPrintf ((char *) buf + len, 128, "\"alSensor\":\"T%c\",", '1' + (aaSunCfg.alFlag & AL_FLAG_NUMMASK)) ;
+		len += aaSnPrintf ((char *) buf + len, 128, "\"alValue\":\"%d\",", aaSunCfg.alValue) ;
 	}
+	buf [len-1] = '}' ;	// Replace the last ',' with '}'
+//aaPrintf ("%d %s\n", len, buf) ;
 
-	* file_len = len ;
-	return ret;
+	* pLen = len ;
+	return HTTP_OK ;
 }
 
 //------------------------------------------------------------------
@@ -607,7 +850,7 @@ aaPrintf ("Unknown MID '%s'\n", midValue) ;
 // On entry  buf is pHTTP_TX which contain the parsed st_http_request, with the full URI, example: /toto.cgi?a=1
 // On output buf will contain the response body of size file_len
 
-uint8_t http_get_cgi_handler (uint8_t * uri_name, uint8_t * buf, uint32_t lenMax, uint32_t * file_len)
+uint8_t http_get_cgi_handler (uint8_t * uri_name, uint8_t * buf, uint32_t lenMax, uint32_t * file_len, httpStream_t * pStream)
 {
 	char	* pUri = (char *)((st_http_request *) buf)->URI ;
 	char	* pStr ;
@@ -623,7 +866,7 @@ uint8_t http_get_cgi_handler (uint8_t * uri_name, uint8_t * buf, uint32_t lenMax
 		pUri = pStr + 1 ; // +1 to skip '?'
 	}
 
-	return http_get_cgi_handler_common (uri_name, pUri, buf, lenMax, file_len) ;
+	return http_get_cgi_handler_common (uri_name, pUri, buf, lenMax, file_len, pStream) ;
 }
 
 //------------------------------------------------------
@@ -1386,74 +1629,215 @@ static	pMidFn	midFnArray [midMax] =
 };
 
 //------------------------------------------------------
+// setConfig.cgi: the JSON data contains the message ID "mid" of the function to call
 
-// Rewrite http_post_cgi_handler to be common to WIFI and W5500
-
-uint8_t http_post_cgi_handler_common (char * uri_name, postCgiParam_t * pParam)
+static	uint8_t	cgiSetConfigFn (postCgiParam_t * pParam)
 {
 	uint8_t		ret = HTTP_FAILED;
 	uint16_t	len = 0;
 	int32_t		nt ;
 	jsmn_parser	* pParser = (jsmn_parser *) pParam->respBuffer ;
 	jsmntok_t	* pTokens = (jsmntok_t *) (pParam->respBuffer + sizeof (jsmn_parser)) ;
-
-	if(strcmp ((const char *) uri_name, "setConfig.cgi") == 0)
+	char		* pMid ;
+	uint32_t	mid ;
+	uint32_t	error = JSON_ERROR ;	// Default error: JSON tag not found
+
+	// Build JSON array
+	jsmn_init (pParser) ;
+	nt = jsmn_parse (pParser, pParam->data, pParam->contentSize, pTokens, (DATA_BUF_SIZE - sizeof (jsmn_parser)) / sizeof (jsmntok_t)) ;
+	if (nt < 0)
+	{
+	    aaPrintf ("Failed to parse JSON: %d\n", nt);
+	}
+	else
 	{
-		char		* pMid ;
-		uint32_t	mid ;
-		uint32_t	error = JSON_ERROR ;	// Default error: JSON tag not found
-
-		// Build JSON array
-		jsmn_init (pParser) ;
-		nt = jsmn_parse (pParser, pParam->data, pParam->contentSize, pTokens, (DATA_BUF_SIZE - sizeof (jsmn_parser)) / sizeof (jsmntok_t)) ;
-		if (nt < 0)
-		{
-		    aaPrintf ("Failed to parse JSON: %d\n", nt);
-		}
-		else
-		{
 // For test
 //jsmnDump (pTokens, pJson) ;
 
-			// Get the message ID value
-			pMid = jsmnGetString (pTokens, pParam->data, "mid") ;
-			if (pMid != NULL)
-			{
-				char	* pEnd ;
-				mid = strtoul (pMid, & pEnd, 10) ;
+		// Get the message ID value
+		pMid = jsmnGetString (pTokens, pParam->data, "mid") ;
+		if (pMid != NULL)
+		{
+			char	* pEnd ;
+			mid = strtoul (pMid, & pEnd, 10) ;
 //aaPrintf ("%d\n", mid) ;
-				if ((pMid != pEnd)  &&  (* pEnd == 0)  &&  (mid < midMax))
+			if ((pMid != pEnd)  &&  (* pEnd == 0)  &&  (mid < midMax))
+			{
+				// Call the function for this mid
+				if ((* (midFnArray[mid]))(pTokens, pParam->data, & error))
+				{
+					// HTML request return value
+					len = aaSnPrintf  (pParam->respBuffer, 100, "OK %u", mid) ;
+					len = strlen (pParam->respBuffer) ;
+					ret = HTTP_OK ;
+				}
+				else
 				{
-					// Call the function for this mid
-					if ((* (midFnArray[mid]))(pTokens, pParam->data, & error))
-					{
-						// HTML request return value
-						len = aaSnPrintf  (pParam->respBuffer, 100, "OK %u", mid) ;
-						len = strlen (pParam->respBuffer) ;
-						ret = HTTP_OK ;
-					}
-					else
-					{
-						// Fail
-						aaSnPrintf  (pParam->respBuffer, 100, "Error %u %u", mid, error) ;
-						len = strlen (pParam->respBuffer) ;
-						ret = HTTP_OK ;
-					}
+					// Fail
+					aaSnPrintf  (pParam->respBuffer, 100, "Error %u %u", mid, error) ;
+					len = strlen (pParam->respBuffer) ;
+					ret = HTTP_OK ;
 				}
 			}
 		}
 	}
 
-	else
+	if (ret == HTTP_OK)
+		* pParam->respLen = len ;
+	return ret ;
+}
+
+//------------------------------------------------------
+//	The CGI registry, common to WIFI and W5500
+//	Sorted by name in strcmp() order: the search is a binary search.
+//	Keep this order when adding a CGI!
+
+static	const cgiDesc_t	cgiTable [] =
+{
+	//	name				GET handler			POST handler		content type			cache
+	{	"config.cgi",		cgiConfigFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_CFG	},
+	{	"dfstatus.cgi",		cgiDfStatusFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+	{	"divrules.cgi",		cgiDivRulesFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_CFG	},
+	{	"enames.cgi",		cgiENamesFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_CFG	},
+	{	"energy.cgi",		cgiEnergyFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+	{	"forcerules.cgi",	cgiForceRulesFn,	NULL,				CGI_TYPE_JSON,			CGI_CACHE_CFG	},
+	{	"meter.cgi",		cgiMeterFn,			NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+	{	"powerHisto.cgi",	cgiPowerHistoFn,	NULL,				CGI_TYPE_BINARY,		CGI_CACHE_NO	},
+	{	"setConfig.cgi",	NULL,				cgiSetConfigFn,		CGI_TYPE_TEXT,			CGI_CACHE_NO	},
+	{	"snapshot.cgi",		cgiSnapshotFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+	{	"statusWord.cgi",	cgiStatusWordFn,	NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+	{	"temperature.cgi",	cgiTemperatureFn,	NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+	{	"variable.cgi",		cgiVariableFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+	{	"version.cgi",		cgiVersionFn,		NULL,				CGI_TYPE_JSON,			CGI_CACHE_CFG	},
+	{	"volt.cgi",			cgiVoltFn,			NULL,				CGI_TYPE_JSON,			CGI_CACHE_1S	},
+} ;
+
+#define	CGI_COUNT	(sizeof (cgiTable) / sizeof (cgiTable [0]))
+
+//------------------------------------------------------
+// Called at init: a CGI out of order would never be found by cgiFind()
+
+void	cgiTableCheck (void)
+{
+	uint32_t	ix ;
+
+	for (ix = 1u ; ix < CGI_COUNT ; ix++)
 	{
-		// CGI file not found
+		AA_ASSERT (strcmp (cgiTable [ix - 1u].name, cgiTable [ix].name) < 0) ;
 	}
+}
 
-	if (ret == HTTP_OK)
-		* pParam->respLen = len ;
+//------------------------------------------------------
+// Returns the descriptor of the CGI, or NULL if the name is unknown
+
+const cgiDesc_t *	cgiFind (const char * pName)
+{
+	uint32_t	first = 0 ;
+	uint32_t	last  = CGI_COUNT ;
+	uint32_t	ix ;
+	int			cmp ;
+
+	while (first < last)
+	{
+		ix  = (first + last) / 2u ;
+		cmp = strcmp (pName, cgiTable [ix].name) ;
+		if (cmp == 0)
+		{
+			return & cgiTable [ix] ;
+		}
+		if (cmp < 0)
+		{
+			last = ix ;
+		}
+		else
+		{
+			first = ix + 1u ;
+		}
+	}
+	return NULL ;
+}
+
+//------------------------------------------------------
+// A handler builds its response in buf, or writes it to pCgi->pStream.
+// pStream is the socket stream of the W5500 server, or the fragment stream of the WIFI server.
+// If it is NULL, the handlers which use the stream write to a memory stream on buf,
+// and the length of the response is the length written.
+// The responses built in buf are cached until the next second (see cgiCache.c), the responses
+// written to the socket stream are never cached.
+
+uint8_t http_get_cgi_handler_common (uint8_t * uri_name, char * pUriData, uint8_t * buf, uint32_t lenMax, uint32_t * file_len, httpStream_t * pStream)
+{
+	const cgiDesc_t	* pDesc = cgiFind ((const char *) uri_name) ;
+	cgiGetParam_t	cgi ;
+	httpStream_t	memStream ;
+	char			midName [16] ;
+	char			midValue [16] ;
+	cgiCacheKey_t	key ;
+	bool			bCache ;
+	uint8_t			ret ;
+
+	* file_len = 0 ;
+	if (pDesc == NULL  ||  pDesc->pGetFn == NULL)
+	{
+		return HTTP_FAILED ;	// CGI file not found
+	}
+
+	// The key must be computed before findParam() which modifies pUriData
+	bCache = pDesc->cache != CGI_CACHE_NO  &&  cgiCacheKey (& key, pUriData) ;
+	if (bCache  &&  cgiCacheGet (pDesc, & key, buf, lenMax, file_len))
+	{
+		return HTTP_OK ;
+	}
+
+	// Find 1st parameter which is the message id
+	findParam (pUriData, midName, midValue, & cgi.pSave) ;
+
+	if (pStream == NULL)
+	{
+		hsInitMem (& memStream, buf, lenMax, pDesc->contentType) ;
+		pStream = & memStream ;
+	}
+
+	cgi.midValue = midValue ;
+	cgi.buf      = buf ;
+	cgi.lenMax   = lenMax ;
+	cgi.pStream  = pStream ;
+	ret = pDesc->pGetFn (& cgi, file_len) ;
+
+	if (pStream == & memStream  &&  memStream.total != 0)
+	{
+		// The response was written to the memory stream
+		* file_len = memStream.total ;
+		if (memStream.bError != 0)
+		{
+			ret = HTTP_FAILED ;		// Buffer overflow
+		}
+	}
+
+	if (ret == HTTP_OK  &&  bCache  &&  (pStream == & memStream  ||  pStream->total == 0))
+	{
+		cgiCachePut (pDesc, & key, buf, * file_len) ;
+	}
 	return ret ;
 }
 
+//------------------------------------------------------
+// Rewrite http_post_cgi_handler to be common to WIFI and W5500
+
+uint8_t http_post_cgi_handler_common (char * uri_name, postCgiParam_t * pParam)
+{
+	const cgiDesc_t	* pDesc = cgiFind (uri_name) ;
+
+	if (pDesc == NULL  ||  pDesc->pPostFn == NULL)
+	{
+		return HTTP_FAILED ;	// CGI file not found
+	}
+
+	// The configuration may be modified: discard the cached responses
+	cgiCacheFlush () ;
+	return pDesc->pPostFn (pParam) ;
+}
+
 // Call from W5500 library
 // Input parameter buf is pHTTP_RX, with size DATA_BUF_SIZE
 uint8_t http_post_cgi_handler (uint8_t * uri_name, st_http_request * p_http_request, uint8_t * buf, uint32_t * file_len)
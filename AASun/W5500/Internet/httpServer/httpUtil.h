@@ -18,6 +18,7 @@ extern "C" {
 
 #include "httpServer.h"
 #include "httpParser.h"
+#include "httpStream.h"
 
 // Rewrite http_post_cgi_handler to be common to WIFI and W5500
 typedef struct
@@ -29,12 +30,51 @@ typedef struct
 
 } postCgiParam_t ;
 
+// Parameters of a GET CGI handler
+typedef struct
+{
+	char		* midValue ;	// Value of the 1st parameter (message ID)
+	char		* pSave ;		// To get the next parameters: findParam (NULL, ...)
+	uint8_t		* buf ;			// Response buffer
+	uint32_t	lenMax ;		// Size of the response buffer
+	httpStream_t	* pStream ;	// To stream the response instead of using buf: to the socket (LAN) or to buf (WIFI)
+
+} cgiGetParam_t ;
+
+typedef uint8_t	(* pCgiGetFn)	(cgiGetParam_t * pCgi, uint32_t * pLen) ;
+typedef uint8_t	(* pCgiPostFn)	(postCgiParam_t * pParam) ;
+
+// Content types of the CGI responses
+#define	CGI_TYPE_JSON		"application/json"
+#define	CGI_TYPE_BINARY		"application/octet-stream"
+#define	CGI_TYPE_TEXT		"text/plain"
+
+// How long a CGI response remains valid. The cache key includes the request parameters.
+// cgiCache.c discards all the responses every second, so CGI_CACHE_CFG is handled as CGI_CACHE_1S
+#define	CGI_CACHE_NO		0		// Never cached: large or streamed response
+#define	CGI_CACHE_1S		1		// Live values: updated every second
+#define	CGI_CACHE_CFG		2		// Only changes when the configuration is modified
+
+// CGI descriptor
+typedef struct
+{
+	const char		* name ;
+	pCgiGetFn		pGetFn ;		// GET handler, NULL if GET is not allowed
+	pCgiPostFn		pPostFn ;		// POST handler, NULL if POST is not allowed
+	const char		* contentType ;
+	uint8_t			cache ;			// CGI_CACHE_xxx
+
+} cgiDesc_t ;
+
+const cgiDesc_t *	cgiFind		(const char * pName) ;
+void				cgiTableCheck	(void) ;
+
 uint8_t http_post_cgi_handler_common (char    * uri_name, postCgiParam_t * pParam) ;
-uint8_t http_get_cgi_handler_common  (uint8_t * uri_name, char * pUriData, uint8_t * buf, uint32_t lenMax, uint32_t * file_len) ;
+uint8_t http_get_cgi_handler_common  (uint8_t * uri_name, char * pUriData, uint8_t * buf, uint32_t lenMax, uint32_t * file_len, httpStream_t * pStream) ;
 
 
 
-uint8_t http_get_cgi_handler(uint8_t * uri_name, uint8_t * buf, uint32_t lenMax, uint32_t * file_len);
+uint8_t http_get_cgi_handler(uint8_t * uri_name, uint8_t * buf, uint32_t lenMax, uint32_t * file_len, httpStream_t * pStream);
 uint8_t http_post_cgi_handler(uint8_t * uri_name, st_http_request * p_http_request, uint8_t * buf, uint32_t * file_len);
 
 uint8_t predefined_get_cgi_processor(uint8_t * uri_name, uint8_t * buf, uint16_t * len);
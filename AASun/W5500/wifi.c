@@ -5,10 +5,19 @@
 
 	Alain Chebrou
 
-	wifi.c		Communication with ESP32 (WIFI)
+	wifi.c		Communication with ESP32 (WIFI): the USART, its DMA and the handlers of the requests
+				The frames and the state machine are in wifiFrame.c
 
 	When		Who	What
 	20/03/24	ac	Creation
+	18/10/26	ac	Protocol V2: frames handled in place in the RX circular buffer, request ID and CRC
+	18/10/26	ac	Push of the live values to the ESP32 (WM_ID_LIVE)
+	18/10/26	ac	Baud rate negotiation, large responses sent in several frames
+	18/10/26	ac	Telnet: coalescing of the output, credits in both directions
+	18/10/26	ac	The file system is read with W25Q_SpiTakeRead(): it can suspend a flash erase
+	18/10/26	ac	The receiver timeout interrupt wakes up the low process task, wifiNext() returns true if busy
+	18/10/26	ac	The fragments of a response have a trailer with their offset and the total size
+	18/10/26	ac	The frames and the state machine moved to wifiFrame.c, which also runs in mfs/wifiSim
 
 ----------------------------------------------------------------------
 */
@@ -28,12 +37,11 @@
 
 #include	"stm32g0xx_ll_bus.h"
 
-#include	"wifiMsg.h"
+#include	"wifiFrame.h"
 #include	"wifi.h"
 #include	"w25q.h"
 #include	"httpUtil.h"
-
-#include	"aautils.h"	// For aaDump
+#include	"wizLan.h"		// For getWizBuffer
 
 extern		mfsCtx_t		wMfsCtx ;		// MFS file system context for HTTP server
 
@@ -46,91 +54,19 @@ extern		mfsCtx_t		wMfsCtx ;		// MFS file system context for HTTP server
 
 static const gpioPinDesc_t	pinTx = {	'A',	9,	AA_GPIO_AF_1,	AA_GPIO_MODE_ALT_PP_UP | AA_GPIO_SPEED_LOW } ;
 static const gpioPinDesc_t	pinRx = {	'A',	10,	AA_GPIO_AF_1,	AA_GPIO_MODE_ALT_PP_UP | AA_GPIO_SPEED_LOW } ;
+// No hardware flow control: PA11 (USART1_CTS) is the SSR output 2, and only TX and RX go to the ESP32
 
 #define		TX_DMA_CHANNEL	LL_DMA_CHANNEL_2	// Channels 2 and 3 shares the same interrupt vector
 #define		RX_DMA_CHANNEL	LL_DMA_CHANNEL_3
 
-static		char			txBuff [WBUF_SIZE] ;
-static		char			rxBuff [WBUF_SIZE] ;
-
-static		uint32_t		rxReadOffset ;
-
-// To synchronize AASun/ESP32 UART exchanges
-#define		SYNC_TMO		3000				// millisecond
-static		uint32_t		syncTmoStartTime ;
-
-// Time out for receiving message data
-#define		RX_TMO			200
-static		uint32_t		rxTmoStartTime ;
-
-// To manage the date/time request timeout
-static		bool			bWifiTimeoutOn ;
-static		uint32_t		wifiDateTimeout ;
-#define		WIFI_DATE_TMO	3000
-
-//--------------------------------------------------------------------------------
-//--------------------------------------------------------------------------------
-// Handling of requests from AASun to WIFI interface
-// Request are message that AAsun want to send to WIFI interface
-// These messages can only be sent in response to the REQ message sent by the WIFI interface
-
-// Messages for the requests
-static	uint8_t		dateRequestMsg [sizeof (wifiMsgHdr_t) + sizeof (uint64_t)] ;
-
-// Indexes of the requests in the arrays
-#define		REQ_IX_DATE		0
-
-// Array of request messages addresses
-static	uint8_t	*	requestMsg [] =
-{
-	dateRequestMsg,
-};
-
-static	const uint32_t	requestCount = sizeof (requestMsg) / sizeof (uint8_t *) ;
-
-// Array of waiting requests
-static	bool		requestWaiting [sizeof (requestMsg) / sizeof (uint8_t *)] ;
-
-// The active request
-#define	REQUEST_NONE	99
-static	uint32_t	requestActive ;
-
-//--------------------------------------------------------------------------------
-
-static	void	requestInit (void)
-{
-	memset (requestWaiting, 0 , sizeof (requestWaiting)) ;
-	requestActive = REQUEST_NONE ;
-}
-
-//--------------------------------------------------------------------------------
-//	Build the date message then request the send
-
-bool	wifiDateRequest (void)
-{
-	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) dateRequestMsg ;
-
-	if (requestWaiting [REQ_IX_DATE] == true)
-	{
-		// Already waiting
-		return false ;
-	}
-	pHdr->magic = WIFIMSG_MAGIC ;
-	pHdr->msgId = WM_ID_REQ_DATE ;
-	pHdr->dataLength = 0 ;		// No data for the request message
-
-	requestWaiting [REQ_IX_DATE] = true ;
-
-	// Start the receive timeout
-	wifiDateTimeout = aaGetTickCount () ;
-	bWifiTimeoutOn  = true ;
-	return true ;
-}
+// The GET CGI responses are written to this stream, which sends the full txBuff as a WM_ID_PART frame
+static		httpStream_t	wifiStream ;
 
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
+//	The I/O of wifiFrame.c: the USART and its DMA
 
-void	wifiTxStart (void * address, uint32_t size)
+void	wifiIoTxStart (void * address, uint32_t size)
 {
 	dma_t			* pDma = (dma_t *) DMA1 ;
 	dmaStream_t		* pStream = & pDma->stream [TX_DMA_CHANNEL] ;
@@ -155,7 +91,7 @@ void	wifiTxStart (void * address, uint32_t size)
 //--------------------------------------------------------------------------------
 // Returns true if TX ended
 
-bool	wifiTxCheckEnd (void)
+bool	wifiIoTxEnd (void)
 {
 	if ((WIFIUART->ISR & USART_ISR_TC) == 0)
 	{
@@ -176,18 +112,16 @@ bool	wifiTxCheckEnd (void)
 }
 
 //--------------------------------------------------------------------------------
-// Start RX in rxBuff, for WBUF_SIZE bytes
+// Start RX in pBuffer, for WBUF_SIZE bytes
 
-void	wifiRxStart (void)
+void	wifiIoRxStart (void * pBuffer)
 {
 	dma_t			* pDma = (dma_t *) DMA1 ;
 	dmaStream_t		* pStream = & pDma->stream [RX_DMA_CHANNEL] ;
 
-	rxReadOffset = 0 ;
-
 	// Set DMA data parameter
 	pStream->CNDTR = WBUF_SIZE ;
-	pStream->CMAR  = (uint32_t) rxBuff ;
+	pStream->CMAR  = (uint32_t) pBuffer ;
 	pStream->CPAR  = (uint32_t) & WIFIUART->RDR ;
 
 	// Clear DMA channel flags
@@ -205,17 +139,23 @@ void	wifiRxStart (void)
 }
 
 //--------------------------------------------------------------------------------
-//	Test if the RX TimeOut Flag is set (end of message)
+//	The receiver timeout (end of a burst of frames) wakes up the low process task which runs wifiNext()
 
-uint32_t	wifiRxCheck (void)
+void	USART1_IRQHandler (void)
 {
-	return (WIFIUART->ISR & USART_ISR_RTOF) != 0 ;
+	aaIntEnter () ;
+	if ((WIFIUART->ISR & USART_ISR_RTOF) != 0u)
+	{
+		WIFIUART->ICR = USART_ICR_RTOCF ;
+		wizLanSignal () ;
+	}
+	aaIntExit () ;
 }
 
 //--------------------------------------------------------------------------------
 //	Stops the RX
 
-void	wifiRxStop (void)
+void	wifiIoRxStop (void)
 {
 	dma_t			* pDma = (dma_t *) DMA1 ;
 	dmaStream_t		* pStream = & pDma->stream [RX_DMA_CHANNEL] ;
@@ -228,24 +168,85 @@ void	wifiRxStop (void)
 }
 
 //--------------------------------------------------------------------------------
-//	Return the count of available bytes in RX buffer
+//	Change the baud rate: BRR can only be written while the USART is disabled
+
+void	wifiIoSetBaud (uint32_t baud)
+{
+	WIFIUART->CR1 &= ~USART_CR1_UE ;
+	WIFIUART->BRR  = rccGetPCLK1ClockFreq () / baud ;
+	WIFIUART->CR1 |= USART_CR1_UE ;
+}
+
+//--------------------------------------------------------------------------------
+//	The baud rate is set by wifiIoSetBaud() at the end of the TX: only check that BRR can reach it
+
+bool	wifiIoBaudNext (uint32_t baud)
+{
+	return rccGetPCLK1ClockFreq () / baud >= 16u ;
+}
+
+//--------------------------------------------------------------------------------
+//	Return the offset of the next byte written by the RX DMA
+
+uint32_t	wifiIoRxOffset (void)
+{
+	dma_t			* pDma = (dma_t *) DMA1 ;
+	dmaStream_t		* pStream = & pDma->stream [RX_DMA_CHANNEL] ;
+
+	return (WBUF_SIZE - pStream->CNDTR) & WBUF_MASK ;
+}
+
+//--------------------------------------------------------------------------------
+//	If nothing is received after readOffset, restart the RX at the beginning of the buffer
+//	Returns true if the RX is restarted
 
-uint32_t	wifiRxlength (void)
+bool	wifiIoRxRewind (uint32_t readOffset)
 {
 	dma_t			* pDma = (dma_t *) DMA1 ;
 	dmaStream_t		* pStream = & pDma->stream [RX_DMA_CHANNEL] ;
+	bool			bRewind ;
 
-	return ((WBUF_SIZE - pStream->CNDTR) - rxReadOffset) & WBUF_MASK ;
+	aaCriticalEnter () ;
+	WIFIUART->CR3 &= ~USART_CR3_DMAR ;		// A byte received now waits in RDR
+	bRewind = wifiIoRxOffset () == readOffset ;
+	if (bRewind)
+	{
+		pStream->CCR  &= ~DMA_CCR_EN ;
+		pStream->CNDTR = WBUF_SIZE ;
+		pStream->CCR  |= DMA_CCR_EN ;
+	}
+	WIFIUART->CR3 |= USART_CR3_DMAR ;
+	aaCriticalExit () ;
+	return bRewind ;
+}
+
+//--------------------------------------------------------------------------------
+//	The kernel
+
+uint32_t	wifiIoTick (void)
+{
+	return aaGetTickCount () ;
+}
+
+void	wifiIoDelay (uint32_t ms)
+{
+	aaTaskDelay (ms) ;
+}
+
+void	wifiIoTrace (const char * pFormat, uint32_t value)
+{
+	aaPrintf (pFormat, value) ;
 }
 
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
 // Copy data from the UART buffer to the RX ring buffer
 // Copy data using iWrite (write to the RX ring buffer)
+// Returns the room available for the next data
 
-static	void	telnetRecv (telnetDesc_t * pTnDesc)
+uint32_t	wifiAppTelnetRecv (const uint8_t * pData, uint32_t size)
 {
-	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) rxBuff ;
+	telnetDesc_t	* pTnDesc = & telnetDesc ;
 	uint32_t		freeSize ;		// Free size in receive ring buffer
 	uint32_t		dataSize ;		// Data length to read in the UART buffer
 	uint32_t		written ;
@@ -253,7 +254,7 @@ static	void	telnetRecv (telnetDesc_t * pTnDesc)
 
 	written = 0 ;
 
-	while (written != pHdr->dataLength)
+	while (written != size)
 	{
 		// Wait for some space in the ring buffer
 		while (1)
@@ -265,7 +266,7 @@ static	void	telnetRecv (telnetDesc_t * pTnDesc)
 				if (AA_ETIMEOUT == aaIoWait (& pTnDesc->rxWriteList, 0u, 100u))		// 100ms timeout
 				{
 					// Timeout: Cancel the write
-					return ;
+					return 0 ;
 				}
 			}
 			else
@@ -277,7 +278,7 @@ static	void	telnetRecv (telnetDesc_t * pTnDesc)
 
 		// Only 1 writer so no need of critical section
 		freeSize = rbGetWriteCount (& pTnDesc->rxBuffer) ;
-		dataSize = pHdr->dataLength - written ;	// Amount of data available in the UART
+		dataSize = size - written ;	// Amount of data available in the UART
 
 		if (dataSize > freeSize)
 		{
@@ -293,17 +294,17 @@ static	void	telnetRecv (telnetDesc_t * pTnDesc)
 		if (chunkSize >= dataSize)
 		{
 			// It can be read at once
-			memcpy (rbGetWritePtr (& pTnDesc->rxBuffer), pHdr->message, dataSize) ;
+			memcpy (rbGetWritePtr (& pTnDesc->rxBuffer), pData + written, dataSize) ;
 			rbAddWrite (& pTnDesc->rxBuffer, dataSize) ;
 		}
 		else
 		{
 			// Wrap at the buffer end: write 1st part until the buffer end
-			memcpy (rbGetWritePtr (& pTnDesc->rxBuffer), pHdr->message, chunkSize) ;
+			memcpy (rbGetWritePtr (& pTnDesc->rxBuffer), pData + written, chunkSize) ;
 			rbAddWrite (& pTnDesc->rxBuffer, chunkSize) ;
 
 			// Write the 2nd part (at the beginning of the buffer)
-			memcpy (rbGetWritePtr (& pTnDesc->rxBuffer), pHdr->message + chunkSize, dataSize - chunkSize) ;
+			memcpy (rbGetWritePtr (& pTnDesc->rxBuffer), pData + written + chunkSize, dataSize - chunkSize) ;
 			rbAddWrite (& pTnDesc->rxBuffer, dataSize - chunkSize) ;
 		}
 		written += dataSize ;
@@ -311,448 +312,254 @@ static	void	telnetRecv (telnetDesc_t * pTnDesc)
 		// If some task is waiting to read from the RX buffer awake it
 		(void) aaIoResumeWaitingTask (& pTnDesc->rxReadList) ;
 	}
+	return rbGetWriteCount (& pTnDesc->rxBuffer) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Count of bytes in the TX ring buffer
+
+uint32_t	wifiAppTelnetCount (void)
+{
+	return rbGetReadCount (& telnetDesc.txBuffer) ;
 }
 
 //--------------------------------------------------------------------------------
 // Copy data from the TX ring buffer to the UART TX buffer
 // Copy data using iRead index (read from the TX ring buffer)
-// Return true if there is something to send, so there is a message in UART txBuff
+// size is at most wifiAppTelnetCount()
 
-static	bool	telnetSend (telnetDesc_t * pTnDesc)
+void	wifiAppTelnetRead (uint8_t * pData, uint32_t size)
 {
-	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) txBuff ;
-	uint32_t		dataSize ;		// Data length to write in the socket
-	uint32_t		toSendSize ;
+	telnetDesc_t	* pTnDesc = & telnetDesc ;
 	uint32_t		chunkSize ;
 
-	dataSize   = dataMessageMax ;	// Space available in UART TX buffer for message data
-	toSendSize = rbGetReadCount (& pTnDesc->txBuffer) ;
-
-	if (dataSize > toSendSize)
-	{
-		dataSize = toSendSize ;
-	}
-	if (dataSize == 0u)
-	{
-		return false ;	// Nothing to write
-	}
-	// Now dataSize is the length to write to the UART buffer
-
 	chunkSize = rbReadChunkSize (& pTnDesc->txBuffer) ;
-	if (chunkSize >= dataSize)
+	if (chunkSize >= size)
 	{
 		// It can be read at once
-		memcpy (pHdr->message, rbGetReadPtr (& pTnDesc->txBuffer), dataSize) ;
-		rbAddRead (& pTnDesc->txBuffer, dataSize) ;
+		memcpy (pData, rbGetReadPtr (& pTnDesc->txBuffer), size) ;
+		rbAddRead (& pTnDesc->txBuffer, size) ;
 	}
 	else
 	{
 		// Wrap at the buffer end: read 1st part until the buffer end
-		memcpy (pHdr->message, rbGetReadPtr (& pTnDesc->txBuffer), chunkSize) ;
+		memcpy (pData, rbGetReadPtr (& pTnDesc->txBuffer), chunkSize) ;
 		rbAddRead (& pTnDesc->txBuffer, chunkSize) ;
 
 		// Read the 2nd part, at the beginning of the buffer
-		memcpy (pHdr->message + chunkSize, rbGetReadPtr (& pTnDesc->txBuffer), dataSize - chunkSize) ;
-		rbAddRead (& pTnDesc->txBuffer, dataSize - chunkSize) ;
+		memcpy (pData + chunkSize, rbGetReadPtr (& pTnDesc->txBuffer), size - chunkSize) ;
+		rbAddRead (& pTnDesc->txBuffer, size - chunkSize) ;
 	}
 
-	// Build the UART message header
-	pHdr->magic      = WIFIMSG_MAGIC ;
-	pHdr->msgId      = WM_ID_TELNET ;
-	pHdr->dataLength = dataSize ;
-
 	// If some task is waiting to transmit awake it
 	(void) aaIoResumeWaitingTask (& pTnDesc->txWriteList) ;
+}
+
+//--------------------------------------------------------------------------------
+//	WIFI Telnet connection opened: returns false if the Telnet is used by the wired LAN
 
+bool	wifiAppTelnetStart (void)
+{
+	if (bTelneInUse)
+	{
+		return bWifiTelnet ;		// Accepted if already WIFI Telnet
+	}
+	telnetSwitchOn () ;
+	bWifiTelnet = true ;
 	return true ;
 }
 
 //--------------------------------------------------------------------------------
-//--------------------------------------------------------------------------------
-//	WIFI over UART state machine
+//	WIFI Telnet connection closed
 
-#define	WST_IDLE			0
-#define	WST_WAIT_RX_HDR		1
-#define	WST_WAIT_RX_DATA	2
-#define	WST_WAIT_TX			3
-#define	WST_SYNC_SEND		4
-#define	WST_SYNC_TX			5
-#define	WST_SYNC_WAIT		6
+void	wifiAppTelnetStop (void)
+{
+	if (bTelneInUse  &&  bWifiTelnet)
+	{
+		telnetSwitchOff () ;
+	}
+}
 
-static	uint32_t	wifiState ;		// Initialized to WST_IDLE=0 by BSS
+//--------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------
+//	The handlers of the requests of the ESP32
 
-// Build the header of a message in txBuff, then start TX
-static	void builHdrAndSend (uint32_t id, uint32_t size)
+// Called by wifiStream when txBuff is full: send it as a fragment of the response
+static	void	wifiStreamFlush (httpStream_t * pStream)
 {
-	wifiMsgHdr_t	* pHdr ;
-
-	pHdr = (wifiMsgHdr_t *) txBuff ;
-	pHdr->magic      = WIFIMSG_MAGIC ;
-	pHdr->msgId      = id ;
-	pHdr->dataLength = size ;
-	wifiRxStart () ;	// Enable RX before the end of TX
-	wifiTxStart (txBuff, wifiHdrSize + size) ;
-	wifiState = WST_WAIT_TX ;
+	uint8_t				* pData = wifiTxData () ;
+	wifiRespMsgCgi_t	* pMess = (wifiRespMsgCgi_t *) pData ;
+	uint32_t			size = (pStream->pMem + pStream->memLen) - pData ;
+
+	if (pStream->pMem == (uint8_t *) pMess->resp)
+	{
+		pMess->respSize = WM_RESP_SIZE_PART ;	// 1st fragment, the size is not known
+	}
+	if (! wifiTxPart (size))
+	{
+		pStream->bError = 1 ;		// Too large for the ESP32
+		return ;
+	}
+
+	// The next fragments have only data
+	pStream->pMem    = pData ;
+	pStream->memSize = dataPartMax ;
+	pStream->memLen  = 0 ;
 }
 
-void	wifiNext (void)
+//--------------------------------------------------------------------------------
+//	CGI request: the response is at wifiTxData(), * pSize is its size
+//	Returns the message ID of the response
+
+uint32_t	wifiAppCgi (wifiReqMsgCgi_t * pCgiMess, uint32_t * pSize)
 {
-	wifiMsgHdr_t	* pHdr ;
+	wifiRespMsgCgi_t	* pMess = (wifiRespMsgCgi_t *) wifiTxData () ;
+	uint32_t			size ;
+	uint8_t				result ;
 
-	if (bWifiTimeoutOn)
+//aaPuts ("CGI ") ; aaPuts (pCgiMess->uriName) ; aaPutChar ('\n') ;
+	* pSize = 0 ;
+	if (pCgiMess->type == WM_TYPE_GET)
 	{
-		if ((aaGetTickCount () - wifiDateTimeout) >= WIFI_DATE_TMO)
+		// GET: the response is written to wifiStream, so it can be larger than txBuff
+		// The handler work buffer is the W5500 HTTP buffer, free between two LAN requests
+		const cgiDesc_t		* pDesc = cgiFind (pCgiMess->uriName) ;
+		uint8_t				* buf   = getWizBuffer () ;
+
+		if (pDesc != NULL)
 		{
-aaPuts ("WIFI_DATE_TMO\n") ;
-			// After sending a date request, we don't receive a WM_ID_REQ_DATE message
-			// Maybe because we were unable to emit the WM_ID_REQ_DATE message
-			bWifiTimeoutOn = false ;
-			requestWaiting [REQ_IX_DATE] = false ;
-			timeUpdateWifi (NULL) ;		// Warns the date/time module of the timeout
+			strcpy (pMess->contentType, pDesc->contentType) ;
 		}
-	}
+		hsInitFragment (& wifiStream, (uint8_t *) pMess->resp, dataPartMax - wifiRespMsgCgiSize,
+						pMess->contentType, wifiStreamFlush) ;
 
-	switch (wifiState)
+		result = http_get_cgi_handler_common ((uint8_t *) pCgiMess->uriName, pCgiMess->uri,
+											  buf, DATA_BUF_SIZE, & size, & wifiStream) ;
+		if (result == HTTP_OK  &&  wifiStream.total == 0)
+		{
+			// Not streamed: the response is in buf
+			hsWrite (& wifiStream, buf, size) ;
+		}
+
+		// The last fragment, or the full response, is in txBuff
+		if (result != HTTP_OK  ||  ! hsEnd (& wifiStream))
+		{
+			return WM_ID_ERROR_404 ;		// Also ends the fragments already sent
+		}
+		if (wifiStream.pMem == (uint8_t *) pMess->resp)
+		{
+			pMess->respSize = wifiStream.memLen ;
+			* pSize = wifiRespMsgCgiSize + wifiStream.memLen ;
+		}
+		else
+		{
+			* pSize = wifiStream.memLen ;
+		}
+//aaPrintf ("CGI resp %u %u\n", * pSize, wifiStream.total) ;
+	}
+	else
 	{
-		case WST_IDLE:
-			// Nothing to do, not started
-			break ;
+		// POST
+		postCgiParam_t	param ;
 
-		case WST_WAIT_RX_HDR:			// Waiting for a message header
-			if (wifiRxlength() >= wifiHdrSize)
-			{
-				pHdr = (wifiMsgHdr_t *) rxBuff ;
-				if (pHdr->magic != WIFIMSG_MAGIC)
-				{
-					// Communication desynchronization
-					wifiState = WST_SYNC_SEND ;
-				}
-				else
-				{
-					syncTmoStartTime = aaGetTickCount () ;	// Header received, so the UART link is active
-					rxTmoStartTime   = syncTmoStartTime ;
-					wifiState = WST_WAIT_RX_DATA ;			// Go to wait for the message data (its size is in the header)
-				}
-			}
-			else
-			{
-				// Check if time out elapsed
-				if ((aaGetTickCount () - syncTmoStartTime) > SYNC_TMO)
-				{
-					// Time is up, send SYNC message
-					wifiState = WST_SYNC_SEND ;
-aaPuts ("WST_WAIT_RX_HDR tmo\n") ;
-				}
-			}
-			break ;
+		param.contentSize = pCgiMess->uriSize ;
+		param.data        = pCgiMess->uri ;
+		param.respBuffer  = pMess->resp ;
+		param.respLen	  = & size  ;
 
-		case WST_WAIT_RX_DATA:			// waiting for message data
-			{
-				if ((aaGetTickCount () - rxTmoStartTime) >= RX_TMO)
-				{
-					// Time out elapsed: reset RX then wait for next header
-					wifiRxStop () ;
-					wifiRxStart () ;
-					wifiState = WST_WAIT_RX_HDR ;
-aaPuts ("WST_WAIT_RX_DATA tmo\n") ;
-				}
+		result = http_post_cgi_handler_common (pCgiMess->uriName, & param) ;
+		if (result != HTTP_OK)
+		{
+			return WM_ID_ERROR_404 ;
+		}
+		pMess->respSize = size ;
+		strcpy (pMess->contentType, cgiFind (pCgiMess->uriName)->contentType) ;
+		* pSize = wifiRespMsgCgiSize + size ;
+	}
+	return WM_ID_CGI_RESP ;
+}
 
-				pHdr = (wifiMsgHdr_t *) rxBuff ;
-				if (wifiRxlength() >= (wifiHdrSize + pHdr->dataLength))
-				{
-					// Message received, handle this message
-					wifiRxStop () ;
-//aaPrintf ("MSG %u  rxl %u  msgl %u  ", pHdr->msgId, wifiRxlength(), wifiHdrSize + pHdr->dataLength) ;
-//aaDump ((uint8_t *) pHdr, wifiHdrSize) ;
-//aaDump (pHdr->message, pHdr->dataLength) ;
-
-					if (pHdr->msgId == WM_ID_CGI)
-					{
-						wifiReqMsgCgi_t	* pCgiMess = (wifiReqMsgCgi_t *) pHdr->message  ;
-						uint8_t			result ;
-//aaPuts ("CGI ") ; aaPuts (pCgiMess->uriName) ; aaPutChar ('\n') ;
+//--------------------------------------------------------------------------------
+//	The live values: the JSON is built once per second for all the servers (see cgiCache.c)
 
-						// Preset error response message
-						pHdr = (wifiMsgHdr_t *) txBuff ;
-						pHdr->magic = WIFIMSG_MAGIC ;
-						pHdr->msgId = WM_ID_ERROR_404 ;
-						pHdr->dataLength = 0 ;
-
-						if (pCgiMess->type == WM_TYPE_GET)
-						{
-							// GET
-							uint32_t	size ;
-
-							result = http_get_cgi_handler_common  ( (uint8_t *) pCgiMess->uriName,
-																	pCgiMess->uri,
-																	(uint8_t *) (txBuff + wifiHdrSize + wifiRespMsgCgiSize),
-																	WBUF_SIZE - wifiHdrSize - wifiRespMsgCgiSize,
-																	& size) ;
-							if (result == HTTP_OK)
-							{
-								// Get CGI found
-								pHdr = (wifiMsgHdr_t *) txBuff ;
-								pHdr->msgId      = WM_ID_CGI_RESP ;
-								pHdr->dataLength = wifiRespMsgCgiSize + size ;
-//aaPrintf ("CGI resp %u %u\n", pHdr->dataLength, size) ;
-								wifiRespMsgCgi_t	* pMess = (wifiRespMsgCgi_t *) (pHdr->message) ;
-								pMess->respSize = size ;
-								strcpy (pMess->contentType, contentTypeJson) ;
-							}
-						}
-						else
-						{
-							// POST
-							uint32_t		size ;
-							postCgiParam_t	param ;
-
-							param.contentSize = pCgiMess->uriSize ;
-							param.data        = pCgiMess->uri ;
-							param.respBuffer  = txBuff + wifiHdrSize + wifiRespMsgCgiSize ;
-							param.respLen	  = & size  ;
-
-							result = http_post_cgi_handler_common (pCgiMess->uriName, & param) ;
-
-							if (result == HTTP_OK)
-							{
-								// Post CGI found
-								pHdr = (wifiMsgHdr_t *) txBuff ;
-								pHdr->msgId      = WM_ID_CGI_RESP ;
-								pHdr->dataLength = wifiRespMsgCgiSize + size ;
-
-								wifiRespMsgCgi_t	* pMess = (wifiRespMsgCgi_t *) pHdr->message ;
-								pMess->respSize = size ;
-								strcpy (pMess->contentType, contentTypeJson) ;
-							}
-						}
-
-						// There is a message to send in txBuffer
-						wifiRxStart () ;	// Enable RX before the end of TX
-						wifiTxStart (txBuff, wifiHdrSize + ((wifiMsgHdr_t *) txBuff)->dataLength) ;
-//aaPrintf ("CGI resp ID %u %u\n", pHdr->msgId, pHdr->dataLength) ;
-						wifiState = WST_WAIT_TX ;
-					}
-
-					else if (pHdr->msgId == WM_ID_SYNC)			//-----------------------------------------
-					{
-						// Do not answer to SYNC message, nothing to do
-						wifiRxStart () ;
-						wifiState = WST_WAIT_RX_HDR ;
-aaPuts ("WM_ID_SYNC received!\n") ;
-					}
-
-					else if (pHdr->msgId == WM_ID_REQ)			//-----------------------------------------
-					{
-						// The ESP32 is asking if we have something to send
-						if (telnetSend (& telnetDesc))
-						{
-							// There is telnet data to transmit in TX buffer
-							wifiRxStart () ;	// Enable RX before the end of TX
-							wifiTxStart (txBuff, wifiHdrSize + ((wifiMsgHdr_t *) txBuff)->dataLength) ;
-						}
-						else
-						{
-							// Search for a waiting request
-							uint32_t		ii ;
-
-							for (ii = 0 ; ii < requestCount ; ii++)
-							{
-								if (requestWaiting [ii] == true)
-								{
-									// This is a waiting request
-									requestActive = ii ;
-									wifiRxStart () ;	// Enable RX before the end of TX
-									wifiTxStart (requestMsg [ii], wifiHdrSize + ((wifiMsgHdr_t *) requestMsg [ii])->dataLength) ;
-									break ;
-								}
-							}
-							if (ii == requestCount)
-							{
-								// Nothing to send, answer NAK
-								builHdrAndSend (WM_ID_NACK, 0) ;
-//aaPuts ("WM_ID_REQ received\n") ;
-							}
-						}
-						wifiState = WST_WAIT_TX ;
-					}
-
-					else if (pHdr->msgId == WM_ID_GET_INFO)		//-----------------------------------------
-					{
-						// The ESP32 is asking for configuration informations: HTTP page version, IP addresses...
-aaPuts ("WM_ID_GET_INFO received\n") ;
-						// Retrieve WIFI application version (1st data word)
-						pHdr = (wifiMsgHdr_t *) rxBuff ;
-						wifiSoftwareVersion = ((wifiGetInfoMsg_t *) pHdr->message)->version ;
-						wifiModeAP          = ((wifiGetInfoMsg_t *) pHdr->message)->softAP != 0 ;
-
-						// Build the answer message
-						pHdr = (wifiMsgHdr_t *) txBuff ;
-						wifiInfoMsg_t	* pMess = (wifiInfoMsg_t *) pHdr->message  ;
-
-						mfsGetCrc (& wMfsCtx, & pMess->fsCRC, & pMess->fsSize) ;
-//aaPrintf ("crc:0x%08X  size:%08X\n", pMess->fsCRC, pMess->fsSize) ;
+uint32_t	wifiAppLiveGeneration (void)
+{
+	return liveSnapGet ()->generation ;
+}
 
-						// The WIFI IP address is the AASun IP Address + 1
-						pMess->ipAddress = (* ((uint32_t *) & aaSunCfg.lanCfg.ip [0])) + 0x01000000 ;
-						pMess->ipMask    =  * ((uint32_t *) & aaSunCfg.lanCfg.sn  [0]) ;
-						pMess->ipGw      =  * ((uint32_t *) & aaSunCfg.lanCfg.gw  [0]) ;
-						pMess->dns1      =  * ((uint32_t *) & aaSunCfg.lanCfg.dns [0]) ;
-						pMess->dns2      = 0 ;	// Not used
-//aaPrintf ("IP:%08X  SN:%08X  GW:%08X\n", pMess->ipAddress, pMess->ipMask, pMess->ipGw) ;
+uint32_t	wifiAppLive (wifiRespMsgCgi_t * pMess, uint32_t maxSize)
+{
+	uint32_t	size ;
+	char		param [1] = { 0 } ;
 
-						builHdrAndSend (WM_ID_INFO, sizeof (wifiInfoMsg_t)) ;
-					}
-
-					else if (pHdr->msgId == WM_ID_GET_FS)		//-----------------------------------------
-					{
-						// The ESP32 need to update its copy of the HTTP file system
-						wifiPageMsg_t	* pReq = (wifiPageMsg_t *) pHdr->message ;
-
-						pHdr = (wifiMsgHdr_t *) txBuff ;
-
-						// Read the flash
-						W25Q_SpiTake () ;
-						W25Q_Read (pHdr->message, (uint32_t) wMfsCtx.userData + pReq->offset, pReq->size) ;
-						W25Q_SpiGive () ;
-//if (pReq->offset == 0) aaDumpEx (pHdr->message, 128, NULL) ;
-						// Send the message
-						builHdrAndSend (WM_ID_FS, pReq->size) ;
-					}
-
-					else if (pHdr->msgId == WM_ID_REQ_DATE)		//-----------------------------------------
-					{
-						// We receive a date to update the local date
-						bWifiTimeoutOn = false ;				// Clear the timeout
-						timeUpdateWifi ((struct tm *) pHdr->message) ;
-						builHdrAndSend (WM_ID_ACK, 0) ;			// Acknowledge the message
-					}
-
-					else if (pHdr->msgId == WM_ID_TELNET)		//-----------------------------------------
-					{
-						// WIFI Telnet data received
-						telnetRecv (& telnetDesc) ;				// Copy the data to the RX ring buffer
-						builHdrAndSend (WM_ID_ACK, 0) ;			// Acknowledge the message
-					}
-
-					else if (pHdr->msgId == WM_ID_TELNET_START)	//-----------------------------------------
-					{
-						// WIFI Telnet connection opened
-aaPuts ("WM_ID_TELNET_START\n") ;
-						if (bTelneInUse)
-						{
-							builHdrAndSend (bWifiTelnet ?
-											WM_ID_ACK :		// Accepted: already WIFI Telnet
-											WM_ID_NACK,		// Rejected: Telnet already in use by wired LAN
-											0) ;
-						}
-						else
-						{
-							telnetSwitchOn () ;					// Accepted
-							bWifiTelnet = true ;
-							builHdrAndSend (WM_ID_ACK, 0) ;
-						}
-					}
-
-					else if (pHdr->msgId == WM_ID_TELNET_STOP)	//-----------------------------------------
-					{
-						// WIFI Telnet connection closed
-						if (bTelneInUse  &&  bWifiTelnet)
-						{
-							telnetSwitchOff () ;
-						}
-aaPuts ("WM_ID_TELNET_STOP\n") ;
-						builHdrAndSend (WM_ID_ACK, 0) ;
-					}
-
-					else if (pHdr->msgId == WM_ID_ACK)	//-----------------------------------------
-					{
-						// It's just a heartbeat so as not to lose synchronization
-aaPuts ("WM_ID_ACK\n") ;
-						builHdrAndSend (WM_ID_ACK, 0) ;
-					}
-
-					else										//-----------------------------------------
-					{
-						// Unknown message, answer NAK to not break the synchronization
-						builHdrAndSend (WM_ID_NACK, 0) ;
-aaPrintf ("WIFI Unknown Id: %u\n", pHdr->msgId) ;
-					}
-				}
-			}
-			break ;
+	if (HTTP_OK != http_get_cgi_handler_common ((uint8_t *) WM_LIVE_CGI, param, (uint8_t *) pMess->resp,
+												maxSize, & size, NULL))
+	{
+		return 0 ;
+	}
+	pMess->respSize = size ;
+	strcpy (pMess->contentType, cgiFind (WM_LIVE_CGI)->contentType) ;
+	return size ;
+}
 
-		case WST_WAIT_TX:
-			if (wifiTxCheckEnd ())
-			{
-				// End of transmit
-				// If a request is pending, then this is the end of the request transmit
-				if (requestActive != REQUEST_NONE)
-				{
-					requestWaiting [requestActive] = false ;	// Free for a new request
-					requestActive = REQUEST_NONE ;
-				}
-				wifiState = WST_WAIT_RX_HDR ;
-			}
-			break ;
+//--------------------------------------------------------------------------------
+//	The ESP32 is asking for configuration informations: HTTP page version, IP addresses...
 
-		// The following states are specific to the synchronization of AASun and WIFI interface
-		case WST_SYNC_SEND:
-			{
-				statusWClear (STSW_WIFI_EN) ;	// WIFI not available
+void	wifiAppInfo (const wifiGetInfoMsg_t * pReq, wifiInfoMsg_t * pMess)
+{
+	// Retrieve WIFI application version (1st data word)
+	wifiSoftwareVersion = pReq->version ;
+	wifiModeAP          = pReq->softAP != 0 ;
 
-				// Reset RX DMA
-				wifiRxStop () ;
-				wifiRxStart () ;
+	mfsGetCrc (& wMfsCtx, & pMess->fsCRC, & pMess->fsSize) ;
+//aaPrintf ("crc:0x%08X  size:%08X\n", pMess->fsCRC, pMess->fsSize) ;
 
-				// Send SYNC message
-				pHdr = (wifiMsgHdr_t *) txBuff ;
-				pHdr->magic      = WIFIMSG_MAGIC ;
-				pHdr->msgId      = WM_ID_SYNC ;
-				pHdr->dataLength = 0 ;
-				wifiTxStart (txBuff, wifiHdrSize) ;
+	// The WIFI IP address is the AASun IP Address + 1
+	pMess->ipAddress = (* ((uint32_t *) & aaSunCfg.lanCfg.ip [0])) + 0x01000000 ;
+	pMess->ipMask    =  * ((uint32_t *) & aaSunCfg.lanCfg.sn  [0]) ;
+	pMess->ipGw      =  * ((uint32_t *) & aaSunCfg.lanCfg.gw  [0]) ;
+	pMess->dns1      =  * ((uint32_t *) & aaSunCfg.lanCfg.dns [0]) ;
+	pMess->dns2      = 0 ;	// Not used
+//aaPrintf ("IP:%08X  SN:%08X  GW:%08X\n", pMess->ipAddress, pMess->ipMask, pMess->ipGw) ;
+}
 
-				wifiState = WST_SYNC_TX ;
-//aaPuts ("WST_SYNC_SEND\n") ;
-			}
-			break ;
+//--------------------------------------------------------------------------------
+//	The HTTP file system, for the ESP32 copy
 
-		case WST_SYNC_TX:
-			if (wifiTxCheckEnd ())
-			{
-				// SYNC message transmission ended
-				syncTmoStartTime = aaGetTickCount () ;	// Reset timeout
-				wifiState = WST_SYNC_WAIT ;
-			}
-			break ;
+uint32_t	wifiAppFsSize (void)
+{
+	uint32_t	crc ;
+	uint32_t	size ;
 
-		case WST_SYNC_WAIT:
-			if (wifiRxlength() >= wifiHdrSize)
-			{
-				// Something received: end of sync
-				if (requestActive != REQUEST_NONE)
-				{
-					// This request is silently aborted
-					requestWaiting [requestActive] = false ;
-					requestActive = REQUEST_NONE ;
-				}
+	mfsGetCrc (& wMfsCtx, & crc, & size) ;
+	return size ;
+}
 
-				statusWSet (STSW_WIFI_EN) ;		// WIFI is detected and running
-				wifiState = WST_WAIT_RX_HDR ;
-aaPuts ("WST_SYNC_WAIT Ok\n") ;
-			}
-			else
-			{
-				if ((aaGetTickCount () - syncTmoStartTime) > SYNC_TMO)
-				{
-					// Time elapsed without receiving a header, send SYNC message again
-					wifiState = WST_SYNC_SEND ;
-				}
-			}
-			break ;
+// Read the flash: W25Q_SpiTakeRead() can suspend an erase
+void	wifiAppFsRead (uint8_t * pData, uint32_t offset, uint32_t size)
+{
+	offset += (uint32_t) wMfsCtx.userData ;
+	W25Q_SpiTakeRead (offset, size) ;
+	W25Q_Read (pData, offset, size) ;
+	W25Q_SpiGiveRead () ;
+}
 
-		default:
-			AA_ASSERT (0) ;
-				break ;
+//--------------------------------------------------------------------------------
+
+void	wifiAppDate (struct tm * pTime)
+{
+	timeUpdateWifi (pTime) ;
+}
+
+void	wifiAppLinkState (bool bUp)
+{
+	if (bUp)
+	{
+		statusWSet (STSW_WIFI_EN) ;		// WIFI is detected and running
+	}
+	else
+	{
+		statusWClear (STSW_WIFI_EN) ;	// WIFI not available
 	}
 }
 
@@ -773,6 +580,11 @@ void	wifiInit (void)
 	WIFIUART->BRR  = rccGetPCLK1ClockFreq () / WIFIMSG_BBR ;  // Set baud rate
 	WIFIUART->CR1 |= USART_CR1_TE ;    		// TX is always enabled
 
+	// Receiver timeout: an interrupt at the end of each burst of received frames
+	WIFIUART->RTOR = WIFIRTOR ;
+	WIFIUART->CR2 |= USART_CR2_RTOEN ;
+	WIFIUART->CR1 |= USART_CR1_RTOIE ;
+
 	WIFIUART->CR1 |= USART_CR1_UE ;         // USART enable
 
 	// Initialize TX DMA
@@ -806,10 +618,11 @@ void	wifiInit (void)
 	// Only 1 DMA on this MCU so DMA channel number is also MUX channel number
 	((dmaMux_t *) DMAMUX1)->CCR [RX_DMA_CHANNEL] = LL_DMAMUX_REQ_USART1_RX ;
 
-	requestInit () ;
+	NVIC_SetPriority (IRQNUM, BSP_IRQPRIOMIN_PLUS (1)) ;
+	NVIC_EnableIRQ   (IRQNUM) ;
 
 	// Start the WIFI state machine
-	wifiState = WST_SYNC_SEND ;
+	wifiFrameStart () ;
 }
 
 //--------------------------------------------------------------------------------
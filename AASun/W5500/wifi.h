@@ -9,6 +9,7 @@
 
 	When		Who	What
 	20/03/24	ac	Creation
+	18/10/26	ac	The frames and the state machine are in wifiFrame.c
 
 ----------------------------------------------------------------------
 */
@@ -18,6 +19,7 @@
 //-----------------------------------------------------------------------------
 
 #include	"ringbuffer.h"
+#include	"wifiFrame.h"		// wifiNext, wifiDateRequest
 
 // The states of the Telnet protocol state machine
 typedef enum
@@ -63,9 +65,6 @@ extern	void			telnetSwitchOff (void) ;
 //-----------------------------------------------------------------------------
 
 void	wifiInit			(void) ;
-void	wifiNext			(void) ;
-
-bool	wifiDateRequest		(void) ;
 
 // In withlan.c
 void	telnetSetFlag		(telnetHandle_t hTelnet, uint32_t flag, uint32_t bSet) ;
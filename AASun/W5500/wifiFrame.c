@@ -0,0 +1,773 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	wifiFrame.c	Communication with ESP32 (WIFI): the frames and the state machine
+
+	When		Who	What
+	18/10/26	ac	Creation: split of wifi.c, the I/O and the handlers are reached through wifiFrame.h
+
+----------------------------------------------------------------------
+*/
+
+#include	<string.h>
+
+#include	"wifiFrame.h"
+
+//--------------------------------------------------------------------------------
+
+// The frames are handled in place: the buffers must be aligned for the message headers
+static		char			txBuff [WBUF_SIZE] __attribute__ ((aligned (4))) ;
+static		char			rxBuff [WBUF_SIZE] __attribute__ ((aligned (4))) ;
+
+static		uint32_t		rxReadOffset ;		// Offset of the next frame in rxBuff, a multiple of 4
+static		uint16_t		rxReqId ;			// Request ID of the handled message, copied to the response
+
+// To synchronize AASun/ESP32 UART exchanges
+#define		SYNC_TMO		3000				// millisecond
+static		uint32_t		syncTmoStartTime ;
+
+// Time out for receiving message data: an incomplete frame is skipped
+#define		RX_TMO			200
+static		uint32_t		rxTmoStartTime ;
+
+// Push of the live values: while the ESP32 sets WM_REQ_LIVE, snapshot.cgi is sent once per second
+// So the WIFI clients polling snapshot.cgi cost one message per second on the UART
+#define		WIFI_LIVE_HOLD	2000				// The push stops if WM_REQ_LIVE is not received for this time
+static		bool			bLiveWanted ;
+static		uint32_t		liveWantedTime ;
+static		uint32_t		liveGeneration ;	// Generation of the last snapshot sent
+
+// Baud rate negotiated by the ESP32 after each synchronization (see wifiMsg.h)
+static		uint32_t		wifiBaud ;			// The current baud rate
+static		uint32_t		wifiBaudPrev ;		// The baud rate to restore if the new one doesn't work
+static		uint32_t		wifiBaudNext ;		// Not 0: the baud rate to use at the end of the TX
+static		bool			bBaudProbe ;		// The new baud rate is not yet confirmed by a valid frame
+static		uint32_t		baudProbeTime ;
+
+// Bytes of the response sent in WM_ID_PART frames
+static		uint32_t		wifiPartSent ;
+
+// Telnet output: time of the last WM_ID_TELNET sent, for the coalescing
+static		uint32_t		telnetSentTime ;
+
+// To manage the date/time request timeout
+static		bool			bWifiTimeoutOn ;
+static		uint32_t		wifiDateTimeout ;
+#define		WIFI_DATE_TMO	3000
+
+static		wifiFrameStat_t	wifiStat ;
+
+//--------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------
+// Handling of requests from AASun to WIFI interface
+// Request are message that AAsun want to send to WIFI interface
+// These messages can only be sent in response to the REQ message sent by the WIFI interface
+
+// Messages for the requests
+static	uint8_t		dateRequestMsg [sizeof (wifiMsgHdr_t) + sizeof (uint64_t)] __attribute__ ((aligned (4))) ;
+
+// Indexes of the requests in the arrays
+#define		REQ_IX_DATE		0
+
+// Array of request messages addresses
+static	uint8_t	*	requestMsg [] =
+{
+	dateRequestMsg,
+};
+
+static	const uint32_t	requestCount = sizeof (requestMsg) / sizeof (uint8_t *) ;
+
+// Array of waiting requests
+static	bool		requestWaiting [sizeof (requestMsg) / sizeof (uint8_t *)] ;
+
+// The active request
+#define	REQUEST_NONE	99
+static	uint32_t	requestActive ;
+
+//--------------------------------------------------------------------------------
+
+static	void	requestInit (void)
+{
+	memset (requestWaiting, 0 , sizeof (requestWaiting)) ;
+	requestActive = REQUEST_NONE ;
+}
+
+//--------------------------------------------------------------------------------
+//	Build the date message then request the send
+
+bool	wifiDateRequest (void)
+{
+	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) dateRequestMsg ;
+
+	if (requestWaiting [REQ_IX_DATE] == true)
+	{
+		// Already waiting
+		return false ;
+	}
+	pHdr->magic = WIFIMSG_MAGIC ;
+	pHdr->msgId = WM_ID_REQ_DATE ;
+	pHdr->dataLength = 0 ;		// No data for the request message
+
+	requestWaiting [REQ_IX_DATE] = true ;
+
+	// Start the receive timeout
+	wifiDateTimeout = wifiIoTick () ;
+	bWifiTimeoutOn  = true ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------
+// Start RX in rxBuff, for WBUF_SIZE bytes
+
+static	void	wifiRxStart (void)
+{
+	rxReadOffset = 0 ;
+	wifiIoRxStart (rxBuff) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Change the baud rate. The RX restarts at the beginning of rxBuff
+
+static	void	wifiSetBaud (uint32_t baud)
+{
+	wifiIoRxStop () ;
+	wifiIoSetBaud (baud) ;
+	wifiRxStart () ;
+	wifiBaud = baud ;
+	wifiStat.baudChanges++ ;
+}
+
+//--------------------------------------------------------------------------------
+//	Return the count of available bytes in RX buffer
+
+uint32_t	wifiRxlength (void)
+{
+	return (wifiIoRxOffset () - rxReadOffset) & WBUF_MASK ;
+}
+
+//--------------------------------------------------------------------------------
+//	If rxBuff is empty restart the RX at the beginning of rxBuff
+//	So the frames sent by the ESP32 don't wrap at the end of rxBuff (see wifiMsg.h)
+
+static	void	wifiRxRewind (void)
+{
+	if (rxReadOffset != 0  &&  wifiIoRxRewind (rxReadOffset))
+	{
+		rxReadOffset = 0 ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Remove size bytes from rxBuff
+
+static	void	wifiRxSkip (uint32_t size)
+{
+	rxReadOffset   = (rxReadOffset + size) & WBUF_MASK ;
+	rxTmoStartTime = wifiIoTick () ;
+	wifiRxRewind () ;
+}
+
+//--------------------------------------------------------------------------------
+//	Returns the next complete frame in rxBuff, or NULL
+//	The frame remains in rxBuff until wifiRxSkip()
+//	Bytes which are not the start of a frame are skipped
+
+static	wifiMsgHdr_t *	wifiRxFrame (void)
+{
+	wifiMsgHdr_t	* pHdr ;
+	uint32_t		length ;
+
+	while (1)
+	{
+		length = wifiRxlength () ;
+		if (length == 0)
+		{
+			rxTmoStartTime = wifiIoTick () ;
+			wifiRxRewind () ;
+			return NULL ;
+		}
+		if (length < wifiHdrSize)
+		{
+			break ;		// Wait for the header
+		}
+
+		pHdr = (wifiMsgHdr_t *) (rxBuff + rxReadOffset) ;
+		if (rxReadOffset + wifiHdrSize > WBUF_SIZE  ||
+			pHdr->magic != WIFIMSG_MAGIC            ||
+			pHdr->dataLength > dataMessageMax       ||
+			rxReadOffset + WIFIMSG_FRAME_SIZE (pHdr->dataLength) > WBUF_SIZE)
+		{
+			// Not the start of a frame, or a frame which wraps at the end of rxBuff
+			wifiStat.skipped += sizeof (uint32_t) ;
+			wifiRxSkip (sizeof (uint32_t)) ;
+			continue ;
+		}
+
+		if (length >= WIFIMSG_FRAME_SIZE (pHdr->dataLength))
+		{
+			return pHdr ;
+		}
+		break ;		// Wait for the data
+	}
+
+	// The frame is incomplete
+	if ((wifiIoTick () - rxTmoStartTime) >= RX_TMO)
+	{
+		// The end of the frame is lost: skip its start
+		wifiStat.rxTimeouts++ ;
+		wifiRxSkip (sizeof (uint32_t)) ;
+		wifiIoTrace ("WIFI RX tmo\n", 0) ;
+	}
+	return NULL ;
+}
+
+//--------------------------------------------------------------------------------
+//	WIFI over UART state machine
+
+#define	WST_IDLE			0
+#define	WST_WAIT_RX			1
+#define	WST_WAIT_TX			2
+#define	WST_SYNC_SEND		3
+#define	WST_SYNC_TX			4
+#define	WST_SYNC_WAIT		5
+
+static	uint32_t	wifiState ;		// Initialized to WST_IDLE=0 by BSS
+
+// Set the request ID and the CRC of a response message, then start TX
+// The RX remains active: the ESP32 can send its next requests during the TX
+static	void wifiSend (wifiMsgHdr_t * pHdr)
+{
+	pHdr->reqId = rxReqId ;
+	pHdr->crc   = wifiMsgCrc (pHdr) ;
+	wifiIoTxStart (pHdr, WIFIMSG_FRAME_SIZE (pHdr->dataLength)) ;
+	wifiState = WST_WAIT_TX ;
+}
+
+// Build the header of a message in txBuff, then start TX
+static	void builHdrAndSend (uint32_t id, uint32_t size)
+{
+	wifiMsgHdr_t	* pHdr ;
+
+	pHdr = (wifiMsgHdr_t *) txBuff ;
+	pHdr->magic      = WIFIMSG_MAGIC ;
+	pHdr->msgId      = id ;
+	pHdr->dataLength = size ;
+	wifiSend (pHdr) ;
+}
+
+// Append the fragment trailer to the size bytes of data in txBuff (see wifiPartMsg_t)
+// Returns the data length of the frame
+static	uint32_t	wifiPartTrailer (uint32_t size, uint32_t offset, uint32_t total)
+{
+	wifiPartMsg_t	part ;
+
+	part.offset = offset ;
+	part.total  = total ;
+	memcpy (txBuff + wifiHdrSize + size, & part, wifiPartMsgSize) ;
+	return size + wifiPartMsgSize ;
+}
+
+// Send a fragment of the response which is in txBuff, then wait for the end of the TX:
+// txBuff is used for the next fragment. The state machine doesn't return during a fragmented response
+// offset is the offset of the fragment in the reassembled message. size is at most dataPartMax
+static	void	wifiSendPart (uint32_t size, uint32_t offset)
+{
+	builHdrAndSend (WM_ID_PART, wifiPartTrailer (size, offset, 0)) ;
+	while (! wifiIoTxEnd ())
+	{
+		wifiIoDelay (1) ;
+	}
+	wifiStat.parts++ ;
+	wifiState = WST_WAIT_RX ;
+}
+
+// Send the last frame of a response. If fragments were sent (offset not 0) it ends the fragmented response
+static	void	wifiSendLast (uint32_t id, uint32_t size, uint32_t offset)
+{
+	if (offset != 0)
+	{
+		id  |= WM_ID_FRAGMENTED ;
+		size = wifiPartTrailer (size, offset, offset + size) ;
+	}
+	builHdrAndSend (id, size) ;
+}
+
+//--------------------------------------------------------------------------------
+//	For the handlers which build a response larger than a frame
+
+uint8_t *	wifiTxData (void)
+{
+	return ((wifiMsgHdr_t *) txBuff)->message ;
+}
+
+// Returns false if the response is too large for the ESP32
+bool	wifiTxPart (uint32_t size)
+{
+	if (wifiPartSent + size > WIFIMSG_MSG_MAX)
+	{
+		return false ;
+	}
+	wifiSendPart (size, wifiPartSent) ;
+	wifiPartSent += size ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+// Copy the telnet output to the UART TX buffer
+// credit is the max data size granted by the ESP32
+// Return true if there is something to send, so there is a message in UART txBuff
+
+static	bool	telnetSend (uint32_t credit)
+{
+	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) txBuff ;
+	uint32_t		dataSize ;		// Data length to write in the message
+	uint32_t		toSendSize ;
+
+	dataSize   = (credit < dataMessageMax) ? credit : dataMessageMax ;	// Space available in UART TX buffer for message data
+	toSendSize = wifiAppTelnetCount () ;
+
+	if (dataSize > toSendSize)
+	{
+		dataSize = toSendSize ;
+	}
+	if (dataSize == 0u)
+	{
+		return false ;	// Nothing to write
+	}
+
+	// During a burst hold the small data, to send less frames
+	if (toSendSize < WIFI_TELNET_COALESCE_MIN  &&
+		(wifiIoTick () - telnetSentTime) < WIFI_TELNET_COALESCE_TMO)
+	{
+		return false ;
+	}
+	telnetSentTime = wifiIoTick () ;
+
+	wifiAppTelnetRead (pHdr->message, dataSize) ;
+
+	// Build the UART message header
+	pHdr->magic      = WIFIMSG_MAGIC ;
+	pHdr->msgId      = WM_ID_TELNET ;
+	pHdr->dataLength = dataSize ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+// If the ESP32 wants the live values and there is a new snapshot, send it
+// Returns true if the message is sent
+
+static	bool	wifiLiveSend (void)
+{
+	wifiRespMsgCgi_t	* pMess = (wifiRespMsgCgi_t *) wifiTxData () ;
+	uint32_t			generation ;
+	uint32_t			size ;
+
+	if (! bLiveWanted)
+	{
+		return false ;
+	}
+	generation = wifiAppLiveGeneration () ;
+	if (generation == liveGeneration)
+	{
+		return false ;
+	}
+	if ((wifiIoTick () - liveWantedTime) > WIFI_LIVE_HOLD)
+	{
+		bLiveWanted = false ;		// The ESP32 no longer needs the live values
+		return false ;
+	}
+	liveGeneration = generation ;
+
+	size = wifiAppLive (pMess, WBUF_SIZE - wifiHdrSize - wifiRespMsgCgiSize) ;
+	if (size == 0)
+	{
+		return false ;
+	}
+	wifiStat.lives++ ;
+
+	rxReqId = 0 ;		// Not a response
+	builHdrAndSend (WM_ID_LIVE, wifiRespMsgCgiSize + size) ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Returns true if it must be called again without waiting for the next received frame
+
+bool	wifiNext (void)
+{
+	wifiMsgHdr_t	* pHdr ;
+	wifiMsgHdr_t	* pRxHdr ;
+	bool			bBusy = false ;
+
+	if (bWifiTimeoutOn)
+	{
+		if ((wifiIoTick () - wifiDateTimeout) >= WIFI_DATE_TMO)
+		{
+wifiIoTrace ("WIFI_DATE_TMO\n", 0) ;
+			// After sending a date request, we don't receive a WM_ID_REQ_DATE message
+			// Maybe because we were unable to emit the WM_ID_REQ_DATE message
+			bWifiTimeoutOn = false ;
+			requestWaiting [REQ_IX_DATE] = false ;
+			wifiAppDate (NULL) ;		// Warns the date/time module of the timeout
+		}
+	}
+
+	switch (wifiState)
+	{
+		case WST_IDLE:
+			// Nothing to do, not started
+			break ;
+
+		case WST_WAIT_RX:				// Waiting for a message
+			pRxHdr = wifiRxFrame () ;
+			if (pRxHdr == NULL)
+			{
+				if (bBaudProbe  &&  (wifiIoTick () - baudProbeTime) > WIFI_BAUD_PROBE_TMO)
+				{
+					// No valid frame at the new baud rate: return to the previous one
+					bBaudProbe = false ;
+					wifiSetBaud (wifiBaudPrev) ;
+					wifiStat.baudReturns++ ;
+wifiIoTrace ("WIFI baud rate back to %u\n", wifiBaudPrev) ;
+				}
+
+				// No request: time to push the live values?
+				if (wifiLiveSend ())
+				{
+					break ;
+				}
+
+				// Check if time out elapsed
+				if ((wifiIoTick () - syncTmoStartTime) > SYNC_TMO)
+				{
+					// Time is up, send SYNC message
+					wifiState = WST_SYNC_SEND ;
+wifiIoTrace ("WST_WAIT_RX tmo\n", 0) ;
+				}
+				break ;
+			}
+			syncTmoStartTime = wifiIoTick () ;	// Frame received, so the UART link is active
+			rxReqId = pRxHdr->reqId ;
+
+			if (wifiMsgCrc (pRxHdr) != pRxHdr->crc)
+			{
+				// Corrupted frame: skip only its magic number, the data length may be wrong
+wifiIoTrace ("WIFI CRC error, ID %u\n", pRxHdr->msgId) ;
+				wifiStat.crcErrors++ ;
+				wifiRxSkip (sizeof (uint32_t)) ;
+				builHdrAndSend (WM_ID_ERROR_CRC, 0) ;
+				break ;
+			}
+			bBaudProbe = false ;		// A valid frame: the baud rate is right
+			wifiStat.frames++ ;
+			wifiPartSent = 0 ;
+
+			// Message received, handle this message
+			pHdr = pRxHdr ;
+
+			if (pHdr->msgId == WM_ID_CGI)
+			{
+				// The GET responses can be larger than txBuff: the handler sends the fragments with wifiTxPart()
+				uint32_t	size ;
+				uint32_t	id ;
+
+				id = wifiAppCgi ((wifiReqMsgCgi_t *) pHdr->message, & size) ;
+				wifiSendLast (id, size, wifiPartSent) ;
+			}
+
+			else if (pHdr->msgId == WM_ID_SYNC)			//-----------------------------------------
+			{
+				// Do not answer to SYNC message, nothing to do
+wifiIoTrace ("WM_ID_SYNC received!\n", 0) ;
+			}
+
+			else if (pHdr->msgId == WM_ID_REQ)			//-----------------------------------------
+			{
+				// The ESP32 is asking if we have something to send
+				uint32_t	credit = dataMessageMax ;
+
+				if (pHdr->dataLength >= wifiReqMsgSize)
+				{
+					if ((((wifiReqMsg_t *) pHdr->message)->flags & WM_REQ_LIVE) != 0)
+					{
+						bLiveWanted    = true ;
+						liveWantedTime = wifiIoTick () ;
+					}
+					credit = ((wifiReqMsg_t *) pHdr->message)->telnetCredit ;
+				}
+
+				if (telnetSend (credit))
+				{
+					// There is telnet data to transmit in TX buffer
+					wifiSend ((wifiMsgHdr_t *) txBuff) ;
+				}
+				else
+				{
+					// Search for a waiting request
+					uint32_t		ii ;
+
+					for (ii = 0 ; ii < requestCount ; ii++)
+					{
+						if (requestWaiting [ii] == true)
+						{
+							// This is a waiting request
+							requestActive = ii ;
+							wifiSend ((wifiMsgHdr_t *) requestMsg [ii]) ;
+							break ;
+						}
+					}
+					if (ii == requestCount)
+					{
+						// Nothing to send, answer NAK
+						builHdrAndSend (WM_ID_NACK, 0) ;
+					}
+				}
+			}
+
+			else if (pHdr->msgId == WM_ID_GET_INFO)		//-----------------------------------------
+			{
+				// The ESP32 is asking for configuration informations: HTTP page version, IP addresses...
+wifiIoTrace ("WM_ID_GET_INFO received\n", 0) ;
+				memset (wifiTxData (), 0, sizeof (wifiInfoMsg_t)) ;
+				wifiAppInfo ((wifiGetInfoMsg_t *) pHdr->message, (wifiInfoMsg_t *) wifiTxData ()) ;
+				builHdrAndSend (WM_ID_INFO, sizeof (wifiInfoMsg_t)) ;
+			}
+
+			else if (pHdr->msgId == WM_ID_GET_FS)		//-----------------------------------------
+			{
+				// The ESP32 need to update its copy of the HTTP file system
+				// A request larger than a frame is answered with WM_ID_PART frames, then WM_ID_FS
+				wifiPageMsg_t	* pReq = (wifiPageMsg_t *) pHdr->message ;
+				uint32_t		offset = pReq->offset ;
+				uint32_t		size   = pReq->size ;
+				uint32_t		fsSize = wifiAppFsSize () ;
+				uint32_t		chunkMax = (size > dataMessageMax) ? dataPartMax : dataMessageMax ;
+				uint32_t		sent = 0 ;
+				uint32_t		chunk ;
+
+				if (size > WIFIMSG_MSG_MAX  ||  offset > fsSize  ||  size > fsSize - offset)
+				{
+					builHdrAndSend (WM_ID_NACK, 0) ;
+				}
+				else
+				{
+					while (1)
+					{
+						chunk = (size > chunkMax) ? chunkMax : size ;
+						wifiAppFsRead (wifiTxData (), offset, chunk) ;
+						offset += chunk ;
+						size   -= chunk ;
+						if (size == 0)
+						{
+							break ;
+						}
+						wifiSendPart (chunk, sent) ;
+						sent += chunk ;
+					}
+					wifiSendLast (WM_ID_FS, chunk, sent) ;
+				}
+			}
+
+			else if (pHdr->msgId == WM_ID_BAUD)			//-----------------------------------------
+			{
+				// Baud rate negotiation
+				uint32_t	baud = ((wifiBaudMsg_t *) pHdr->message)->baudRate ;
+
+				if (pHdr->dataLength >= wifiBaudMsgSize  &&  baud == wifiBaud)
+				{
+					// The test message at the new baud rate: echo it
+					memcpy (txBuff + wifiHdrSize, pHdr->message, pHdr->dataLength) ;
+					builHdrAndSend (WM_ID_BAUD, pHdr->dataLength) ;
+wifiIoTrace ("WIFI baud rate %u\n", baud) ;
+				}
+				else if (pHdr->dataLength >= wifiBaudMsgSize  &&  baud >= WIFIMSG_BBR  &&  baud <= WIFIMSG_BBR_MAX  &&
+						 wifiIoBaudNext (baud))
+				{
+					// Accepted: the new baud rate is used at the end of this answer
+					((wifiBaudMsg_t *) (txBuff + wifiHdrSize))->baudRate = baud ;
+					builHdrAndSend (WM_ID_BAUD, wifiBaudMsgSize) ;
+					wifiBaudNext = baud ;
+				}
+				else
+				{
+					builHdrAndSend (WM_ID_NACK, 0) ;
+				}
+			}
+
+			else if (pHdr->msgId == WM_ID_REQ_DATE)		//-----------------------------------------
+			{
+				// We receive a date to update the local date
+				bWifiTimeoutOn = false ;				// Clear the timeout
+				wifiAppDate ((struct tm *) pHdr->message) ;
+				builHdrAndSend (WM_ID_ACK, 0) ;			// Acknowledge the message
+			}
+
+			else if (pHdr->msgId == WM_ID_TELNET)		//-----------------------------------------
+			{
+				// WIFI Telnet data received
+				uint32_t	credit ;
+
+				credit = wifiAppTelnetRecv (pHdr->message, pHdr->dataLength) ;
+
+				// Acknowledge the message, with the room available for the next data
+				((wifiTelnetAckMsg_t *) wifiTxData ())->credit = (credit < dataMessageMax) ? credit : dataMessageMax ;
+				builHdrAndSend (WM_ID_ACK, wifiTelnetAckMsgSize) ;
+			}
+
+			else if (pHdr->msgId == WM_ID_TELNET_START)	//-----------------------------------------
+			{
+				// WIFI Telnet connection opened
+wifiIoTrace ("WM_ID_TELNET_START\n", 0) ;
+				builHdrAndSend (wifiAppTelnetStart () ? WM_ID_ACK : WM_ID_NACK, 0) ;
+			}
+
+			else if (pHdr->msgId == WM_ID_TELNET_STOP)	//-----------------------------------------
+			{
+				// WIFI Telnet connection closed
+				wifiAppTelnetStop () ;
+wifiIoTrace ("WM_ID_TELNET_STOP\n", 0) ;
+				builHdrAndSend (WM_ID_ACK, 0) ;
+			}
+
+			else if (pHdr->msgId == WM_ID_ACK)	//-----------------------------------------
+			{
+				// It's just a heartbeat so as not to lose synchronization
+wifiIoTrace ("WM_ID_ACK\n", 0) ;
+				builHdrAndSend (WM_ID_ACK, 0) ;
+			}
+
+			else										//-----------------------------------------
+			{
+				// Unknown message, answer NAK to not break the synchronization
+				builHdrAndSend (WM_ID_NACK, 0) ;
+wifiIoTrace ("WIFI Unknown Id: %u\n", pRxHdr->msgId) ;
+			}
+
+			// The frame is no longer used: the RX buffer restarts at its beginning if it is empty
+			// Other frames may be already received: the receiver timeout doesn't signal them again
+			wifiRxSkip (WIFIMSG_FRAME_SIZE (pRxHdr->dataLength)) ;
+			bBusy = true ;
+			break ;
+
+		case WST_WAIT_TX:
+			if (wifiIoTxEnd ())
+			{
+				// End of transmit
+				// If a request is pending, then this is the end of the request transmit
+				if (requestActive != REQUEST_NONE)
+				{
+					requestWaiting [requestActive] = false ;	// Free for a new request
+					requestActive = REQUEST_NONE ;
+				}
+				if (wifiBaudNext != 0)
+				{
+					// The answer to WM_ID_BAUD is sent: use the new baud rate, until it is confirmed
+					wifiBaudPrev  = wifiBaud ;
+					wifiSetBaud (wifiBaudNext) ;
+					wifiBaudNext  = 0 ;
+					bBaudProbe    = true ;
+					baudProbeTime = wifiIoTick () ;
+				}
+				wifiState = WST_WAIT_RX ;
+			}
+			bBusy = true ;		// Poll the end of TX, or the next frame
+			break ;
+
+		// The following states are specific to the synchronization of AASun and WIFI interface
+		case WST_SYNC_SEND:
+			{
+				wifiAppLinkState (false) ;		// WIFI not available
+
+				// The synchronization is always done at WIFIMSG_BBR
+				bBaudProbe   = false ;
+				wifiBaudNext = 0 ;
+				if (wifiBaud != WIFIMSG_BBR)
+				{
+					wifiSetBaud (WIFIMSG_BBR) ;
+				}
+
+				// Reset RX DMA
+				wifiIoRxStop () ;
+				wifiRxStart () ;
+
+				// Send SYNC message, the only message not sent as a response: request ID 0
+				pHdr = (wifiMsgHdr_t *) txBuff ;
+				pHdr->magic      = WIFIMSG_MAGIC ;
+				pHdr->msgId      = WM_ID_SYNC ;
+				pHdr->dataLength = 0 ;
+				pHdr->reqId      = 0 ;
+				pHdr->crc        = wifiMsgCrc (pHdr) ;
+				wifiIoTxStart (txBuff, WIFIMSG_FRAME_SIZE (0)) ;
+				wifiStat.syncs++ ;
+
+				wifiState = WST_SYNC_TX ;
+			}
+			break ;
+
+		case WST_SYNC_TX:
+			if (wifiIoTxEnd ())
+			{
+				// SYNC message transmission ended
+				syncTmoStartTime = wifiIoTick () ;	// Reset timeout
+				wifiState = WST_SYNC_WAIT ;
+			}
+			break ;
+
+		case WST_SYNC_WAIT:
+			if (wifiRxlength() >= wifiHdrSize)
+			{
+				// Something received: end of sync
+				if (requestActive != REQUEST_NONE)
+				{
+					// This request is silently aborted
+					requestWaiting [requestActive] = false ;
+					requestActive = REQUEST_NONE ;
+				}
+
+				wifiAppLinkState (true) ;			// WIFI is detected and running
+				rxTmoStartTime = wifiIoTick () ;
+				wifiState = WST_WAIT_RX ;			// The SYNC echoed by the ESP32 is the 1st frame
+wifiIoTrace ("WST_SYNC_WAIT Ok\n", 0) ;
+			}
+			else
+			{
+				if ((wifiIoTick () - syncTmoStartTime) > SYNC_TMO)
+				{
+					// Time elapsed without receiving a header, send SYNC message again
+					wifiState = WST_SYNC_SEND ;
+				}
+			}
+			break ;
+
+		default:
+			wifiState = WST_SYNC_SEND ;
+			break ;
+	}
+	return bBusy ;
+}
+
+//--------------------------------------------------------------------------------
+//	The USART is initialized at WIFIMSG_BBR
+
+void	wifiFrameStart (void)
+{
+	requestInit () ;
+	wifiBaud  = WIFIMSG_BBR ;
+
+	// Start the WIFI state machine
+	wifiState = WST_SYNC_SEND ;
+}
+
+//--------------------------------------------------------------------------------
+
+const wifiFrameStat_t *	wifiFrameGetStat (void)
+{
+	return & wifiStat ;
+}
+
+//--------------------------------------------------------------------------------
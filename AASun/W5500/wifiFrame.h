@@ -0,0 +1,101 @@
+ /*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter
+
+	Alain Chebrou
+
+	wifiFrame.h	Communication with ESP32 (WIFI): the frames and the state machine
+
+	When		Who	What
+	18/10/26	ac	Creation: split of wifi.c
+
+	wifiFrame.c has no access to the hardware, the kernel or the application:
+	it uses the functions declared here, which are implemented:
+	- On AASun by wifi.c: the USART and its DMA, the aa kernel, the handlers of the requests
+	- On the host by mfs/wifiSim/src/aasunSim.c, so the real code is tested with the ESP32 code
+
+----------------------------------------------------------------------
+*/
+
+#if ! defined WIFIFRAME_H_
+#define WIFIFRAME_H_
+//-----------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#include	"wifiMsg.h"
+
+// The counters of the link
+typedef struct
+{
+	uint32_t	frames ;			// Valid frames received
+	uint32_t	crcErrors ;
+	uint32_t	rxTimeouts ;		// Incomplete frames skipped
+	uint32_t	skipped ;			// Bytes skipped while searching a frame
+	uint32_t	syncs ;				// WM_ID_SYNC sent
+	uint32_t	parts ;				// WM_ID_PART frames sent
+	uint32_t	lives ;				// WM_ID_LIVE sent
+	uint32_t	baudChanges ;
+	uint32_t	baudReturns ;		// Returns to the previous baud rate
+
+} wifiFrameStat_t ;
+
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// In wifiFrame.c
+void		wifiFrameStart		(void) ;			// Start the state machine, after the I/O initialization
+bool		wifiNext			(void) ;			// Returns true if it must be called again without waiting for a frame
+bool		wifiDateRequest		(void) ;
+uint32_t	wifiRxlength		(void) ;			// Count of received bytes not yet handled
+
+uint8_t *	wifiTxData			(void) ;			// The data of the response message, to build by the handlers
+bool		wifiTxPart			(uint32_t size) ;	// Send the size bytes at wifiTxData() as a fragment of the response
+
+const wifiFrameStat_t *	wifiFrameGetStat	(void) ;
+
+//-----------------------------------------------------------------------------
+//	The I/O: the USART, its DMA and the kernel
+
+void		wifiIoTxStart		(void * address, uint32_t size) ;
+bool		wifiIoTxEnd			(void) ;			// Returns true if the TX is ended
+void		wifiIoRxStart		(void * pBuffer) ;	// Start the RX at the beginning of pBuffer, WBUF_SIZE bytes in circle
+void		wifiIoRxStop		(void) ;
+uint32_t	wifiIoRxOffset		(void) ;			// Offset of the next byte written by the RX
+bool		wifiIoRxRewind		(uint32_t readOffset) ;	// If nothing is received after readOffset restart at the beginning
+void		wifiIoSetBaud		(uint32_t baud) ;	// The RX is stopped
+bool		wifiIoBaudNext		(uint32_t baud) ;	// The baud rate to use at the end of the next TX, false if not possible
+
+uint32_t	wifiIoTick			(void) ;			// ms
+void		wifiIoDelay			(uint32_t ms) ;
+void		wifiIoTrace			(const char * pFormat, uint32_t value) ;
+
+//-----------------------------------------------------------------------------
+//	The application: the handlers of the requests of the ESP32
+//	The responses are built at wifiTxData()
+
+uint32_t	wifiAppCgi			(wifiReqMsgCgi_t * pReq, uint32_t * pSize) ;	// Returns the message ID of the response
+void		wifiAppInfo			(const wifiGetInfoMsg_t * pReq, wifiInfoMsg_t * pInfo) ;
+uint32_t	wifiAppFsSize		(void) ;
+void		wifiAppFsRead		(uint8_t * pData, uint32_t offset, uint32_t size) ;
+void		wifiAppDate			(struct tm * pTime) ;				// NULL: no answer to wifiDateRequest()
+void		wifiAppLinkState	(bool bUp) ;
+
+uint32_t	wifiAppLiveGeneration	(void) ;
+uint32_t	wifiAppLive			(wifiRespMsgCgi_t * pMess, uint32_t maxSize) ;	// Returns the size of the response, 0 if error
+
+bool		wifiAppTelnetStart	(void) ;			// Returns false if the telnet is rejected
+void		wifiAppTelnetStop	(void) ;
+uint32_t	wifiAppTelnetRecv	(const uint8_t * pData, uint32_t size) ;	// Returns the free room for the next data
+uint32_t	wifiAppTelnetCount	(void) ;			// Count of the bytes to send
+void		wifiAppTelnetRead	(uint8_t * pData, uint32_t size) ;
+
+#ifdef __cplusplus
+}
+#endif
+//-----------------------------------------------------------------------------
+#endif	// WIFIFRAME_H_
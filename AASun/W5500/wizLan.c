@@ -13,6 +13,11 @@
 	09/03/23	ac	Creation
 	06/09/23	ac	Check W5500 version register: allows to test if the chip is physically present
 	20/03/24	ac	Add ESP32 communication to WIFI
+	18/10/26	ac	The low process task is awakened by the W5500 interrupt instead of polling every 3 ms
+	18/10/26	ac	DMA for W5500 burst reads, add SPI throughput benchmark
+	18/10/26	ac	HTTP files are copied from the flash to the W5500 without the HTTP buffer
+	18/10/26	ac	The MFS is read with W25Q_SpiTakeRead(): it can suspend a flash erase
+	18/10/26	ac	The WIFI receiver timeout interrupt wakes up the task, WIZ_BUSY_MS while a WIFI exchange is in progress
 
 
 
@@ -34,6 +39,7 @@
 
 #include	"AASun.h"
 #include	"spi.h"
+#include	"gpiobasic.h"	// For W5500 interrupt pin
 #include	"wizLan.h"
 #include	"wifi.h"
 #include	"util.h"		// For getMacAddress()
@@ -72,6 +78,11 @@ static	int8_t			mfsOk ;		// MFS_ENONE if the file system is mounted
 #define	rstOff()	RST_PORT->BSRR = (1u << RST_PIN)		// Reset is active low
 #define	rstOn()		RST_PORT->BSRR = (1u << (RST_PIN + 16))
 
+// Burst reads of at least this length use DMA, shorter ones (registers) are polled
+#define	WIZ_RD_DMA_MIN	16u
+
+static	uint16_t	wizRdDmaMin = WIZ_RD_DMA_MIN ;	// Variable for the benchmark
+
 //--------------------------------------------------------------------------------
 // Socket error message
 // Errors are negative, so negate the value before use as index in this array
@@ -231,9 +242,16 @@ void	wiz_spi_wbyte (uint8_t byte)
 
 void	wiz_spi_rburst (uint8_t * pBuf, uint16_t len)
 {
-	for (uint32_t ii = 0 ; ii < len ; ii++)
+	if (len >= wizRdDmaMin)
 	{
-		pBuf [ii] = wiz_spi_rbyte () ;
+		spiW5500ReadDmaXfer (len, pBuf) ;
+	}
+	else
+	{
+		for (uint32_t ii = 0 ; ii < len ; ii++)
+		{
+			pBuf [ii] = wiz_spi_rbyte () ;
+		}
 	}
 }
 
@@ -262,7 +280,7 @@ void	wiz_spi_wburst (uint8_t * pBuf, uint16_t len)
 static const uint8_t		sockBufferSize [8] = { 2, 2, 2, 2, 2, 2, 2, 2 } ;
 
 // DATA_BUF_SIZE defined in httpServer.h
-// wizBuffers is also used by SerEL.c
+// wizBuffers is also used by SerEL.c, and by wifi.c between two HTTP requests
 static	uint8_t	wizBuffer [DATA_BUF_SIZE * 2] ;
 static	uint8_t * const wizRxBuf = & wizBuffer [0] ;
 static	uint8_t * const wizTxBuf = & wizBuffer [DATA_BUF_SIZE] ;
@@ -271,6 +289,10 @@ static	aaTimerId_t		wiz1secTimerHandle ;
 
 extern	mfsCtx_t	wMfsCtx ;	// MFS file system context for http server
 
+// The MFS in the flash, above the configuration and history sectors
+#define	WIZ_MFS_ADDR		0x100000u
+#define	WIZ_MFS_SIZE		0x700000u	// Up to the end of the 8 MB flash
+
 /*
 // The default configuration when the EEPROM configuration is not available
 static const wiz_NetInfo	netInfo =
@@ -302,6 +324,22 @@ static const uint8_t		httpSocknumlist [HTTP_SOCK_MAX] = { 4, 5, 6 ,7 } ;
 
 #define	WLAN_TASK_PRIORITY	BSP_IRQPRIOMIN_PLUS(1)
 
+// --------------------------- W5500 interrupt
+// The W5500 INTn output (active low) is wired to this pin, configured as EXTI falling edge.
+// INTn is low as long as a socket has an unmasked Sn_IR bit set.
+// SENDOK is not enabled: it is polled by send(), httpStream and httpPush.
+#define	WIZ_INT_PORT		'C'
+#define	WIZ_INT_PIN			8
+#define	WIZ_INT_IRQN		EXTI4_15_IRQn
+#define	WIZ_SN_IMR			(Sn_IR_CON | Sn_IR_DISCON | Sn_IR_RECV | Sn_IR_TIMEOUT)
+
+#define	WIZ_SIG_EVENT		1u		// Signal from the W5500 interrupt or wizLanSignal() (WIFI receiver timeout)
+#define	WIZ_IDLE_MS			10u		// Max sleep time: temperature sensors, telnet output, DNS/SNTP timeouts
+#define	WIZ_BUSY_MS			1u		// Sleep time while a HTTP response or a WIFI exchange is in progress
+
+static	aaTaskId_t			wLanTaskId ;
+static	uint8_t				wizSnIr [_WIZCHIP_SOCK_NUM_] ;	// Snapshot of the Sn_IR registers
+
 //--------------------------------------------------------------------------------
 
 void		wizSetCfg			(lanCfg_t * pCfg)
@@ -979,16 +1017,181 @@ static	int mfsDevRead (void * userData, uint32_t address, void * pBuffer, uint32
 	return MFS_ENONE ;
 }
 
+// The MFS is only read: it can suspend an erase of the configuration or history
 static	void mfsDevLock (void * userData)
 {
-	(void) userData ;
-	W25Q_SpiTake () ;
+	W25Q_SpiTakeRead ((uint32_t) userData, WIZ_MFS_SIZE) ;
 }
 
 static	void mfsDevUnlock (void * userData)
 {
 	(void) userData ;
-	W25Q_SpiGive () ;
+	W25Q_SpiGiveRead () ;
+}
+
+//--------------------------------------------------------------------------------
+//	Send a part of a HTTP file straight from the flash to the socket TX memory of the W5500.
+//	The flash is read by DMA in small parts, alternately in two buffers:
+//	while the W5500 DMA writes a part, the flash DMA reads the next one.
+//	So the HTTP shared buffer is not used, and the CPU doesn't copy the data.
+
+#define	WIZ_FILE_CHUNK		128u
+
+static	void	wizFlashFill (uint8_t sn, uint16_t ptr, uint16_t len, void * arg)
+{
+	static uint8_t	chunk [2][WIZ_FILE_CHUNK] ;
+	uint32_t		addrSel = ((uint32_t) ptr << 8) + (WIZCHIP_TXBUF_BLOCK (sn) << 3) + _W5500_SPI_WRITE_ ;	// Variable data length mode
+	uint8_t			header [3] ;
+	uint32_t		size ;
+	uint32_t		ii = 0 ;
+	bool			bWriting = false ;
+
+	header [0] = (uint8_t) (addrSel >> 16) ;
+	header [1] = (uint8_t) (addrSel >>  8) ;
+	header [2] = (uint8_t) addrSel ;
+
+	W25Q_SpiTakeRead (* (uint32_t *) arg, len) ;
+	W25Q_ReadStreamStart (* (uint32_t *) arg) ;
+	wiz_cs_sel () ;
+	wiz_spi_wburst (header, 3) ;
+
+	while (len != 0)
+	{
+		size = (len > WIZ_FILE_CHUNK) ? WIZ_FILE_CHUNK : len ;
+		W25Q_ReadStream (chunk [ii], size) ;
+		if (bWriting)
+		{
+			spiW5500WriteDmaWait () ;
+		}
+		spiW5500WriteDmaStart (size, chunk [ii]) ;
+		bWriting = true ;
+		ii ^= 1u ;
+		len -= (uint16_t) size ;
+	}
+	if (bWriting)
+	{
+		spiW5500WriteDmaWait () ;
+	}
+
+	wiz_cs_desel () ;
+	W25Q_ReadStreamEnd () ;
+	W25Q_SpiGiveRead () ;
+}
+
+// Returns the same values as send()
+
+int32_t	wizSendFile (uint8_t sn, mfsFile_t * pFile, uint32_t offset, uint16_t len)
+{
+	uint32_t	address ;
+
+	if (mfsDataAddress (pFile, (int32_t) offset, len, & address) != MFS_ENONE)
+	{
+		return SOCKERR_ARG ;
+	}
+	address += WIZ_MFS_ADDR ;		// The file system address in the flash
+	return send_fill (sn, len, wizFlashFill, & address) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Display the MFS block cache statistics
+
+void	mfsCacheStat (void)
+{
+	uint32_t	hit, miss ;
+
+	mfsGetCacheStat (& wMfsCtx, & hit, & miss) ;
+	aaPrintf ("MFS cache: %u blocks, hit %u, miss %u\n", MFS_CACHE_BLOCKS, hit, miss) ;
+}
+
+//--------------------------------------------------------------------------------
+//	W5500 SPI throughput benchmark
+//	The W5500 has no internal loopback, so the socket data path is measured as send() and recv() use it:
+//	the TX buffer of the unused socket WBENCH_SOCK_NUM is written, then read back with polled and DMA reads.
+//	The SPI is used only by the LAN task: the console requests the benchmark (mode 0), the LAN task runs it (mode 1)
+
+#define	WBENCH_SOCK_NUM		3
+#define	WBENCH_COUNT		64u		// Count of DATA_BUF_SIZE transfers in each direction
+
+static	uint32_t	wizBenchRun (bool bRead, uint8_t * pBuf)
+{
+	uint32_t	addr = (uint32_t) WIZCHIP_TXBUF_BLOCK (WBENCH_SOCK_NUM) << 3 ;
+	uint32_t	start = aaGetTickCount () ;
+	uint32_t	ii ;
+
+	for (ii = 0 ; ii < WBENCH_COUNT ; ii++)
+	{
+		if (bRead)
+		{
+			WIZCHIP_READ_BUF (addr, pBuf, DATA_BUF_SIZE) ;
+		}
+		else
+		{
+			WIZCHIP_WRITE_BUF (addr, pBuf, DATA_BUF_SIZE) ;
+		}
+	}
+	return aaGetTickCount () - start ;
+}
+
+static	void	wizBenchDisplay (const char * pText, uint32_t ms)
+{
+	uint32_t	kbs = (ms == 0) ? 0 : (WBENCH_COUNT * DATA_BUF_SIZE * 1000u) / (ms * 1024u) ;
+
+	aaPrintf ("  %-10s %5u ms  %5u KB/s\n", pText, ms, kbs) ;
+}
+
+void	wizBench (uint32_t mode)
+{
+	static volatile bool	bBenchRequest = false ;	// Written by the console task, read by the LAN task
+	uint32_t		ms ;
+	uint32_t		ii ;
+
+	if (mode == 0)
+	{
+		bBenchRequest = true ;
+		wizLanSignal () ;		// Run it now
+		return ;
+	}
+
+	if (! bBenchRequest)
+	{
+		return ;
+	}
+	bBenchRequest = false ;
+
+	if (! statusWTest (STSW_W5500_EN))
+	{
+		aaPrintf ("No W5500\n") ;
+		return ;
+	}
+
+	// wizBuffer is free between two HTTP requests
+	for (ii = 0 ; ii < DATA_BUF_SIZE ; ii++)
+	{
+		wizRxBuf [ii] = (uint8_t) (ii * 7u + 1u) ;
+	}
+
+	aaPrintf ("W5500 SPI: %u x %u bytes, DMA read from %u bytes\n", WBENCH_COUNT, DATA_BUF_SIZE, WIZ_RD_DMA_MIN) ;
+
+	ms = wizBenchRun (false, wizRxBuf) ;
+	wizBenchDisplay ("TX DMA", ms) ;
+
+	wizRdDmaMin = 0xFFFFu ;
+	memset (wizTxBuf, 0, DATA_BUF_SIZE) ;
+	ms = wizBenchRun (true, wizTxBuf) ;
+	wizBenchDisplay ("RX polled", ms) ;
+	if (memcmp (wizRxBuf, wizTxBuf, DATA_BUF_SIZE) != 0)
+	{
+		aaPrintf ("  RX polled data error\n") ;
+	}
+
+	wizRdDmaMin = WIZ_RD_DMA_MIN ;
+	memset (wizTxBuf, 0, DATA_BUF_SIZE) ;
+	ms = wizBenchRun (true, wizTxBuf) ;
+	wizBenchDisplay ("RX DMA", ms) ;
+	if (memcmp (wizRxBuf, wizTxBuf, DATA_BUF_SIZE) != 0)
+	{
+		aaPrintf ("  RX DMA data error\n") ;
+	}
 }
 
 //--------------------------------------------------------------------------------
@@ -1120,6 +1323,107 @@ void	sntpNext (void)
 	}
 }
 
+//--------------------------------------------------------------------------------
+//	W5500 interrupt: wakes up the low process task
+
+static	void	wizIntInit (void)
+{
+	static const gpioPinDesc_t	intPin = { WIZ_INT_PORT, WIZ_INT_PIN, AA_GPIO_AF_0, AA_GPIO_MODE_INPUT | AA_GPIO_PULL_UP } ;
+	uint32_t	shift = (WIZ_INT_PIN % 4u) * 8u ;
+	uint8_t		sn ;
+
+	gpioConfigurePin (& intPin) ;
+
+	// The sockets events which activate INTn
+	for (sn = 0 ; sn < _WIZCHIP_SOCK_NUM_ ; sn++)
+	{
+		setSn_IMR (sn, WIZ_SN_IMR) ;
+	}
+	setSIMR (0xFF) ;
+
+	// EXTI line on falling edge
+	EXTI->EXTICR [WIZ_INT_PIN / 4u] = (EXTI->EXTICR [WIZ_INT_PIN / 4u] & ~(0xFFu << shift)) | ((uint32_t) (WIZ_INT_PORT - 'A') << shift) ;
+	EXTI->RTSR1 &= ~(1u << WIZ_INT_PIN) ;
+	EXTI->FTSR1 |= 1u << WIZ_INT_PIN ;
+	EXTI->FPR1   = 1u << WIZ_INT_PIN ;
+	EXTI->IMR1  |= 1u << WIZ_INT_PIN ;
+
+	NVIC_SetPriority (WIZ_INT_IRQN, BSP_IRQPRIOMIN_PLUS (1)) ;
+	NVIC_EnableIRQ   (WIZ_INT_IRQN) ;
+}
+
+void	EXTI4_15_IRQHandler (void)
+{
+	aaIntEnter () ;
+	if ((EXTI->FPR1 & (1u << WIZ_INT_PIN)) != 0u)
+	{
+		EXTI->FPR1 = 1u << WIZ_INT_PIN ;
+		if (wLanTaskId != 0)
+		{
+			(void) aaSignalSend (wLanTaskId, WIZ_SIG_EVENT) ;
+		}
+	}
+	aaIntExit () ;
+}
+
+// Read the sockets interrupts. If pSnIr is not NULL, save the Sn_IR values to clear them later.
+// Returns true if a socket has an event
+
+static	bool	wizIntRead (uint8_t * pSnIr)
+{
+	uint8_t		sir = getSIR () ;
+	uint8_t		ir ;
+	uint8_t		sn ;
+	bool		bEvent = false ;
+
+	for (sn = 0 ; sn < _WIZCHIP_SOCK_NUM_ ; sn++)
+	{
+		ir = 0 ;
+		if ((sir & (1u << sn)) != 0u)
+		{
+			ir = getSn_IR (sn) & WIZ_SN_IMR ;
+		}
+		if (ir != 0u)
+		{
+			bEvent = true ;
+		}
+		if (pSnIr != NULL)
+		{
+			pSnIr [sn] = ir ;
+		}
+	}
+	return bEvent ;
+}
+
+// Clear the mask events read by wizIntRead(). INTn goes high when all are cleared.
+// RECV and DISCON are cleared before the processing: the sockets state is read from Sn_SR and Sn_RX_RSR,
+// so new data received during the processing sets RECV again and is not lost.
+// CON and TIMEOUT are cleared after the processing: the HTTP server uses CON, socket.c and httpStream use TIMEOUT.
+
+static	void	wizIntClear (const uint8_t * pSnIr, uint8_t mask)
+{
+	uint8_t		sn ;
+
+	for (sn = 0 ; sn < _WIZCHIP_SOCK_NUM_ ; sn++)
+	{
+		if ((pSnIr [sn] & mask) != 0u)
+		{
+			setSn_IR (sn, pSnIr [sn] & mask) ;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Wake up the low process task, e.g. when new live values are available for the event stream
+
+void	wizLanSignal (void)
+{
+	if (wLanTaskId != 0)
+	{
+		(void) aaSignalSend (wLanTaskId, WIZ_SIG_EVENT) ;
+	}
+}
+
 //--------------------------------------------------------------------------------
 // When the console link is used for SerEl (web page download) it is necessary to get exclusive use of this link.
 // Setting bLowProcessEnabled to false disable the low process task, so it can't generate outputs
@@ -1137,7 +1441,8 @@ void	enableLowProcesses	(bool enable)
 void	lowProcessesTask (uintptr_t arg)
 {
 	int8_t		tmp ;
-	int8_t		seqnum ;
+	uint8_t		seqnum ;
+	uint32_t	sleepTime = 0 ;
 
 	(void) arg ;
 
@@ -1145,6 +1450,7 @@ void	lowProcessesTask (uintptr_t arg)
 	spiInit (w5500Spi) ;
 	wiz_cs_desel ()  ;
 	spiW5500DmaInit () ;
+	spiFlashDmaInit () ;
 	rstOff () ;
 	aaTaskDelay (10) ;	// More than 1ms (RSTn to internal PLOCK)
 	spiSetBaudRate (w5500Spi, SPI_W5500_BRDIV) ;
@@ -1182,7 +1488,7 @@ void	lowProcessesTask (uintptr_t arg)
 	// For http server
 	// Initialize the MFS context
 	// userData is used to provide the starting address of the file system in the FLASH
-	wMfsCtx.userData = (void *) 0x100000 ;
+	wMfsCtx.userData = (void *) WIZ_MFS_ADDR ;
 	wMfsCtx.lock     = mfsDevLock ;
 	wMfsCtx.unlock   = mfsDevUnlock ;
 	wMfsCtx.read     = mfsDevRead ;
@@ -1233,22 +1539,32 @@ aaPutChar('\n') ;
 
 	dnsState = DNS_ST_IDLE ;
 	sntpRunning = 0u ;
-	seqnum = 0 ;
 
 	DNS_init (DNS_SOCK_NUM, wizTxBuf) ;
 
 	// Initialize communication with ESP32 that handle WIFI
 	wifiInit () ;
 
+	wizIntInit () ;
+
 	// This loop manage the Telnet connections (wired and WIFI), HTTP server, DNS request, SNTP, temperature sensors, etc
+	// The task sleeps until a W5500 socket event, or for WIZ_IDLE_MS for the processes without interrupt.
+	// At each wake up all the sockets with an event are serviced.
 	while (1)
 	{
-		aaTaskDelay (3) ;
+		if (sleepTime != 0)
+		{
+			(void) aaSignalWait (WIZ_SIG_EVENT, NULL, AA_SIGNAL_AND, sleepTime) ;
+		}
+		sleepTime = WIZ_IDLE_MS ;
 		if (bLowProcessEnabled == false)
 		{
 			continue ;
 		}
 
+		(void) wizIntRead (wizSnIr) ;
+		wizIntClear (wizSnIr, Sn_IR_RECV | Sn_IR_DISCON) ;
+
 		tmp = 0 ;
 		ctlwizchip (CW_GET_PHYLINK, (void *) & tmp) ;
 		if (tmp == PHY_LINK_ON)
@@ -1263,10 +1579,13 @@ if (statusWTest (STSW_NET_LINK_OFF)) aaPrintf ("STSW_NET_LINK_ON\n") ;	// Print
 			// If the file system is mounted, then manage HTTP
 			if (mfsOk == MFS_ENONE)
 			{
-				httpServer_run (seqnum++) ;
-				if (seqnum == HTTP_SOCK_MAX)
+				for (seqnum = 0 ; seqnum < HTTP_SOCK_MAX ; seqnum++)
+				{
+					httpServer_run (seqnum) ;
+				}
+				if (httpServer_busy ())
 				{
-					seqnum = 0 ;
+					sleepTime = WIZ_BUSY_MS ;
 				}
 			}
 		}
@@ -1276,11 +1595,23 @@ if (! statusWTest (STSW_NET_LINK_OFF)) aaPrintf ("STSW_NET_LINK_OFF\n") ;	// Pri
 			statusWSet (STSW_NET_LINK_OFF) ;
 		}
 
-		wifiNext () ;
+		if (wifiNext ())
+		{
+			sleepTime = WIZ_BUSY_MS ;
+		}
 
 		tempSensorNext () ;
 
 		displayYesterdayHisto (1, 0) ;
+
+		wizBench (1) ;
+
+		// Events which occurred during the processing: don't sleep
+		wizIntClear (wizSnIr, Sn_IR_CON | Sn_IR_TIMEOUT) ;
+		if (wizIntRead (NULL))
+		{
+			sleepTime = 0 ;
+		}
 	}
 }
 
@@ -1301,7 +1632,7 @@ void	lowProcessesInit (void)
 		wLanStack,					// Stack pointer
 		WLAN_STACK_SIZE,			// Stack size
 		AA_FLAG_STACKCHECK,			// Flags
-		NULL) ;						// Created task id
+		& wLanTaskId) ;				// Created task id
 
 	aaTaskDelay (50) ;	// Allows the task to start
 }
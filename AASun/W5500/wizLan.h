@@ -69,7 +69,14 @@ void			sntpNext			(void) ;
 void			lowProcessesInit		(void) ;
 void			displayYesterdayHisto	(uint32_t mode, uint32_t rank) ;
 void			enableLowProcesses		(bool enable) ;
+void			wizLanSignal			(void) ;
 uint8_t *		getWizBuffer			(void) ;
+void			mfsCacheStat			(void) ;
+void			wizBench				(uint32_t mode) ;
+
+// HTTP server
+struct mfsFile_s ;
+int32_t			wizSendFile				(uint8_t sn, struct mfsFile_s * pFile, uint32_t offset, uint16_t len) ;
 
 #ifdef __cplusplus
 }
@@ -9,6 +9,9 @@
 
 	When		Who	What
 	09/04/24	ac	Creation
+	18/10/26	ac	wifiLink.c: several requests to AASun in flight
+	18/10/26	ac	Larger buffers for the fragmented responses
+	18/10/26	ac	Telnet coalescing and credits
 
 ----------------------------------------------------------------------
 */
@@ -47,8 +50,13 @@
 #define UART_TX_PIN			GPIO_NUM_0	//	GPIO_NUM_21
 #define UART_RX_PIN			GPIO_NUM_1	//	GPIO_NUM_20
 
-#define	UART_RX_BUF_SIZE	2048
+#define	UART_RX_BUF_SIZE	4096		// The fragments of a response arrive without pause, at up to WIFIMSG_BBR_MAX
 #define	UART_TX_BUF_SIZE	1024
+#define	UART_EVENT_QUEUE	20		// Size of the queue of the UART driver events
+
+#define	WIFI_LINK_TMO		(1000 / portTICK_PERIOD_MS)	// Max wait for an AASun response
+#define	WIFI_CGI_RESP_MAX	8192						// Max size of a GET CGI response: the full day power history fits
+#define	WIFI_FS_CHUNK		(16 * WIFIMSG_PAGE_CHUNK)	// Size of the HTTP file system pieces read from AASun
 
 //----------------------------------------------------------------------
 
@@ -57,7 +65,7 @@ EXTERN	int led_state ;
 
 #define	lenMax				4048
 EXTERN	char				uartBuffer [lenMax] ;		// The use of uartBuffer must be protected by uartMutex
-EXTERN	SemaphoreHandle_t	uartMutex ;
+EXTERN	SemaphoreHandle_t	uartMutex ;					// Only for uartBuffer: the UART is managed by wifiLink.c
 
 EXTERN	wifiInfoMsg_t		aaSunInfo ;
 
@@ -81,7 +89,16 @@ httpd_handle_t	setup_server		(void) ;
 void			wifiRequest			(void) ;
 void			wifiUartInit		(void) ;
 void			telnetOn			(bool bTelnetOn) ;
+void			wifiLivePut			(const wifiMsgHdr_t * pHdr) ;
+bool			wifiLiveWanted		(void) ;
+
+// In wifiLink.c
+void			wifiLinkInit		(QueueHandle_t uartQueue) ;
+bool			wifiLinkExchange	(wifiMsgHdr_t * pHdr, uint32_t bufSize, TickType_t timeout) ;
 bool			message_exchange	(wifiMsgHdr_t * pHdr) ;
+uint32_t		wifiLinkInFlight	(void) ;
+uint32_t		wifiLinkStatJson	(char * pBuf, uint32_t size) ;
+void			wifiLinkStat		(void) ;
 
 // In telnet.c
 void			telnetNext			(void) ;
@@ -9,6 +9,18 @@
 
 	When		Who	What
 	20/03/24	ac	Creation
+	18/10/26	ac	Files: ETag, If-None-Match (304), gzip compressed files
+	18/10/26	ac	Files are sent from a buffer allocated for the request, not from uartBuffer
+	18/10/26	ac	CGI requests use their own buffer and wifiLink.c: several CGI requests in flight
+	18/10/26	ac	UART driver event queue for wifiLink.c, /wifiLink statistics URI
+	18/10/26	ac	Mirror of the live values pushed by AASun, answers snapshot.cgi without UART exchange
+	18/10/26	ac	Fragmented responses: larger GET CGI responses and HTTP file system pieces
+	18/10/26	ac	Incremental HTTP file system update, using the block CRC table
+	18/10/26	ac	LRU cache of the files in RAM, content type from a table
+	18/10/26	ac	Telnet credit in WM_ID_REQ, fast WM_ID_REQ while AASun has telnet data
+	18/10/26	ac	GET CGI handled by worker tasks, identical requests collapsed, responses kept 500 ms
+	18/10/26	ac	gzip files only sent if the client accepts gzip, else 406, Vary: Accept-Encoding
+	18/10/26	ac	A CGI response requested before a cgiFlush() is not kept
 
 	https://github.com/espressif/esp-idf/blob/master/examples/protocols/sockets/tcp_server/main/tcp_server.c
 
@@ -18,13 +30,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> //Required for memset
+#include <strings.h>	// strncasecmp
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
 
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "esp_partition.h"
+#include "esp_rom_crc.h"
 
 #include <time.h>
 #include <lwip/sockets.h>
@@ -36,8 +52,6 @@
 
 static const	char 			* TAG = "http" ; // TAG for debug
 
-static	void	uartSynchronize (void) ;
-
 //----------------------------------------------------------------------
 // To access the HTTP data in SPI flash
 
@@ -45,7 +59,51 @@ static	void	uartSynchronize (void) ;
 #define		MFS_PATITION_SUBTYPE	((esp_partition_subtype_t) 0x80)
 
 static	mfsCtx_t	mfsCtx ;
-static	mfsFile_t	mfsFile ;
+
+// A file request has its own buffer: it doesn't wait for uartBuffer, used by the CGI requests
+#define	FILE_CHUNK_SIZE		2048
+
+// The files are kept in a RAM cache: a cached file is sent in one httpd_resp_send()
+// The least recently used files are evicted to keep the total size under FILE_CACHE_SIZE.
+// A cached file is valid only for the file system which has the same fsCRC.
+// Only the HTTP server task uses the cache: no exclusive access is needed.
+#define	FILE_CACHE_SIZE		(96 * 1024)		// Max total size of the cached files
+#define	FILE_CACHE_FILE_MAX	(32 * 1024)		// Larger files are not cached, they are sent by chunks
+#define	FILE_CACHE_SLOTS	24				// Max count of cached files
+
+typedef struct
+{
+	char		* pPath ;			// Allocated block: the path, then the file data
+	uint8_t		* pData ;
+	uint32_t	size ;
+	uint32_t	fsCRC ;				// CRC of the file system when the file was read
+	uint32_t	lastUse ;			// fileCacheTick of the last request, for the LRU
+	const char	* pType ;			// Content type
+	bool		bGzip ;
+	char		etag [24] ;			// "CRC-address" with quotes
+
+} fileCacheSlot_t ;
+
+static	fileCacheSlot_t	fileCache [FILE_CACHE_SLOTS] ;
+static	uint32_t		fileCacheUsed ;		// Total size of the allocated blocks
+static	uint32_t		fileCacheTick ;
+static	uint32_t		fileCacheHit, fileCacheMiss, fileCacheEvict ;
+
+// The content type from the file name extension, the default is "text/html"
+static const struct
+{
+	const char	* pExt ;
+	const char	* pType ;
+
+} fileTypes [] =
+{
+	{ ".js",	"application/javascript" },
+	{ ".ico",	"image/x-icon" },
+	{ ".css",	"text/css" },
+	{ ".png",	"image/png" },
+	{ ".svg",	"image/svg+xml" },
+	{ ".json",	"application/json" },
+} ;
 
 // The user provided functions to set in the MFS context
 
@@ -72,10 +130,243 @@ static	void mfsDevUnlock (void * userData)
 static	uint32_t			requestStartTime ;
 static	uint32_t			requestCounter ;		// To slow the LED pace
 static	uint32_t			requestTimeout ;		// Set to REQUEST_TMO_FAST or REQUEST_TMO_SLOW
+static	bool				bRequestSoon ;			// AASun has more telnet data: next request after REQUEST_TMO_TELNET
+#define	REQUEST_TMO_TELNET	(WIFI_TELNET_COALESCE_TMO / portTICK_PERIOD_MS)
+
+//----------------------------------------------------------------------
+
+static	const char *	fileContentType (const char * path)
+{
+	const char	* pExt = strrchr (path, '.') ;
+
+	if (pExt != NULL)
+	{
+		for (uint32_t ii = 0 ; ii < sizeof (fileTypes) / sizeof (fileTypes [0]) ; ii++)
+		{
+			if (strcmp (pExt, fileTypes [ii].pExt) == 0)
+			{
+				return fileTypes [ii].pType ;
+			}
+		}
+	}
+	return "text/html" ;
+}
+
+//----------------------------------------------------------------------
+
+static	void	fileCacheFree (fileCacheSlot_t * pSlot)
+{
+	fileCacheUsed -= pSlot->size + strlen (pSlot->pPath) + 1 ;
+	free (pSlot->pPath) ;
+	pSlot->pPath = NULL ;
+}
+
+//----------------------------------------------------------------------
+// Find a file in the cache, NULL if absent
+
+static	fileCacheSlot_t *	fileCacheFind (const char * path, uint32_t fsCRC)
+{
+	fileCacheSlot_t	* pSlot = fileCache ;
+
+	for (uint32_t ii = 0 ; ii < FILE_CACHE_SLOTS ; ii++, pSlot++)
+	{
+		if (pSlot->pPath != NULL  &&  strcmp (pSlot->pPath, path) == 0)
+		{
+			if (pSlot->fsCRC != fsCRC)
+			{
+				fileCacheFree (pSlot) ;		// From a previous file system
+				break ;
+			}
+			pSlot->lastUse = ++fileCacheTick ;
+			fileCacheHit++ ;
+			return pSlot ;
+		}
+	}
+	fileCacheMiss++ ;
+	return NULL ;
+}
+
+//----------------------------------------------------------------------
+// Read an opened file to the cache, evicting the least recently used files if needed
+// Returns NULL if the file is not cached
+
+static	fileCacheSlot_t *	fileCacheLoad (mfsFile_t * pFile, const char * path, uint32_t fsCRC)
+{
+	fileCacheSlot_t	* pSlot, * pOlder ;
+	uint32_t		size   = (uint32_t) mfsSize (pFile) ;
+	uint32_t		length = strlen (path) + 1 ;
+	uint32_t		crc, address ;
+
+	if (size > FILE_CACHE_FILE_MAX)
+	{
+		return NULL ;
+	}
+
+	while (1)
+	{
+		// Find a free slot, and the least recently used one
+		pSlot  = NULL ;
+		pOlder = NULL ;
+		for (uint32_t ii = 0 ; ii < FILE_CACHE_SLOTS ; ii++)
+		{
+			if (fileCache [ii].pPath == NULL)
+			{
+				pSlot = & fileCache [ii] ;
+			}
+			else if (pOlder == NULL  ||  fileCache [ii].lastUse < pOlder->lastUse)
+			{
+				pOlder = & fileCache [ii] ;
+			}
+		}
+		if (pSlot != NULL  &&  fileCacheUsed + size + length <= FILE_CACHE_SIZE)
+		{
+			break ;
+		}
+		if (pOlder == NULL)
+		{
+			return NULL ;
+		}
+		fileCacheFree (pOlder) ;
+		fileCacheEvict++ ;
+	}
+
+	pSlot->pPath = malloc (length + size) ;
+	if (pSlot->pPath == NULL)
+	{
+		return NULL ;
+	}
+	pSlot->pData = (uint8_t *) pSlot->pPath + length ;
+	memcpy (pSlot->pPath, path, length) ;
+	if (mfsRead (pFile, pSlot->pData, size) != (int32_t) size)
+	{
+		free (pSlot->pPath) ;
+		pSlot->pPath = NULL ;
+		return NULL ;
+	}
+
+	// The ETag changes when the file system is updated
+	mfsGetFileTag (pFile, & crc, & address) ;
+	snprintf (pSlot->etag, sizeof (pSlot->etag), "\"%08lX-%lX\"", crc, address) ;
+	pSlot->size    = size ;
+	pSlot->fsCRC   = fsCRC ;
+	pSlot->lastUse = ++fileCacheTick ;
+	pSlot->pType   = fileContentType (path) ;
+	pSlot->bGzip   = mfsIsGzip (pFile) ;
+	fileCacheUsed += length + size ;
+	return pSlot ;
+}
+
+//----------------------------------------------------------------------
+// Returns true if the Accept-Encoding header of the request allows gzip
+// Without Accept-Encoding any coding is acceptable. A coding with q=0 is not acceptable,
+// gzip takes precedence over *
 
-#define	SYNC_TMO			(1500 / portTICK_PERIOD_MS)
+static	bool	acceptGzip (httpd_req_t * req)
+{
+	char		value [96] ;
+	const char	* pStr = value ;
+	int			gzip = -1, star = -1 ;	// -1: not in the list, 0: not acceptable, 1: acceptable
+	int			* pCoding ;
+	int			accept ;
+	size_t		len ;
+	esp_err_t	err ;
+
+	err = httpd_req_get_hdr_value_str (req, "Accept-Encoding", value, sizeof (value)) ;
+	if (err == ESP_ERR_NOT_FOUND)
+	{
+		return true ;
+	}
+	if (err != ESP_OK  &&  err != ESP_ERR_HTTPD_RESULT_TRUNC)
+	{
+		return false ;
+	}
+
+	while (* pStr != 0)
+	{
+		// A coding: name, then optional parameters up to ','
+		pStr   += strspn (pStr, " \t,") ;
+		len     = strcspn (pStr, " \t;,") ;
+		accept  = 1 ;
+		pCoding = NULL ;
+		if (len == 4  &&  strncasecmp (pStr, "gzip", 4) == 0)
+		{
+			pCoding = & gzip ;
+		}
+		else if (len == 1  &&  * pStr == '*')
+		{
+			pCoding = & star ;
+		}
+		pStr += len ;
+
+		while (* pStr != 0  &&  * pStr != ',')
+		{
+			if ((pStr [0] == 'q'  ||  pStr [0] == 'Q')  &&  pStr [1] == '=')
+			{
+				// q=0, q=0.0 ... : not acceptable
+				pStr += 2 ;
+				if (* pStr == '0')
+				{
+					pStr++ ;
+					if (* pStr == '.')
+					{
+						pStr += 1 + strspn (pStr + 1, "0") ;
+					}
+					accept = * pStr >= '1'  &&  * pStr <= '9' ;
+				}
+				continue ;
+			}
+			pStr++ ;
+		}
+		if (pCoding != NULL)
+		{
+			* pCoding = accept ;
+		}
+	}
+	return (gzip != -1) ? gzip == 1 : star == 1 ;
+}
 
 //----------------------------------------------------------------------
+// Set the response headers of a file
+// Returns true if the response is sent: 304 if the client has this version of the file,
+// 406 if the file is gzip compressed and the client doesn't accept gzip
+
+static	bool	fileHeaders (httpd_req_t * req, const char * pType, const char * etag, bool bGzip)
+{
+	char			ifNoneMatch [24] ;
+
+	if (bGzip)
+	{
+		// The MFS only has the gzip variant of a compressed file
+		httpd_resp_set_hdr (req, "Vary", "Accept-Encoding") ;
+		if (! acceptGzip (req))
+		{
+			httpd_resp_set_status (req, "406 Not Acceptable") ;
+			httpd_resp_set_type (req, "text/plain") ;
+			httpd_resp_sendstr (req, "This file is only available gzip compressed") ;
+			return true ;
+		}
+	}
+
+	httpd_resp_set_type (req, pType) ;
+	httpd_resp_set_hdr (req, "ETag", etag) ;
+	httpd_resp_set_hdr (req, "Cache-Control", "no-cache") ;
+
+	// Conditional GET: the client has this version of the file in its cache
+	if (ESP_OK == httpd_req_get_hdr_value_str (req, "If-None-Match", ifNoneMatch, sizeof (ifNoneMatch))  &&
+		0 == strcmp (ifNoneMatch, etag))
+	{
+		httpd_resp_set_status (req, "304 Not Modified") ;
+		httpd_resp_send (req, NULL, 0) ;
+		return true ;
+	}
+
+	if (bGzip)
+	{
+		httpd_resp_set_hdr (req, "Content-Encoding", "gzip") ;
+	}
+	return false ;
+}
+
 //----------------------------------------------------------------------
 // Send a file as request response
 
@@ -84,7 +375,11 @@ static esp_err_t http_response_file (httpd_req_t * req)
 	int32_t			size, len ;
 	int32_t			fileLen ;
 	const char *	path ;
-	char *			pExt ;
+	char			etag [24] ;			// "CRC-address" with quotes
+	uint32_t		crc, address, fsCRC ;
+	mfsFile_t		mfsFile ;
+	char			* pChunk ;
+	fileCacheSlot_t	* pSlot ;
 
 ESP_LOGI (TAG, "FILE: %s", req->uri) ;
     if (strcmp (req->uri, "/")  == 0)
@@ -104,56 +399,75 @@ ESP_LOGI (TAG, "FILE: %s", req->uri) ;
     	}
     }
 
-    // Set the response content type
-    pExt = strrchr (path, '.') ;
-    if (pExt != NULL)
-    {
-		if (strcmp (pExt, ".js") == 0)
-		{
-			httpd_resp_set_type (req, "application/javascript") ;
-		}
-		else if (strcmp (pExt, ".ico") == 0)
-		{
-			httpd_resp_set_type (req, "image/x-icon") ;
-		}
-		else if (strcmp (pExt, ".css") == 0)
+	// From the RAM cache
+	mfsGetCrc (& mfsCtx, & fsCRC, & address) ;
+	pSlot = fileCacheFind (path, fsCRC) ;
+	if (pSlot == NULL)
+	{
+	    if (MFS_ENONE != mfsOpen (& mfsCtx, & mfsFile, path))
 		{
-		    httpd_resp_set_type (req, "text/css") ;
+			// File not found
+			httpd_resp_send_err (req, HTTPD_404_NOT_FOUND, "File does not exist") ;
+			return ESP_FAIL ;
 		}
-		else if (strcmp (pExt, ".png") == 0)
+		pSlot = fileCacheLoad (& mfsFile, path, fsCRC) ;
+		if (pSlot != NULL)
 		{
-			httpd_resp_set_type (req, "image/png") ;
+			mfsClose (& mfsFile) ;
 		}
-		else
+	}
+	if (pSlot != NULL)
+	{
+		if (! fileHeaders (req, pSlot->pType, pSlot->etag, pSlot->bGzip))
 		{
-			// Default value is "text/html"
+			return httpd_resp_send (req, (const char *) pSlot->pData, pSlot->size) ;
 		}
-    }
+		return ESP_OK ;
+	}
+
+	// Not cached: send the file by chunks
+	mfsSeek (& mfsFile, 0, MFS_SEEK_SET) ;
+	fileLen = mfsSize (& mfsFile) ;
+    ESP_LOGI (TAG, "FILE found: %ld bytes", fileLen) ;
+
+	mfsGetFileTag (& mfsFile, & crc, & address) ;
+	snprintf (etag, sizeof (etag), "\"%08lX-%lX\"", crc, address) ;
+	if (fileHeaders (req, fileContentType (path), etag, mfsIsGzip (& mfsFile)))
+	{
+		mfsClose (& mfsFile) ;
+		return ESP_OK ;
+	}
 
-    if (MFS_ENONE == mfsOpen (& mfsCtx, & mfsFile, path))
+	pChunk = malloc (MIN (FILE_CHUNK_SIZE, fileLen + 1)) ;
+	if (pChunk == NULL)
 	{
-		fileLen = mfsSize (& mfsFile) ;
-	    ESP_LOGI (TAG, "FILE found: %ld bytes", fileLen) ;
+		mfsClose (& mfsFile) ;
+		httpd_resp_send_err (req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory") ;
+		return ESP_FAIL ;
+	}
 
-		len = 0 ;
-		while (len < fileLen)
+	len = 0 ;
+	while (len < fileLen)
+	{
+		size = MIN (FILE_CHUNK_SIZE, fileLen - len) ;
+		mfsRead (& mfsFile, pChunk, size) ;
+		if (ESP_OK != httpd_resp_send_chunk (req, pChunk, size))
 		{
-			size = MIN (sizeof (uartBuffer), fileLen - len) ;
-			mfsRead (& mfsFile, uartBuffer, size) ;
-			len += size ;
-
-			httpd_resp_send_chunk (req, uartBuffer, size) ;
+			break ;		// The client is gone
 		}
-		// An empty chunk to signal HTTP response completion
-//		httpd_resp_set_hdr(req, "Connection", "close") ;
-		httpd_resp_send_chunk (req, NULL, 0) ;
-		mfsClose (& mfsFile) ;
-		return ESP_OK ;
+		len += size ;
+	}
+	free (pChunk) ;
+	mfsClose (& mfsFile) ;
+	if (len < fileLen)
+	{
+		return ESP_FAIL ;
 	}
 
-	// File not found
-	httpd_resp_send_err (req, HTTPD_404_NOT_FOUND, "File does not exist") ;
-	return ESP_FAIL ;
+	// An empty chunk to signal HTTP response completion
+//	httpd_resp_set_hdr(req, "Connection", "close") ;
+	httpd_resp_send_chunk (req, NULL, 0) ;
+	return ESP_OK ;
 }
 
 //----------------------------------------------------------------------
@@ -205,57 +519,30 @@ bool get_http_uri_name (const char * uri, char * uri_buf)
 
 //----------------------------------------------------------------------
 // Send a message to AASun then wait for the response message
-// The message to send is built in uartBuffet and pointed to by pHdr
+// The message to send is built in a buffer of bufSize bytes pointed to by pHdr
 
-static	esp_err_t cgi_message_exchange (httpd_req_t * req, wifiMsgHdr_t * pHdr)
-{
-	wifiRespMsgCgi_t	* pResp ;
-	size_t				size ;
+// Returns true if the response received from AASun is a valid CGI response
 
-	// Send the message to AASun
-	uart_write_bytes (UART_NUM, pHdr, wifiHdrSize + pHdr->dataLength) ;
+static	bool	cgi_response_check (wifiMsgHdr_t * pHdr)
+{
+	wifiRespMsgCgi_t	* pResp = (wifiRespMsgCgi_t *) pHdr->message ;
 
-	// Wait for response header
-// TODO: Timeout
-	while (1)
+	if (pHdr->msgId == WM_ID_CGI_RESP  &&  pResp->respSize == WM_RESP_SIZE_PART  &&  pHdr->dataLength >= wifiRespMsgCgiSize)
 	{
-		uart_get_buffered_data_len (UART_NUM, & size) ;
-		if (size >= wifiHdrSize)
-		{
-			uart_read_bytes (UART_NUM, pHdr, wifiHdrSize, 10 / portTICK_PERIOD_MS) ;
-			break ;
-		}
-		vTaskDelay (2) ;
+		// Fragmented response: all the reassembled data
+		pResp->respSize = pHdr->dataLength - wifiRespMsgCgiSize ;
 	}
+	return pHdr->msgId == WM_ID_CGI_RESP  &&  pHdr->dataLength >= wifiRespMsgCgiSize  &&
+		   pResp->respSize <= pHdr->dataLength - wifiRespMsgCgiSize ;
+}
 
-    // Check response header
-    if (pHdr->magic != WIFIMSG_MAGIC)
-    {
-    	//  Badly formated message: communication not synchronized
-		httpd_resp_send_err (req, HTTPD_404_NOT_FOUND, "Get error") ;
-		uartSynchronize () ;
-		return ESP_FAIL ;
-    }
+// Send to the client a response checked by cgi_response_check()
 
-	// Get message data
-	pResp = (wifiRespMsgCgi_t *) pHdr->message ;
-	if (pHdr->dataLength != 0)
-	{
-		while (1)
-		{
-			uart_get_buffered_data_len (UART_NUM, & size) ;
-			if (size >= pHdr->dataLength)
-			{
-				uart_read_bytes (UART_NUM, pResp, pHdr->dataLength, 10 / portTICK_PERIOD_MS) ;
-				pResp->resp [pResp->respSize] = 0 ;
-				break ;
-			}
-			vTaskDelay (2) ;
-		}
-	}
+static	void	cgi_response_send (httpd_req_t * req, const wifiMsgHdr_t * pHdr, bool bValid)
+{
+	const wifiRespMsgCgi_t	* pResp = (const wifiRespMsgCgi_t *) pHdr->message ;
 
-	// Message handling
-	if (pHdr->msgId != WM_ID_CGI_RESP)
+	if (! bValid)
 	{
 		httpd_resp_send_err (req, HTTPD_404_NOT_FOUND, "Get error") ;
 	}
@@ -264,46 +551,435 @@ static	esp_err_t cgi_message_exchange (httpd_req_t * req, wifiMsgHdr_t * pHdr)
 		httpd_resp_set_type (req, pResp->contentType) ;
 		httpd_resp_send     (req, pResp->resp, pResp->respSize) ;
 	}
+}
+
+static	esp_err_t cgi_message_exchange (httpd_req_t * req, wifiMsgHdr_t * pHdr, uint32_t bufSize)
+{
+	// Send the message to AASun and wait for the response
+	if (! wifiLinkExchange (pHdr, bufSize, WIFI_LINK_TMO))
+	{
+		httpd_resp_send_err (req, HTTPD_500_INTERNAL_SERVER_ERROR, "AASun no response") ;
+		return ESP_OK ;
+	}
 
+	// Message handling
+	cgi_response_send (req, pHdr, cgi_response_check (pHdr)) ;
 	return ESP_OK ;
 }
 
 //----------------------------------------------------------------------
-// Manage HTTP GET CGI request
+// Mirror of the live values pushed by AASun (WM_ID_LIVE)
+// While clients request WM_LIVE_CGI, wifiRequest() asks AASun to push it once per second.
+// Then WM_LIVE_CGI without query is answered from the mirror, without UART exchange.
 
-static	esp_err_t get_cgi_handler (httpd_req_t * req)
+#define	LIVE_MAX_AGE		(2500  / portTICK_PERIOD_MS)	// Older live values are not used
+#define	LIVE_WANTED_TMO		(10000 / portTICK_PERIOD_MS)	// The push is wanted during this time after a request
+
+static	SemaphoreHandle_t	liveMutex ;
+static	char				liveContentType [WM_CONTENT_MAX] ;
+static	char				liveBuffer [WBUF_SIZE] ;
+static	uint32_t			liveLength ;			// 0 if no live values received
+static	TickType_t			liveTime ;				// Time of reception of the live values
+static	TickType_t			liveRequestTime ;		// Time of the last request of WM_LIVE_CGI
+static	bool				bLiveRequested ;
+
+// Called by the wifiLink.c reader task: the message is a wifiRespMsgCgi_t
+
+void	wifiLivePut (const wifiMsgHdr_t * pHdr)
 {
-	// Take the semaphore to protect access to uartBuffer
-    xSemaphoreTakeRecursive (uartMutex, portMAX_DELAY) ;
-    gpio_set_level (LED_PIN, LED_ON) ;
+	const wifiRespMsgCgi_t	* pResp = (const wifiRespMsgCgi_t *) pHdr->message ;
 
-	wifiMsgHdr_t		* pHdr  = (wifiMsgHdr_t *) uartBuffer ;
-	wifiReqMsgCgi_t		* pMess = (wifiReqMsgCgi_t *) pHdr->message ;
-	size_t				size ;
-	esp_err_t			status ;
+	if (pHdr->dataLength < wifiRespMsgCgiSize  ||  pResp->respSize > pHdr->dataLength - wifiRespMsgCgiSize)
+	{
+		return ;
+	}
+	xSemaphoreTake (liveMutex, portMAX_DELAY) ;
+	memcpy (liveContentType, pResp->contentType, WM_CONTENT_MAX) ;
+	liveContentType [WM_CONTENT_MAX - 1] = 0 ;
+	memcpy (liveBuffer, pResp->resp, pResp->respSize) ;
+	liveLength = pResp->respSize ;
+	liveTime   = xTaskGetTickCount () ;
+	xSemaphoreGive (liveMutex) ;
+}
 
-	ESP_LOGI (TAG, "GET CGI: %s", req->uri) ;
+// Returns true if AASun should push the live values
+
+bool	wifiLiveWanted (void)
+{
+	return bLiveRequested  &&  (xTaskGetTickCount () - liveRequestTime) < LIVE_WANTED_TMO ;
+}
+
+// Answer the request from the mirror. Returns false if the mirror is not up to date
+
+static	bool	liveSend (httpd_req_t * req)
+{
+	char		* pBuffer = NULL ;
+	char		contentType [WM_CONTENT_MAX] ;
+	uint32_t	length = 0 ;
+
+	liveRequestTime = xTaskGetTickCount () ;
+	bLiveRequested  = true ;
 
-    // Build the message to send to AASun in uartBuffer
-    // Get the request URI name and URI query string
+	// Copy the live values: the mutex is not held while sending to the client
+	xSemaphoreTake (liveMutex, portMAX_DELAY) ;
+	if (liveLength != 0  &&  (xTaskGetTickCount () - liveTime) < LIVE_MAX_AGE)
+	{
+		pBuffer = malloc (liveLength) ;
+		if (pBuffer != NULL)
+		{
+			length = liveLength ;
+			memcpy (pBuffer, liveBuffer, length) ;
+			memcpy (contentType, liveContentType, WM_CONTENT_MAX) ;
+		}
+	}
+	xSemaphoreGive (liveMutex) ;
+
+	if (pBuffer == NULL)
+	{
+		return false ;
+	}
+	httpd_resp_set_type (req, contentType) ;
+	httpd_resp_send     (req, pBuffer, length) ;
+	free (pBuffer) ;
+	return true ;
+}
+
+//----------------------------------------------------------------------
+// Collapsing of the GET CGI requests
+// The identical GET CGI requests (same URI name and query) are sent once to AASun: the first
+// one is sent, the others wait for its response. Then a valid response is kept CGI_CACHE_TTL
+// for the next identical requests. A POST CGI may modify AASun: it discards the kept responses.
+// The GET CGI requests are handled by CGI_WORKERS tasks (asynchronous requests of the HTTP
+// server), so several requests can be in flight on the UART link.
+
+#define	CGI_SLOTS			4							// Max count of different requests in flight or kept
+#define	CGI_CACHE_TTL		(500 / portTICK_PERIOD_MS)	// Life time of a kept response
+#define	CGI_WAIT_TMO		(3 * WIFI_LINK_TMO)			// Max wait for the response of an identical request
+#define	CGI_WORKERS			2
+#define	CGI_WORKER_STACK	3072
+#define	CGI_QUEUE_SIZE		8
+
+typedef enum
+{
+	CGI_FREE	= 0,
+	CGI_PENDING,						// The request is sent to AASun
+	CGI_DONE							// The response is received
+
+} cgiState_t ;
+
+typedef struct
+{
+	cgiState_t		state ;
+	uint32_t		refCount ;			// Count of requests using the slot: it can't be reused
+	uint32_t		hash ;				// Hash of the URI name and query
+	char			uriName [WM_URINAME_MAX] ;
+	char			* pQuery ;			// Allocated
+	wifiMsgHdr_t	* pHdr ;			// The response, allocated. NULL if AASun did not answer
+	bool			bValid ;			// The response is a valid CGI response
+	TickType_t		time ;				// Time of the response
+	uint32_t		flushGen ;			// cgiFlushGen when the request was sent
+
+} cgiSlot_t ;
+
+static	cgiSlot_t			cgiSlots [CGI_SLOTS] ;
+static	SemaphoreHandle_t	cgiMutex ;
+static	EventGroupHandle_t	cgiEvents ;			// Bit n is set when the response of cgiSlots [n] is received
+static	QueueHandle_t		cgiQueue ;			// The asynchronous requests for the workers
+static	uint32_t			cgiFlushGen ;		// Incremented by cgiFlush()
+static	uint32_t			cgiUpstream, cgiCollapsed, cgiHit, cgiBypass ;
+
+// FNV-1a hash of the URI name and query
+
+static	uint32_t	cgiHash (const wifiReqMsgCgi_t * pMess)
+{
+	uint32_t	hash = 2166136261u ;
+	const char	* pStr ;
+
+	for (pStr = pMess->uriName ; * pStr != 0 ; pStr++)
+	{
+		hash = (hash ^ (uint8_t) * pStr) * 16777619u ;
+	}
+	for (pStr = pMess->uri ; * pStr != 0 ; pStr++)
+	{
+		hash = (hash ^ (uint8_t) * pStr) * 16777619u ;
+	}
+	return hash ;
+}
+
+// To call inside cgiMutex protection
+
+static	bool	cgiSlotValid (const cgiSlot_t * pSlot, TickType_t now)
+{
+	return pSlot->state == CGI_DONE  &&  pSlot->bValid  &&  (now - pSlot->time) < CGI_CACHE_TTL ;
+}
+
+static	void	cgiSlotFree (cgiSlot_t * pSlot)
+{
+	free (pSlot->pQuery) ;
+	free (pSlot->pHdr) ;
+	pSlot->pQuery = NULL ;
+	pSlot->pHdr   = NULL ;
+	pSlot->state  = CGI_FREE ;
+}
+
+// Discard the kept responses
+// The responses of the requests in flight are not kept either: they may have been built before the flush
+
+static	void	cgiFlush (void)
+{
+	xSemaphoreTake (cgiMutex, portMAX_DELAY) ;
+	cgiFlushGen++ ;
+	for (uint32_t ii = 0 ; ii < CGI_SLOTS ; ii++)
+	{
+		cgiSlots [ii].bValid = false ;		// Still given to the waiting requests, but not kept
+	}
+	xSemaphoreGive (cgiMutex) ;
+}
+
+static	void	cgiCacheStat (void)
+{
+	printf ("CGI: upstream %lu, collapsed %lu, hit %lu, bypass %lu\n", cgiUpstream, cgiCollapsed, cgiHit, cgiBypass) ;
+}
+
+//----------------------------------------------------------------------
+// Send a GET CGI request to AASun, or join an identical request
+
+static	esp_err_t	cgi_get_request (httpd_req_t * req)
+{
+	wifiMsgHdr_t		* pHdr, * pResp ;
+	wifiReqMsgCgi_t		* pMess ;
+	cgiSlot_t			* pSlot = NULL ;
+	cgiSlot_t			* pFree = NULL ;
+	char				* pQuery ;
+	size_t				size ;
+	uint32_t			hash, ii ;
+	TickType_t			now ;
+	bool				bLeader = false ;
+	bool				bValid  = false ;
+
+	// The request has its own buffer: it doesn't wait for the other requests
+	size = httpd_req_get_url_query_len (req) ;
+	if (size >= dataMessageMax - wifiReqMsgCgiSize)
+	{
+		httpd_resp_send_err (req, HTTPD_414_URI_TOO_LONG, "URI too long") ;
+		return ESP_OK ;
+	}
+	pHdr = (wifiMsgHdr_t *) malloc (WBUF_SIZE) ;
+	if (pHdr == NULL)
+	{
+		httpd_resp_send_err (req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory") ;
+		return ESP_OK ;
+	}
+	pMess = (wifiReqMsgCgi_t *) pHdr->message ;
+    gpio_set_level (LED_PIN, LED_ON) ;
+
+    // Build the message to send to AASun
+    // Set the request URI name, get the URI query string
     get_http_uri_name (req->uri, pMess->uriName) ;
-    size = httpd_req_get_url_query_len (req) ;
     if (size != 0)
     {
-    	httpd_req_get_url_query_str (req, pMess->uri, lenMax - wifiHdrSize - wifiReqMsgCgiSize) ;
+    	httpd_req_get_url_query_str (req, pMess->uri, size + 1) ;
     }
 	pMess->uri [size] = 0 ;
 	pMess->uriSize    = size ;
     pMess->type       = WM_TYPE_GET ;
 
-    pHdr->magic      = WIFIMSG_MAGIC ;
     pHdr->msgId      = WM_ID_CGI ;
-    pHdr->dataLength = wifiReqMsgCgiSize + pMess->uriSize ;
+    pHdr->dataLength = wifiReqMsgCgiSize + pMess->uriSize + 1 ;	// With the final 0
+    hash = cgiHash (pMess) ;
+
+	// Search an identical request in flight or a kept response, else a slot for this request
+	xSemaphoreTake (cgiMutex, portMAX_DELAY) ;
+	now = xTaskGetTickCount () ;
+	for (ii = 0 ; ii < CGI_SLOTS ; ii++)
+	{
+		cgiSlot_t	* pCur = & cgiSlots [ii] ;
+
+		// A request sent before a cgiFlush() can't be joined: its response may be obsolete
+		if (((pCur->state == CGI_PENDING  &&  pCur->flushGen == cgiFlushGen)  ||  cgiSlotValid (pCur, now))  &&  pCur->hash == hash  &&
+			strcmp (pCur->uriName, pMess->uriName) == 0  &&  strcmp (pCur->pQuery, pMess->uri) == 0)
+		{
+			pSlot = pCur ;
+			break ;
+		}
+		if (pCur->state != CGI_PENDING  &&  pCur->refCount == 0  &&  (pFree == NULL  ||  pCur->state == CGI_FREE  ||
+			(pFree->state != CGI_FREE  &&  (now - pCur->time) > (now - pFree->time))))
+		{
+			pFree = pCur ;		// Free, or the oldest unused response
+		}
+	}
+	if (pSlot != NULL)
+	{
+		pSlot->refCount++ ;
+		if (pSlot->state == CGI_PENDING)
+		{
+			cgiCollapsed++ ;
+		}
+		else
+		{
+			cgiHit++ ;
+		}
+	}
+	else if (pFree != NULL  &&  (pQuery = strdup (pMess->uri)) != NULL)
+	{
+		// This request is sent to AASun, the identical requests will wait for its response
+		cgiSlotFree (pFree) ;
+		pFree->pQuery   = pQuery ;
+		pFree->state    = CGI_PENDING ;
+		pFree->refCount = 1 ;
+		pFree->hash     = hash ;
+		pFree->flushGen = cgiFlushGen ;
+		strcpy (pFree->uriName, pMess->uriName) ;
+		xEventGroupClearBits (cgiEvents, 1 << (pFree - cgiSlots)) ;
+		pSlot   = pFree ;
+		bLeader = true ;
+		cgiUpstream++ ;
+	}
+	else
+	{
+		cgiBypass++ ;
+	}
+	xSemaphoreGive (cgiMutex) ;
+
+	if (pSlot == NULL)
+	{
+		// No slot available: not collapsed
+		pResp = (wifiMsgHdr_t *) realloc (pHdr, wifiHdrSize + WIFI_CGI_RESP_MAX) ;
+		if (pResp == NULL)
+		{
+			free (pHdr) ;
+			httpd_resp_send_err (req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory") ;
+		}
+		else
+		{
+			cgi_message_exchange (req, pResp, wifiHdrSize + WIFI_CGI_RESP_MAX) ;
+			free (pResp) ;
+		}
+	    gpio_set_level (LED_PIN, LED_OFF) ;
+		return ESP_OK ;
+	}
+
+	if (bLeader)
+	{
+		// The response can be larger than the request: it may be fragmented
+		pResp = (wifiMsgHdr_t *) realloc (pHdr, wifiHdrSize + WIFI_CGI_RESP_MAX) ;
+		if (pResp == NULL)
+		{
+			free (pHdr) ;
+		}
+		else if (! wifiLinkExchange (pResp, wifiHdrSize + WIFI_CGI_RESP_MAX, WIFI_LINK_TMO))
+		{
+			free (pResp) ;
+			pResp = NULL ;
+		}
+		else
+		{
+			// Keep only the size of the response
+			bValid = cgi_response_check (pResp) ;
+			pHdr   = (wifiMsgHdr_t *) realloc (pResp, wifiHdrSize + pResp->dataLength) ;
+			pResp  = (pHdr != NULL) ? pHdr : pResp ;
+		}
+
+		xSemaphoreTake (cgiMutex, portMAX_DELAY) ;
+		pSlot->pHdr   = pResp ;
+		pSlot->bValid = bValid  &&  pSlot->flushGen == cgiFlushGen ;	// Not kept if flushed meanwhile
+		pSlot->time   = xTaskGetTickCount () ;
+		pSlot->state  = CGI_DONE ;
+		xSemaphoreGive (cgiMutex) ;
+		xEventGroupSetBits (cgiEvents, 1 << (pSlot - cgiSlots)) ;
+	}
+	else
+	{
+		free (pHdr) ;
+		xEventGroupWaitBits (cgiEvents, 1 << (pSlot - cgiSlots), pdFALSE, pdTRUE, CGI_WAIT_TMO) ;
+	}
+
+	// Send the response: the slot is not reused while refCount != 0
+	xSemaphoreTake (cgiMutex, portMAX_DELAY) ;
+	pResp = (pSlot->state == CGI_DONE) ? pSlot->pHdr : NULL ;
+	bValid = pSlot->state == CGI_DONE  &&  pSlot->pHdr != NULL  &&  pSlot->pHdr->msgId == WM_ID_CGI_RESP ;
+	xSemaphoreGive (cgiMutex) ;
+
+	if (pResp == NULL)
+	{
+		httpd_resp_send_err (req, HTTPD_500_INTERNAL_SERVER_ERROR, "AASun no response") ;
+	}
+	else
+	{
+		cgi_response_send (req, pResp, bValid) ;
+	}
+
+	xSemaphoreTake (cgiMutex, portMAX_DELAY) ;
+	pSlot->refCount-- ;
+	if (pSlot->refCount == 0  &&  ! cgiSlotValid (pSlot, xTaskGetTickCount ()))
+	{
+		cgiSlotFree (pSlot) ;
+	}
+	xSemaphoreGive (cgiMutex) ;
 
-	status = cgi_message_exchange (req, pHdr) ;
     gpio_set_level (LED_PIN, LED_OFF) ;
-	xSemaphoreGiveRecursive (uartMutex) ;
-	return status ;
+	return ESP_OK ;
+}
+
+//----------------------------------------------------------------------
+// The worker tasks: they handle the asynchronous GET CGI requests
+
+static	void	cgiWorkerTask (void * pParam)
+{
+	httpd_req_t		* req ;
+
+	(void) pParam ;
+	while (1)
+	{
+		if (xQueueReceive (cgiQueue, & req, portMAX_DELAY) == pdTRUE)
+		{
+			cgi_get_request (req) ;
+			httpd_req_async_handler_complete (req) ;
+		}
+	}
+}
+
+static	void	cgiInit (void)
+{
+	cgiMutex  = xSemaphoreCreateMutex () ;
+	cgiEvents = xEventGroupCreate () ;
+	cgiQueue  = xQueueCreate (CGI_QUEUE_SIZE, sizeof (httpd_req_t *)) ;
+	for (uint32_t ii = 0 ; ii < CGI_WORKERS ; ii++)
+	{
+		xTaskCreate (cgiWorkerTask, "cgiWorker", CGI_WORKER_STACK, NULL, tskIDLE_PRIORITY + 5, NULL) ;
+	}
+}
+
+//----------------------------------------------------------------------
+// Manage HTTP GET CGI request
+
+static	esp_err_t get_cgi_handler (httpd_req_t * req)
+{
+	httpd_req_t			* pCopy ;
+	char				uriName [WM_URINAME_MAX] ;
+
+	ESP_LOGI (TAG, "GET CGI: %s", req->uri) ;
+
+	get_http_uri_name (req->uri, uriName) ;
+
+	// The live values may be in the mirror
+	if (httpd_req_get_url_query_len (req) == 0  &&  strcmp (uriName, WM_LIVE_CGI) == 0  &&  liveSend (req))
+	{
+		return ESP_OK ;
+	}
+
+	// The exchange with AASun is done by a worker: the server handles the next requests meanwhile
+	if (uxQueueSpacesAvailable (cgiQueue) != 0  &&  ESP_OK == httpd_req_async_handler_begin (req, & pCopy))
+	{
+		if (xQueueSend (cgiQueue, & pCopy, 0) == pdTRUE)
+		{
+			return ESP_OK ;
+		}
+		cgi_get_request (pCopy) ;
+		httpd_req_async_handler_complete (pCopy) ;
+		return ESP_OK ;
+	}
+	return cgi_get_request (req) ;
 }
 
 //----------------------------------------------------------------------
@@ -311,37 +987,41 @@ static	esp_err_t get_cgi_handler (httpd_req_t * req)
 
 static	esp_err_t post_cgi_handler (httpd_req_t * req)
 {
-	wifiMsgHdr_t		* pHdr  = (wifiMsgHdr_t *) uartBuffer ;
-	wifiReqMsgCgi_t		* pMess = (wifiReqMsgCgi_t *) pHdr->message ;
+	wifiMsgHdr_t		* pHdr ;
+	wifiReqMsgCgi_t		* pMess ;
 	size_t				size, nn ;
 	int					ret ;
 	esp_err_t			status ;
 
     ESP_LOGI (TAG, "POST CGI: %s", req->uri) ;
 
-	// Take the semaphore to protect access to uartBuffer
-	xSemaphoreTakeRecursive (uartMutex, portMAX_DELAY) ;
-    gpio_set_level (LED_PIN, LED_ON) ;
-
-	// Get the request URI name
-    get_http_uri_name (req->uri, pMess->uriName) ;
-
     // Get the request body length
     size = req->content_len ;	// Length of the body
-    if (size >= lenMax - wifiHdrSize - wifiReqMsgCgiSize - 1)
+    if (size >= dataMessageMax - wifiReqMsgCgiSize)
     {
-        ESP_LOGE (TAG, "POST CGI URI too large: %d / %lu", size, lenMax - wifiHdrSize - wifiReqMsgCgiSize) ;
+        ESP_LOGE (TAG, "POST CGI URI too large: %d / %lu", size, dataMessageMax - wifiReqMsgCgiSize) ;
     	httpd_resp_send_err (req, HTTPD_400_BAD_REQUEST, "Body too large");
-        gpio_set_level (LED_PIN, LED_OFF) ;
-    	xSemaphoreGiveRecursive (uartMutex) ;
         return ESP_OK ;
     }
 
+	// The request has its own buffer: it doesn't wait for the other requests
+	pHdr = (wifiMsgHdr_t *) malloc (WBUF_SIZE) ;
+	if (pHdr == NULL)
+	{
+		httpd_resp_send_err (req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory") ;
+		return ESP_OK ;
+	}
+	pMess = (wifiReqMsgCgi_t *) pHdr->message ;
+    gpio_set_level (LED_PIN, LED_ON) ;
+
+	// Get the request URI name
+    get_http_uri_name (req->uri, pMess->uriName) ;
+
     // Get the body data, like: {"mid":"17","V1":"1"}
     nn = 0 ;
     while (nn != size)
     {
-		ret = httpd_req_recv (req, pMess->uri + nn, lenMax - wifiHdrSize - wifiReqMsgCgiSize - 1 - nn) ;
+		ret = httpd_req_recv (req, pMess->uri + nn, size - nn) ;
 		if (ret <= 0)	// 0 return value indicates connection closed
 		{
 			if (ret == HTTPD_SOCK_ERR_TIMEOUT)
@@ -351,7 +1031,7 @@ static	esp_err_t post_cgi_handler (httpd_req_t * req)
 				continue ;
 			}
 		    gpio_set_level (LED_PIN, LED_OFF) ;
-			xSemaphoreGiveRecursive (uartMutex) ;
+			free (pHdr) ;
 			return ESP_FAIL ; // Return ESP_FAIL to close underlying socket
 		}
 		nn += ret ;
@@ -426,17 +1106,32 @@ ESP_LOGI (TAG, "AP Reset PSWD '%s'", pMess->uri) ;
 		pMess->uriSize    = size ;
 		pMess->type       = WM_TYPE_POST ;
 
-		pHdr->magic      = WIFIMSG_MAGIC ;
 		pHdr->msgId      = WM_ID_CGI ;
-		pHdr->dataLength = wifiReqMsgCgiSize + pMess->uriSize ;
+		pHdr->dataLength = wifiReqMsgCgiSize + pMess->uriSize + 1 ;	// With the final 0
 
-		status = cgi_message_exchange (req, pHdr) ;
+		status = cgi_message_exchange (req, pHdr, WBUF_SIZE) ;
+		cgiFlush () ;		// AASun may be modified
     }
 	gpio_set_level (LED_PIN, LED_OFF) ;
-	xSemaphoreGiveRecursive (uartMutex) ;
+	free (pHdr) ;
 	return status ;
 }
 
+//----------------------------------------------------------------------
+// Statistics of the UART link with AASun, handled locally
+
+static	esp_err_t get_link_stat_handler (httpd_req_t * req)
+{
+	char		buffer [512] ;
+	uint32_t	len ;
+
+	len = wifiLinkStatJson (buffer, sizeof (buffer)) ;
+	httpd_resp_set_type (req, contentTypeJson) ;
+	httpd_resp_set_hdr  (req, "Cache-Control", "no-cache") ;
+	httpd_resp_send     (req, buffer, len) ;
+	return ESP_OK ;
+}
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 //	URI declaration, compatible with the function my_uri_match()
@@ -496,6 +1191,12 @@ static const httpd_uri_t uriList [] =
 		.method   = HTTP_GET,
 		.handler  = get_file_handler,
 		.user_ctx = NULL
+	},
+	{
+		.uri      = "/wifiLink",	// Statistics of the UART link with AASun
+		.method   = HTTP_GET,
+		.handler  = get_link_stat_handler,
+		.user_ctx = NULL
 	}
 } ;
 
@@ -561,104 +1262,6 @@ static	bool my_uri_match (const char * template, const char * uri, size_t len)
 }
 
 //----------------------------------------------------------------------
-//----------------------------------------------------------------------
-// Synchronize UART communication
-
-static	void		uartSynchronize (void)
-{
-	size_t			size ;
-	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) uartBuffer ;
-	uint32_t		tmoStartTime ;
-
-	uart_flush_input (UART_NUM) ;
-
-	tmoStartTime = xTaskGetTickCount () ;
-	while (1)
-	{
-    	uart_get_buffered_data_len (UART_NUM, & size) ;
-    	if (size >= wifiHdrSize)
-    	{
-    		uart_read_bytes (UART_NUM, pHdr, wifiHdrSize, 10 / portTICK_PERIOD_MS) ;
-    		if (pHdr->magic == WIFIMSG_MAGIC  &&  pHdr->msgId == WM_ID_SYNC)
-    		{
-    			// Synchronized
-    			break ;
-    		}
-    		uart_flush_input (UART_NUM) ;
-    	}
-    	if ((xTaskGetTickCount () - tmoStartTime) > SYNC_TMO)
-    	{
-    		// Time out: Reset RX buffer
-    		ESP_LOGI (TAG, "UART sync tmo, flush input") ;
-    		uart_flush_input (UART_NUM) ;
-    		tmoStartTime = xTaskGetTickCount () ;
-    	}
-    	vTaskDelay (2) ;
-	}
-
-	// Sync message received. Send the received SYNC message as acknowledge
-	uart_write_bytes (UART_NUM, pHdr, wifiHdrSize) ;
-
-	// Now ESP32/AAsun are synchronized, and AASun go passive mode and will no longer take the initiative to send a message
-	// Clean the reception buffer after being sure to have received the possible last message from AASun
-	vTaskDelay (100 / portTICK_PERIOD_MS) ;
-	uart_flush_input (UART_NUM) ;
-	ESP_LOGI (TAG, "UART sync done") ;
-}
-
-//----------------------------------------------------------------------
-//	The message to send is built in a buffer pointed to by pHdr
-//	The answer is returned in the same buffer
-//	Return true on success, else false (timeout)
-//  To call inside uartMutex protection (except on initialization)
-
-bool message_exchange (wifiMsgHdr_t * pHdr)
-{
-	size_t				size ;
-
-	// Send the message to AASun
-	uart_write_bytes (UART_NUM, pHdr, wifiHdrSize + pHdr->dataLength) ;
-
-	// Wait for response header
-// TODO Timeout
-	while (1)
-	{
-		uart_get_buffered_data_len (UART_NUM, & size) ;
-		if (size >= wifiHdrSize)
-		{
-			uart_read_bytes (UART_NUM, pHdr, wifiHdrSize, 10 / portTICK_PERIOD_MS) ;
-			break ;
-		}
-		vTaskDelay (2) ;
-	}
-
-    // Check response header
-    if (pHdr->magic != WIFIMSG_MAGIC)
-    {
-    	//  Badly formated message: communication not synchronized
-    	ESP_LOGE (TAG, "message_exchange error") ;
-		return false ;
-    }
-
-	// Get message data
-	if (pHdr->dataLength != 0)
-	{
-		while (1)
-		{
-			uart_get_buffered_data_len (UART_NUM, & size) ;
-			if (size >= pHdr->dataLength)
-			{
-				uart_read_bytes (UART_NUM, pHdr->message, pHdr->dataLength, 10 / portTICK_PERIOD_MS) ;
-				pHdr->message [pHdr->dataLength] = 0 ;
-				break ;
-			}
-			vTaskDelay (2) ;
-		}
-	}
-
-	return true ;
-}
-
 //----------------------------------------------------------------------
 // Initialize the UART to communicate with AAsun
 // Then get some configuration information
@@ -666,6 +1269,7 @@ bool message_exchange (wifiMsgHdr_t * pHdr)
 void	wifiUartInit (void)
 {
 	wifiMsgHdr_t		* pHdr ;
+	QueueHandle_t		uartQueue ;
 
 	const uart_config_t uart_config =
     {
@@ -676,23 +1280,22 @@ void	wifiUartInit (void)
         .flow_ctrl  = UART_HW_FLOWCTRL_DISABLE,
         .source_clk = UART_SCLK_DEFAULT,
     } ;
-    ESP_ERROR_CHECK(uart_driver_install (UART_NUM, UART_RX_BUF_SIZE, UART_TX_BUF_SIZE, 0, NULL, ESP_INTR_FLAG_IRAM)) ;
+    ESP_ERROR_CHECK(uart_driver_install (UART_NUM, UART_RX_BUF_SIZE, UART_TX_BUF_SIZE, UART_EVENT_QUEUE, & uartQueue, ESP_INTR_FLAG_IRAM)) ;
     ESP_ERROR_CHECK(uart_param_config   (UART_NUM, & uart_config)) ;
     ESP_ERROR_CHECK(uart_set_pin        (UART_NUM, UART_TX_PIN, UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE)) ;
 	vTaskDelay (2) ;
 	uart_flush_input (UART_NUM) ;	// Flush parasitic char received at UART initialization
+	xQueueReset (uartQueue) ;
 
 	uartMutex = xSemaphoreCreateRecursiveMutex () ;
+	liveMutex = xSemaphoreCreateMutex () ;
 
-	// Synchronize communication with AASun
-	xSemaphoreTakeRecursive (uartMutex, portMAX_DELAY) ;
-	uartSynchronize () ;
-	xSemaphoreGiveRecursive (uartMutex) ;
+	// Start the link with AASun, wait for the synchronization
+	wifiLinkInit (uartQueue) ;
 
 	// Get information about web page version and WIFI addresses
 	// Provides to AASun the WIFI application version and mode (STA or AP)
 	pHdr  = (wifiMsgHdr_t *) uartBuffer ;
-    pHdr->magic      = WIFIMSG_MAGIC ;
     pHdr->msgId      = WM_ID_GET_INFO ;
     pHdr->dataLength = wifiGetInfoMsgSize ;
     ((wifiGetInfoMsg_t *) pHdr->message)->version = VERSION ;
@@ -758,44 +1361,212 @@ bool	eraseMfs (void)
 }
 
 //----------------------------------------------------------------------
-// Update the web pages file system from AASun
+//	Display the MFS block cache statistics
 
-bool	web_page_update (const esp_partition_t	* pPartition)
+void	mfsCacheStat (void)
+{
+	uint32_t	hit, miss ;
+
+	mfsGetCacheStat (& mfsCtx, & hit, & miss) ;
+	printf ("MFS cache: %d blocks, hit %lu, miss %lu\n", MFS_CACHE_BLOCKS, hit, miss) ;
+	printf ("File cache: %lu/%d bytes, hit %lu, miss %lu, evict %lu\n",
+			fileCacheUsed, FILE_CACHE_SIZE, fileCacheHit, fileCacheMiss, fileCacheEvict) ;
+	cgiCacheStat () ;
+}
+
+//----------------------------------------------------------------------
+// Read a piece of the AASun file system to pHdr->message
+// pHdr is a buffer of wifiHdrSize + WIFI_FS_CHUNK bytes, AASun sends a piece in several frames
+
+static	bool	fsRead (wifiMsgHdr_t * pHdr, uint32_t offset, uint32_t size)
 {
-	wifiMsgHdr_t		* pHdr = (wifiMsgHdr_t *) uartBuffer ;
 	wifiPageMsg_t		* pMsg = (wifiPageMsg_t *) pHdr->message ;
-	uint32_t			size, offset ;
 
-	// Erase flash partition
-	size = (aaSunInfo.fsSize + (pPartition->erase_size - 1)) & ~(pPartition->erase_size - 1)  ; // round up the size to next 4k
-	ESP_LOGI (TAG, "Flash Erase %lu %lu", aaSunInfo.fsSize, size) ;
-	if (ESP_OK != esp_partition_erase_range (pPartition, 0, size))
+	pHdr->msgId      = WM_ID_GET_FS ;
+	pHdr->dataLength = wifiPageMsgSize ;
+	pMsg->offset     = offset ;
+	pMsg->size       = size ;
+	if (! wifiLinkExchange (pHdr, wifiHdrSize + WIFI_FS_CHUNK, WIFI_LINK_TMO)  ||
+		pHdr->msgId != WM_ID_FS  ||  pHdr->dataLength != size)
 	{
-		ESP_LOGE (TAG, "Flash Erase error") ;
+		ESP_LOGE (TAG, "GET FS error at %lu", offset) ;
+		return false ;
+	}
+	return true ;
+}
+
+//----------------------------------------------------------------------
+// Copy a range of the AASun file system to the local flash
+// offset is a multiple of the flash erase size
+
+static	bool	fsCopy (const esp_partition_t * pPartition, wifiMsgHdr_t * pHdr, uint32_t offset, uint32_t size)
+{
+	uint32_t	chunk ;
+
+	chunk = (size + (pPartition->erase_size - 1)) & ~(pPartition->erase_size - 1) ; // round up the size to next 4k
+	if (ESP_OK != esp_partition_erase_range (pPartition, offset, chunk))
+	{
+		ESP_LOGE (TAG, "Flash Erase error at %lu", offset) ;
 		return false ;
 	}
-	ESP_LOGI (TAG, "Flash Erase end") ;
 
-	size = (aaSunInfo.fsSize + (WIFIMSG_PAGE_CHUNK - 1)) & ~(WIFIMSG_PAGE_CHUNK - 1) ;
-	offset = 0 ;
 	while (size != 0)
 	{
-	    pHdr->magic      = WIFIMSG_MAGIC ;
-	    pHdr->msgId      = WM_ID_GET_FS ;
-	    pHdr->dataLength = wifiPageMsgSize ;
+		chunk = (size > WIFI_FS_CHUNK) ? WIFI_FS_CHUNK : size ;
+		if (! fsRead (pHdr, offset, chunk))
+		{
+			return false ;
+		}
+		esp_partition_write (pPartition, offset, pHdr->message, chunk) ;
+		ESP_LOGI (TAG, "PartWrite %lu %lu", size, offset) ;
 
-	    pMsg->offset = offset ;
-	    pMsg->size   = WIFIMSG_PAGE_CHUNK ;
-	    message_exchange (pHdr) ;
+		offset += chunk ;
+		size   -= chunk ;
+	}
+	return true ;
+}
 
-	    esp_partition_write (pPartition, offset, pMsg, WIFIMSG_PAGE_CHUNK) ;
-	    ESP_LOGI (TAG, "PartWrite %lu %lu", size, offset) ;
+//----------------------------------------------------------------------
+// Check the local copy of the file system: compute its CRC as mfsBuild does (zlib CRC32)
 
-		offset += WIFIMSG_PAGE_CHUNK ;
-		size   -= WIFIMSG_PAGE_CHUNK ;
+static	bool	fsCheck (const esp_partition_t * pPartition, wifiMsgHdr_t * pHdr, const mfsSuperBloc_t * pSuper)
+{
+	uint32_t	offset = pSuper->blockSize ;
+	uint32_t	crc = 0 ;
+	uint32_t	chunk ;
+
+	while (offset < pSuper->fsSize)
+	{
+		chunk = pSuper->fsSize - offset ;
+		chunk = (chunk > WIFI_FS_CHUNK) ? WIFI_FS_CHUNK : chunk ;
+		if (ESP_OK != esp_partition_read (pPartition, offset, pHdr->message, chunk))
+		{
+			return false ;
+		}
+		crc = esp_rom_crc32_le (crc, pHdr->message, chunk) ;
+		offset += chunk ;
 	}
+	return crc == pSuper->fsCRC ;
+}
 
-	return true ;
+//----------------------------------------------------------------------
+// Incremental update: the CRC table of the AASun file system is compared with the one of the
+// local copy, and only the modified blocks are copied. The blocks of the CRC table itself are
+// always copied, then the super block, so an interrupted update is resumed at the next start.
+// Returns false if the incremental update is not possible: then a full copy is needed
+
+static	bool	web_page_delta (const esp_partition_t * pPartition, wifiMsgHdr_t * pHdr)
+{
+	mfsSuperBloc_t		remote, local ;
+	uint32_t			* pTable ;
+	uint32_t			count, localCount, crcBlockSize ;
+	uint32_t			ii, first, copied = 0 ;
+	bool				bOk = true ;
+
+	// The super blocks of AASun and of the local copy
+	if (! fsRead (pHdr, 0, sizeof (mfsSuperBloc_t)))
+	{
+		return false ;
+	}
+	remote = * (mfsSuperBloc_t *) pHdr->message ;
+	if (ESP_OK != esp_partition_read (pPartition, 0, & local, sizeof (mfsSuperBloc_t)))
+	{
+		return false ;
+	}
+
+	crcBlockSize = remote.crcBlockSize ;
+	if (remote.magic != MFS_SB_MAGIC  ||  remote.crcTable == 0  ||  remote.fsSize != aaSunInfo.fsSize  ||
+		local.magic  != MFS_SB_MAGIC  ||  local.crcTable  == 0  ||  local.crcBlockSize != crcBlockSize  ||
+		crcBlockSize == 0  ||  (crcBlockSize % pPartition->erase_size) != 0  ||
+		remote.fsSize > pPartition->size  ||  local.fsSize > pPartition->size)
+	{
+		ESP_LOGI (TAG, "No CRC table") ;
+		return false ;
+	}
+
+	// The CRC tables: AASun one then the local one
+	count      = remote.crcTable / crcBlockSize ;
+	localCount = local.crcTable  / crcBlockSize ;
+	localCount = (localCount > count) ? count : localCount ;
+	if (count * sizeof (uint32_t) > WIFI_FS_CHUNK  ||  ! fsRead (pHdr, remote.crcTable, count * sizeof (uint32_t)))
+	{
+		return false ;
+	}
+	pTable = (uint32_t *) malloc (2 * count * sizeof (uint32_t)) ;
+	if (pTable == NULL)
+	{
+		return false ;
+	}
+	memcpy (pTable, pHdr->message, count * sizeof (uint32_t)) ;
+	if (ESP_OK != esp_partition_read (pPartition, local.crcTable, & pTable [count], localCount * sizeof (uint32_t)))
+	{
+		free (pTable) ;
+		return false ;
+	}
+
+	// Copy the runs of modified blocks. The 1st block holds the super block: copied at the end
+	ii = 1 ;
+	while (bOk  &&  ii < count)
+	{
+		if (ii < localCount  &&  pTable [ii] == pTable [count + ii])
+		{
+			ii++ ;
+			continue ;
+		}
+		first = ii ;
+		while (ii < count  &&  (ii >= localCount  ||  pTable [ii] != pTable [count + ii])  &&
+				(ii - first) * crcBlockSize < WIFI_FS_CHUNK)
+		{
+			ii++ ;
+		}
+		bOk = fsCopy (pPartition, pHdr, first * crcBlockSize, (ii - first) * crcBlockSize) ;
+		copied += ii - first ;
+	}
+	free (pTable) ;
+	ESP_LOGI (TAG, "Blocks updated: %lu / %lu", copied, count) ;
+
+	// The CRC table and the super block
+	if (bOk)
+	{
+		bOk = fsCopy (pPartition, pHdr, remote.crcTable, remote.fsSize - remote.crcTable)  &&
+			  fsCopy (pPartition, pHdr, 0, crcBlockSize) ;
+	}
+
+	// The local copy must be exactly the AASun file system
+	if (bOk  &&  ! fsCheck (pPartition, pHdr, & remote))
+	{
+		ESP_LOGE (TAG, "Incremental update CRC error") ;
+		bOk = false ;
+	}
+	return bOk ;
+}
+
+//----------------------------------------------------------------------
+// Update the web pages file system from AASun
+// Only the modified blocks are copied if the file systems have a CRC table, else all the file system
+
+bool	web_page_update (const esp_partition_t	* pPartition)
+{
+	wifiMsgHdr_t		* pHdr ;
+	bool				bOk ;
+
+	// The file system is read by pieces of WIFI_FS_CHUNK bytes
+	pHdr = (wifiMsgHdr_t *) malloc (wifiHdrSize + WIFI_FS_CHUNK) ;
+	if (pHdr == NULL)
+	{
+		ESP_LOGE (TAG, "GET FS no memory") ;
+		return false ;
+	}
+
+	bOk = web_page_delta (pPartition, pHdr) ;
+	if (! bOk)
+	{
+		ESP_LOGI (TAG, "Full update %lu", aaSunInfo.fsSize) ;
+		bOk = fsCopy (pPartition, pHdr, 0, aaSunInfo.fsSize) ;
+	}
+
+	free (pHdr) ;
+	return bOk ;
 }
 
 //----------------------------------------------------------------------
@@ -820,8 +1591,7 @@ httpd_handle_t setup_server (void)
 	const esp_partition_t	* pPartition ;
 	mfsError_t				mfsErr ;
 
-	// Force UART synchronization: Initializations take a long time, and synchronization can be lost
-	uartSynchronize () ;
+	// Initializations take a long time: if AASun loses the synchronization, the wifiLink.c reader task answers its SYNC
 
 	// Find HTTP data SPI partition and initialize the MFS context
 
@@ -890,6 +1660,7 @@ httpd_handle_t setup_server (void)
 //		config.uri_match_fn      = httpd_uri_match_wildcard ;	// Use the URI wildcard matching function
 		config.uri_match_fn      = my_uri_match ;	// Use this URI wildcard matching function
 		config.close_fn          = close_fd_cb ;
+		cgiInit () ;			// The workers of the GET CGI requests
 
 		if (httpd_start (& server, & config) == ESP_OK)
 		{
@@ -928,9 +1699,10 @@ void			telnetOn		(bool bTelnetOn)
 void	wifiRequest (void)
 {
 	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) uartBuffer ;
+	uint32_t		credit ;
 
 	// Time out elapsed ?
-	if ((xTaskGetTickCount () - requestStartTime) < requestTimeout)
+	if ((xTaskGetTickCount () - requestStartTime) < (bRequestSoon ? REQUEST_TMO_TELNET : requestTimeout))
 	{
 		return ;	// No
 	}
@@ -957,9 +1729,14 @@ void	wifiRequest (void)
 	}
 	requestCounter++ ;
 
-    pHdr->magic      = WIFIMSG_MAGIC ;
+	// The telnet data of the answer: less while the CGI requests are waiting for AASun
+	credit = (wifiLinkInFlight () != 0) ? WIFI_TELNET_CREDIT_BUSY : dataMessageMax ;
+	bRequestSoon = false ;
+
     pHdr->msgId      = WM_ID_REQ ;
-    pHdr->dataLength = 0 ;
+    pHdr->dataLength = wifiReqMsgSize ;
+    ((wifiReqMsg_t *) pHdr->message)->flags        = wifiLiveWanted () ? WM_REQ_LIVE : 0 ;
+    ((wifiReqMsg_t *) pHdr->message)->telnetCredit = credit ;
     if (! message_exchange (pHdr))
 	{
     	xSemaphoreGiveRecursive (uartMutex) ;
@@ -975,6 +1752,8 @@ void	wifiRequest (void)
 
 		case WM_ID_TELNET:
 			// Some data to transmit to telnet client
+			// The credit is used: AASun has probably more data, ask again soon
+			bRequestSoon = pHdr->dataLength >= credit ;
 			telnetSend ((char *) pHdr->message, pHdr->dataLength) ;
 			break ;
 
@@ -992,19 +1771,12 @@ char      strftime_buf[64] ;
 strftime (strftime_buf, sizeof (strftime_buf), "%c", (struct tm *) pHdr->message) ;
 ESP_LOGI (TAG, "The current date/time is: %s", strftime_buf) ;
 */
-				pHdr->magic      = WIFIMSG_MAGIC ;
 				pHdr->msgId      = WM_ID_REQ_DATE ;
 				pHdr->dataLength = sizeof (struct tm) ;
 				message_exchange (pHdr) ;
 			}
 			break ;
 
-		case WM_ID_SYNC:
-			// Communication is not synchronized any more, then AASUn send WM_ID_SYNC messages
-ESP_LOGI (TAG, "WM_ID_SYNC") ;
-			uartSynchronize () ;
-			break ;
-
 		default:
 			ESP_LOGE (TAG, "Unknown request: %d", pHdr->msgId) ;
 			break ;
@@ -9,6 +9,7 @@
 
 	When		Who	What
 	20/03/24	ac	Creation
+	18/10/26	ac	Command link: UART link statistics
 
 	ESP32 Web Server with ESP-IDF
 	https://esp32tutorials.com/esp32-web-server-esp-idf/
@@ -1055,6 +1056,7 @@ ESP_LOGI (TAG, "wifiErasePSWDAp") ;
 static	char	cmdBuffer [128] ;
 
 bool	eraseMfs (void) ;	// For test
+void	mfsCacheStat (void) ;
 
 // Background loop
 
@@ -1187,6 +1189,8 @@ void app_main()
 			printf ("w?           Display WIFI credential\n") ;
 			printf ("sntp         Get SNTP date\n") ;
 			printf ("emfs         Erase 1st sector of MFS (test)\n") ;
+			printf ("mfs          Display MFS, file and CGI cache statistics\n") ;
+			printf ("link         Display UART link statistics\n") ;
 			printf ("dis          Disconnect WIFI station (test)\n") ;
 		}
 
@@ -1252,6 +1256,16 @@ void app_main()
 			eraseMfs () ;
 		}
 
+		else if (0 == strcmp ("mfs", pCmd))		// MFS cache statistics
+		{
+			mfsCacheStat () ;
+		}
+
+		else if (0 == strcmp ("link", pCmd))	// UART link statistics
+		{
+			wifiLinkStat () ;
+		}
+
 		else if (0 == strcmp ("in", pCmd))		// Get required WIFI mode
 		{
 			int level = gpio_get_level (WIFIMODE_PIN) ;
@@ -7,6 +7,11 @@
 
 	When		Who	What
 	05/22/23	ac	Creation
+	10/18/26	ac	Add LRU block cache in front of the low level driver read
+	10/18/26	ac	Add MFS_GZIP file flag and mfsGetFileTag()
+	10/18/26	ac	Add the block CRC table to the super block
+	10/18/26	ac	Add the path hash table to the super block (MFS_FS_VERSION2)
+	10/18/26	ac	Add mfsDataAddress()
 
 ----------------------------------------------------------------------
 */
@@ -21,12 +26,23 @@
 //--------------------------------------------------------------------------------
 
 #define	MFS_FS_VERSION		((1 << 16) | 0)
-#define	MFS_SOFT_VERSION	((1 << 16) | 1)
+#define	MFS_FS_VERSION2		((2 << 16) | 0)		// With the path hash table
+#define	MFS_SOFT_VERSION	((1 << 16) | 4)
 #define	MFS_SB_MAGIC		(('5' << 24) | ('F' << 16) | ('A' << 8) | 'A')
 
 #define	MFS_ENTRY_SIZE_MAX		96		// With 512 B block, allows min 5 files per directory block, max name length 88
 #define	MFS_NAME_MAX			(MFS_ENTRY_SIZE_MAX	- sizeof (mfsEntryHdr_t))
 
+//--------------------------------------------------------------------------------
+//	Block cache in front of the low level driver read
+//	MFS_CACHE_BLOCKS can be defined by the project to adapt the cache to the RAM budget
+//	The cache uses MFS_CACHE_BLOCKS * MFS_CACHE_BLOCK_SIZE bytes in mfsCtx_t, 0 disables the cache
+
+#if (! defined MFS_CACHE_BLOCKS)
+#define	MFS_CACHE_BLOCKS		4		// Count of blocks in the cache
+#endif
+#define	MFS_CACHE_BLOCK_SIZE	512		// Power of 2, the cache is not used if the file system block size is lower
+
 //--------------------------------------------------------------------------------
 //	Header of an entry in a directory: dir entry or file entry
 //	An entry consists of this header followed by the name
@@ -58,6 +74,9 @@ typedef struct mfsDirHdr_s
 //	The super bloc on the disk,
 //  Block 0 is the super block
 //	Block 1 is the root directory
+//	The optional block CRC table is at the end of the image, from crcTable up to fsSize:
+//	the CRC32 of each crcBlockSize bytes of the image before crcTable (see mfsBuild)
+//	The optional path hash table (MFS_FS_VERSION2) is before the CRC table
 
 typedef struct mfsSuperBloc_s
 {
@@ -67,12 +86,34 @@ typedef struct mfsSuperBloc_s
 	uint32_t		blockPower2 ;	// (1 << blockPower2) is blockSize
 	uint32_t		fsCRC ;			// CRC of this file system
 	uint32_t		fsSize ;		// Size of this file system
-	uint32_t		reserve1 ;
-	uint32_t		reserve2 ;
+	uint32_t		crcTable ;		// Offset of the block CRC table, 0 if none
+	uint32_t		crcBlockSize ;	// Size of the blocks described by the CRC table
+	uint32_t		hashTable ;		// Offset of the path hash table, 0 if none
+	uint32_t		hashCount ;		// Count of blocks of the path hash table, power of 2
 	char			text [0] ;
 
 } mfsSuperBloc_t ;
 
+//--------------------------------------------------------------------------------
+//	The path hash table: hashCount consecutive blocks, the buckets.
+//	A bucket is a directory block whose entry names are full paths without the leading '/',
+//	E.G.: "css/index.css". So the full path of an entry is limited to MFS_NAME_MAX.
+//	The bucket of a path is: mfsHashPath (path) & (hashCount - 1)
+//	The buckets are at most half full, a bucket may have next blocks after the table.
+
+// FNV-1a hash of a path without the leading '/', used by mfsBuild and mfs
+static inline uint32_t	mfsHashPath (const char * path)
+{
+	uint32_t	hash = 2166136261u ;
+
+	while (* path != 0)
+	{
+		hash ^= (uint8_t) * path++ ;
+		hash *= 16777619u ;
+	}
+	return hash ;
+}
+
 //--------------------------------------------------------------------------------
 // API structures
 //--------------------------------------------------------------------------------
@@ -91,10 +132,22 @@ typedef enum
 {
 	MFS_NOTFILE		= 0,	// Not a file, or free
 	MFS_DIR			= 1,
-	MFS_FILE		= 2
+	MFS_FILE		= 2,
+	MFS_GZIP		= 0x80	// File flag: the data is gzip compressed (see mfsBuild -z)
 
 } fileType_t ;
 
+//--------------------------------------------------------------------------------
+//	A block of the cache
+
+typedef struct mfsCacheBlock_s
+{
+	uint32_t		address ;		// Address of the block on the disk, MFS_CACHE_INVALID if unused
+	uint32_t		lastUse ;		// Value of cacheUse at the last access of this block (LRU)
+	uint8_t			data [MFS_CACHE_BLOCK_SIZE] ;
+
+} mfsCacheBlock_t ;
+
 //--------------------------------------------------------------------------------
 // This structure is to be filled in by the user before passing it to mfsMount()
 // If not used lock and unlock must be NULL
@@ -116,6 +169,17 @@ typedef struct mfsCtx_s
 	uint32_t		blockPower2 ;	// (1 << blockPower2) is blockSize
 	uint32_t		fsCRC ;			// CRC of the file system (excluding super bloc)
 	uint32_t		fsSize ;		// Size of this file system
+	uint32_t		hashTable ;		// Address of the path hash table, 0 to search the directories
+	uint32_t		hashCount ;		// Count of slots in the path hash table
+
+	// Block cache
+	uint32_t		cacheOn ;		// 0 if the cache is not usable with this file system
+	uint32_t		cacheUse ;		// Incremented at each cache access, to find the least recently used block
+	uint32_t		cacheHit ;		// Statistics
+	uint32_t		cacheMiss ;
+#if (MFS_CACHE_BLOCKS != 0)
+	mfsCacheBlock_t	cache [MFS_CACHE_BLOCKS] ;
+#endif
 
 } mfsCtx_t ;
 
@@ -191,6 +255,7 @@ mfsError_t		mfsClose		(mfsFile_t * pFile) ;
 mfsError_t		mfsRead			(mfsFile_t * pFile, void * pBuffer, int32_t size) ;
 mfsError_t		mfsSeek			(mfsFile_t * pFile, int32_t offset, mfsWhenceFlag_t whence) ;
 int32_t			mfsSize			(mfsFile_t * pFile) ;
+mfsError_t		mfsDataAddress	(mfsFile_t * pFile, int32_t offset, int32_t size, uint32_t * pAddress) ;
 void			mfsRewind		(mfsFile_t * pFile) ;
 
 mfsError_t		mfsDirOpen		(mfsCtx_t * pCtx, const char * path, mfsDir_t * pDir) ;
@@ -202,6 +267,25 @@ static inline void mfsGetCrc (mfsCtx_t * pCtx, uint32_t * pCRC, uint32_t * pSize
 	* pSize = pCtx->fsSize ;
 }
 
+static inline int mfsIsGzip (mfsFile_t * pFile)
+{
+	return (pFile->flags & MFS_GZIP) != 0 ;
+}
+
+// The file tag changes when the file content may have changed (HTTP ETag):
+// the CRC of the file system and the address of the file data
+static inline void mfsGetFileTag (mfsFile_t * pFile, uint32_t * pCRC, uint32_t * pAddress)
+{
+	* pCRC     = pFile->pCtx->fsCRC ;
+	* pAddress = pFile->dataAddress ;
+}
+
+static inline void mfsGetCacheStat (mfsCtx_t * pCtx, uint32_t * pHit, uint32_t * pMiss)
+{
+	* pHit  = pCtx->cacheHit ;
+	* pMiss = pCtx->cacheMiss ;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,12 +9,15 @@
 
 	When		Who	What
 	09/04/24	ac	Creation
+	18/10/26	ac	Telnet data are sent from the Telnet buffer without uartMutex
+	18/10/26	ac	Coalescing of the data sent to AASun, credit given by AASun
 
 ----------------------------------------------------------------------
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -78,6 +81,13 @@ static	int						clientSock ;
 static	char					data [WBUF_SIZE] ;
 static	char *					dataMessage = & data [wifiHdrSize] ;
 
+// The received data is coalesced before being sent to AASun (see wifiMsg.h)
+#define	TELNET_COALESCE_TMO		(WIFI_TELNET_COALESCE_TMO / portTICK_PERIOD_MS)
+static	char					pending [WBUF_SIZE] ;
+static	uint32_t				pendingCount ;		// Count of bytes in pending
+static	TickType_t				telnetSentTime ;	// Time of the last WM_ID_TELNET sent
+static	uint32_t				telnetCredit ;		// Max size of the next data sent to AASun
+
 //-----------------------------------------------------------------------------
 // Returns the string representation of IP address
 
@@ -193,7 +203,6 @@ uint32_t		telnetSendEvent	(uint32_t id)
 
 	xSemaphoreTakeRecursive (uartMutex, portMAX_DELAY) ;
 
-    pHdr->magic      = WIFIMSG_MAGIC ;
     pHdr->msgId      = id ;
     pHdr->dataLength = 0 ;
     if (! message_exchange (pHdr))
@@ -263,6 +272,46 @@ static	uint32_t	telnetConvertReceive (char * pData, uint32_t length)
 	return count ;
 }
 
+//-----------------------------------------------------------------------------
+// Send the pending data to AASun
+// During a burst the small data is held, and AASun doesn't receive more than its credit
+
+static	void	telnetFlush (void)
+{
+	wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) data ;
+	TickType_t		now = xTaskGetTickCount () ;
+	uint32_t		size ;
+
+	if (pendingCount == 0)
+	{
+		return ;
+	}
+	size = (pendingCount < telnetCredit) ? pendingCount : telnetCredit ;
+	if ((now - telnetSentTime) < TELNET_COALESCE_TMO  &&  (size == 0  ||  pendingCount < WIFI_TELNET_COALESCE_MIN))
+	{
+		return ;
+	}
+
+	// If the credit is 0 this empty message only gets a new credit
+	memcpy (dataMessage, pending, size) ;
+	pHdr->msgId      = WM_ID_TELNET ;
+	pHdr->dataLength = size ;
+	telnetSentTime   = now ;
+	if (! message_exchange (pHdr))
+	{
+		// No response from AASun: release the Telnet socket
+		shutdown (clientSock, SHUT_RDWR) ;
+		close (clientSock) ;
+		telnetState = TS_LISTEN ;
+		return ;
+	}
+	telnetCredit = (pHdr->msgId == WM_ID_ACK  &&  pHdr->dataLength >= wifiTelnetAckMsgSize) ?
+						((wifiTelnetAckMsg_t *) pHdr->message)->credit : dataMessageMax ;
+
+	pendingCount -= size ;
+	memmove (pending, pending + size, pendingCount) ;
+}
+
 //-----------------------------------------------------------------------------
 //	The Telnet state machine
 
@@ -354,7 +403,9 @@ void	telnetNext (void)
    		    		if (telnetSendEvent (WM_ID_TELNET_START))
    		    		{
    		    			// Accepted by AASun
-   		    			telnetState = TS_RUNNING ;
+   		    			telnetState  = TS_RUNNING ;
+   		    			pendingCount = 0 ;
+   		    			telnetCredit = dataMessageMax ;
    		    		}
    		    		else
    		    		{
@@ -370,11 +421,15 @@ void	telnetNext (void)
 
 		case	TS_RUNNING:
 	   		{
-	   			// Try to receive. recv returns:
+	   			// Try to receive, if there is room in the pending buffer. recv returns:
 	   			// -1 : nothing to read and should check errno
 	   			// >0 : data available
 	   			//  0 : ?
-	   		    int len = recv (clientSock, dataMessage, dataMessageMax, 0) ;
+	   		    int len = 0 ;
+	   		    if (pendingCount < dataMessageMax)
+	   		    {
+	   		    	len = recv (clientSock, pending + pendingCount, dataMessageMax - pendingCount, 0) ;
+	   		    }
 	   		    if (len < 0)
 	   		    {
 	   		        if (errno == EINPROGRESS || errno == EAGAIN || errno == EWOULDBLOCK)
@@ -396,32 +451,17 @@ void	telnetNext (void)
 						shutdown (clientSock, SHUT_RDWR) ;
 						close (clientSock) ;
 	                	telnetState = TS_LISTEN ;
+	                	break ;
 	   		        }
 	   		    }
 	   		    else if (len > 0)
 	   		    {
-	   		    	// Something received
-	   		    	len = telnetConvertReceive (dataMessage, len) ;	// Remove Telnet protocol data
-	   		    	if (len != 0)
-	   		    	{
-						// Send the data to AASun
-						wifiMsgHdr_t	* pHdr = (wifiMsgHdr_t *) data ;
-
-						xSemaphoreTakeRecursive (uartMutex, portMAX_DELAY) ;
-
-						pHdr->magic      = WIFIMSG_MAGIC ;
-						pHdr->msgId      = WM_ID_TELNET ;
-						pHdr->dataLength = len ;
-						if (! message_exchange (pHdr))
-						{
-							// UART synchronization error: release the Telnet socket
-							shutdown (clientSock, SHUT_RDWR) ;
-							close (clientSock) ;
-							telnetState = TS_LISTEN ;
-						}
-						xSemaphoreGiveRecursive (uartMutex) ;
-	   		    	}
+	   		    	// Something received: remove Telnet protocol data
+	   		    	pendingCount += telnetConvertReceive (pending + pendingCount, len) ;
 	   		    }
+
+	   		    // Send the data to AASun
+	   		    telnetFlush () ;
 	   		}
 	   		break ;
 	}
@@ -0,0 +1,749 @@
+/*
+----------------------------------------------------------------------
+
+	Energy monitor and diverter: WIFI interface
+
+	Alain Chebrou
+
+	wifiLink.c	UART link with AASun: requests with ID, several requests in flight
+
+	When		Who	What
+	18/10/26	ac	Creation
+	18/10/26	ac	Reader driven by the UART event queue, waiters use task notifications, statistics
+	18/10/26	ac	WM_ID_LIVE messages given to the live values mirror
+	18/10/26	ac	Baud rate negotiation after each synchronization, reassembly of the fragmented responses
+	18/10/26	ac	wifiLinkInFlight() for the telnet credit
+	18/10/26	ac	A fragmented response fails if a fragment is missing or the total size doesn't match
+
+----------------------------------------------------------------------
+
+	Each request sent to AASun has a request ID, which AASun copies to the response
+	(see wifiMsg.h). The tasks which send a request (HTTP CGI, Telnet, polling of AASun
+	requests) only wait for their own response: a slow request doesn't block the others.
+
+	The reader task is woken by the events of the UART driver: it parses the frames as the
+	bytes arrive, checks their CRC, then copies each response to the buffer of the task
+	waiting for this request ID and notifies this task. A corrupted frame is skipped:
+	its request fails at its timeout, or at once if AASun answers WM_ID_ERROR_CRC.
+	The reader task also answers the WM_ID_SYNC messages of AASun, and gives the WM_ID_LIVE
+	messages to the live values mirror (see http.c).
+
+	The counters of the link are available on the URI /wifiLink and the console command "link".
+
+	AASun handles the frames in place in its RX circular buffer, so the frames are sent only
+	while the sum of their sizes, since the last time no request was in flight, fits in WBUF_SIZE.
+
+	A large response arrives in several frames (WM_ID_PART), their data is appended in the
+	buffer of the request. The timeout of the request restarts at each fragment.
+	The trailer of each fragment gives its offset, which must be the size already received,
+	and the last frame gives the total size: a lost fragment fails the request at once.
+
+	After each synchronization the baud task proposes the rates of linkBauds to AASun, from the
+	highest, and keeps the first one which passes the test (see wifiMsg.h). Meanwhile the other
+	requests wait. After LINK_BAUD_LOST consecutive timeouts the link returns to WIFIMSG_BBR:
+	AASun will synchronize again.
+
+----------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "global.h"
+
+//----------------------------------------------------------------------
+
+static const	char 			* TAG = "link" ; // TAG for debug
+
+#define	LINK_TASK_STACK		3072
+#define	LINK_TASK_PRIORITY	6							// Above the HTTP server and the main task
+#define	LINK_BYTE_TMO		(20 / portTICK_PERIOD_MS)	// Max silence inside a frame
+#define	LINK_READ_SIZE		256							// Bytes read from the UART driver at once
+#define	SYNC_TMO			(1500 / portTICK_PERIOD_MS)
+#define	LINK_BAUD_TEST		1024						// Size of the test pattern sent at a new baud rate
+#define	LINK_BAUD_TMO		(300 / portTICK_PERIOD_MS)	// Max wait for the echo of the test pattern
+#define	LINK_BAUD_LOST		2							// Consecutive timeouts to return to WIFIMSG_BBR
+
+// The baud rates to try, from the highest. The dividers of the AASun and ESP32 UART clocks are exact
+static	const uint32_t		linkBauds [] = { WIFIMSG_BBR_MAX, 1000000, 500000 } ;
+
+// The states of a request slot
+#define	LINK_FREE			0
+#define	LINK_PENDING		1		// Sent, waiting for the response
+#define	LINK_DONE			2		// The response is in the buffer of the request
+#define	LINK_ERROR			3		// Aborted by a synchronization
+
+typedef struct
+{
+	uint32_t			state ;
+	uint16_t			reqId ;
+	wifiMsgHdr_t		* pHdr ;		// The request, then the response
+	uint32_t			bufSize ;		// Size of the buffer pointed to by pHdr
+	TaskHandle_t		task ;			// Notified by the reader task when the state is no longer LINK_PENDING
+	int64_t				sendTime ;		// For the latency statistics, us
+	TickType_t			partTime ;		// Time of the send, then of the last fragment received
+	uint32_t			length ;		// Count of data bytes of the response received
+
+} linkSlot_t ;
+
+// The statistics of the link
+typedef struct
+{
+	uint32_t	requests ;			// Requests sent
+	uint32_t	responses ;			// Responses given to their request
+	uint32_t	timeouts ;			// Requests without response
+	uint32_t	noRoom ;			// Requests not sent: no free slot or no room in AASun buffer
+	uint32_t	aborted ;			// Requests aborted by a synchronization
+	uint32_t	aasunCrcErrors ;	// WM_ID_ERROR_CRC responses: AASun received a corrupted request
+	uint32_t	crcErrors ;			// Frames received with a bad CRC
+	uint32_t	badFrames ;			// Frames received with a bad length, or incomplete
+	uint32_t	orphans ;			// Responses received after the timeout of their request
+	uint32_t	syncs ;				// Synchronizations requested by AASun
+	uint32_t	lives ;				// Live values received
+	uint32_t	parts ;				// Fragments of responses received
+	uint32_t	partErrors ;		// Fragmented responses failed: missing fragment or bad total size
+	uint32_t	baudFallbacks ;		// Returns to WIFIMSG_BBR after request timeouts
+	uint32_t	overflows ;			// UART RX FIFO or RX buffer full: bytes lost
+	uint32_t	uartErrors ;		// UART frame or parity errors
+	uint32_t	latencyMax ;		// Max time between the send of a request and its response, us
+	uint64_t	latencySum ;		// For the average latency, us
+
+} linkStat_t ;
+
+static	linkSlot_t			linkSlots [WIFIMSG_INFLIGHT_MAX] ;
+static	SemaphoreHandle_t	linkMutex ;			// Protects the slots, the counters below and the UART TX
+static	SemaphoreHandle_t	linkSyncSem ;		// Given at each synchronization
+static	SemaphoreHandle_t	linkRoomSem ;		// Given when a request ends: a slot and some room may be free
+static	uint32_t			linkInFlight ;		// Count of requests sent and not answered
+static	uint32_t			linkTxPos ;			// Bytes sent since the AASun RX buffer was empty
+static	uint16_t			linkReqId ;			// The last request ID used
+static	linkStat_t			linkStat ;
+static	uint32_t			linkBaud = WIFIMSG_BBR ;	// The current baud rate
+static	bool				linkNegotiating ;	// Only the baud task sends requests
+static	uint32_t			linkTimeoutCount ;	// Consecutive request timeouts
+static	SemaphoreHandle_t	linkReadySem ;		// Given at the end of each baud rate negotiation
+static	uint32_t			linkBaudBuffer [WBUF_SIZE / sizeof (uint32_t)] ;	// The messages of the baud task
+
+static	QueueHandle_t		linkUartQueue ;		// The events of the UART driver
+static	uint32_t			rxFrame [WBUF_SIZE / sizeof (uint32_t)] ;	// The frame received by the reader task
+static	uint32_t			rxCount ;			// Count of bytes in rxFrame
+static	uint32_t			rxFrameSize ;		// Size of the frame in rxFrame, when its header is received
+
+//----------------------------------------------------------------------
+//	A request is answered, aborted or timed out
+//	To call inside linkMutex protection
+
+static	void	linkRequestEnd (void)
+{
+	linkInFlight-- ;
+	if (linkInFlight == 0)
+	{
+		// Every request is answered, so AASun has read all the frames: its RX buffer is empty
+		linkTxPos = 0 ;
+	}
+	xSemaphoreGive (linkRoomSem) ;
+}
+
+//----------------------------------------------------------------------
+
+static	void	linkSetBaud (uint32_t baud)
+{
+	uart_set_baudrate (UART_NUM, baud) ;
+	linkBaud = baud ;
+}
+
+//----------------------------------------------------------------------
+//	Answer the SYNC message of AASun: echo the message
+//	The requests in flight are lost by AASun, they fail now
+
+static	void	linkSync (wifiMsgHdr_t * pHdr)
+{
+	uint32_t	ii ;
+
+	xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+	uart_write_bytes (UART_NUM, pHdr, WIFIMSG_FRAME_SIZE (pHdr->dataLength)) ;
+
+	for (ii = 0 ; ii < WIFIMSG_INFLIGHT_MAX ; ii++)
+	{
+		if (linkSlots [ii].state == LINK_PENDING)
+		{
+			linkSlots [ii].state = LINK_ERROR ;
+			xTaskNotifyGive (linkSlots [ii].task) ;
+			linkStat.aborted++ ;
+		}
+	}
+	linkInFlight     = 0 ;
+	linkTxPos        = WIFIMSG_FRAME_SIZE (pHdr->dataLength) ;	// The echo is in the AASun RX buffer
+	linkTimeoutCount = 0 ;
+	linkStat.syncs++ ;
+	xSemaphoreGive (linkMutex) ;
+	xSemaphoreGive (linkRoomSem) ;
+
+	xSemaphoreGive (linkSyncSem) ;
+	ESP_LOGI (TAG, "UART sync done") ;
+}
+
+//----------------------------------------------------------------------
+//	Give a response, or a fragment of a response, to the task waiting for it
+
+static	void	linkDispatch (wifiMsgHdr_t * pHdr)
+{
+	linkSlot_t		* pSlot ;
+	wifiPartMsg_t	part ;
+	uint32_t		dataLength ;
+	uint32_t		size ;
+	uint32_t		latency ;
+	uint32_t		ii ;
+	bool			bPart = pHdr->msgId == WM_ID_PART  ||  (pHdr->msgId & WM_ID_FRAGMENTED) != 0 ;
+	bool			bInOrder ;
+
+	xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+	for (ii = 0 ; ii < WIFIMSG_INFLIGHT_MAX ; ii++)
+	{
+		pSlot = & linkSlots [ii] ;
+		if (pSlot->state == LINK_PENDING  &&  pSlot->reqId == pHdr->reqId)
+		{
+			// A frame not fragmented is the whole response
+			dataLength = pHdr->dataLength ;
+			memset (& part, 0, sizeof (part)) ;
+			bInOrder   = pSlot->length == 0 ;
+			if (bPart)
+			{
+				// The data of a fragment ends with its trailer: its offset is the size already received,
+				// and the last frame gives the total size
+				bInOrder = false ;
+				if (dataLength >= wifiPartMsgSize)
+				{
+					dataLength -= wifiPartMsgSize ;
+					memcpy (& part, pHdr->message + dataLength, wifiPartMsgSize) ;
+					bInOrder = part.offset == pSlot->length  &&
+							   (pHdr->msgId == WM_ID_PART  ||  part.total == pSlot->length + dataLength) ;
+				}
+			}
+
+			size = wifiHdrSize + pSlot->length + dataLength ;
+			if (size > pSlot->bufSize  ||  size > wifiHdrSize + WIFIMSG_MSG_MAX)
+			{
+				// Doesn't fit in the buffer of the request
+				ESP_LOGE (TAG, "Response too large: %lu / %lu", size, pSlot->bufSize) ;
+				pSlot->state = LINK_ERROR ;
+			}
+			else if (! bInOrder)
+			{
+				// A fragment is missing, or the total size is wrong
+				ESP_LOGE (TAG, "Fragment error, ID %u: offset %lu / %lu, total %lu", pHdr->msgId, part.offset, pSlot->length, part.total) ;
+				linkStat.partErrors++ ;
+				pSlot->state = LINK_ERROR ;
+			}
+			else
+			{
+				// Append the data to the fragments already received
+				memcpy (pSlot->pHdr, pHdr, wifiHdrSize) ;
+				pSlot->pHdr->msgId &= ~WM_ID_FRAGMENTED ;
+				memcpy (pSlot->pHdr->message + pSlot->length, pHdr->message, dataLength) ;
+				pSlot->length += dataLength ;
+				linkTimeoutCount = 0 ;
+				if (pHdr->msgId == WM_ID_PART)
+				{
+					// Wait for the next fragment
+					pSlot->partTime = xTaskGetTickCount () ;
+					linkStat.parts++ ;
+					break ;
+				}
+
+				pSlot->pHdr->dataLength = pSlot->length ;
+				if (size < pSlot->bufSize)
+				{
+					pSlot->pHdr->message [pSlot->length] = 0 ;
+				}
+				pSlot->state = LINK_DONE ;
+
+				latency = (uint32_t) (esp_timer_get_time () - pSlot->sendTime) ;
+				linkStat.responses++ ;
+				linkStat.latencySum += latency ;
+				if (latency > linkStat.latencyMax)
+				{
+					linkStat.latencyMax = latency ;
+				}
+				if (pHdr->msgId == WM_ID_ERROR_CRC)
+				{
+					linkStat.aasunCrcErrors++ ;
+				}
+			}
+			linkRequestEnd () ;
+			xTaskNotifyGive (pSlot->task) ;
+			break ;
+		}
+	}
+	if (ii == WIFIMSG_INFLIGHT_MAX)
+	{
+		linkStat.orphans++ ;
+	}
+	xSemaphoreGive (linkMutex) ;
+
+	if (ii == WIFIMSG_INFLIGHT_MAX)
+	{
+		// The request timed out
+		ESP_LOGW (TAG, "No request for response %u, ID %u", pHdr->reqId, pHdr->msgId) ;
+	}
+}
+
+//----------------------------------------------------------------------
+//	A frame is received in rxFrame
+
+static	void	linkFrame (wifiMsgHdr_t * pHdr)
+{
+	if (wifiMsgCrc (pHdr) != pHdr->crc)
+	{
+		linkStat.crcErrors++ ;
+		ESP_LOGE (TAG, "CRC error, ID %u", pHdr->msgId) ;
+	}
+	else if (pHdr->msgId == WM_ID_SYNC)
+	{
+		linkSync (pHdr) ;
+	}
+	else if (pHdr->msgId == WM_ID_LIVE  &&  pHdr->reqId == 0)
+	{
+		linkStat.lives++ ;
+		wifiLivePut (pHdr) ;
+	}
+	else
+	{
+		linkDispatch (pHdr) ;
+	}
+}
+
+//----------------------------------------------------------------------
+//	Add the received bytes to the frame in rxFrame
+
+static	void	linkParse (const uint8_t * pData, uint32_t size)
+{
+	wifiMsgHdr_t	* pHdr   = (wifiMsgHdr_t *) rxFrame ;
+	uint8_t			* pBytes = (uint8_t *) rxFrame ;
+	uint32_t		chunk ;
+
+	while (size != 0)
+	{
+		if (rxCount < sizeof (uint32_t))
+		{
+			// Search the magic number, byte by byte
+			pBytes [rxCount++] = * pData++ ;
+			size-- ;
+			if (rxCount == sizeof (uint32_t)  &&  pHdr->magic != WIFIMSG_MAGIC)
+			{
+				memmove (pBytes, pBytes + 1, sizeof (uint32_t) - 1) ;
+				rxCount-- ;
+			}
+			continue ;
+		}
+
+		// The end of the header, then the data and the padding
+		chunk = ((rxCount < wifiHdrSize) ? wifiHdrSize : rxFrameSize) - rxCount ;
+		if (chunk > size)
+		{
+			chunk = size ;
+		}
+		memcpy (pBytes + rxCount, pData, chunk) ;
+		rxCount += chunk ;
+		pData   += chunk ;
+		size    -= chunk ;
+
+		if (rxCount == wifiHdrSize)
+		{
+			if (pHdr->dataLength > dataMessageMax)
+			{
+				linkStat.badFrames++ ;
+				rxCount = 0 ;		// Search the next magic number
+				continue ;
+			}
+			rxFrameSize = WIFIMSG_FRAME_SIZE (pHdr->dataLength) ;
+		}
+		if (rxCount == rxFrameSize)
+		{
+			linkFrame (pHdr) ;
+			rxCount = 0 ;
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+//	Read the frames sent by AASun, when the UART driver signals an event
+
+static	void	linkReaderTask (void * pParam)
+{
+	static	uint8_t	readBuffer [LINK_READ_SIZE] ;
+	uart_event_t	event ;
+	size_t			size ;
+	int				len ;
+
+	(void) pParam ;
+
+	while (1)
+	{
+		// While a frame is incomplete its bytes must not be too far apart
+		if (xQueueReceive (linkUartQueue, & event, (rxCount < sizeof (uint32_t)) ? portMAX_DELAY : LINK_BYTE_TMO) != pdTRUE)
+		{
+			linkStat.badFrames++ ;
+			ESP_LOGE (TAG, "Frame incomplete") ;
+			rxCount = 0 ;
+			continue ;
+		}
+
+		switch (event.type)
+		{
+			case UART_DATA:
+				// Read all the available bytes, some may have arrived after the event
+				uart_get_buffered_data_len (UART_NUM, & size) ;
+				while (size != 0)
+				{
+					len = uart_read_bytes (UART_NUM, readBuffer, (size < LINK_READ_SIZE) ? size : LINK_READ_SIZE, 0) ;
+					if (len <= 0)
+					{
+						break ;
+					}
+					linkParse (readBuffer, (uint32_t) len) ;
+					size -= (size_t) len ;
+				}
+				break ;
+
+			case UART_FIFO_OVF:
+			case UART_BUFFER_FULL:
+				// Bytes are lost: restart from an empty buffer
+				linkStat.overflows++ ;
+				ESP_LOGE (TAG, "UART overflow") ;
+				uart_flush_input (UART_NUM) ;
+				xQueueReset (linkUartQueue) ;
+				rxCount = 0 ;
+				break ;
+
+			case UART_FRAME_ERR:
+			case UART_PARITY_ERR:
+				linkStat.uartErrors++ ;
+				break ;
+
+			default:
+				break ;
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+//	Send a request to AASun and wait for its response
+//	During a baud rate negotiation only the requests of the baud task (bBaud) are sent
+
+static	bool	linkExchange (wifiMsgHdr_t * pHdr, uint32_t bufSize, TickType_t timeout, bool bBaud)
+{
+	linkSlot_t	* pSlot = NULL ;
+	uint32_t	frameSize = WIFIMSG_FRAME_SIZE (pHdr->dataLength) ;
+	TickType_t	startTime = xTaskGetTickCount () ;
+	TickType_t	lastTime ;
+	TickType_t	elapsed ;
+	uint32_t	state ;
+	uint32_t	ii ;
+
+	if (frameSize > WBUF_SIZE  ||  frameSize > bufSize)
+	{
+		ESP_LOGE (TAG, "Request too large: %lu", frameSize) ;
+		return false ;
+	}
+
+	// Wait for a free slot and for room in the AASun RX buffer
+	while (1)
+	{
+		xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+		if (linkTxPos + frameSize <= WBUF_SIZE  &&  (! linkNegotiating  ||  bBaud))
+		{
+			for (ii = 0 ; ii < WIFIMSG_INFLIGHT_MAX ; ii++)
+			{
+				if (linkSlots [ii].state == LINK_FREE)
+				{
+					pSlot = & linkSlots [ii] ;
+					break ;
+				}
+			}
+		}
+		if (pSlot != NULL)
+		{
+			break ;		// Note: exit while inside linkMutex protection
+		}
+		xSemaphoreGive (linkMutex) ;
+
+		elapsed = xTaskGetTickCount () - startTime ;
+		if (elapsed >= timeout  ||  xSemaphoreTake (linkRoomSem, timeout - elapsed) != pdTRUE)
+		{
+			linkStat.noRoom++ ;
+			ESP_LOGE (TAG, "No room for message %u", pHdr->msgId) ;
+			return false ;
+		}
+	}
+
+	// Send the request
+	linkReqId++ ;
+	if (linkReqId == 0)
+	{
+		linkReqId = 1 ;		// 0 is for WM_ID_SYNC
+	}
+	pHdr->magic = WIFIMSG_MAGIC ;
+	pHdr->reqId = linkReqId ;
+	pHdr->crc   = wifiMsgCrc (pHdr) ;
+
+	pSlot->state    = LINK_PENDING ;
+	pSlot->reqId    = linkReqId ;
+	pSlot->pHdr     = pHdr ;
+	pSlot->bufSize  = bufSize ;
+	pSlot->task     = xTaskGetCurrentTaskHandle () ;
+	pSlot->sendTime = esp_timer_get_time () ;
+	pSlot->partTime = xTaskGetTickCount () ;
+	pSlot->length   = 0 ;
+	ulTaskNotifyTake (pdTRUE, 0) ;		// Clear a notification after the timeout of a previous request
+
+	linkInFlight++ ;
+	linkTxPos += frameSize ;
+	linkStat.requests++ ;
+	uart_write_bytes (UART_NUM, pHdr, frameSize) ;
+
+	// Other tasks may wait for room in AASun buffer: wake the next one if there is still some
+	if (linkTxPos < WBUF_SIZE  &&  linkInFlight < WIFIMSG_INFLIGHT_MAX)
+	{
+		xSemaphoreGive (linkRoomSem) ;
+	}
+	xSemaphoreGive (linkMutex) ;
+
+	// Wait for the notification of the reader task
+	// The timeout restarts at each fragment of the response
+	while (1)
+	{
+		xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+		state    = pSlot->state ;
+		lastTime = pSlot->partTime ;
+		xSemaphoreGive (linkMutex) ;
+
+		elapsed = xTaskGetTickCount () - lastTime ;
+		if (state != LINK_PENDING  ||  elapsed >= timeout)
+		{
+			break ;
+		}
+		ulTaskNotifyTake (pdTRUE, timeout - elapsed) ;
+	}
+
+	xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+	state = pSlot->state ;
+	if (state == LINK_PENDING)
+	{
+		// Timeout: a response received later will be ignored
+		linkRequestEnd () ;
+		linkStat.timeouts++ ;
+		ESP_LOGE (TAG, "Timeout, request %u", pSlot->reqId) ;
+
+		linkTimeoutCount++ ;
+		if (linkTimeoutCount >= LINK_BAUD_LOST  &&  linkBaud != WIFIMSG_BBR  &&  ! linkNegotiating)
+		{
+			// The link is lost: AASun will synchronize at WIFIMSG_BBR
+			linkSetBaud (WIFIMSG_BBR) ;
+			linkStat.baudFallbacks++ ;
+			ESP_LOGE (TAG, "Link lost, baud rate %d", WIFIMSG_BBR) ;
+		}
+	}
+	pSlot->state = LINK_FREE ;
+	xSemaphoreGive (linkMutex) ;
+
+	return state == LINK_DONE  &&  pHdr->msgId != WM_ID_ERROR_CRC ;
+}
+
+//----------------------------------------------------------------------
+//	Send a request to AASun and wait for its response
+//	The request is built in a buffer of bufSize bytes pointed to by pHdr,
+//	the magic number, request ID and CRC are set here.
+//	The response is returned in the same buffer, followed by a 0 if there is room for it
+//	A fragmented response can be larger than WBUF_SIZE, up to the size of the buffer
+//	Return true on success, else false (timeout, error)
+
+bool	wifiLinkExchange (wifiMsgHdr_t * pHdr, uint32_t bufSize, TickType_t timeout)
+{
+	return linkExchange (pHdr, bufSize, timeout, false) ;
+}
+
+//----------------------------------------------------------------------
+//	The message to send is built in a buffer of at least WBUF_SIZE bytes pointed to by pHdr
+//	The answer is returned in the same buffer
+//	Return true on success, else false (timeout)
+
+bool message_exchange (wifiMsgHdr_t * pHdr)
+{
+	return wifiLinkExchange (pHdr, WBUF_SIZE, WIFI_LINK_TMO) ;
+}
+
+//----------------------------------------------------------------------
+//	Return the count of requests sent to AASun and not yet answered
+
+uint32_t	wifiLinkInFlight (void)
+{
+	uint32_t	inFlight ;
+
+	xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+	inFlight = linkInFlight ;
+	xSemaphoreGive (linkMutex) ;
+	return inFlight ;
+}
+
+//----------------------------------------------------------------------
+//	Try a baud rate: AASun must accept it, then echo a test pattern at this rate
+//	Returns false if the previous baud rate is still used
+
+static	bool	linkBaudTry (uint32_t baud)
+{
+	static	const uint8_t	patterns [4] = { 0x00, 0xFF, 0x55, 0xAA } ;
+	wifiMsgHdr_t	* pHdr     = (wifiMsgHdr_t *) linkBaudBuffer ;
+	wifiBaudMsg_t	* pMess    = (wifiBaudMsg_t *) pHdr->message ;
+	uint8_t			* pPattern = pHdr->message + wifiBaudMsgSize ;
+	uint32_t		prevBaud   = linkBaud ;
+	uint32_t		ii ;
+
+	// Propose the baud rate at the current one
+	pHdr->msgId      = WM_ID_BAUD ;
+	pHdr->dataLength = wifiBaudMsgSize ;
+	pMess->baudRate  = baud ;
+	if (! linkExchange (pHdr, sizeof (linkBaudBuffer), WIFI_LINK_TMO, true)  ||  pHdr->msgId != WM_ID_BAUD)
+	{
+		return false ;		// Refused by AASun
+	}
+
+	// AASun uses the new baud rate since the end of its answer
+	linkSetBaud (baud) ;
+	uart_flush_input (UART_NUM) ;
+
+	// The test message: patterns which are sensitive to a wrong sampling, and a counter
+	pHdr->msgId      = WM_ID_BAUD ;
+	pHdr->dataLength = wifiBaudMsgSize + LINK_BAUD_TEST ;
+	pMess->baudRate  = baud ;
+	for (ii = 0 ; ii < LINK_BAUD_TEST ; ii++)
+	{
+		pPattern [ii] = (ii & 1) ? (uint8_t) ii : patterns [(ii >> 1) & 3] ;
+	}
+	if (linkExchange (pHdr, sizeof (linkBaudBuffer), LINK_BAUD_TMO, true)  &&
+		pHdr->msgId == WM_ID_BAUD  &&  pHdr->dataLength == wifiBaudMsgSize + LINK_BAUD_TEST)
+	{
+		return true ;		// The echo has a good CRC
+	}
+
+	// Not reliable: AASun returns to the previous baud rate after WIFI_BAUD_PROBE_TMO
+	linkSetBaud (prevBaud) ;
+	vTaskDelay ((2 * WIFI_BAUD_PROBE_TMO) / portTICK_PERIOD_MS) ;
+	uart_flush_input (UART_NUM) ;
+	ESP_LOGW (TAG, "Baud rate %lu failed", baud) ;
+	return false ;
+}
+
+//----------------------------------------------------------------------
+//	After each synchronization, negotiate the baud rate with AASun
+
+static	void	linkBaudTask (void * pParam)
+{
+	uint32_t	ii ;
+
+	(void) pParam ;
+
+	while (1)
+	{
+		xSemaphoreTake (linkSyncSem, portMAX_DELAY) ;
+
+		// The other requests wait for the end of the negotiation
+		xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+		linkNegotiating = true ;
+		xSemaphoreGive (linkMutex) ;
+
+		// Wait for the end of the requests in flight
+		for (ii = 0 ; ii < 100  &&  linkInFlight != 0 ; ii++)
+		{
+			vTaskDelay (10 / portTICK_PERIOD_MS) ;
+		}
+
+		for (ii = 0 ; ii < sizeof (linkBauds) / sizeof (linkBauds [0]) ; ii++)
+		{
+			if (linkBaudTry (linkBauds [ii]))
+			{
+				break ;
+			}
+		}
+
+		xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+		linkNegotiating  = false ;
+		linkTimeoutCount = 0 ;
+		xSemaphoreGive (linkMutex) ;
+		xSemaphoreGive (linkRoomSem) ;
+
+		ESP_LOGI (TAG, "UART baud rate %lu", linkBaud) ;
+		xSemaphoreGive (linkReadySem) ;
+	}
+}
+
+//----------------------------------------------------------------------
+//	Start the reader and baud tasks, then wait for the synchronization with AASun
+//	The UART driver must be installed with the event queue uartQueue
+
+void	wifiLinkInit (QueueHandle_t uartQueue)
+{
+	linkUartQueue = uartQueue ;
+	linkMutex     = xSemaphoreCreateMutex () ;
+	linkSyncSem   = xSemaphoreCreateBinary () ;
+	linkRoomSem   = xSemaphoreCreateBinary () ;
+	linkReadySem  = xSemaphoreCreateBinary () ;
+
+	xTaskCreate (linkReaderTask, "wifiLink", LINK_TASK_STACK, NULL, LINK_TASK_PRIORITY, NULL) ;
+	xTaskCreate (linkBaudTask,   "wifiBaud", LINK_TASK_STACK, NULL, LINK_TASK_PRIORITY - 1, NULL) ;
+
+	// AASun sends WM_ID_SYNC messages until the reader task answers, then the baud rate is negotiated
+	while (xSemaphoreTake (linkReadySem, SYNC_TMO) != pdTRUE)
+	{
+		ESP_LOGI (TAG, "Waiting for UART sync") ;
+	}
+}
+
+//----------------------------------------------------------------------
+//	Write the statistics of the link as a JSON object in pBuf
+//	Return the length of the string
+
+uint32_t	wifiLinkStatJson (char * pBuf, uint32_t size)
+{
+	linkStat_t	stat ;
+	uint32_t	inFlight ;
+	uint32_t	baud ;
+	int			len ;
+
+	xSemaphoreTake (linkMutex, portMAX_DELAY) ;
+	stat     = linkStat ;
+	inFlight = linkInFlight ;
+	baud     = linkBaud ;
+	xSemaphoreGive (linkMutex) ;
+
+	len = snprintf (pBuf, size,
+			"{\"baud\":%lu,\"requests\":%lu,\"responses\":%lu,\"inFlight\":%lu,\"timeouts\":%lu,\"noRoom\":%lu,"
+			"\"aborted\":%lu,\"aasunCrcErrors\":%lu,\"crcErrors\":%lu,\"badFrames\":%lu,\"orphans\":%lu,"
+			"\"syncs\":%lu,\"lives\":%lu,\"parts\":%lu,\"partErrors\":%lu,\"baudFallbacks\":%lu,\"overflows\":%lu,\"uartErrors\":%lu,\"latencyAvgUs\":%lu,\"latencyMaxUs\":%lu}",
+			baud, stat.requests, stat.responses, inFlight, stat.timeouts, stat.noRoom,
+			stat.aborted, stat.aasunCrcErrors, stat.crcErrors, stat.badFrames, stat.orphans,
+			stat.syncs, stat.lives, stat.parts, stat.partErrors, stat.baudFallbacks, stat.overflows, stat.uartErrors,
+			(stat.responses == 0) ? 0ul : (uint32_t) (stat.latencySum / stat.responses), stat.latencyMax) ;
+
+	return (len < 0) ? 0 : ((uint32_t) len >= size) ? size - 1 : (uint32_t) len ;
+}
+
+//----------------------------------------------------------------------
+//	Display the statistics of the link
+
+void	wifiLinkStat (void)
+{
+	char	buffer [512] ;
+
+	wifiLinkStatJson (buffer, sizeof (buffer)) ;
+	printf ("WIFI link: %s\n", buffer) ;
+}
+
+//----------------------------------------------------------------------
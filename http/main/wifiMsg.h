@@ -9,9 +9,58 @@
 
 	When		Who	What
 	25/03/24	ac	Creation
+	18/10/26	ac	Protocol V2: request ID and CRC16 in the header, several requests in flight
+	18/10/26	ac	WM_ID_LIVE: the live values pushed by AASun
+	18/10/26	ac	Baud rate negotiation (WM_ID_BAUD), fragmented responses (WM_ID_PART)
+	18/10/26	ac	Telnet: coalescing of the data and credits
+	18/10/26	ac	The fragments have a trailer with their offset, the last one with the total size
 
 	This file is common to AASun and the WIFI interface on ESP32
 
+	Protocol V2
+	The ESP32 sends requests, AASun sends the responses. Each request has a request ID
+	which AASun copies to the response, so the ESP32 can have several requests in flight
+	and match the responses in any order. AASun sends only two messages on its own initiative,
+	with a request ID of 0: WM_ID_SYNC, and WM_ID_LIVE once per second while the ESP32 sets
+	WM_REQ_LIVE in its WM_ID_REQ messages.
+	The header has a CRC16 of the header and of the message data. A frame with a bad CRC is
+	skipped by the receiver, which searches the next magic number: no full resynchronization.
+	AASun answers a corrupted request with WM_ID_ERROR_CRC if it can read its request ID.
+
+	A frame is padded to a multiple of 4 bytes (WIFIMSG_FRAME_SIZE).
+	AASun handles the frames in place in its RX circular buffer of WBUF_SIZE bytes, so a frame
+	must not wrap at the end of this buffer. AASun restarts at the beginning of the buffer each
+	time it is empty: the ESP32 sends a frame only if the size of the frames sent since it had
+	no request in flight, this frame included, is not greater than WBUF_SIZE.
+
+	A response larger than a frame is sent in several frames with the same request ID:
+	WM_ID_PART frames, then a last frame with the ID of the response ORed with WM_ID_FRAGMENTED.
+	The data of each of these frames ends with a wifiPartMsg_t trailer: the offset of the data
+	of the frame in the reassembled message, and in the last frame the size of this message.
+	The ESP32 appends their data, and fails the request if a fragment is missing (its offset
+	is not the size already received) or if the total size doesn't match. The size of the
+	reassembled message is at most WIFIMSG_MSG_MAX. The requests are never fragmented.
+
+	Baud rate: each synchronization is done at WIFIMSG_BBR. Then the ESP32 proposes a higher
+	baud rate with WM_ID_BAUD, while it has no other request in flight. AASun answers WM_ID_BAUD
+	at the current rate, then switches to the new rate. The ESP32 switches when it receives
+	the answer, then sends a WM_ID_BAUD with a test pattern at the new rate, which AASun echoes.
+	If AASun receives no valid frame for WIFI_BAUD_PROBE_TMO it returns to the previous rate,
+	and the ESP32 tries a lower rate. If the link is lost later, AASun synchronizes again at
+	WIFIMSG_BBR, and the ESP32 returns to WIFIMSG_BBR after some request timeouts.
+	There is no hardware flow control: the board connects only TX and RX.
+
+	Telnet: the data is coalesced on both sides. After a quiet period a frame is sent at once
+	(echo of the typed chars), but during a burst the data is held until WIFI_TELNET_COALESCE_MIN
+	bytes are pending or WIFI_TELNET_COALESCE_TMO has elapsed since the last telnet frame.
+	Each direction has a credit, so the console output can't starve the CGI requests:
+	- AASun to ESP32: the telnet data is the answer of WM_ID_REQ, its size is at most the
+	  telnetCredit of wifiReqMsg_t. The ESP32 grants WIFI_TELNET_CREDIT_BUSY while it has
+	  other requests in flight.
+	- ESP32 to AASun: the ACK of WM_ID_TELNET is a wifiTelnetAckMsg_t with the free room of
+	  the AASun console input buffer. The ESP32 doesn't send more, and sends an empty
+	  WM_ID_TELNET to get a new credit.
+
 ----------------------------------------------------------------------
 */
 
@@ -19,17 +68,27 @@
 #define WIFIMSG_H_
 //-----------------------------------------------------------------------------
 #include <stdint.h>
+#include <stddef.h>		// For offsetof
 #include <time.h>		// For struct tm
 
-#define	WIFIMSG_MAGIC		0x44332211
+#define	WIFIMSG_MAGIC		0x44332212	// Protocol V2. V1 was 0x44332211
 #define	WIFIMSG_PAGE_CHUNK	1024		// To send HTTP file system to the ESP32. Mandatory power of 2
-#define	WIFIMSG_BBR			230400		// UART baud rate
+#define	WIFIMSG_BBR			230400		// UART baud rate at the synchronization
+#define	WIFIMSG_BBR_MAX		2000000		// Max UART baud rate negotiated after the synchronization
+#define	WIFIMSG_MSG_MAX		32768		// Max data size of a fragmented message
+#define	WIFI_BAUD_PROBE_TMO	500			// ms, AASun returns to the previous baud rate without valid frame
+
+#define	WIFI_TELNET_COALESCE_TMO	50	// ms, max hold time of the telnet data during a burst
+#define	WIFI_TELNET_COALESCE_MIN	256	// A telnet frame of this size is sent at once
+#define	WIFI_TELNET_CREDIT_BUSY		256	// Max telnet data from AASun while the CGI requests are in flight
 
 // The size of the TX and RX UART buffers
 #define		WBUF_POW2		11			// 2^WBUF_POW2 is WBUF_SIZE. Example WBUF_POW2 of 5 for 32 bytes, 11 for 2048 bytes
 #define		WBUF_SIZE		(1 << WBUF_POW2)
 #define		WBUF_MASK		(WBUF_SIZE-1)
 
+#define	WIFIMSG_INFLIGHT_MAX	4		// Max count of ESP32 requests waiting for a response
+
 // Values for wifiMsgHdr_t.msgId
 #define	WM_ID_ACK			0			// Acknowledge answer, nothing to do. Data length 0
 #define	WM_ID_NACK			1			// Not acknowledge answer, nothing to do. Data length 0
@@ -44,15 +103,23 @@
 #define	WM_ID_TELNET_START	10			// New Telnet connection, response is ACK or NACk
 #define	WM_ID_TELNET_STOP	11			// Telnet connection closed, response is ACK
 #define	WM_ID_TELNET		12			// Telnet data, from both side
+#define	WM_ID_ERROR_CRC		13			// Response to a request received with a bad CRC, data length 0
+#define	WM_ID_LIVE			14			// Sent by AASun: the snapshot.cgi response, wifiRespMsgCgi_t
+#define	WM_ID_PART			15			// A fragment of a response, the next frames with the same request ID follow
+#define	WM_ID_BAUD			16			// Baud rate negotiation, wifiBaudMsg_t. The response is WM_ID_BAUD or WM_ID_NACK
 
 #define	WM_ID_REQ			20			// Request from WIFI to AASun. Data length 0
 #define	WM_ID_REQ_DATE		21			// Request of the current date from AASUN, also the response
 
+#define	WM_ID_FRAGMENTED	0x8000		// Flag of msgId: the last frame of a fragmented response, with a wifiPartMsg_t trailer
+
 typedef struct
 {
 	uint32_t	magic ;
 	uint16_t	msgId ;
-	uint16_t	dataLength ;
+	uint16_t	dataLength ;	// Size of message[], without the padding
+	uint16_t	reqId ;			// Set by the ESP32, copied to the response by AASun. 0 for WM_ID_SYNC
+	uint16_t	crc ;			// CRC16 of the header fields before crc, then of message[]
 	uint8_t		message [0] ;
 
 } wifiMsgHdr_t ;
@@ -61,6 +128,39 @@ static	const uint32_t	wifiHdrSize = sizeof (wifiMsgHdr_t) ;
 
 static	const uint32_t	dataMessageMax = WBUF_SIZE - wifiHdrSize ;
 
+// The size of the frame to transmit for a message of dataLength bytes
+#define	WIFIMSG_FRAME_SIZE(dataLength)	((sizeof (wifiMsgHdr_t) + (dataLength) + 3u) & ~3u)
+
+//-----------------------------------------------------------------------------
+// CRC16 CCITT (polynomial 0x1021), using a table of 16 entries to save flash
+
+static inline uint16_t	wifiCrc16 (uint16_t crc, const void * pData, uint32_t size)
+{
+	static const uint16_t	table [16] =
+	{
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+	} ;
+	const uint8_t	* pBytes = (const uint8_t *) pData ;
+
+	while (size-- != 0)
+	{
+		crc = (uint16_t) ((crc << 4) ^ table [(crc >> 12) ^ (* pBytes >> 4)]) ;
+		crc = (uint16_t) ((crc << 4) ^ table [(crc >> 12) ^ (* pBytes & 0x0F)]) ;
+		pBytes++ ;
+	}
+	return crc ;
+}
+
+// The CRC to set in, or to check against, pHdr->crc
+static inline uint16_t	wifiMsgCrc (const wifiMsgHdr_t * pHdr)
+{
+	uint16_t	crc ;
+
+	crc = wifiCrc16 (0xFFFF, pHdr, offsetof (wifiMsgHdr_t, crc)) ;
+	return wifiCrc16 (crc, pHdr->message, pHdr->dataLength) ;
+}
+
 //-----------------------------------------------------------------------------
 
 // Values for wifiMsgCgi.type
@@ -84,15 +184,37 @@ typedef struct
 static	const uint32_t	wifiReqMsgCgiSize = sizeof (wifiReqMsgCgi_t) ;
 
 // This message us used as CGI response of AASun to ESP request
+#define	WM_RESP_SIZE_PART		0xFFFFFFFF	// respSize of a fragmented response: the size of the reassembled data
+
 typedef struct
 {
-	uint32_t	respSize ;			// Length of the response data
+	uint32_t	respSize ;			// Length of the response data, or WM_RESP_SIZE_PART
 	char		contentType [WM_CONTENT_MAX] ;
 	char		resp [0] ;			// The response data
 
 } wifiRespMsgCgi_t ;
 static	const uint32_t	wifiRespMsgCgiSize = sizeof (wifiRespMsgCgi_t) ;
 
+// The data of WM_ID_REQ
+#define	WM_REQ_LIVE				0x0001		// The ESP32 wants the WM_ID_LIVE messages
+#define	WM_LIVE_CGI				"snapshot.cgi"	// The CGI whose response is sent in WM_ID_LIVE
+
+typedef struct
+{
+	uint32_t	flags ;
+	uint32_t	telnetCredit ;		// Max size of the telnet data in the answer
+
+} wifiReqMsg_t ;
+static	const uint32_t	wifiReqMsgSize = sizeof (wifiReqMsg_t) ;
+
+// The data of the WM_ID_ACK answer to WM_ID_TELNET
+typedef struct
+{
+	uint32_t	credit ;			// Max size of the next telnet data sent to AASun
+
+} wifiTelnetAckMsg_t ;
+static	const uint32_t	wifiTelnetAckMsgSize = sizeof (wifiTelnetAckMsg_t) ;
+
 // The request from WIFI to AASun
 typedef struct
 {
@@ -126,6 +248,26 @@ typedef struct
 } wifiPageMsg_t ;
 static	const uint32_t	wifiPageMsgSize = sizeof (wifiPageMsg_t) ;
 
+// The trailer of the frames of a fragmented response: the last bytes of their data, not aligned
+typedef struct
+{
+	uint32_t	offset ;			// Offset of the data of this frame in the reassembled message
+	uint32_t	total ;				// Size of the reassembled message in the last frame, 0 in WM_ID_PART
+
+} wifiPartMsg_t ;
+static	const uint32_t	wifiPartMsgSize = sizeof (wifiPartMsg_t) ;
+
+// The max data of a fragment, before its trailer
+static	const uint32_t	dataPartMax = WBUF_SIZE - sizeof (wifiMsgHdr_t) - sizeof (wifiPartMsg_t) ;
+
+// The data of WM_ID_BAUD. The test message at the new rate is followed by a test pattern
+typedef struct
+{
+	uint32_t	baudRate ;
+
+} wifiBaudMsg_t ;
+static	const uint32_t	wifiBaudMsgSize = sizeof (wifiBaudMsg_t) ;
+
 typedef struct
 {
 	struct tm timeinfo ;
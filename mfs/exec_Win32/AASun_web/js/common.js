@@ -119,3 +119,49 @@ export function switchLed ()
 writeLedOff () ;
 
 //------------------------------------------------------------------
+//  Live values
+//  The LAN server pushes the snapshot.cgi data each second (live.cgi event stream).
+//  If the event stream is not available (WIFI, too many clients) snapshot.cgi is polled.
+//  onData is called with the snapshot JSON object, or with null on error.
+
+const livePeriod = 1200 ;
+
+export function liveStart (onData)
+{
+    let pollTimer = null ;
+
+    function poll ()
+    {
+        fetch ("snapshot.cgi", { method: "GET", headers: {"Content-Type": "application/json" } })
+            .then (response => response.ok ? response.json () : null)
+            .catch (() => null)
+            .then (data => onData (data)) ;
+    }
+
+    function startPolling ()
+    {
+        if (pollTimer === null)
+        {
+            pollTimer = setInterval (poll, livePeriod) ;
+            poll () ;
+        }
+    }
+
+    if (typeof EventSource === "undefined")
+    {
+        startPolling () ;
+        return ;
+    }
+
+    const source = new EventSource ("live.cgi") ;
+    source.onmessage = (event) => { onData (JSON.parse (event.data)) ; } ;
+    source.onerror = () => {
+        // The browser reconnects by itself, except if the server refused the stream
+        if (source.readyState === EventSource.CLOSED)
+        {
+            startPolling () ;
+        }
+    } ;
+}
+
+//------------------------------------------------------------------
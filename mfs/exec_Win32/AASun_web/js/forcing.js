@@ -338,78 +338,75 @@ console.log ("forcerules.cgi ended") ;
 // let greenLeds = [] ;
 // DIVERTING_MAX + FORCING_MAX
 
-function updateDfStatus ()
+function updateDfStatus (data)
 {
-    let data = getServerData ("dfstatus.cgi").then (data => {
-        if (data != null)
+    if (data != null)
+    {
+        let text ;
+        let words ;
+        let idx ;
+        for (let ii = 0 ; ii < OUT_MAX ; ii++)
         {
-            let text ;
-            let words ;
-            let idx ;
-            for (let ii = 0 ; ii < OUT_MAX ; ii++)
+            text = data["out" + (ii)]
+            words = text.split (" ") ;
+            idx = Number (words[1]) ;   // Index of the diverting or forcing, 0 based
+
+            // Set led
+            if (words [0] == "Diverting")
             {
-                text = data["out" + (ii)]
-                words = text.split (" ") ;
-                idx = Number (words[1]) ;   // Index of the diverting or forcing, 0 based
+                // Diverting are at index 0 and 1 in greenLeds[]
+                dfStatus[ii].display.innerText = words [0] ;
 
-                // Set led
-                if (words [0] == "Diverting")
+                if (dfStatus[ii].led != greenLeds [idx])
                 {
-                    // Diverting are at index 0 and 1 in greenLeds[]
-                    dfStatus[ii].display.innerText = words [0] ;
-
-                    if (dfStatus[ii].led != greenLeds [idx])
+                    if (dfStatus[ii].led !== undefined)
                     {
-                        if (dfStatus[ii].led !== undefined)
-                        {
-                            dfStatus[ii].led.setAttribute("data-led", "off") ;
-                        }
-                        greenLeds [idx].setAttribute("data-led", "on");
-                        dfStatus[ii].led = greenLeds [idx] ;
+                        dfStatus[ii].led.setAttribute("data-led", "off") ;
                     }
+                    greenLeds [idx].setAttribute("data-led", "on");
+                    dfStatus[ii].led = greenLeds [idx] ;
                 }
-                else if (words [0] == "Forcing")
-                {
-                    // Forcing indexes are from DIVERTING_MAX in greenLeds[]
-                    dfStatus[ii].display.innerText = words [0] + " " + (idx+1) ;
+            }
+            else if (words [0] == "Forcing")
+            {
+                // Forcing indexes are from DIVERTING_MAX in greenLeds[]
+                dfStatus[ii].display.innerText = words [0] + " " + (idx+1) ;
 
-                    idx += DIVERTING_MAX ;
-                    if (dfStatus[ii].led != greenLeds [idx])
-                    {
-                        if (dfStatus[ii].led !== undefined)
-                        {
-                            dfStatus[ii].led.setAttribute("data-led", "off") ;
-                        }
-                        greenLeds [idx].setAttribute("data-led", "on");
-                        dfStatus[ii].led = greenLeds [idx] ;
-                    }
-                }
-                else
+                idx += DIVERTING_MAX ;
+                if (dfStatus[ii].led != greenLeds [idx])
                 {
-                    // Idle
-                    dfStatus[ii].display.innerText = "" ;
-                    if (dfStatus[ii].led != undefined)
+                    if (dfStatus[ii].led !== undefined)
                     {
                         dfStatus[ii].led.setAttribute("data-led", "off") ;
-                        dfStatus[ii].led = undefined ;
                     }
+                    greenLeds [idx].setAttribute("data-led", "on");
+                    dfStatus[ii].led = greenLeds [idx] ;
                 }
             }
-        }
-        else
-        {
-            for (let ii = 0 ; ii < OUT_MAX ; ii++)
+            else
             {
-                dfStatus[ii].display.innerText = "?" ;
-                if (dfStatus[ii].led !== undefined)
+                // Idle
+                dfStatus[ii].display.innerText = "" ;
+                if (dfStatus[ii].led != undefined)
                 {
                     dfStatus[ii].led.setAttribute("data-led", "off") ;
                     dfStatus[ii].led = undefined ;
                 }
             }
         }
-    }) ;
-console.log ("dfstatus.cgi ended") ;
+    }
+    else
+    {
+        for (let ii = 0 ; ii < OUT_MAX ; ii++)
+        {
+            dfStatus[ii].display.innerText = "?" ;
+            if (dfStatus[ii].led !== undefined)
+            {
+                dfStatus[ii].led.setAttribute("data-led", "off") ;
+                dfStatus[ii].led = undefined ;
+            }
+        }
+    }
 }
 
 
@@ -451,21 +448,27 @@ function setDivOnOff (state)    // if state == true then diverter on
 
 //------------------------------------------------------------------
 
-function updatePeriodic ()
+// All the live values are in one snapshot, pushed by the server each second
+
+function updatePeriodic (data)
 {
-    // Update global diverter button color
-    getServerData ("statusWord.cgi").then (data => {
+    if (data != null)
+    {
+        // Update global diverter button color
         const wordBit = ["", "X"] ;
         let word = data["SW"] ;
 console.log ("statusWord ", word) ;
-    
+
         // Diverter  on/off is bit 0x01
         setDivOnOff (wordBit [(word >>> 0) & 0x01] != 0) ;
-console.log ("statusWord.cgi ended") ;
 
         // Update dfStatus and forcing/diverting running green led
-        updateDfStatus () ;
-    }) ;
+        updateDfStatus (data ["df"]) ;
+    }
+    else
+    {
+        updateDfStatus (null) ;
+    }
 }
 
 //------------------------------------------------------------------
@@ -533,6 +536,6 @@ document.getElementById ("footerText").innerHTML = common.getFooterString () ;
 loadRules () ;
 
 // Periodic display update of data
-let updateTimer = setInterval (updatePeriodic, 1200) ;
+common.liveStart (updatePeriodic) ;
 
 //------------------------------------------------------------------
@@ -37,82 +37,77 @@ console.log ("getServerData " + urldata) ;
 
 //------------------------------------------------------------------
 
-function updateDisplay ()
+// All the live values are in one snapshot, pushed by the server each second
+
+function updateDisplay (data)
+{
+    if (data != null)
+    {
+        updateMeter (data ["meter"]) ;
+        updateTemperature (data ["temp"]) ;
+        updateStatusWord (data) ;
+    }
+}
+
+// Update meter values display
+function updateMeter (data)
 {
-    // Update meter values display
-    getServerData ("meter.cgi").then (data => {
-        if (data != null)
-        {
 console.log ("updateMeterGroup ", JSON.stringify(data)) ;
-            document.getElementById("meterVolt").innerHTML   = data["volt"] ;
-            document.getElementById("meterEnergy").innerHTML = data["cnt"] ;
-            document.getElementById("meterPapp").innerHTML   = data["pApp"] ;
-        }
-        updateTemperature () ;
-    });
+    document.getElementById("meterVolt").innerHTML   = data["volt"] ;
+    document.getElementById("meterEnergy").innerHTML = data["cnt"] ;
+    document.getElementById("meterPapp").innerHTML   = data["pApp"] ;
 }
 
 // Update temperature display
-function updateTemperature ()
+function updateTemperature (data)
 {
-    getServerData ("temperature.cgi/?mid=All").then (data => {
-        if (data != null)
-        {
-            let factor ;
-            let temp ;
+    let factor ;
+    let temp ;
 console.log ("updateTemperatureGroup ", JSON.stringify(data)) ;
-    
-            for (let ii = 0 ; ii < TEMPERATURE_MAX ; ii++)
-            {
-                factor = Number (data ["factor"]) ;
-        
-                temp = Number (data["temp" + (ii+1)] ) / factor ;
-                if (isNaN(temp)  ||  temp > 199)
-                {
-                    tempElement[ii].innerHTML = "-" ;
-                }
-                else
-                {
-                    tempElement[ii].innerHTML = temp.toFixed (1) ;
-                }
-            }
+
+    for (let ii = 0 ; ii < TEMPERATURE_MAX ; ii++)
+    {
+        factor = Number (data ["factor"]) ;
+
+        temp = Number (data["temp" + (ii+1)] ) / factor ;
+        if (isNaN(temp)  ||  temp > 199)
+        {
+            tempElement[ii].innerHTML = "-" ;
+        }
+        else
+        {
+            tempElement[ii].innerHTML = temp.toFixed (1) ;
         }
-        updateStatusWord ()
-    }) ;
+    }
 }
 
 // Update status word display
-function updateStatusWord ()
+function updateStatusWord (data)
 {
-    getServerData ("statusWord.cgi").then (data => {
-        if (data != null)
-        {
-            const wordBit = ["", "X"] ;
-    
-            let word = data["SW"] ;
+    const wordBit = ["", "X"] ;
+
+    let word = data["SW"] ;
 console.log ("updateStatusWordGroup ", word) ;
-    
-            // Line A
-            document.getElementById("SW_A0").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_A1").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_A2").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_A3").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_A4").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_A5").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_A6").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_A7").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-    
-            // Line B
-            document.getElementById("SW_B0").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_B1").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_B2").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_B3").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_B4").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_B5").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_B6").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-            document.getElementById("SW_B7").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
-        }
-    }) ;
+
+    // Line A
+    document.getElementById("SW_A0").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_A1").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_A2").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_A3").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_A4").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_A5").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_A6").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_A7").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+
+    // Line B
+    document.getElementById("SW_B0").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_B1").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_B2").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_B3").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_B4").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_B5").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_B6").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
+    document.getElementById("SW_B7").innerHTML = wordBit [(word >>> 0) & 1] ; word = word >>> 1 ;
 }
 
 //------------------------------------------------------------------
@@ -190,7 +185,7 @@ getServerData ("version.cgi").then (data => {
 }) ;
 
 //  For periodic update of the page
-let updateTimer = setInterval (updateDisplay, 1200) ;
+common.liveStart (updateDisplay) ;
 
 //------------------------------------------------------------------
  
\ No newline at end of file
@@ -33,162 +33,154 @@ function setHideShow (list, display)
 //------------------------------------------------------------------
 //------------------------------------------------------------------
 
-function updatePowerGroup ()
+function updatePowerGroup (data)
 {
-    getServerData ("volt.cgi").then (data => {
-        if (data === null)
-        {
-            document.getElementById("vRms").innerHTML   = "-" ;
-            document.getElementById("p1Real").innerHTML = "-" ;
-            document.getElementById("p1App").innerHTML  = "-" ;
-            document.getElementById("p2Real").innerHTML = "-" ;
-            document.getElementById("p2App").innerHTML  = "-" ;
-            document.getElementById("p3Real").innerHTML = "-" ;
-            document.getElementById("p3App").innerHTML  = "-" ;
-            document.getElementById("p4Real").innerHTML = "-" ;
-            document.getElementById("p4App").innerHTML  = "-" ;
-            document.getElementById("pDiv").innerHTML   = "-" ;
-            document.getElementById("cPhi1").innerHTML  = "-" ;
-            document.getElementById("cPhi2").innerHTML  = "-" ;
-            document.getElementById("cPhi3").innerHTML  = "-" ;
-            document.getElementById("cPhi4").innerHTML  = "-" ;
-            document.getElementById("Counter1").innerHTML  = "-" ;
-            document.getElementById("Counter2").innerHTML  = "-" ;
-        }
-        else
-        {
+    if (data === null)
+    {
+        document.getElementById("vRms").innerHTML   = "-" ;
+        document.getElementById("p1Real").innerHTML = "-" ;
+        document.getElementById("p1App").innerHTML  = "-" ;
+        document.getElementById("p2Real").innerHTML = "-" ;
+        document.getElementById("p2App").innerHTML  = "-" ;
+        document.getElementById("p3Real").innerHTML = "-" ;
+        document.getElementById("p3App").innerHTML  = "-" ;
+        document.getElementById("p4Real").innerHTML = "-" ;
+        document.getElementById("p4App").innerHTML  = "-" ;
+        document.getElementById("pDiv").innerHTML   = "-" ;
+        document.getElementById("cPhi1").innerHTML  = "-" ;
+        document.getElementById("cPhi2").innerHTML  = "-" ;
+        document.getElementById("cPhi3").innerHTML  = "-" ;
+        document.getElementById("cPhi4").innerHTML  = "-" ;
+        document.getElementById("Counter1").innerHTML  = "-" ;
+        document.getElementById("Counter2").innerHTML  = "-" ;
+    }
+    else
+    {
 console.log ("updatePowerGroup ", JSON.stringify(data)) ;
-            document.getElementById("vRms").innerHTML   = data["vRms"] ;
-            document.getElementById("p1Real").innerHTML = data["p1Real"] ;
-            document.getElementById("p1App").innerHTML  = data["p1App"] ;
-            document.getElementById("p2Real").innerHTML = data["p2Real"] ;
-            document.getElementById("p2App").innerHTML  = data["p2App"] ;
-            document.getElementById("pDiv").innerHTML   = data["pDiv"] ;
-
-            let cos = Number (data["cPhi1"]) / 1000 ; 
-            document.getElementById("cPhi1").innerHTML  = cos.toFixed (3) ;
-            cos = Number (data["cPhi2"]) / 1000 ; 
-            document.getElementById("cPhi2").innerHTML  = cos.toFixed (3) ;
-
-            document.getElementById("Counter1").innerHTML  = data["Counter1"] ;
-            document.getElementById("Counter2").innerHTML  = data["Counter2"] ;
-
-            if (firstShow)
-            {
-                if (Object.hasOwn (data, "p3Real"))
-                {
-                    setHideShow (hideCT3, showMode) ;
-                    hasCT3 = true ;
-                }
-                if (Object.hasOwn (data, "p4Real"))
-                {
-                    setHideShow (hideCT4, showMode) ;
-                    hasCT4 = true ;
-                }
-                firstShow = false ;
-            }
-
-            if (hasCT3)
+        document.getElementById("vRms").innerHTML   = data["vRms"] ;
+        document.getElementById("p1Real").innerHTML = data["p1Real"] ;
+        document.getElementById("p1App").innerHTML  = data["p1App"] ;
+        document.getElementById("p2Real").innerHTML = data["p2Real"] ;
+        document.getElementById("p2App").innerHTML  = data["p2App"] ;
+        document.getElementById("pDiv").innerHTML   = data["pDiv"] ;
+
+        let cos = Number (data["cPhi1"]) / 1000 ; 
+        document.getElementById("cPhi1").innerHTML  = cos.toFixed (3) ;
+        cos = Number (data["cPhi2"]) / 1000 ; 
+        document.getElementById("cPhi2").innerHTML  = cos.toFixed (3) ;
+
+        document.getElementById("Counter1").innerHTML  = data["Counter1"] ;
+        document.getElementById("Counter2").innerHTML  = data["Counter2"] ;
+
+        if (firstShow)
+        {
+            if (Object.hasOwn (data, "p3Real"))
             {
-                document.getElementById("p3Real").innerHTML = data["p3Real"] ;
-                document.getElementById("p3App").innerHTML  = data["p3App"] ;
-                cos = Number (data["cPhi3"]) / 1000 ; 
-                document.getElementById("cPhi3").innerHTML  = cos.toFixed (3) ;
-        
+                setHideShow (hideCT3, showMode) ;
+                hasCT3 = true ;
             }
-            if (hasCT4)
+            if (Object.hasOwn (data, "p4Real"))
             {
-                document.getElementById("p4Real").innerHTML = data["p4Real"] ;
-                document.getElementById("p4App").innerHTML  = data["p4App"] ;
-                cos = Number (data["cPhi4"]) / 1000 ; 
-                document.getElementById("cPhi4").innerHTML  = cos.toFixed (3) ;
+                setHideShow (hideCT4, showMode) ;
+                hasCT4 = true ;
             }
+            firstShow = false ;
         }
-        updateEnergyTotalGroup () ;
-    }) ;
+
+        if (hasCT3)
+        {
+            document.getElementById("p3Real").innerHTML = data["p3Real"] ;
+            document.getElementById("p3App").innerHTML  = data["p3App"] ;
+            cos = Number (data["cPhi3"]) / 1000 ; 
+            document.getElementById("cPhi3").innerHTML  = cos.toFixed (3) ;
+    
+        }
+        if (hasCT4)
+        {
+            document.getElementById("p4Real").innerHTML = data["p4Real"] ;
+            document.getElementById("p4App").innerHTML  = data["p4App"] ;
+            cos = Number (data["cPhi4"]) / 1000 ; 
+            document.getElementById("cPhi4").innerHTML  = cos.toFixed (3) ;
+        }
+    }
 }
 
-function updateEnergyTotalGroup ()
+function updateEnergyTotalGroup (data)
 {
-    getServerData ("energy.cgi/?mid=Total").then (data => {
-        if (data !== null  &&  data["date"] != -1)
-        {
+    if (data !== null  &&  data["date"] != -1)
+    {
 console.log ("updateEnergyTotalGroup ", JSON.stringify(data)) ;
-            let date = Number (data["date"]) ;
-            let string = "" + (date >> 16) + "/" + ((date >> 8) & 0xFF) + "/" + (date & 0xFF) ;
-            document.getElementById("etdate").innerHTML = string ;
-            document.getElementById("et0").innerHTML  = data["e0"] ;
-            document.getElementById("et1").innerHTML  = data["e1"] ;
-            document.getElementById("et2").innerHTML  = data["e2"] ;
-            document.getElementById("et3").innerHTML  = data["e3"] ;
-            document.getElementById("et4").innerHTML  = data["e4"] ;
-            if (hasCT3)
-            {
-                document.getElementById("et5").innerHTML = data["e5"] ;
-            }
-            if (hasCT4)
-            {
-                document.getElementById("et6").innerHTML = data["e6"] ;
-            }
-            document.getElementById("et7").innerHTML = data["e7"] ;
-            document.getElementById("et8").innerHTML = data["e8"] ;
+        let date = Number (data["date"]) ;
+        let string = "" + (date >> 16) + "/" + ((date >> 8) & 0xFF) + "/" + (date & 0xFF) ;
+        document.getElementById("etdate").innerHTML = string ;
+        document.getElementById("et0").innerHTML  = data["e0"] ;
+        document.getElementById("et1").innerHTML  = data["e1"] ;
+        document.getElementById("et2").innerHTML  = data["e2"] ;
+        document.getElementById("et3").innerHTML  = data["e3"] ;
+        document.getElementById("et4").innerHTML  = data["e4"] ;
+        if (hasCT3)
+        {
+            document.getElementById("et5").innerHTML = data["e5"] ;
         }
-        else
+        if (hasCT4)
         {
-            document.getElementById("etdate").innerHTML = "" ;
-            document.getElementById("et0").innerHTML = "-" ;
-            document.getElementById("et1").innerHTML = "-" ;
-            document.getElementById("et2").innerHTML = "-" ;
-            document.getElementById("et3").innerHTML = "-" ;
-            document.getElementById("et4").innerHTML = "-" ;
-            document.getElementById("et5").innerHTML = "-" ;
-            document.getElementById("et6").innerHTML = "-" ;
-            document.getElementById("et7").innerHTML = "-" ;
-            document.getElementById("et8").innerHTML = "-" ;
+            document.getElementById("et6").innerHTML = data["e6"] ;
         }
-        updateEnergyTodayGroup () ;
-    }) ;
+        document.getElementById("et7").innerHTML = data["e7"] ;
+        document.getElementById("et8").innerHTML = data["e8"] ;
+    }
+    else
+    {
+        document.getElementById("etdate").innerHTML = "" ;
+        document.getElementById("et0").innerHTML = "-" ;
+        document.getElementById("et1").innerHTML = "-" ;
+        document.getElementById("et2").innerHTML = "-" ;
+        document.getElementById("et3").innerHTML = "-" ;
+        document.getElementById("et4").innerHTML = "-" ;
+        document.getElementById("et5").innerHTML = "-" ;
+        document.getElementById("et6").innerHTML = "-" ;
+        document.getElementById("et7").innerHTML = "-" ;
+        document.getElementById("et8").innerHTML = "-" ;
+    }
 }
 
-function updateEnergyTodayGroup ()
+function updateEnergyTodayGroup (data)
 {
-    getServerData ("energy.cgi/?mid=Day").then (data => {
-        if (data !== null  &&  data["date"] != -1)
-        {
+    if (data !== null  &&  data["date"] != -1)
+    {
 console.log ("updateEnergyTodayGroup ", JSON.stringify(data)) ;
-            let date = Number (data["date"]) ;
-            let string = "" + (date >> 16) + "/" + ((date >> 8) & 0xFF) + "/" + (date & 0xFF) ;
-            document.getElementById("eddate").innerHTML = string ;
-            document.getElementById("ed0").innerHTML  = data["e0"] ;
-            document.getElementById("ed1").innerHTML  = data["e1"] ;
-            document.getElementById("ed2").innerHTML  = data["e2"] ;
-            document.getElementById("ed3").innerHTML  = data["e3"] ;
-            document.getElementById("ed4").innerHTML  = data["e4"] ;
-            if (hasCT3)
-            {
-                document.getElementById("ed5").innerHTML = data["e5"] ;
-            }
-            if (hasCT4)
-            {
-                document.getElementById("ed6").innerHTML = data["e6"] ;
-            }
-            document.getElementById("ed7").innerHTML = data["e7"] ;
-            document.getElementById("ed8").innerHTML = data["e8"] ;
+        let date = Number (data["date"]) ;
+        let string = "" + (date >> 16) + "/" + ((date >> 8) & 0xFF) + "/" + (date & 0xFF) ;
+        document.getElementById("eddate").innerHTML = string ;
+        document.getElementById("ed0").innerHTML  = data["e0"] ;
+        document.getElementById("ed1").innerHTML  = data["e1"] ;
+        document.getElementById("ed2").innerHTML  = data["e2"] ;
+        document.getElementById("ed3").innerHTML  = data["e3"] ;
+        document.getElementById("ed4").innerHTML  = data["e4"] ;
+        if (hasCT3)
+        {
+            document.getElementById("ed5").innerHTML = data["e5"] ;
         }
-        else
+        if (hasCT4)
         {
-            document.getElementById("eddate").innerHTML = "" ;
-            document.getElementById("ed0").innerHTML = "-" ;
-            document.getElementById("ed1").innerHTML = "-" ;
-            document.getElementById("ed2").innerHTML = "-" ;
-            document.getElementById("ed3").innerHTML = "-" ;
-            document.getElementById("ed4").innerHTML = "-" ;
-            document.getElementById("ed5").innerHTML = "-" ;
-            document.getElementById("ed6").innerHTML = "-" ;
-            document.getElementById("ed7").innerHTML = "-" ;
-            document.getElementById("ed8").innerHTML = "-" ;
+            document.getElementById("ed6").innerHTML = data["e6"] ;
         }
-    })
+        document.getElementById("ed7").innerHTML = data["e7"] ;
+        document.getElementById("ed8").innerHTML = data["e8"] ;
+    }
+    else
+    {
+        document.getElementById("eddate").innerHTML = "" ;
+        document.getElementById("ed0").innerHTML = "-" ;
+        document.getElementById("ed1").innerHTML = "-" ;
+        document.getElementById("ed2").innerHTML = "-" ;
+        document.getElementById("ed3").innerHTML = "-" ;
+        document.getElementById("ed4").innerHTML = "-" ;
+        document.getElementById("ed5").innerHTML = "-" ;
+        document.getElementById("ed6").innerHTML = "-" ;
+        document.getElementById("ed7").innerHTML = "-" ;
+        document.getElementById("ed8").innerHTML = "-" ;
+    }
 }
 
 function updateEnergyHistoGroup ()
@@ -311,9 +303,22 @@ console.log ("sendToServer " + urlData + " " + JSON.stringify (jsonData)) ;
 
 //------------------------------------------------------------------
 
-function updateDisplay ()
+// All the live values are in one snapshot, pushed by the server each second
+
+function updateDisplay (data)
 {
-    updatePowerGroup () ;
+    if (data === null)
+    {
+        updatePowerGroup (null) ;
+        updateEnergyTotalGroup (null) ;
+        updateEnergyTodayGroup (null) ;
+    }
+    else
+    {
+        updatePowerGroup (data ["volt"]) ;
+        updateEnergyTotalGroup (data ["eTotal"]) ;
+        updateEnergyTodayGroup (data ["eDay"]) ;
+    }
 }
 
 //------------------------------------------------------------------
@@ -338,7 +343,8 @@ function updateEnergyNames ()
                 }
             }
         }
-        updateDisplay () ;
+        // The names are known: start the live values update
+        common.liveStart (updateDisplay) ;
     }) ;
 }
 
@@ -418,8 +424,6 @@ setTimeout(() => {
     updateEnergyHistoGroup() ;
   }, "500");
 
-//  For periodic update of the page
-let updateTimer = setInterval (updateDisplay, 1200) ;
 
 //------------------------------------------------------------------
  
\ No newline at end of file
@@ -8,6 +8,8 @@ console.log ("chart start") ;
 const POWER_ITEM_MAX    = 9 ;           // Count ot 32 bit values in a sample
 const TODAY_HISTO       = 1 ;
 const YESTERDAY_HISTO   = 3 ;
+const TODAY_FULL        = 5 ;           // The full day in one response (LAN only)
+const DAY_FULL          = 6 ;
 const POWER_HISTO_MAGIC	= 0x12345678 ;	// To check data header validity
 
 const ENERGY_COUNT      = 9 ;           // Count of curves to display
@@ -15,6 +17,7 @@ const ENERGY_COUNT      = 9 ;           // Count of curves to display
 const HISTO_MAX         = 32 ;          // Max history depth
 
 let histoIndex = 0 ;
+let fullHistoOk = true ;                // false if the server can't send the full day in one response (WIFI)
 
 // Create a line chart
 var chart = anychart.line() ;
@@ -66,7 +69,8 @@ function updateEnergyNames (data)
 }
 
 //------------------------------------------------------------------
-// The server have a buffer of only 2 kB, not enough for the full history.
+// On LAN the server streams the full history in one response.
+// On WIFI the server have a buffer of only 2 kB, not enough for the full history.
 // Then the server allows to acquire it in 2 parts.
 
 // Example:             url = 'powerHisto.cgi/?mid=3&index=2'; 
@@ -77,8 +81,31 @@ async function serverHistoRequest (typeHisto)
     try
     {
 console.log ("serverHistoRequest " + typeHisto) ;
-        // Get the 1st part of the data
         let url ;
+        if (fullHistoOk)
+        {
+            // Get the full day
+            url = 'powerHisto.cgi' ;
+            url += '?mid=' + ((typeHisto == TODAY_HISTO) ? TODAY_FULL : DAY_FULL) ;
+            url += '&index=' + histoIndex ;
+
+            let response = await fetch (url, { method: "GET", headers: {"Content-Type": "application/json" } }) ;
+            if (response.ok)
+            {
+                let arrayBuffer = await response.arrayBuffer() ;
+                if (0 == buildData (arrayBuffer, 1))
+                {
+                    ackDialog ("History", "Data not available") ;
+                    throw "Data not available" ;
+                }
+                updateChartData () ;
+                chart.draw() ;
+                return ;
+            }
+            fullHistoOk = false ;   // Not available: use the 2 parts requests
+        }
+
+        // Get the 1st part of the data
         url = 'powerHisto.cgi' ;
         url += '?mid=' + typeHisto ;
         url += '&index=' + histoIndex ;
@@ -9,6 +9,11 @@
 	05/22/23	ac	Creation
 	04/03/24	ac	Add CRC and size of the file system to the super bloc
 					This alows to compare 2 fisystem and detect change
+	10/18/26	ac	Add LRU block cache: directory searches and small reads no longer
+					access the device when the block is in the cache
+	10/18/26	ac	Search the path hash table when the file system has one (MFS_FS_VERSION2):
+					a path is found with 1 or 2 device reads, whatever its depth
+	10/18/26	ac	Add mfsDataAddress(): the file data can be read directly from the device
 
 ----------------------------------------------------------------------
 */
@@ -39,6 +44,108 @@ static	void	lockStub (void * param)
 	(void) param ;
 }
 
+//--------------------------------------------------------------------------------
+//	Block cache
+//	Small reads (directory headers, entries, names, small files) are done through
+//	a LRU cache of MFS_CACHE_BLOCKS blocks.
+//	Reads of MFS_CACHE_BLOCK_SIZE or more are done directly by the low level driver:
+//	streaming a large file must not evict the directory blocks from the cache.
+
+#define	MFS_CACHE_INVALID	0xFFFFFFFFu
+
+static	void	cacheInit (mfsCtx_t * pCtx)
+{
+	pCtx->cacheOn   = (pCtx->blockSize >= MFS_CACHE_BLOCK_SIZE) ? 1 : 0 ;
+	pCtx->cacheUse  = 0 ;
+	pCtx->cacheHit  = 0 ;
+	pCtx->cacheMiss = 0 ;
+#if (MFS_CACHE_BLOCKS != 0)
+	{
+		uint32_t	ii ;
+
+		for (ii = 0 ; ii < MFS_CACHE_BLOCKS ; ii++)
+		{
+			pCtx->cache [ii].address = MFS_CACHE_INVALID ;
+			pCtx->cache [ii].lastUse = 0 ;
+		}
+	}
+#endif
+}
+
+//--------------------------------------------------------------------------------
+//	Replaces pCtx->read() for all file system reads, except the super bloc
+
+static	int		cacheRead (mfsCtx_t * pCtx, uint32_t address, void * pBuffer, uint32_t size)
+{
+#if (MFS_CACHE_BLOCKS != 0)
+	uint8_t			* pData = (uint8_t *) pBuffer ;
+	mfsCacheBlock_t	* pBlock ;
+	uint32_t		blockAddress ;
+	uint32_t		offset ;
+	uint32_t		length ;
+	uint32_t		ii ;
+	int				err ;
+
+	if (pCtx->cacheOn == 0  ||  size >= MFS_CACHE_BLOCK_SIZE)
+	{
+		return pCtx->read (pCtx->userData, address, pBuffer, size) ;
+	}
+
+	while (size != 0)
+	{
+		blockAddress = address & ~(MFS_CACHE_BLOCK_SIZE - 1u) ;
+		offset = address - blockAddress ;
+		length = MFS_CACHE_BLOCK_SIZE - offset ;
+		if (length > size)
+		{
+			length = size ;
+		}
+
+		// Search the block in the cache, and the least recently used block
+		pBlock = & pCtx->cache [0] ;
+		for (ii = 0 ; ii < MFS_CACHE_BLOCKS ; ii++)
+		{
+			if (pCtx->cache [ii].address == blockAddress)
+			{
+				pBlock = & pCtx->cache [ii] ;
+				break ;
+			}
+			if (pCtx->cache [ii].lastUse < pBlock->lastUse)
+			{
+				pBlock = & pCtx->cache [ii] ;
+			}
+		}
+
+		if (ii < MFS_CACHE_BLOCKS)
+		{
+			pCtx->cacheHit++ ;
+		}
+		else
+		{
+			// Not in the cache: replace the least recently used block
+			pCtx->cacheMiss++ ;
+			err = pCtx->read (pCtx->userData, blockAddress, pBlock->data, MFS_CACHE_BLOCK_SIZE) ;
+			if (err != MFS_ENONE)
+			{
+				pBlock->address = MFS_CACHE_INVALID ;
+				pBlock->lastUse = 0 ;
+				return err ;
+			}
+			pBlock->address = blockAddress ;
+		}
+		pBlock->lastUse = ++pCtx->cacheUse ;
+
+		memcpy (pData, & pBlock->data [offset], length) ;
+		pData   += length ;
+		address += length ;
+		size    -= length ;
+	}
+	return MFS_ENONE ;
+#else
+	return pCtx->read (pCtx->userData, address, pBuffer, size) ;
+#endif
+}
+
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
 // Search a name in a directory
@@ -59,7 +166,7 @@ static	mfsError_t	searchDir (mfsCtx_t * pCtx, mfsDirHdr_t * address, const char
 	{
 		// Read the next block of the dir
 		dirAddress = (uint32_t) (uintptr_t) pNext ;
-		err = pCtx->read (pCtx->userData, dirAddress, & scratchpad, sizeof (mfsDirHdr_t)) ;
+		err = cacheRead (pCtx, dirAddress, & scratchpad, sizeof (mfsDirHdr_t)) ;
 		if (err != MFS_ENONE)
 		{
 			return err ;
@@ -71,13 +178,13 @@ static	mfsError_t	searchDir (mfsCtx_t * pCtx, mfsDirHdr_t * address, const char
 		for (ii = 0; ii < count; ii++)
 		{
 			// Read the entry header
-			err = pCtx->read (pCtx->userData, entryAddress, & scratchpad, sizeof (mfsEntryHdr_t)) ;
+			err = cacheRead (pCtx, entryAddress, & scratchpad, sizeof (mfsEntryHdr_t)) ;
 			if (err != MFS_ENONE)
 			{
 				return err ;
 			}
 			// Read the entry name after the header in the scratchpad
-			err = pCtx->read (pCtx->userData,
+			err = cacheRead (pCtx,
 							entryAddress + sizeof (mfsEntryHdr_t),
 							scratchpad.fileEntry.name,
 							scratchpad.fileEntry.entrySize - sizeof (mfsEntryHdr_t)) ;
@@ -104,6 +211,23 @@ static	mfsError_t	searchDir (mfsCtx_t * pCtx, mfsDirHdr_t * address, const char
 	return MFS_ENOTFOUND ;
 }
 
+//--------------------------------------------------------------------------------
+//	Search a full path in its bucket of the path hash table (see mfs.h)
+//	On return the scratchpad contain the fileEntry of the path
+
+static	mfsError_t	searchHash (mfsCtx_t * pCtx, const char * path)
+{
+	uint32_t		bucket ;
+
+	if (* path == '/')
+	{
+		path++ ;	// Skip the begining '/'
+	}
+	bucket = mfsHashPath (path) & (pCtx->hashCount - 1) ;
+
+	return searchDir (pCtx, (mfsDirHdr_t *) (uintptr_t) (pCtx->hashTable + (bucket << pCtx->blockPower2)), path) ;
+}
+
 //--------------------------------------------------------------------------------
 //	Traverse the path for an absolute path (beginning with '/')
 //	On return the scratchpad contain the fileEntry of the last name
@@ -128,6 +252,11 @@ static	mfsError_t	searchPath (mfsCtx_t * pCtx, mfsDirHdr_t * address, const char
 		return MFS_ENONE ;	// Found
 	}
 
+	if (pCtx->hashTable != 0)
+	{
+		return searchHash (pCtx, path) ;
+	}
+
 	pName = path ;
 	pDirBlock = address ;
 	while (1)
@@ -180,22 +309,38 @@ mfsError_t	mfsMount	(mfsCtx_t * pCtx)
 		pCtx->unlock = lockStub ; 
 	}
 	pCtx->lock (pCtx->userData) ;
+	pCtx->cacheOn = 0 ;		// Until the file system is checked
 
 	// Read the super bloc header at offset 0
 	err = pCtx->read (pCtx->userData, 0, pSuper, sizeof (mfsSuperBloc_t)) ;
 	if (err == MFS_ENONE)
 	{
-		if ((pSuper->magic != MFS_SB_MAGIC)  ||  (pSuper->version != MFS_FS_VERSION)  ||
+		if ((pSuper->magic != MFS_SB_MAGIC)  ||
+		    (pSuper->version != MFS_FS_VERSION  &&  pSuper->version != MFS_FS_VERSION2)  ||
 		    (pSuper->blockSize != (1u << pSuper->blockPower2)))
 		{
 			err = MFS_ECORRUPT ;
 		}
+		else if (pSuper->version == MFS_FS_VERSION2  &&
+		         (pSuper->hashTable == 0  ||  pSuper->hashCount == 0  ||
+		          (pSuper->hashCount & (pSuper->hashCount - 1)) != 0))
+		{
+			err = MFS_ECORRUPT ;	// Invalid path hash table
+		}
 		else
 		{
 			pCtx->blockSize   = pSuper->blockSize ;
 			pCtx->blockPower2 = pSuper->blockPower2 ;
 			pCtx->fsCRC       = pSuper->fsCRC ;
 			pCtx->fsSize      = pSuper->fsSize ;
+			pCtx->hashTable   = 0 ;		// Version 1: search the directories
+			pCtx->hashCount   = 0 ;
+			if (pSuper->version == MFS_FS_VERSION2)
+			{
+				pCtx->hashTable = pSuper->hashTable ;
+				pCtx->hashCount = pSuper->hashCount ;
+			}
+			cacheInit (pCtx) ;
 			err = MFS_ENONE ;
 		}
 	}
@@ -280,7 +425,7 @@ mfsError_t		mfsRead		(mfsFile_t * pFile, void * pBuffer, int32_t size)
 		}
 		if (readSize > 0)
 		{
-			err = pFile->pCtx->read (pFile->pCtx->userData, pFile->dataAddress + pFile->position, pBuffer, readSize) ;
+			err = cacheRead (pFile->pCtx, pFile->dataAddress + pFile->position, pBuffer, readSize) ;
 			if (err == MFS_ENONE)
 			{
 				pFile->position += readSize ;
@@ -383,6 +528,20 @@ int32_t		mfsSize		(mfsFile_t * pFile)
 	return pFile->fileSize ;
 }
 
+//--------------------------------------------------------------------------------
+//	Get the device address of size bytes at offset in the file, as given to the low level driver read().
+//	Allows the user to copy the file data directly from the device, e.g. by DMA
+
+mfsError_t		mfsDataAddress	(mfsFile_t * pFile, int32_t offset, int32_t size, uint32_t * pAddress)
+{
+	if (offset < 0  ||  size < 0  ||  size > pFile->fileSize - offset)
+	{
+		return MFS_EINVAL ;
+	}
+	* pAddress = pFile->dataAddress + (uint32_t) offset ;
+	return MFS_ENONE ;
+}
+
 //--------------------------------------------------------------------------------
 
 void		mfsRewind	(mfsFile_t* pFile)
@@ -415,7 +574,7 @@ mfsError_t		mfsDirOpen (mfsCtx_t * pCtx, const char * path, mfsDir_t * pDir)
 			pDir->address  = scratchpad.fileEntry.blockNum << pCtx->blockPower2 ;
 			pDir->index    = 0 ;
 			pDir->offset   = sizeof (mfsDirHdr_t) ;	// Offset of 1st entry
-			err = pCtx->read (pCtx->userData, pDir->address, & scratchpad, sizeof (mfsDirHdr_t)) ;
+			err = cacheRead (pCtx, pDir->address, & scratchpad, sizeof (mfsDirHdr_t)) ;
 			if (err == MFS_ENONE)
 			{
 				pDir->pNext    = scratchpad.dirBloc.pNext ;
@@ -451,7 +610,7 @@ mfsError_t		mfsDirRead		(mfsCtx_t * pCtx, mfsDir_t * pDir, mfsDirEntry_t * pEntr
 			pDir->address  = (uintptr_t) pDir->pNext ;
 			pDir->index    = 0 ;
 			pDir->offset   = sizeof (mfsDirHdr_t) ;	// Offset of 1st entry
-			err = pCtx->read (pCtx->userData, pDir->address, & scratchpad, sizeof (mfsDirHdr_t)) ;
+			err = cacheRead (pCtx, pDir->address, & scratchpad, sizeof (mfsDirHdr_t)) ;
 			if (err == MFS_ENONE)
 			{
 				pDir->pNext    = scratchpad.dirBloc.pNext ;
@@ -469,14 +628,14 @@ mfsError_t		mfsDirRead		(mfsCtx_t * pCtx, mfsDir_t * pDir, mfsDirEntry_t * pEntr
 	if (err == MFS_ENONE)
 	{
 		entryAddress = pDir->address + pDir->offset ;
-		err = pCtx->read (pCtx->userData, entryAddress, & scratchpad, sizeof (mfsEntryHdr_t)) ;
+		err = cacheRead (pCtx, entryAddress, & scratchpad, sizeof (mfsEntryHdr_t)) ;
 		if (err == MFS_ENONE)
 		{
 			pEntry->type = scratchpad.fileEntry.flags ;
 			pEntry->size = scratchpad.fileEntry.fileSize ;
 
 			// Read the entry name
-			err = pCtx->read (pCtx->userData,
+			err = cacheRead (pCtx,
 							entryAddress + sizeof (mfsEntryHdr_t),
 							pEntry->name,
 							scratchpad.fileEntry.entrySize - sizeof (mfsEntryHdr_t)) ;
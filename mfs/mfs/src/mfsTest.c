@@ -7,20 +7,38 @@
 
 	When		Who	What
 	05/31/23	ac	Creation
+	10/18/26	ac	Optionally read the image through the W25Q flash emulator
+	10/18/26	ac	Add openBench(): count of device reads per mfsOpen()
+	10/18/26	ac	dumpFile() checks the data read directly from the device with mfsDataAddress()
 
 ----------------------------------------------------------------------
 */
 
 #include	<stdint.h>
 #include	<stdio.h>
+#include	<string.h>
 #include	"mfs.h"
 
+// 1 to copy the image to an emulated W25Q flash, and read the MFS from this flash as AASun does
+#define	MFS_TEST_W25Q_EMU	0
+
+#if (MFS_TEST_W25Q_EMU == 1)
+#include	"w25qEmu.h"
+
+#define	FLASH_FILE			"flash.bin"
+#define	FLASH_SIZE			(8u * 1024u * 1024u)	// W25Q64
+#define	FLASH_MFS_ADDR		0x100000u				// Address of the MFS in the flash, as in AASun
+#endif
+
 //--------------------------------------------------------------------------------
 
 // The MFS read function to set in the MFS context
 
 static	int simRead (void * userData, uint32_t address, void * pBuffer, uint32_t size) ;
 
+// Counters of the device reads done by simRead
+static	uint32_t	readCount ;
+
 //--------------------------------------------------------------------------------
 // Example of reading an MFS file
 
@@ -83,10 +101,162 @@ void	dumpFile (const char * filePath)
 	}
 	printf (">\nBytes read: %d\n", fileSize) ;	// End marker
 
+	// Read the end of the file directly from the device, as AASun sends the HTTP files
+	if (fileSize != 0)
+	{
+		uint8_t		directBuffer [sizeof (readBuffer)] ;
+		uint32_t	address ;
+
+		nn = (fileSize > sizeof (readBuffer)) ? sizeof (readBuffer) : fileSize ;
+		mfsSeek (& mfsFile, (int32_t) (fileSize - nn), MFS_SEEK_SET) ;
+		mfsRead (& mfsFile, readBuffer, nn) ;
+		err = mfsDataAddress (& mfsFile, (int32_t) (fileSize - nn), nn, & address) ;
+		if (err == MFS_ENONE)
+		{
+			simRead (NULL, address, directBuffer, nn) ;
+		}
+		printf ("Direct read: %s\n", (err == MFS_ENONE  &&  memcmp (readBuffer, directBuffer, nn) == 0) ? "Ok" : "ERROR") ;
+		if (mfsDataAddress (& mfsFile, (int32_t) (fileSize - nn), nn + 1, & address) != MFS_EINVAL)
+		{
+			printf ("Direct read: the range after the end of file is accepted\n") ;
+		}
+	}
+
 	mfsClose  (& mfsFile) ;
 	mfsUmount (& mfsCtx) ;
 }
 
+//--------------------------------------------------------------------------------
+//	Benchmark of the path search: count of device reads per mfsOpen() for every file
+//	of the image, with the path hash table (image built with mfsBuild -x) and
+//	with the directory search.
+//	Cold: the file system is mounted before each mfsOpen(), so the block cache is empty.
+//	Warm: all the files are opened again, the cache keeps the last used blocks.
+
+#define	BENCH_PATH_MAX		64
+#define	BENCH_PATH_SIZE		128
+
+static	char		benchPath [BENCH_PATH_MAX][BENCH_PATH_SIZE] ;
+static	uint32_t	benchPathCount ;
+
+// Walk a directory to collect the path of the files
+
+static	void	benchWalk (mfsCtx_t * pCtx, const char * dirPath)
+{
+	mfsDir_t		dir ;
+	mfsDirEntry_t	entry ;
+	char			path [BENCH_PATH_SIZE] ;
+
+	if (mfsDirOpen (pCtx, dirPath, & dir) != MFS_ENONE)
+	{
+		return ;
+	}
+	while (mfsDirRead (pCtx, & dir, & entry) == MFS_ENONE)
+	{
+		snprintf (path, sizeof (path), "%s%s%s", dirPath, (dirPath [1] == 0) ? "" : "/", entry.name) ;
+		if ((entry.type & MFS_DIR) != 0)
+		{
+			benchWalk (pCtx, path) ;
+		}
+		else if (benchPathCount < BENCH_PATH_MAX)
+		{
+			strcpy (benchPath [benchPathCount++], path) ;
+		}
+	}
+}
+
+// Mount then open the files. bHash 0 to search the directories
+// Returns the count of device reads of the warm opens
+
+static	uint32_t	benchOpen (mfsCtx_t * pCtx, int bHash, uint32_t * pCold)
+{
+	mfsFile_t	mfsFile ;
+	uint32_t	ii, hashTable ;
+
+	hashTable = pCtx->hashTable ;
+	for (ii = 0 ; ii < benchPathCount ; ii++)
+	{
+		mfsMount (pCtx) ;
+		if (! bHash)
+		{
+			pCtx->hashTable = 0 ;	// Force the directory search
+		}
+		readCount = 0 ;
+		if (mfsOpen (pCtx, & mfsFile, benchPath [ii]) != MFS_ENONE)
+		{
+			printf ("mfsOpen error: %s\n", benchPath [ii]) ;
+		}
+		pCold [ii] = readCount ;
+	}
+
+	readCount = 0 ;
+	for (ii = 0 ; ii < benchPathCount ; ii++)
+	{
+		mfsOpen (pCtx, & mfsFile, benchPath [ii]) ;
+	}
+	pCtx->hashTable = hashTable ;
+	return readCount ;
+}
+
+void	openBench (void)
+{
+	mfsCtx_t	mfsCtx ;
+	uint32_t	coldHash [BENCH_PATH_MAX], coldDir [BENCH_PATH_MAX] ;
+	uint32_t	warmHash = 0, warmDir ;
+	uint32_t	sumHash = 0, sumDir = 0, ii ;
+	int			bHash ;
+
+	mfsCtx.userData = NULL ;
+	mfsCtx.lock     = NULL ;
+	mfsCtx.unlock   = NULL ;
+	mfsCtx.read     = simRead ;
+
+	if (mfsMount (& mfsCtx) != MFS_ENONE)
+	{
+		printf ("mfsMount error\nAbort\n") ;
+		return ;
+	}
+	bHash = mfsCtx.hashTable != 0 ;
+	benchPathCount = 0 ;
+	benchWalk (& mfsCtx, "/") ;
+
+	printf ("mfsOpen device reads, cache of %u blocks, %s\n", MFS_CACHE_BLOCKS,
+			bHash ? "image with hash table" : "image without hash table (see mfsBuild -x)") ;
+	warmDir = benchOpen (& mfsCtx, 0, coldDir) ;
+	if (bHash)
+	{
+		warmHash = benchOpen (& mfsCtx, 1, coldHash) ;
+	}
+
+	printf ("  %-40s %6s %6s\n", "Path (cold)", "Dir", bHash ? "Hash" : "") ;
+	for (ii = 0 ; ii < benchPathCount ; ii++)
+	{
+		printf ("  %-40s %6u", benchPath [ii], coldDir [ii]) ;
+		sumDir += coldDir [ii] ;
+		if (bHash)
+		{
+			printf (" %6u", coldHash [ii]) ;
+			sumHash += coldHash [ii] ;
+		}
+		printf ("\n") ;
+	}
+	if (benchPathCount != 0)
+	{
+		printf ("  %-40s %6.2f", "Average cold", (double) sumDir / benchPathCount) ;
+		if (bHash)
+		{
+			printf (" %6.2f", (double) sumHash / benchPathCount) ;
+		}
+		printf ("\n  %-40s %6.2f", "Average warm", (double) warmDir / benchPathCount) ;
+		if (bHash)
+		{
+			printf (" %6.2f", (double) warmHash / benchPathCount) ;
+		}
+		printf ("\n") ;
+	}
+	mfsUmount (& mfsCtx) ;
+}
+
 //--------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------
 //	This is to simulate the MFS Flash.
@@ -95,14 +265,62 @@ void	dumpFile (const char * filePath)
 static	char		* imageMfs = "image.bin" ;		// The filesystem to use 
 static	FILE		* imgFs ;
 
+#if (MFS_TEST_W25Q_EMU == 1)
+
+static	int simRead (void * userData, uint32_t address, void * pBuffer, uint32_t size)
+{
+	(void) userData  ; 
+	readCount++ ;
+	W25Q_SpiTakeRead (FLASH_MFS_ADDR + address, size) ;
+	W25Q_Read (pBuffer, FLASH_MFS_ADDR + address, size) ;
+	W25Q_SpiGiveRead () ;
+	return MFS_ENONE ;
+}
+
+//	Copy the image to the emulated flash, as SerEL does
+
+static	int	flashLoad (void)
+{
+	uint8_t			sector [W25Q_SECTOR_SIZE] ;
+	uint32_t		address = FLASH_MFS_ADDR ;
+	size_t			nn ;
+	w25qEmuStat_t	stat ;
+
+	if (! W25QEmu_Open (FLASH_FILE, FLASH_SIZE))
+	{
+		printf ("Can't open flash file: %s\r\n", FLASH_FILE) ;
+		return 0 ;
+	}
+
+	while (0 != (nn = fread (sector, 1, sizeof (sector), imgFs)))
+	{
+		W25Q_SpiTake () ;
+		W25Q_EraseSector (address) ;
+		W25Q_Write (sector, address, (uint32_t) nn) ;
+		W25Q_SpiGive () ;
+		address += W25Q_SECTOR_SIZE ;
+	}
+
+	W25QEmu_GetStat (& stat) ;
+	printf ("Flash loaded: %u bytes, %u erases, %u programs, %.3f s\n\n",
+			address - FLASH_MFS_ADDR, stat.eraseCount, stat.programCount, (double) W25QEmu_GetTime () / 1e6) ;
+	W25QEmu_ClearStat () ;
+	return 1 ;
+}
+
+#else
+
 static	int simRead (void * userData, uint32_t address, void * pBuffer, uint32_t size)
 {
 	(void) userData  ; 
+	readCount++ ;
 	fseek (imgFs, address, SEEK_SET) ;
 	fread (pBuffer, 1, size, imgFs) ;
 	return MFS_ENONE ;
 }
 
+#endif
+
 //	The files to dump:
 
 const char	* filePath1 = "/fonts/fonts2" ;
@@ -133,12 +351,34 @@ int	main ()
 		return 0 ;
 	}
 
+#if (MFS_TEST_W25Q_EMU == 1)
+	if (! flashLoad ())
+	{
+		fclose (imgFs) ;
+		return 0 ;
+	}
+#endif
+
 	for (uint32_t ii = 0 ; ii < filePathCount ; ii++)
 	{
 		dumpFile (filePath [ii]) ;
 		printf ("\n-------------------------------\n") ;
 	}
 
+	openBench () ;
+	printf ("\n-------------------------------\n") ;
+
+#if (MFS_TEST_W25Q_EMU == 1)
+	{
+		w25qEmuStat_t	stat ;
+
+		W25QEmu_GetStat (& stat) ;
+		printf ("Flash reads: %u, bytes: %u, time %.3f ms\n",
+				stat.readCount, stat.readBytes, (double) W25QEmu_GetTime () / 1e3) ;
+		W25QEmu_Close () ;
+	}
+#endif
+
 	fclose (imgFs) ;
 }
 
@@ -7,6 +7,9 @@
 
 	When		Who	What
 	05/22/23	ac	Creation
+	10/18/26	ac	Add -z: store the precompressed gzip variant of the files
+	10/18/26	ac	Add -c: block CRC table at the end of the image, for incremental updates
+	10/18/26	ac	Add -x: path hash table, the image is MFS_FS_VERSION2
 
 ----------------------------------------------------------------------
 */
@@ -31,6 +34,15 @@ uint32_t crc32		(uint32_t crc, const char * s, size_t n) ;
 //--------------------------------------------------------------------------------
 
 
+// Information to remember for the path hash table
+typedef struct
+{
+	mfsEntryHdr_t	entry ;				// Copy of the directory entry
+	char			* path ;			// Full path without the source directory
+	uint32_t		hash ;
+
+} hashInfo_t ;
+
 // Information to remember when creating a folder
 typedef struct
 {
@@ -48,11 +60,25 @@ char			* dst = "AASun_web.bin" ;	// Destination image path
 
 FILE			* dstFile ;
 
+// -z: if the file name.gz exists in the source directory, it is stored as name with the MFS_GZIP flag
+// The compressed variants are made before building the image, E.G.: gzip -k -9 *.js *.css *.html
+int				bGzip = 0 ;
+
 // The logical block size to use for the filesystem
 // It is different from FLASH erase block size
 uint32_t		blockSize   = 512 ;
 uint32_t		blockPower2 ;			// 2^blockPower2 = blockSize
 
+// The size of the blocks described by the CRC table, 0 for no table
+// This is the FLASH erase block size of the ESP32, so it can rewrite only the modified erase blocks
+uint32_t		crcBlockSize = 4096 ;
+
+// -x: add the path hash table, so mfsOpen() finds a path without searching the directories
+int				bHash = 0 ;
+hashInfo_t		* pHashInfo ;			// All the entries of the file system
+uint32_t		hashInfoCount ;
+uint32_t		hashInfoMax ;
+
 uint8_t			* pDataBlock ;
 uint32_t		lastBlock ;				// This is always the bock num past the end of the file
 
@@ -63,7 +89,22 @@ mfsSuperBloc_t	* pSuperBloc ;
 #define			bloc2Addr(blocNum)			(blocNum << blockPower2)		
 
 // Some statistics of the created filesystem
-uint32_t		dirCount, fileCount ;
+uint32_t		dirCount, fileCount, gzipCount ;
+
+//--------------------------------------------------------------------------------
+//	Returns 1 if the file exists
+
+static	int	fileExists (const char * path)
+{
+	FILE	* pFile = fopen (path, "rb") ;
+
+	if (pFile == NULL)
+	{
+		return 0 ;
+	}
+	fclose (pFile) ;
+	return 1 ;
+}
 
 //--------------------------------------------------------------------------------
 //  Count trailing 0 of value (value 0 is forbidden)
@@ -181,6 +222,18 @@ printf ("D+ %u\n", lastBlock) ;
 		FILE			* dataFile ;
 		int32_t			nn ;
 		int32_t			fileSize ;
+		char			gzPath [PATH_MAX] ;
+
+		// Use the compressed variant if it exists
+		strcpy (gzPath, path) ;
+		strcat (gzPath, ".gz") ;
+		if (bGzip  &&  fileExists (gzPath))
+		{
+			printf ("  gzip %s\n", gzPath) ;
+			pEntry->flags |= MFS_GZIP ;
+			path = gzPath ;
+			gzipCount++ ;
+		}
 
 		dataFile = fopen (path, "rb") ;
 		if (dataFile == NULL)
@@ -204,6 +257,50 @@ printf ("D+ %u\n", lastBlock) ;
 	return pEntry ;
 }
 
+//--------------------------------------------------------------------------------
+//	Remember an entry for the path hash table
+//	path is the path of the entry in the source directory
+
+static	void	hashAdd (mfsEntryHdr_t * pEntry, const char * path)
+{
+	hashInfo_t	* pInfo ;
+	uint32_t	len ;
+
+	if (! bHash)
+	{
+		return ;
+	}
+
+	path += strlen (src) ;			// Skip "<source_dir>/"
+	while (* path == '/')
+	{
+		path++ ;
+	}
+	len = sizeof (mfsEntryHdr_t) + strlen (path) + 1 ;	// +1 for final 0
+	len = (len + 3) & ~0x03 ;		// Align len to multiple of 4
+	if (len > MFS_ENTRY_SIZE_MAX)
+	{
+		printf ("Path too long for the hash table: %s\nAbort\n", path) ;
+		exit (0) ;
+	}
+
+	if (hashInfoCount == hashInfoMax)
+	{
+		hashInfoMax = (hashInfoMax == 0) ? 64 : hashInfoMax * 2 ;
+		pHashInfo   = realloc (pHashInfo, hashInfoMax * sizeof (hashInfo_t)) ;
+		if (pHashInfo == NULL)
+		{
+			printf ("Malloc error\n") ;
+			exit (0) ;
+		}
+	}
+	pInfo = & pHashInfo [hashInfoCount++] ;
+	pInfo->entry = * pEntry ;
+	pInfo->entry.entrySize = len ;
+	pInfo->path  = strdup (path) ;
+	pInfo->hash  = mfsHashPath (pInfo->path) ;
+}
+
 //--------------------------------------------------------------------------------
 // Walk the source tree to build the MFS image
 
@@ -234,8 +331,20 @@ void	build (dirCtx_t * pDirCtx, char * src)
 			strcat (currentPath, entry->d_name) ;
 			if (entry->d_type == DT_REG)
 			{
+				// -z: a compressed variant is stored with the name of the uncompressed file
+				size_t	len = strlen (currentPath) ;
+				if (bGzip  &&  len > 3  &&  strcmp (currentPath + len - 3, ".gz") == 0)
+				{
+					currentPath [len - 3] = 0 ;
+					if (fileExists (currentPath))
+					{
+						continue ;
+					}
+					currentPath [len - 3] = '.' ;
+				}
+
 				printf ("F %s\n", currentPath) ;
-				addEntry (pDirCtx, MFS_FILE, entry->d_name, currentPath) ;
+				hashAdd (addEntry (pDirCtx, MFS_FILE, entry->d_name, currentPath), currentPath) ;
 			}
 			else if (entry->d_type == DT_DIR)
 			{
@@ -247,6 +356,7 @@ void	build (dirCtx_t * pDirCtx, char * src)
 
 				// New dir entry, set the 1st dir block 
 				pEntry->blockNum = lastBlock ;
+				hashAdd (pEntry, currentPath) ;
 
 				pNewDirCtx = newDirCtx (lastBlock++) ;
 				pNewDirCtx->pDir->pParent = bloc2DirAddr (pDirCtx->blockNum) ;
@@ -265,12 +375,164 @@ void	build (dirCtx_t * pDirCtx, char * src)
 	closedir (dir) ; 
 }
 
+//--------------------------------------------------------------------------------
+//	Append the CRC table to the image: the CRC32 of each crcBlockSize block of the file system.
+//	The file system is padded to a multiple of crcBlockSize, the table is padded the same way.
+//	The 1st CRC excludes the super block, which contains fsCRC and is always updated.
+//	The table is included in fsCRC.
+
+static	void	buildCrcTable (void)
+{
+	uint32_t	blocksPerCrc = crcBlockSize / blockSize ;
+	uint32_t	crcCount, tableSize, ii, jj ;
+	uint32_t	* pCrcTable ;
+
+	// Pad the file system
+	memset (pDataBlock, 0, blockSize) ;
+	fseek  (dstFile, bloc2Addr (lastBlock), SEEK_SET) ;
+	while ((lastBlock % blocksPerCrc) != 0)
+	{
+		fwrite (pDataBlock, blockSize, 1, dstFile) ;
+		lastBlock++ ;
+	}
+
+	crcCount  = lastBlock / blocksPerCrc ;
+	tableSize = (crcCount * sizeof (uint32_t) + crcBlockSize - 1) & ~(crcBlockSize - 1) ;
+	pCrcTable = (uint32_t *) calloc (tableSize, 1) ;
+	if (pCrcTable == NULL)
+	{
+		printf ("Malloc error\n") ;
+		exit (1) ;
+	}
+
+	// Compute the CRC of the blocks
+	fseek  (dstFile, 0, SEEK_SET) ;
+	for (ii = 0 ; ii < crcCount ; ii++)
+	{
+		pCrcTable [ii] = crc32Init () ;
+		for (jj = 0 ; jj < blocksPerCrc ; jj++)
+		{
+			fread (pDataBlock, blockSize, 1, dstFile) ;
+			if (ii != 0  ||  jj != 0)
+			{
+				pCrcTable [ii] = crc32 (pCrcTable [ii], (char *) pDataBlock, blockSize) ;
+			}
+		}
+	}
+
+	// Write the table
+	fseek  (dstFile, bloc2Addr (lastBlock), SEEK_SET) ;
+	fwrite (pCrcTable, tableSize, 1, dstFile) ;
+	pSuperBloc->crcTable     = bloc2Addr (lastBlock) ;
+	pSuperBloc->crcBlockSize = crcBlockSize ;
+	lastBlock += tableSize / blockSize ;
+
+	free (pCrcTable) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Append the path hash table to the image: the bucket blocks then their next blocks (see mfs.h)
+//	The count of buckets is computed so that the buckets are at most half full.
+//	The table is before the CRC table, so it is described by the CRC table.
+
+static	void	buildHashTable (void)
+{
+	uint8_t			* pTable ;			// The buckets then the next blocks
+	mfsDirHdr_t		* pDir ;
+	uint32_t		hashCount, nextCount, tableBlock, blockCount, current, offset, bucket, count, ii ;
+	uint32_t		size, countMax = 0 ;
+
+	size = 0 ;
+	for (ii = 0 ; ii < hashInfoCount ; ii++)
+	{
+		size += pHashInfo [ii].entry.entrySize ;
+	}
+	hashCount = 1 ;
+	while (hashCount * (blockSize - sizeof (mfsDirHdr_t)) < size * 2)
+	{
+		hashCount *= 2 ;
+	}
+
+	tableBlock = lastBlock ;
+	blockCount = hashCount ;
+	pTable = (uint8_t *) calloc (blockCount, blockSize) ;
+	if (pTable == NULL)
+	{
+		printf ("Malloc error\n") ;
+		exit (1) ;
+	}
+
+	// Fill the buckets, add a next block to a full bucket as addEntry() does for a directory
+	nextCount = 0 ;
+	for (bucket = 0 ; bucket < hashCount ; bucket++)
+	{
+		current = bucket ;		// Index of the current block of the bucket in pTable
+		offset  = sizeof (mfsDirHdr_t) ;
+		count  = 0 ;
+		for (ii = 0 ; ii < hashInfoCount ; ii++)
+		{
+			if ((pHashInfo [ii].hash & (hashCount - 1)) != bucket)
+			{
+				continue ;
+			}
+			size = pHashInfo [ii].entry.entrySize ;
+			pDir = (mfsDirHdr_t *) (pTable + current * blockSize) ;
+			if ((offset + size) > blockSize)
+			{
+				pTable = (uint8_t *) realloc (pTable, (blockCount + 1) * blockSize) ;
+				if (pTable == NULL)
+				{
+					printf ("Malloc error\n") ;
+					exit (1) ;
+				}
+				pDir = (mfsDirHdr_t *) (pTable + current * blockSize) ;
+				pDir->pNext = bloc2DirAddr (tableBlock + blockCount) ;
+				pDir = (mfsDirHdr_t *) (pTable + blockCount * blockSize) ;
+				memset (pDir, 0, blockSize) ;
+				pDir->pPrev = bloc2DirAddr (tableBlock + current) ;
+				current = blockCount++ ;
+				offset  = sizeof (mfsDirHdr_t) ;
+				nextCount++ ;
+			}
+			memcpy ((uint8_t *) pDir + offset, & pHashInfo [ii].entry, sizeof (mfsEntryHdr_t)) ;
+			strcpy ((char *) pDir + offset + sizeof (mfsEntryHdr_t), pHashInfo [ii].path) ;
+			offset += size ;
+			pDir->count++ ;
+			count++ ;
+		}
+		if (count > countMax)
+		{
+			countMax = count ;
+		}
+	}
+
+	fseek  (dstFile, bloc2Addr (tableBlock), SEEK_SET) ;
+	fwrite (pTable, blockSize, blockCount, dstFile) ;
+	pSuperBloc->version   = MFS_FS_VERSION2 ;
+	pSuperBloc->hashTable = bloc2Addr (tableBlock) ;
+	pSuperBloc->hashCount = hashCount ;
+	lastBlock += blockCount ;
+
+	printf ("Hash buckets:    %8u\nHash next blocks:%8u\nHash bucket max: %8u entries\n",
+			hashCount, nextCount, countMax) ;
+
+	for (ii = 0 ; ii < hashInfoCount ; ii++)
+	{
+		free (pHashInfo [ii].path) ;
+	}
+	free (pTable) ;
+	free (pHashInfo) ;
+}
+
 //--------------------------------------------------------------------------------
 
 void usage (void)
 {
-	printf ("usage: mfsBuid -i <source_dir> -o <output_image_file> -b <block_size>\n") ;
-	printf ("Default: -i %s  -o %s  -b %u\n", src, dst, blockSize) ;
+	printf ("usage: mfsBuid -i <source_dir> -o <output_image_file> -b <block_size> -c <crc_block_size> [-z] [-x]\n") ;
+	printf ("  -z  Store name.gz in place of name, with the gzip flag\n") ;
+	printf ("  -x  Add the path hash table (file system version 2)\n") ;
+	printf ("  -c  Size of the blocks of the CRC table, 0 for no table\n") ;
+	printf ("Default: -i %s  -o %s  -b %u  -c %u\n", src, dst, blockSize, crcBlockSize) ;
 }
 
 //--------------------------------------------------------------------------------
@@ -281,7 +543,7 @@ int	main (int argc, char ** argv)
 	int					c ;
 
 	// Parse command line parameters
-	while ((c = getopt(argc, argv, "i:o:b:?")) != -1)
+	while ((c = getopt(argc, argv, "i:o:b:c:zx?")) != -1)
 	{
 		switch (c)
 		{
@@ -297,6 +559,18 @@ int	main (int argc, char ** argv)
 				blockSize = strtoul (optarg, NULL, 0) ;
 				break;
 
+			case 'c':
+				crcBlockSize = strtoul (optarg, NULL, 0) ;
+				break;
+
+			case 'z':
+				bGzip = 1 ;			// Use the precompressed variants
+				break;
+
+			case 'x':
+				bHash = 1 ;			// Add the path hash table
+				break;
+
 			case '?':
 				usage () ;
 				return 0 ;
@@ -317,6 +591,13 @@ int	main (int argc, char ** argv)
 	}
 	blockPower2 = ctz (blockSize) ;
 
+	// Check the CRC table block size: a multiple of the block size
+	if (crcBlockSize != 0  &&  ((crcBlockSize & (crcBlockSize - 1)) != 0  ||  crcBlockSize < blockSize))
+	{
+		printf ("Invalid CRC block size: %u\n", crcBlockSize) ;
+		return 0 ;
+	}
+
 	// Open the destination image file
 	dstFile = fopen (dst, "wb+") ;
 	if (dstFile == NULL)
@@ -358,11 +639,21 @@ int	main (int argc, char ** argv)
 
 	fileCount = 0;
 	dirCount  = 0 ;
+	gzipCount = 0 ;
 
 	build (pRootCtx, src) ;		// Build the MFS filesystem
 
 	releaseDirCtx (pRootCtx) ;
 
+	if (bHash)
+	{
+		buildHashTable () ;
+	}
+	if (crcBlockSize != 0)
+	{
+		buildCrcTable () ;
+	}
+
 	// Compute file CRC excluding the 1st block (supe block containing the CRC)
 	fseek  (dstFile, blockSize, SEEK_SET) ;
 	pSuperBloc->fsCRC = crc32Init () ;
@@ -376,8 +667,13 @@ int	main (int argc, char ** argv)
 	fwrite (pSuperBloc, blockSize, 1, dstFile) ;
 
 	printf ("Directory count: %8u\nFile count:      %8u\n", dirCount, fileCount) ;
+	printf ("Gzip file count: %8u\n", gzipCount) ;
 	printf ("File size:       %8u\nCrc:           0x%08X\n", pSuperBloc->fsSize, pSuperBloc->fsCRC) ;
 	printf ("Block size:      %8u\n", blockSize) ;
+	if (crcBlockSize != 0)
+	{
+		printf ("CRC block size:  %8u\nCRC table:       %8u\n", crcBlockSize, pSuperBloc->crcTable) ;
+	}
 
 	free (pSuperBloc) ;
 	free (pDataBlock) ;
@@ -0,0 +1,1009 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	w25qEmu.c	Host emulator of the Winbond W25Qxx SPI flash
+				Implements the w25q.h API on a memory mapped file, so the code
+				using the flash (configuration, history, MFS) can run on Windows/Linux
+
+				NOR semantics: program only changes bits from 1 to 0,
+				erase sets the bytes to 0xFF, page program wraps inside the 256 bytes page.
+				The time is virtual: every operation adds its latency to the emulator clock.
+
+				The erase suspend/resume of w25q.c is emulated: while an erase is in progress
+				the poll hook simulates the other tasks. If the hook calls W25Q_SpiTakeRead()
+				the erase is suspended until W25Q_SpiGiveRead().
+
+				With W25QEMU_SPI 1 the emulator is the flash on the SPI: the commands of the
+				real w25q.c are executed, including the erase suspend (0x75), resume (0x7A)
+				and the SR2 SUS bit. A command sent while the flash is busy is ignored.
+
+	When		Who	What
+	10/18/26	ac	Creation
+	10/18/26	ac	Stream read in API mode: W25Q_ReadStreamStart(), W25Q_ReadStream(), W25Q_ReadStreamEnd()
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+
+#if defined _WIN32
+#include	<windows.h>
+#else
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	<sys/mman.h>
+#include	<sys/stat.h>
+#endif
+
+#include	"w25qEmu.h"
+
+//--------------------------------------------------------------------------------
+
+#define	W25Q_SR1_BUSY			0x01	// Erase/Write in Progress
+#define	W25Q_SR1_WEL			0x02	// Write Enable Latch
+#define	W25Q_SR2_SUS			0x80	// Erase/Program suspended
+
+#define	W25Q_ERASE_NONE			0		// No erase in progress
+#define	W25Q_ERASE_RUN			1		// Erase in progress, the SPI is released by the erasing task
+#define	W25Q_ERASE_SUSPENDED	2		// Erase suspended by the task which owns the SPI
+
+typedef struct
+{
+	uint8_t			* pMem ;		// The mapped file
+	uint32_t		size ;			// Flash size in bytes
+#if defined _WIN32
+	HANDLE			hFile ;
+	HANDLE			hMap ;
+#else
+	int				fd ;
+#endif
+
+	uint64_t		time ;			// Virtual time in us
+	uint64_t		timeNs ;		// Sub microsecond part of SPI transfers
+	uint32_t		sr1 ;
+	uint32_t		spiTaken ;		// Count of W25Q_SpiTake() not yet given
+
+	// Erase in progress
+	uint32_t		eraseState ;
+	uint32_t		eraseAddress ;
+	uint32_t		eraseSize ;
+	uint32_t		eraseRemain ;	// Remaining erase time in us
+	void			(* pPollHook) (void) ;
+
+#if (W25QEMU_SPI == 0)
+	// Stream read in progress
+	bool			bStream ;
+	uint32_t		streamAddress ;
+#endif
+
+	// Power loss emulation
+	uint32_t		powerFailCount ;
+	bool			bPowerLost ;
+
+#if (W25QEMU_SPI == 1)
+	// SPI command in progress
+	bool			bSelected ;
+	int32_t			cmd ;			// -1 before the command byte, W25Q_IGNORED if the command is rejected
+	uint32_t		count ;			// Count of bytes after the command byte
+	uint32_t		cmdAddress ;
+	uint8_t			latch [W25Q_PAGE_SIZE] ;	// Page program data
+	uint8_t			latchSet [W25Q_PAGE_SIZE] ;	// 1 if the latch byte is to be programmed
+	uint64_t		busyUntil ;		// End of a page program or of the suspend latency
+	bool			bChipErase ;	// The erase in progress can't be suspended
+#endif
+
+	w25qEmuTiming_t	timing ;
+	w25qEmuStat_t	stat ;
+
+} w25qEmu_t ;
+
+static	w25qEmu_t	emu ;
+
+static const w25qEmuTiming_t	defaultTiming =
+{
+	250,			// tByte in ns
+	400,			// tPageProgram
+	45000,			// tSectorErase
+	120000,			// tBlock32Erase
+	150000,			// tBlock64Erase
+	20000000,		// tChipErase
+	20,				// tSuspend
+	1000			// tPoll
+} ;
+
+#if (W25QEMU_SPI == 0)
+//--------------------------------------------------------------------------------
+//	Time of a SPI transfer of byteCount bytes
+
+static	void	spiTime (uint32_t byteCount)
+{
+	emu.timeNs += (uint64_t) byteCount * emu.timing.tByte ;
+	emu.time   += emu.timeNs / 1000u ;
+	emu.timeNs %= 1000u ;
+}
+#endif
+
+//--------------------------------------------------------------------------------
+//	Returns true if the power is lost during this program or erase
+
+static	bool	powerFailCheck (void)
+{
+	if (emu.powerFailCount != 0)
+	{
+		emu.powerFailCount-- ;
+		if (emu.powerFailCount == 0)
+		{
+			emu.bPowerLost = true ;
+			return true ;
+		}
+	}
+	return false ;
+}
+
+//--------------------------------------------------------------------------------
+//	Program bytes: only 1 to 0 changes are possible
+
+static	void	programBytes (uint32_t address, const uint8_t * pData, uint32_t count)
+{
+	uint32_t	ii ;
+	uint8_t		* pMem = emu.pMem + address ;
+
+	for (ii = 0 ; ii < count ; ii++)
+	{
+		if ((pData [ii] & ~pMem [ii]) != 0u)
+		{
+			emu.stat.norViolation++ ;
+		}
+		pMem [ii] &= pData [ii] ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	eraseApply (void)
+{
+	memset (emu.pMem + emu.eraseAddress, 0xFF, emu.eraseSize) ;
+	emu.eraseRemain = 0 ;
+	emu.eraseState  = W25Q_ERASE_NONE ;
+}
+
+#if (W25QEMU_SPI == 0)
+//--------------------------------------------------------------------------------
+//	Same sequence as eraseStart() and waitEraseEnd() of w25q.c
+
+static	void	eraseRun (uint32_t address, uint32_t size, uint32_t duration)
+{
+	uint32_t	step ;
+
+	if (emu.eraseState == W25Q_ERASE_SUSPENDED)
+	{
+		// A new erase is not allowed while suspended: complete the suspended erase first
+		emu.time += emu.timing.tSuspend + emu.eraseRemain ;
+		emu.stat.busyTime += emu.eraseRemain ;
+		eraseApply () ;
+	}
+
+	if (emu.bPowerLost  ||  address + size > emu.size)
+	{
+		return ;
+	}
+	emu.stat.eraseCount++ ;
+	spiTime (4) ;
+
+	if (powerFailCheck ())
+	{
+		// Interrupted erase: only a random part of the area is erased
+		memset (emu.pMem + address, 0xFF, rand () % size) ;
+		return ;
+	}
+
+	emu.eraseAddress = address ;
+	emu.eraseSize    = size ;
+	emu.eraseRemain  = duration ;
+	emu.eraseState   = W25Q_ERASE_RUN ;
+	while (emu.eraseState != W25Q_ERASE_NONE)
+	{
+		// The SPI is released: other tasks can use the flash
+		if (emu.pPollHook != NULL)
+		{
+			emu.spiTaken-- ;
+			emu.pPollHook () ;
+			emu.spiTaken++ ;
+			if (emu.eraseState == W25Q_ERASE_NONE)
+			{
+				break ;		// Completed by a new erase from the hook
+			}
+			if (emu.eraseState == W25Q_ERASE_SUSPENDED)
+			{
+				fprintf (stderr, "W25QEmu: the poll hook didn't give the SPI\n") ;
+				abort () ;
+			}
+		}
+
+		step = (emu.eraseRemain < emu.timing.tPoll) ? emu.eraseRemain : emu.timing.tPoll ;
+		emu.time          += emu.timing.tPoll ;
+		emu.stat.busyTime += step ;
+		emu.eraseRemain   -= step ;
+		if (emu.eraseRemain == 0)
+		{
+			eraseApply () ;
+		}
+	}
+	emu.sr1 &= ~W25Q_SR1_WEL ;
+}
+#endif
+
+//--------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------
+//	Emulator management
+
+bool	W25QEmu_Open	(const char * fileName, uint32_t size)
+{
+	bool		bNew ;
+
+	memset (& emu, 0, sizeof (emu)) ;
+	emu.timing = defaultTiming ;
+	emu.size   = size ;
+
+#if defined _WIN32
+	emu.hFile = CreateFileA (fileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL) ;
+	if (emu.hFile == INVALID_HANDLE_VALUE)
+	{
+		return false ;
+	}
+	bNew = GetFileSize (emu.hFile, NULL) < size ;
+	emu.hMap = CreateFileMappingA (emu.hFile, NULL, PAGE_READWRITE, 0, size, NULL) ;
+	if (emu.hMap == NULL)
+	{
+		CloseHandle (emu.hFile) ;
+		return false ;
+	}
+	emu.pMem = (uint8_t *) MapViewOfFile (emu.hMap, FILE_MAP_ALL_ACCESS, 0, 0, size) ;
+	if (emu.pMem == NULL)
+	{
+		CloseHandle (emu.hMap) ;
+		CloseHandle (emu.hFile) ;
+		return false ;
+	}
+#else
+	struct stat		st ;
+
+	emu.fd = open (fileName, O_RDWR | O_CREAT, 0644) ;
+	if (emu.fd < 0)
+	{
+		return false ;
+	}
+	fstat (emu.fd, & st) ;
+	bNew = st.st_size < (off_t) size ;
+	if (ftruncate (emu.fd, size) != 0)
+	{
+		close (emu.fd) ;
+		return false ;
+	}
+	emu.pMem = (uint8_t *) mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, emu.fd, 0) ;
+	if (emu.pMem == MAP_FAILED)
+	{
+		close (emu.fd) ;
+		return false ;
+	}
+#endif
+
+	if (bNew)
+	{
+		// New flash: erased state
+		memset (emu.pMem, 0xFF, size) ;
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	W25QEmu_Close	(void)
+{
+	if (emu.pMem == NULL)
+	{
+		return ;
+	}
+#if defined _WIN32
+	FlushViewOfFile (emu.pMem, emu.size) ;
+	UnmapViewOfFile (emu.pMem) ;
+	CloseHandle (emu.hMap) ;
+	CloseHandle (emu.hFile) ;
+#else
+	msync (emu.pMem, emu.size, MS_SYNC) ;
+	munmap (emu.pMem, emu.size) ;
+	close (emu.fd) ;
+#endif
+	emu.pMem = NULL ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	W25QEmu_SetTiming	(const w25qEmuTiming_t * pTiming)
+{
+	emu.timing = (pTiming == NULL) ? defaultTiming : * pTiming ;
+}
+
+uint64_t	W25QEmu_GetTime	(void)
+{
+	return emu.time ;
+}
+
+void	W25QEmu_GetStat	(w25qEmuStat_t * pStat)
+{
+	* pStat = emu.stat ;
+}
+
+void	W25QEmu_ClearStat	(void)
+{
+	memset (& emu.stat, 0, sizeof (emu.stat)) ;
+}
+
+#if (W25QEMU_SPI == 0)
+void	W25QEmu_SetPollHook	(void (* pHook) (void))
+{
+	emu.pPollHook = pHook ;
+}
+#endif
+
+void	W25QEmu_SetPowerFail	(uint32_t opCount)
+{
+	emu.powerFailCount = opCount ;
+}
+
+bool	W25QEmu_PowerLost	(void)
+{
+	return emu.bPowerLost ;
+}
+
+void	W25QEmu_PowerOn		(void)
+{
+	// An erase interrupted by the power loss is lost
+	emu.eraseState     = W25Q_ERASE_NONE ;
+	emu.eraseRemain    = 0 ;
+	emu.powerFailCount = 0 ;
+	emu.bPowerLost     = false ;
+	emu.sr1            = 0 ;
+}
+
+//--------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------
+#if (W25QEMU_SPI == 0)
+//	w25q.h API
+
+void	W25Q_Init (void)
+{
+}
+
+//	The emulator can't block the task of the poll hook:
+//	it can't wait for the flash owner, nor for the end of the erase
+
+void	W25Q_SpiTake 	(void)
+{
+	if (emu.eraseState != W25Q_ERASE_NONE)
+	{
+		fprintf (stderr, "W25QEmu: W25Q_SpiTake() while an erase is in progress, use W25Q_SpiTakeRead()\n") ;
+		abort () ;
+	}
+	emu.spiTaken++ ;
+}
+
+void	W25Q_SpiGive	(void)
+{
+	if (emu.spiTaken == 0)
+	{
+		fprintf (stderr, "W25QEmu: W25Q_SpiGive() without W25Q_SpiTake()\n") ;
+		abort () ;
+	}
+	emu.spiTaken-- ;
+}
+
+void	W25Q_SpiTakeRead	(uint32_t address, uint32_t size)
+{
+	if (emu.eraseState == W25Q_ERASE_RUN)
+	{
+		if (address < emu.eraseAddress + emu.eraseSize  &&  address + size > emu.eraseAddress)
+		{
+			fprintf (stderr, "W25QEmu: W25Q_SpiTakeRead() of the range being erased 0x%06X\n", address) ;
+			abort () ;
+		}
+
+		// The flash owner waits for the end of an erase: suspend it
+		emu.time += emu.timing.tSuspend ;
+		emu.eraseState = W25Q_ERASE_SUSPENDED ;
+		emu.stat.suspendCount++ ;
+	}
+	emu.spiTaken++ ;
+}
+
+void	W25Q_SpiGiveRead	(void)
+{
+	if (emu.eraseState == W25Q_ERASE_SUSPENDED)
+	{
+		// Resume, the erase progresses during tSUS
+		uint32_t	step = (emu.eraseRemain < emu.timing.tSuspend) ? emu.eraseRemain : emu.timing.tSuspend ;
+
+		emu.eraseState         = W25Q_ERASE_RUN ;
+		emu.time              += emu.timing.tSuspend ;
+		emu.stat.busyTime     += step ;
+		emu.eraseRemain       -= step ;
+	}
+	if (emu.spiTaken == 0)
+	{
+		fprintf (stderr, "W25QEmu: W25Q_SpiGiveRead() without W25Q_SpiTakeRead()\n") ;
+		abort () ;
+	}
+	emu.spiTaken-- ;
+}
+
+//--------------------------------------------------------------------------------
+
+uint32_t	W25Q_ReadDeviceId	(void)
+{
+	uint32_t	capacity = 0 ;
+
+	// Winbond, W25QxxJV-IQ, capacity is log2 (size)
+	while ((1u << capacity) < emu.size)
+	{
+		capacity++ ;
+	}
+	spiTime (4) ;
+	return 0xEF4000u | capacity ;
+}
+
+uint32_t	W25Q_ReadSR1 (void)
+{
+	spiTime (2) ;
+	return emu.sr1 ;
+}
+
+void	W25Q_WriteSR1 (uint8_t sr1)
+{
+	spiTime (2) ;
+	emu.sr1 = sr1 & ~(W25Q_SR1_BUSY | W25Q_SR1_WEL) ;
+}
+
+uint32_t	W25Q_WriteEnable (void)
+{
+	spiTime (1) ;
+	emu.sr1 |= W25Q_SR1_WEL ;
+	return 1 ;
+}
+
+void	W25Q_WriteDisable	(void)
+{
+	spiTime (1) ;
+	emu.sr1 &= ~W25Q_SR1_WEL ;
+}
+
+void	W25Q_WaitWhileBusy (void)
+{
+	// The operations are synchronous: nothing to wait
+}
+
+uint32_t	W25Q_IsBusy	(void)
+{
+	spiTime (2) ;
+	return 0 ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	W25Q_Read	(void * pBuffer, uint32_t address, uint32_t byteCount)
+{
+	uint32_t	count = byteCount ;
+
+	emu.stat.readCount++ ;
+	emu.stat.readBytes += byteCount ;
+	spiTime (4 + byteCount) ;
+
+	if (emu.eraseState == W25Q_ERASE_SUSPENDED  &&
+		address < emu.eraseAddress + emu.eraseSize  &&  address + byteCount > emu.eraseAddress)
+	{
+		// The content of an area being erased is undefined
+		emu.stat.suspendedRead++ ;
+	}
+
+	if (address >= emu.size)
+	{
+		count = 0 ;
+	}
+	else if (count > emu.size - address)
+	{
+		count = emu.size - address ;
+	}
+	memcpy (pBuffer, emu.pMem + address, count) ;
+	memset ((uint8_t *) pBuffer + count, 0xFF, byteCount - count) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Stream read: a continuous read of the flash in several parts
+//	As the real flash the address wraps to 0 at the end of the memory
+
+void	W25Q_ReadStreamStart	(uint32_t address)
+{
+	if (emu.bStream)
+	{
+		fprintf (stderr, "W25QEmu: W25Q_ReadStreamStart() without W25Q_ReadStreamEnd()\n") ;
+		abort () ;
+	}
+	emu.bStream = true ;
+	emu.streamAddress = address % emu.size ;
+	emu.stat.readCount++ ;
+	spiTime (4) ;
+}
+
+void	W25Q_ReadStream	(void * pBuffer, uint32_t byteCount)
+{
+	uint8_t		* pData = (uint8_t *) pBuffer ;
+	uint32_t	count ;
+
+	if (! emu.bStream)
+	{
+		fprintf (stderr, "W25QEmu: W25Q_ReadStream() without W25Q_ReadStreamStart()\n") ;
+		abort () ;
+	}
+	emu.stat.readBytes += byteCount ;
+	spiTime (byteCount) ;
+
+	if (emu.eraseState == W25Q_ERASE_SUSPENDED  &&
+		emu.streamAddress < emu.eraseAddress + emu.eraseSize  &&  emu.streamAddress + byteCount > emu.eraseAddress)
+	{
+		emu.stat.suspendedRead++ ;
+	}
+
+	while (byteCount != 0)
+	{
+		count = emu.size - emu.streamAddress ;
+		if (count > byteCount)
+		{
+			count = byteCount ;
+		}
+		memcpy (pData, emu.pMem + emu.streamAddress, count) ;
+		pData     += count ;
+		byteCount -= count ;
+		emu.streamAddress = (emu.streamAddress + count) % emu.size ;
+	}
+}
+
+void	W25Q_ReadStreamEnd	(void)
+{
+	if (! emu.bStream)
+	{
+		fprintf (stderr, "W25QEmu: W25Q_ReadStreamEnd() without W25Q_ReadStreamStart()\n") ;
+		abort () ;
+	}
+	emu.bStream = false ;
+}
+
+//--------------------------------------------------------------------------------
+//	As the real flash: if the range crosses the page boundary, the address wraps to
+//	the beginning of the page. If byteCount > 256 only the last 256 bytes are programmed
+
+void	W25Q_WritePage	(const uint8_t * pBuffer, uint32_t address, uint32_t byteCount)
+{
+	uint32_t	page   = address & ~(W25Q_PAGE_SIZE - 1u) ;
+	uint32_t	offset = address &  (W25Q_PAGE_SIZE - 1u) ;
+	uint32_t	count ;
+	uint32_t	ii ;
+
+	W25Q_WriteEnable () ;
+	spiTime (4 + byteCount) ;
+	if (emu.bPowerLost  ||  page >= emu.size)
+	{
+		return ;
+	}
+	emu.stat.programCount++ ;
+	emu.stat.programBytes += byteCount ;
+
+	if (byteCount > W25Q_PAGE_SIZE)
+	{
+		offset = (offset + byteCount - W25Q_PAGE_SIZE) & (W25Q_PAGE_SIZE - 1u) ;
+		pBuffer += byteCount - W25Q_PAGE_SIZE ;
+		byteCount = W25Q_PAGE_SIZE ;
+	}
+	if (offset + byteCount > W25Q_PAGE_SIZE)
+	{
+		emu.stat.pageWrap++ ;
+	}
+
+	count = byteCount ;
+	if (powerFailCheck ())
+	{
+		count = rand () % byteCount ;	// Interrupted program
+	}
+	for (ii = 0 ; ii < count ; ii++)
+	{
+		programBytes (page + ((offset + ii) & (W25Q_PAGE_SIZE - 1u)), & pBuffer [ii], 1) ;
+	}
+
+	emu.time          += emu.timing.tPageProgram ;
+	emu.stat.busyTime += emu.timing.tPageProgram ;
+	emu.sr1 &= ~W25Q_SR1_WEL ;
+}
+
+//--------------------------------------------------------------------------------
+//	Same as w25q.c
+
+void	W25Q_Write	(const void * pBuffer, uint32_t address, uint32_t byteCount)
+{
+	uint32_t		addr    = address ;
+	uint32_t		remain  = byteCount ;
+	const uint8_t	* pData = (const uint8_t *) pBuffer ;
+	uint32_t		nn ;
+
+	while (remain != 0u)
+	{
+		nn = W25Q_PAGE_SIZE - (addr % W25Q_PAGE_SIZE) ;		// Count of bytes to write to this page
+		if (nn > remain)
+		{
+			nn = remain ;
+		}
+		W25Q_WritePage (pData, addr, nn) ;
+		remain -= nn ;
+		addr   += nn ;
+		pData  += nn ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+
+void		W25Q_EraseSector	(uint32_t address)
+{
+	if ((address & (W25Q_SECTOR_SIZE - 1u)) != 0u)
+	{
+		fprintf (stderr, "W25QEmu: unaligned sector erase 0x%06X\n", address) ;
+		abort () ;
+	}
+	W25Q_WriteEnable () ;
+	eraseRun (address, W25Q_SECTOR_SIZE, emu.timing.tSectorErase) ;
+}
+
+void		W25Q_EraseBlock32	(uint32_t address)
+{
+	if ((address & ((32*1024) - 1u)) != 0u)
+	{
+		fprintf (stderr, "W25QEmu: unaligned block32 erase 0x%06X\n", address) ;
+		abort () ;
+	}
+	W25Q_WriteEnable () ;
+	eraseRun (address, 32*1024, emu.timing.tBlock32Erase) ;
+}
+
+void		W25Q_EraseBlock64	(uint32_t address)
+{
+	if ((address & ((64*1024) - 1u)) != 0u)
+	{
+		fprintf (stderr, "W25QEmu: unaligned block64 erase 0x%06X\n", address) ;
+		abort () ;
+	}
+	W25Q_WriteEnable () ;
+	eraseRun (address, 64*1024, emu.timing.tBlock64Erase) ;
+}
+
+//--------------------------------------------------------------------------------
+//	The chip erase can't be suspended
+
+void		W25Q_EraseChip		(void)
+{
+	void	(* pHook) (void) = emu.pPollHook ;
+
+	W25Q_WriteEnable () ;
+	emu.pPollHook = NULL ;
+	eraseRun (0, emu.size, emu.timing.tChipErase) ;
+	emu.pPollHook = pHook ;
+}
+
+#endif	// W25QEMU_SPI == 0
+
+#if (W25QEMU_SPI == 1)
+//--------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------
+//	The flash on the SPI
+
+#define W25Q_READ_ID			0x9F
+#define W25Q_WRITE_ENABLE		0x06
+#define W25Q_WRITE_DISABLE		0x04
+#define W25Q_READ_SR1			0x05
+#define W25Q_READ_SR2			0x35
+#define W25Q_READ_SR3			0x15
+#define W25Q_WRITE_SR1			0x01
+#define W25Q_READ				0x03
+#define W25Q_PAGE_PROGRAM		0x02
+#define W25Q_SECTOR_ERASE		0x20
+#define W25Q_BLOCK32_ERASE		0x52
+#define W25Q_BLOCK64_ERASE		0xD8
+#define W25Q_CHIP_ERASE			0xC7
+#define W25Q_SUSPEND			0x75
+#define W25Q_RESUME				0x7A
+
+#define	W25Q_NONE				(-1)	// Waiting for the command byte
+#define	W25Q_IGNORED			(-2)	// Command rejected
+
+//--------------------------------------------------------------------------------
+//	The time passes: the erase progresses if it is not suspended
+
+static	void	timeAdvance (uint32_t us)
+{
+	uint32_t	step ;
+
+	emu.time += us ;
+	if (emu.eraseState == W25Q_ERASE_RUN)
+	{
+		step = (emu.eraseRemain < us) ? emu.eraseRemain : us ;
+		emu.stat.busyTime += step ;
+		emu.eraseRemain   -= step ;
+		if (emu.eraseRemain == 0)
+		{
+			eraseApply () ;
+		}
+	}
+}
+
+static	bool	isBusy (void)
+{
+	return emu.eraseState == W25Q_ERASE_RUN  ||  emu.time < emu.busyUntil ;
+}
+
+//--------------------------------------------------------------------------------
+//	Check if the command is allowed in the current state of the flash
+
+static	bool	cmdAllowed (uint8_t cmd)
+{
+	if (cmd == W25Q_READ_SR1  ||  cmd == W25Q_READ_SR2  ||  cmd == W25Q_READ_SR3)
+	{
+		return true ;
+	}
+	if (isBusy ())
+	{
+		return cmd == W25Q_SUSPEND  &&  emu.eraseState == W25Q_ERASE_RUN ;
+	}
+	if (emu.eraseState == W25Q_ERASE_SUSPENDED)
+	{
+		// Erase and status write are not allowed while suspended
+		return cmd != W25Q_SECTOR_ERASE  &&  cmd != W25Q_BLOCK32_ERASE  &&  cmd != W25Q_BLOCK64_ERASE  &&
+			   cmd != W25Q_CHIP_ERASE  &&  cmd != W25Q_WRITE_SR1 ;
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	eraseBegin (uint32_t size, uint32_t duration)
+{
+	uint32_t	address = emu.cmdAddress & ~(size - 1u) ;
+
+	if ((emu.sr1 & W25Q_SR1_WEL) == 0  ||  emu.count != 3)
+	{
+		return ;
+	}
+	emu.sr1 &= ~W25Q_SR1_WEL ;
+	if (emu.bPowerLost  ||  address + size > emu.size)
+	{
+		return ;
+	}
+	emu.stat.eraseCount++ ;
+
+	if (powerFailCheck ())
+	{
+		// Interrupted erase: only a random part of the area is erased
+		memset (emu.pMem + address, 0xFF, rand () % size) ;
+		return ;
+	}
+	emu.eraseAddress = address ;
+	emu.eraseSize    = size ;
+	emu.eraseRemain  = duration ;
+	emu.eraseState   = W25Q_ERASE_RUN ;
+	emu.bChipErase   = size == emu.size ;
+}
+
+//--------------------------------------------------------------------------------
+//	Program the bytes of the latch, as the real flash does at the end of the command
+
+static	void	pageProgram (void)
+{
+	uint32_t	page = emu.cmdAddress & ~(W25Q_PAGE_SIZE - 1u) & (emu.size - 1u) ;
+	uint32_t	count, ii, nn ;
+
+	if ((emu.sr1 & W25Q_SR1_WEL) == 0  ||  emu.count < 4)
+	{
+		return ;
+	}
+	emu.sr1 &= ~W25Q_SR1_WEL ;
+	count = emu.count - 3 ;
+	if (emu.bPowerLost)
+	{
+		return ;
+	}
+	if (emu.eraseState == W25Q_ERASE_SUSPENDED  &&
+		page < emu.eraseAddress + emu.eraseSize  &&  page + W25Q_PAGE_SIZE > emu.eraseAddress)
+	{
+		emu.stat.busyCommand++ ;	// Program of the area being erased is not allowed
+		return ;
+	}
+	emu.stat.programCount++ ;
+	emu.stat.programBytes += count ;
+	if ((emu.cmdAddress & (W25Q_PAGE_SIZE - 1u)) + count > W25Q_PAGE_SIZE)
+	{
+		emu.stat.pageWrap++ ;
+	}
+
+	nn = W25Q_PAGE_SIZE ;
+	if (powerFailCheck ())
+	{
+		nn = rand () % W25Q_PAGE_SIZE ;		// Interrupted program
+	}
+	for (ii = 0 ; ii < nn ; ii++)
+	{
+		if (emu.latchSet [ii])
+		{
+			programBytes (page + ii, & emu.latch [ii], 1) ;
+		}
+	}
+	emu.busyUntil = emu.time + emu.timing.tPageProgram ;
+	emu.stat.busyTime += emu.timing.tPageProgram ;
+}
+
+//--------------------------------------------------------------------------------
+//	Chip select: the commands are executed when the chip is deselected
+
+void	W25QEmu_SpiSelect	(bool bSelect)
+{
+	if (bSelect)
+	{
+		emu.bSelected = true ;
+		emu.cmd       = W25Q_NONE ;
+		emu.count     = 0 ;
+		return ;
+	}
+	if (! emu.bSelected)
+	{
+		return ;
+	}
+	emu.bSelected = false ;
+
+	switch (emu.cmd)
+	{
+		case W25Q_WRITE_ENABLE:		emu.sr1 |=  W25Q_SR1_WEL ;	break ;
+		case W25Q_WRITE_DISABLE:	emu.sr1 &= ~W25Q_SR1_WEL ;	break ;
+		case W25Q_PAGE_PROGRAM:		pageProgram () ;			break ;
+		case W25Q_SECTOR_ERASE:		eraseBegin (W25Q_SECTOR_SIZE, emu.timing.tSectorErase) ;	break ;
+		case W25Q_BLOCK32_ERASE:	eraseBegin (32*1024, emu.timing.tBlock32Erase) ;			break ;
+		case W25Q_BLOCK64_ERASE:	eraseBegin (64*1024, emu.timing.tBlock64Erase) ;			break ;
+		case W25Q_CHIP_ERASE:
+			emu.count = 3 ;
+			emu.cmdAddress = 0 ;
+			eraseBegin (emu.size, emu.timing.tChipErase) ;
+			break ;
+
+		case W25Q_SUSPEND:
+			if (emu.eraseState == W25Q_ERASE_RUN  &&  ! emu.bChipErase)
+			{
+				emu.eraseState = W25Q_ERASE_SUSPENDED ;
+				emu.busyUntil  = emu.time + emu.timing.tSuspend ;
+				emu.stat.suspendCount++ ;
+			}
+			break ;
+
+		case W25Q_RESUME:
+			if (emu.eraseState == W25Q_ERASE_SUSPENDED)
+			{
+				emu.eraseState = W25Q_ERASE_RUN ;
+			}
+			break ;
+
+		default:
+			break ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Transfer a byte: returns the byte sent by the flash
+
+uint8_t	W25QEmu_SpiByte	(uint8_t byte)
+{
+	uint32_t	address ;
+
+	// SPI transfer time
+	emu.timeNs += emu.timing.tByte ;
+	if (emu.timeNs >= 1000u)
+	{
+		timeAdvance ((uint32_t) (emu.timeNs / 1000u)) ;
+		emu.timeNs %= 1000u ;
+	}
+
+	if (! emu.bSelected  ||  emu.cmd == W25Q_IGNORED)
+	{
+		return 0xFF ;
+	}
+	if (emu.cmd == W25Q_NONE)
+	{
+		emu.cmd = byte ;
+		if (! cmdAllowed (byte))
+		{
+			emu.stat.busyCommand++ ;
+			emu.cmd = W25Q_IGNORED ;
+		}
+		else if (byte == W25Q_PAGE_PROGRAM)
+		{
+			memset (emu.latch,    0xFF, sizeof (emu.latch)) ;
+			memset (emu.latchSet, 0,    sizeof (emu.latchSet)) ;
+		}
+		emu.cmdAddress = 0 ;
+		return 0xFF ;
+	}
+	emu.count++ ;
+
+	switch (emu.cmd)
+	{
+		case W25Q_READ_ID:
+		{
+			uint32_t	capacity = 0 ;
+
+			while ((1u << capacity) < emu.size)
+			{
+				capacity++ ;
+			}
+			return (emu.count == 1) ? 0xEF : (emu.count == 2) ? 0x40 : (uint8_t) capacity ;
+		}
+
+		case W25Q_READ_SR1:
+			return (uint8_t) ((emu.sr1 & ~W25Q_SR1_BUSY) | (isBusy () ? W25Q_SR1_BUSY : 0)) ;
+
+		case W25Q_READ_SR2:
+			return (emu.eraseState == W25Q_ERASE_SUSPENDED) ? W25Q_SR2_SUS : 0 ;
+
+		case W25Q_READ:
+		case W25Q_PAGE_PROGRAM:
+		case W25Q_SECTOR_ERASE:
+		case W25Q_BLOCK32_ERASE:
+		case W25Q_BLOCK64_ERASE:
+			if (emu.count <= 3)
+			{
+				emu.cmdAddress = ((emu.cmdAddress << 8) | byte) & (emu.size - 1u) ;
+				return 0xFF ;
+			}
+			address = emu.cmdAddress + emu.count - 4 ;
+			if (emu.cmd == W25Q_PAGE_PROGRAM)
+			{
+				address &= W25Q_PAGE_SIZE - 1u ;	// The address wraps inside the page
+				emu.latch    [address] = byte ;
+				emu.latchSet [address] = 1 ;
+				return 0xFF ;
+			}
+			if (emu.cmd != W25Q_READ)
+			{
+				return 0xFF ;
+			}
+			address &= emu.size - 1u ;
+			if (emu.count == 4)
+			{
+				emu.stat.readCount++ ;
+				if (emu.eraseState == W25Q_ERASE_SUSPENDED  &&
+					address >= emu.eraseAddress  &&  address < emu.eraseAddress + emu.eraseSize)
+				{
+					emu.stat.suspendedRead++ ;	// The content of an area being erased is undefined
+				}
+			}
+			emu.stat.readBytes++ ;
+			return emu.pMem [address] ;
+
+		default:
+			return 0xFF ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+
+void	W25QEmu_Delay	(uint32_t us)
+{
+	timeAdvance (us) ;
+}
+
+#endif	// W25QEMU_SPI == 1
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	w25qEmu.h	Host emulator of the Winbond W25Qxx SPI flash
+				Implements the w25q.h API on a memory mapped file
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined W25QEMU_H_
+#define W25QEMU_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	"w25q.h"		// The emulated API, from AASun/Application
+
+// 0: the emulator implements the w25q.h API
+// 1: the emulator is a flash on the SPI, the real w25q.c runs on it (see mfs/w25qTest)
+#if (! defined W25QEMU_SPI)
+#define	W25QEMU_SPI			0
+#endif
+
+//--------------------------------------------------------------------------------
+//	Latencies of the emulated flash, in microseconds
+//	The default values are the typical values of the W25Q64JV
+
+typedef struct w25qEmuTiming_s
+{
+	uint32_t		tByte ;			// SPI transfer of 1 byte, in ns (32 MHz SPI: 250 ns)
+	uint32_t		tPageProgram ;	// Page program
+	uint32_t		tSectorErase ;	// 4 KB sector erase
+	uint32_t		tBlock32Erase ;	// 32 KB block erase
+	uint32_t		tBlock64Erase ;	// 64 KB block erase
+	uint32_t		tChipErase ;	// Chip erase
+	uint32_t		tSuspend ;		// Erase suspend latency, and min time from resume to next suspend
+	uint32_t		tPoll ;			// Status poll period while waiting for the end of an erase (aaTaskDelay (1))
+
+} w25qEmuTiming_t ;
+
+//--------------------------------------------------------------------------------
+//	Statistics
+
+typedef struct w25qEmuStat_s
+{
+	uint32_t		readCount ;		// W25Q_Read calls
+	uint32_t		readBytes ;
+	uint32_t		programCount ;	// Page programs
+	uint32_t		programBytes ;
+	uint32_t		eraseCount ;	// Sector, block and chip erases
+	uint32_t		suspendCount ;	// Erases suspended to serve another task
+	uint32_t		norViolation ;	// Writes which attempted to change a bit from 0 to 1
+	uint32_t		pageWrap ;		// Page programs which wrapped to the beginning of the page
+	uint32_t		suspendedRead ;	// Reads of the area being erased while the erase is suspended
+	uint32_t		busyCommand ;	// SPI: commands ignored because the flash is busy or suspended
+	uint64_t		busyTime ;		// Time spent in program and erase, in us
+
+} w25qEmuStat_t ;
+
+//--------------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool		W25QEmu_Open			(const char * fileName, uint32_t size) ;
+void		W25QEmu_Close			(void) ;
+void		W25QEmu_SetTiming		(const w25qEmuTiming_t * pTiming) ;
+uint64_t	W25QEmu_GetTime			(void) ;
+void		W25QEmu_GetStat			(w25qEmuStat_t * pStat) ;
+void		W25QEmu_ClearStat		(void) ;
+
+#if (W25QEMU_SPI == 0)
+// The hook is called at every status poll while an erase is in progress and the SPI is released.
+// It simulates other tasks accessing the flash with W25Q_SpiTakeRead()/W25Q_SpiGiveRead()
+void		W25QEmu_SetPollHook		(void (* pHook) (void)) ;
+#else
+// The SPI side of the flash: chip select, byte transfer, and the time elapsed out of the transfers
+void		W25QEmu_SpiSelect		(bool bSelect) ;
+uint8_t		W25QEmu_SpiByte			(uint8_t byte) ;
+void		W25QEmu_Delay			(uint32_t us) ;
+#endif
+
+// Power loss during the opCount-th program or erase from now (1 for the next one), 0 to disable.
+// The interrupted operation is partially done, then the following programs and erases are ignored
+// until W25QEmu_PowerOn() is called
+void		W25QEmu_SetPowerFail	(uint32_t opCount) ;
+bool		W25QEmu_PowerLost		(void) ;
+void		W25QEmu_PowerOn			(void) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// W25QEMU_H_
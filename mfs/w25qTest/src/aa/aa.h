@@ -0,0 +1,40 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	aa.h		Host shim of the aa kernel API used by w25q.c
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined AA_H_
+#define AA_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+typedef	uint32_t			aaError_t ;
+typedef	uint16_t			aaMutexId_t ;
+
+#define	AA_ENONE			0u
+#define	AA_EFAIL			1u
+#define	AA_INFINITE			(0xFFFFFFFFu)
+#define	AA_INVALID_MUTEX	((aaMutexId_t) 0xFFFFu)
+
+#define	AA_ASSERT(expr)		((expr) ? (void)0 : aaAssertFailed (__FILE__, __LINE__))
+
+void		aaAssertFailed	(const char * file, int line) ;
+
+aaError_t	aaMutexCreate	(aaMutexId_t * pMutexId) ;
+aaError_t	aaMutexTake		(aaMutexId_t mutexId, uint32_t timeOut) ;
+aaError_t	aaMutexGive		(aaMutexId_t mutexId) ;
+
+void		aaTaskDelay		(uint32_t delay) ;
+void		bspDelayUs		(uint32_t us) ;
+
+//--------------------------------------------------------------------------------
+#endif	// AA_H_
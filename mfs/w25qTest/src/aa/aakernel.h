@@ -0,0 +1,13 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	aakernel.h	Host shim: everything is in aa.h
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#include	"aa.h"
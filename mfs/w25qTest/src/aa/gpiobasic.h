@@ -0,0 +1,25 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	gpiobasic.h	Host shim: the chip select of the flash is the one of the emulator
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined GPIOBASIC_H_
+#define GPIOBASIC_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdbool.h>
+
+void	simChipSelect	(bool bSelect) ;		// In aaShim.c
+
+#define	csSet()		simChipSelect (true)
+#define	csClear()	simChipSelect (false)
+
+//--------------------------------------------------------------------------------
+#endif	// GPIOBASIC_H_
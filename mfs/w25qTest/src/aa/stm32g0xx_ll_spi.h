@@ -0,0 +1,34 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	stm32g0xx_ll_spi.h	Host shim of the SPI definitions used by spi.h
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined STM32G0XX_LL_SPI_H_
+#define STM32G0XX_LL_SPI_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+
+typedef struct
+{
+	uint32_t	id ;
+} SPI_TypeDef ;
+
+extern	SPI_TypeDef		simSpi1, simSpi2 ;
+
+#define	SPI1		(& simSpi1)
+#define	SPI2		(& simSpi2)
+
+#define	LL_SPI_BAUDRATEPRESCALER_DIV2		0u
+#define	LL_SPI_BAUDRATEPRESCALER_DIV4		1u
+#define	LL_SPI_BAUDRATEPRESCALER_DIV8		2u
+
+//--------------------------------------------------------------------------------
+#endif	// STM32G0XX_LL_SPI_H_
@@ -0,0 +1,146 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	aaShim.c	Host shim of the aa kernel and of the SPI driver used by w25q.c
+
+				The tasks are POSIX threads, the mutexes are recursive as the aa mutexes.
+				The SPI bus is a mutex as the semaphore of spi.c, the bytes are transferred
+				to the emulated flash of w25qEmu.c (W25QEMU_SPI 1).
+				The time is virtual: aaTaskDelay (1) adds 1 ms to the emulator clock,
+				and yields the CPU for a short real time.
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<unistd.h>
+#include	<pthread.h>
+
+#include	"aa.h"
+#include	"spi.h"
+#include	"w25qEmu.h"
+
+//--------------------------------------------------------------------------------
+
+#define	MUTEX_MAX		8
+
+SPI_TypeDef						simSpi1, simSpi2 ;
+
+static	pthread_mutex_t			busMutex = PTHREAD_MUTEX_INITIALIZER ;		// The SPI semaphore
+static	pthread_mutex_t			emuMutex = PTHREAD_MUTEX_INITIALIZER ;		// The emulator is shared by the threads
+static	pthread_mutex_t			mutexTable [MUTEX_MAX] ;
+static	uint32_t				mutexCount ;
+
+//--------------------------------------------------------------------------------
+
+void	aaAssertFailed	(const char * file, int line)
+{
+	fprintf (stderr, "Assert failed %s %d\n", file, line) ;
+	abort () ;
+}
+
+aaError_t	aaMutexCreate	(aaMutexId_t * pMutexId)
+{
+	pthread_mutexattr_t		attr ;
+
+	if (mutexCount == MUTEX_MAX)
+	{
+		return AA_EFAIL ;
+	}
+	pthread_mutexattr_init (& attr) ;
+	pthread_mutexattr_settype (& attr, PTHREAD_MUTEX_RECURSIVE) ;
+	pthread_mutex_init (& mutexTable [mutexCount], & attr) ;
+	* pMutexId = (aaMutexId_t) mutexCount++ ;
+	return AA_ENONE ;
+}
+
+aaError_t	aaMutexTake	(aaMutexId_t mutexId, uint32_t timeOut)
+{
+	AA_ASSERT (mutexId < mutexCount  &&  timeOut == AA_INFINITE) ;
+	pthread_mutex_lock (& mutexTable [mutexId]) ;
+	return AA_ENONE ;
+}
+
+aaError_t	aaMutexGive	(aaMutexId_t mutexId)
+{
+	AA_ASSERT (mutexId < mutexCount) ;
+	pthread_mutex_unlock (& mutexTable [mutexId]) ;
+	return AA_ENONE ;
+}
+
+void	aaTaskDelay	(uint32_t delay)
+{
+	pthread_mutex_lock (& emuMutex) ;
+	W25QEmu_Delay (delay * 1000u) ;
+	pthread_mutex_unlock (& emuMutex) ;
+	usleep (50) ;
+}
+
+void	bspDelayUs	(uint32_t us)
+{
+	pthread_mutex_lock (& emuMutex) ;
+	W25QEmu_Delay (us) ;
+	pthread_mutex_unlock (& emuMutex) ;
+}
+
+//--------------------------------------------------------------------------------
+//	The SPI
+
+void	simChipSelect	(bool bSelect)
+{
+	pthread_mutex_lock (& emuMutex) ;
+	W25QEmu_SpiSelect (bSelect) ;
+	pthread_mutex_unlock (& emuMutex) ;
+}
+
+void	spiTake	(SPI_TypeDef * pSpi)
+{
+	AA_ASSERT (pSpi == flashSpi) ;
+	pthread_mutex_lock (& busMutex) ;
+}
+
+void	spiGive	(SPI_TypeDef * pSpi)
+{
+	AA_ASSERT (pSpi == flashSpi) ;
+	pthread_mutex_unlock (& busMutex) ;
+}
+
+void	spiSetBaudRate	(SPI_TypeDef * pSpi, uint32_t br)
+{
+	(void) pSpi ;
+	(void) br ;
+}
+
+void	spiModeDuplex	(SPI_TypeDef * pSpi)
+{
+	(void) pSpi ;
+}
+
+uint32_t	spiTxRxByte	(SPI_TypeDef * pSpi, uint32_t byte)
+{
+	uint8_t		rx ;
+
+	(void) pSpi ;
+	pthread_mutex_lock (& emuMutex) ;
+	rx = W25QEmu_SpiByte ((uint8_t) byte) ;
+	pthread_mutex_unlock (& emuMutex) ;
+	return rx ;
+}
+
+void	spiFlashReadDmaXfer	(uint32_t bufferSize, uint8_t * pBuffer)
+{
+	pthread_mutex_lock (& emuMutex) ;
+	while (bufferSize-- != 0u)
+	{
+		* pBuffer++ = W25QEmu_SpiByte (0) ;
+	}
+	pthread_mutex_unlock (& emuMutex) ;
+}
+
+//--------------------------------------------------------------------------------
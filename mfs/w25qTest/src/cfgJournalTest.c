@@ -0,0 +1,216 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	cfgJournalTest.c	Power fail test of the configuration journal (AASun/Application/cfgJournal.c)
+
+				A sequence of writes of a structure with random modifications is done on the
+				flash emulator. The power is lost during the n-th program or erase of the sequence,
+				for every n from the 1st to the last operation of the sequence.
+				After each power loss the journal is loaded: it must be valid, and contain the last
+				completed write or the interrupted one. Then a new write must be loaded back.
+				A program over a damaged record is an error (NOR violation).
+
+				Build on Windows/Linux, from this directory:
+					gcc -O2 -Wall -I../../utils -I../../../AASun/Application -o cfgJournalTest cfgJournalTest.c ../../../AASun/Application/cfgJournal.c ../../utils/w25qEmu.c
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+
+#include	"w25qEmu.h"
+#include	"cfgJournal.h"
+
+//--------------------------------------------------------------------------------
+
+#define	FLASH_FILE		"cfgJournalTest.bin"
+#define	FLASH_SIZE		(64u * 1024u)
+
+#define	CFG_ADDR		(0u * W25Q_SECTOR_SIZE)		// As FLASH_CFG_ADDR and FLASH_CFG2_ADDR of cfgParameters.c
+#define	CFG2_ADDR		(2u * W25Q_SECTOR_SIZE)
+
+#define	CFG_WORDS		256u						// The size of the structure: 1 KB
+#define	WRITE_COUNT		40u							// Writes of the sequence: several compactions
+
+typedef struct
+{
+	uint32_t	data [CFG_WORDS - 1u] ;
+	uint32_t	ckSum ;					// Not part of the deltas, as in configParameters_t
+
+} testCfg_t ;
+
+static	testCfg_t		cfgFlash ;
+static	cfgJournal_t	journal ;
+
+//--------------------------------------------------------------------------------
+
+static	void	journalInit (void)
+{
+	memset (& journal, 0, sizeof (journal)) ;
+	journal.sectors [0] = CFG_ADDR ;
+	journal.sectors [1] = CFG2_ADDR ;
+	journal.pFlash      = & cfgFlash ;
+	journal.size        = sizeof (testCfg_t) ;
+	journal.cmpSize     = sizeof (testCfg_t) - 4u ;
+	journal.sectorAddr  = CFGJ_NO_SECTOR ;
+}
+
+//	Modify some words of the structure: from 1 word to 1/4 of the structure
+
+static	void	cfgModify (testCfg_t * pCfg)
+{
+	uint32_t	first, count, ii ;
+
+	first = (uint32_t) rand () % (CFG_WORDS - 1u) ;
+	count = 1u + (uint32_t) rand () % (CFG_WORDS / 4u) ;
+	for (ii = first ; ii < first + count  &&  ii < CFG_WORDS - 1u ; ii++)
+	{
+		pCfg->data [ii] = (uint32_t) rand () ;
+	}
+	pCfg->ckSum = 0 ;
+	pCfg->ckSum = 0u - cfgSum (pCfg, sizeof (testCfg_t)) ;
+}
+
+static	bool	cfgWrite (const testCfg_t * pCfg)
+{
+	bool	bOk ;
+
+	W25Q_SpiTake () ;
+	bOk = cfgJournalWrite (& journal, pCfg) ;
+	W25Q_SpiGive () ;
+	return bOk ;
+}
+
+static	bool	cfgLoad (void)
+{
+	bool	bOk ;
+
+	journalInit () ;
+	W25Q_SpiTake () ;
+	bOk = cfgJournalLoad (& journal) ;
+	W25Q_SpiGive () ;
+	return bOk ;
+}
+
+static	bool	cfgEqual (const testCfg_t * pCfg)
+{
+	return memcmp (& cfgFlash, pCfg, journal.cmpSize) == 0 ;
+}
+
+//--------------------------------------------------------------------------------
+//	Run the sequence of writes, with a power loss at the failAt-th operation (0: no power loss)
+//	Returns the count of errors
+
+static	uint32_t	runSequence (uint32_t failAt)
+{
+	testCfg_t	committed, current ;
+	uint32_t	ii ;
+	bool		bInterrupted = false ;
+
+	W25QEmu_PowerOn () ;
+	W25Q_SpiTake () ;
+	W25Q_EraseSector (CFG_ADDR) ;
+	W25Q_EraseSector (CFG2_ADDR) ;
+	W25Q_SpiGive () ;
+
+	srand (1) ;
+	memset (& current, 0, sizeof (current)) ;
+	cfgModify (& current) ;
+	journalInit () ;
+	if (! cfgWrite (& current))
+	{
+		printf ("failAt %u: initial write error\n", failAt) ;
+		return 1 ;
+	}
+	committed = current ;
+
+	W25QEmu_SetPowerFail (failAt) ;
+	for (ii = 0 ; ii < WRITE_COUNT ; ii++)
+	{
+		cfgModify (& current) ;
+		if (! cfgWrite (& current)  &&  ! W25QEmu_PowerLost ())
+		{
+			printf ("failAt %u: write %u error\n", failAt, ii) ;
+			return 1 ;
+		}
+		if (W25QEmu_PowerLost ())
+		{
+			bInterrupted = true ;
+			break ;
+		}
+		committed = current ;
+	}
+	W25QEmu_SetPowerFail (0) ;
+
+	// Reboot
+	W25QEmu_PowerOn () ;
+	if (! cfgLoad ())
+	{
+		printf ("failAt %u: no valid journal\n", failAt) ;
+		return 1 ;
+	}
+	if (! cfgEqual (& committed)  &&  ! (bInterrupted  &&  cfgEqual (& current)))
+	{
+		printf ("failAt %u: the loaded configuration is neither the last written nor the interrupted one\n", failAt) ;
+		return 1 ;
+	}
+
+	// The journal is usable after the power loss
+	current = cfgFlash ;
+	cfgModify (& current) ;
+	if (! cfgWrite (& current)  ||  ! cfgLoad ()  ||  ! cfgEqual (& current))
+	{
+		printf ("failAt %u: write after reboot error\n", failAt) ;
+		return 1 ;
+	}
+	return 0 ;
+}
+
+//--------------------------------------------------------------------------------
+
+int		main (void)
+{
+	w25qEmuStat_t	stat ;
+	uint32_t		opCount, failAt, errors ;
+
+	remove (FLASH_FILE) ;
+	if (! W25QEmu_Open (FLASH_FILE, FLASH_SIZE))
+	{
+		fprintf (stderr, "Can't open %s\n", FLASH_FILE) ;
+		return 1 ;
+	}
+
+	// Count the programs and erases of the sequence without power loss
+	errors = runSequence (0) ;
+	W25QEmu_ClearStat () ;
+	errors += runSequence (0) ;
+	W25QEmu_GetStat (& stat) ;
+	opCount = stat.programCount + stat.eraseCount ;
+	printf ("%u writes: %u programs, %u erases\n", WRITE_COUNT, stat.programCount, stat.eraseCount) ;
+
+	W25QEmu_ClearStat () ;
+	for (failAt = 1 ; failAt <= opCount ; failAt++)
+	{
+		errors += runSequence (failAt) ;
+	}
+	W25QEmu_GetStat (& stat) ;
+	if (stat.norViolation != 0)
+	{
+		printf ("%u NOR violations\n", stat.norViolation) ;
+		errors++ ;
+	}
+
+	W25QEmu_Close () ;
+	remove (FLASH_FILE) ;
+	printf ("%u power fail points, %u errors\n%s\n", opCount, errors, (errors == 0) ? "OK" : "FAILED") ;
+	return (errors == 0) ? 0 : 1 ;
+}
+
+//--------------------------------------------------------------------------------
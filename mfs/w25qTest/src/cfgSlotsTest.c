@@ -0,0 +1,198 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	cfgSlotsTest.c	Test of the energy counter slots (AASun/Application/cfgSlots.c) on the flash emulator
+
+				The records are written in the slots of a sector, as writeTotalEnergyCounters().
+				- Cold boot: the last record is found and read back, the next writes go to the free slots
+				- Warm restart: the record is kept in RAM, only the next slot is found (as histoInit()).
+				  The next writes, and the erase when the sector is full, must not program a slot
+				  which is already written (NOR violation)
+				- A warm restart which doesn't find the next slot is detected by the emulator
+
+				Build on Windows/Linux, from this directory:
+					gcc -O2 -Wall -I../../utils -I../../../AASun/Application -o cfgSlotsTest cfgSlotsTest.c ../../../AASun/Application/cfgSlots.c ../../utils/w25qEmu.c
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+
+#include	"w25qEmu.h"
+#include	"cfgSlots.h"
+
+//--------------------------------------------------------------------------------
+
+#define	FLASH_FILE		"cfgSlotsTest.bin"
+#define	FLASH_SIZE		(64u * 1024u)
+
+#define	ENERGY_ADDR		(1u * W25Q_SECTOR_SIZE)		// As FLASH_ENERGY_ADDR of cfgParameters.c
+#define	SLOT_SIZE		128u						// As FLASH_ENERGY_SLOTSIZE
+#define	SLOT_COUNT		(W25Q_SECTOR_SIZE / SLOT_SIZE)
+#define	VERSION			1u
+
+typedef struct
+{
+	uint32_t	date ;					// As energyCounters_t: never 0xFFFFFFFF
+	uint32_t	version ;
+	uint32_t	counters [14] ;
+
+} testRec_t ;
+
+static	cfgSlots_t		slots ;
+static	testRec_t		record ;		// The record in RAM, as energyWh
+static	uint32_t		writeCount ;
+
+//--------------------------------------------------------------------------------
+//	The slot descriptor is not initialized: reboot, its nextIx is 0
+
+static	void	slotsReset (void)
+{
+	memset (& slots, 0, sizeof (slots)) ;
+	slots.sectorAddr = ENERGY_ADDR ;
+	slots.slotSize   = SLOT_SIZE ;
+	slots.slotCount  = SLOT_COUNT ;
+	slots.version    = VERSION ;
+}
+
+static	void	recWrite (void)
+{
+	uint32_t	ii ;
+
+	writeCount++ ;
+	record.date    = 20000u + writeCount ;
+	record.version = VERSION ;
+	for (ii = 0 ; ii < 14u ; ii++)
+	{
+		record.counters [ii] = writeCount * 1000u + ii ;
+	}
+	W25Q_SpiTake () ;
+	cfgSlotsWrite (& slots, & record, sizeof (record)) ;
+	W25Q_SpiGive () ;
+}
+
+//	As readTotalEnergyCounters(): returns true if the last record is found and equal to the record in RAM
+
+static	bool	coldBoot (void)
+{
+	testRec_t	rec ;
+	uint32_t	addr ;
+	bool		bOk ;
+
+	slotsReset () ;
+	W25Q_SpiTake () ;
+	bOk = cfgSlotsFind (& slots, & addr) ;
+	if (bOk)
+	{
+		W25Q_Read (& rec, addr, sizeof (rec)) ;
+		bOk = memcmp (& rec, & record, sizeof (rec)) == 0 ;
+	}
+	W25Q_SpiGive () ;
+	return bOk ;
+}
+
+//	As the warm restart of histoInit(): only find the next slot to write
+
+static	void	warmRestart (bool bFind)
+{
+	uint32_t	addr ;
+
+	slotsReset () ;
+	if (bFind)
+	{
+		W25Q_SpiTake () ;
+		(void) cfgSlotsFind (& slots, & addr) ;
+		W25Q_SpiGive () ;
+	}
+}
+
+static	uint32_t	norViolations (void)
+{
+	w25qEmuStat_t	stat ;
+
+	W25QEmu_GetStat (& stat) ;
+	return stat.norViolation ;
+}
+
+//--------------------------------------------------------------------------------
+
+int		main (void)
+{
+	uint32_t	errors = 0 ;
+	uint32_t	ii ;
+
+	remove (FLASH_FILE) ;
+	if (! W25QEmu_Open (FLASH_FILE, FLASH_SIZE))
+	{
+		fprintf (stderr, "Can't open %s\n", FLASH_FILE) ;
+		return 1 ;
+	}
+	W25Q_SpiTake () ;
+	W25Q_EraseSector (ENERGY_ADDR) ;
+	W25Q_SpiGive () ;
+	W25QEmu_ClearStat () ;
+
+	// Cold boot on an erased sector
+	slotsReset () ;
+	if (coldBoot ()  ||  slots.nextIx != 0)
+	{
+		printf ("Erased sector: a record is found\n") ;
+		errors++ ;
+	}
+
+	// Some writes, then a cold boot
+	for (ii = 0 ; ii < 10u ; ii++)
+	{
+		recWrite () ;
+	}
+	if (! coldBoot ()  ||  slots.nextIx != 10u)
+	{
+		printf ("Cold boot: the last record is not found\n") ;
+		errors++ ;
+	}
+
+	// Warm restarts, with writes up to the erase of the full sector
+	for (ii = 0 ; ii < 3u * SLOT_COUNT ; ii++)
+	{
+		if ((ii % 7u) == 0)
+		{
+			warmRestart (true) ;
+		}
+		recWrite () ;
+	}
+	if (norViolations () != 0)
+	{
+		printf ("Warm restart: %u NOR violations\n", norViolations ()) ;
+		errors++ ;
+	}
+	if (! coldBoot ())
+	{
+		printf ("Cold boot after warm restarts: the last record is not found\n") ;
+		errors++ ;
+	}
+	printf ("%u writes, %u warm restarts: %u NOR violations\n", writeCount, (3u * SLOT_COUNT + 6u) / 7u, norViolations ()) ;
+
+	// The emulator detects the writes of a warm restart which doesn't find the next slot:
+	// the slot 0 is already written
+	warmRestart (false) ;
+	recWrite () ;
+	if (norViolations () == 0)
+	{
+		printf ("Warm restart without the next slot: not detected\n") ;
+		errors++ ;
+	}
+
+	W25QEmu_Close () ;
+	remove (FLASH_FILE) ;
+	printf ("%u errors\n%s\n", errors, (errors == 0) ? "OK" : "FAILED") ;
+	return (errors == 0) ? 0 : 1 ;
+}
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,329 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	w25qEmuTest.c	Test of the features of the W25Q flash emulator (w25qEmu.c, API mode)
+
+				- NOR: a program can't change a bit from 0 to 1, the violations are counted
+				- Page program: the address wraps to the beginning of the page
+				- Stream read: the parts are contiguous, the address wraps at the end of the flash
+				- Power fail: the interrupted program or erase is partial,
+				  the next ones are ignored until W25QEmu_PowerOn()
+				- Erase suspend: the poll hook reads the flash with W25Q_SpiTakeRead()
+				  while an erase is in progress, as the MFS readers of AASun
+
+				Build on Windows/Linux, from this directory:
+					gcc -O2 -Wall -I../../utils -I../../../AASun/Application -o w25qEmuTest w25qEmuTest.c ../../utils/w25qEmu.c
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+
+#include	"w25qEmu.h"
+
+//--------------------------------------------------------------------------------
+
+#define	FLASH_FILE		"w25qEmuTest.bin"
+#define	FLASH_SIZE		(1024u * 1024u)
+
+#define	HOOK_ADDR		0x000000u		// Read by the poll hook
+#define	ERASE_ADDR		0x010000u		// Erased while the hook reads
+
+static	uint32_t	failCount ;
+static	uint32_t	hookCount ;
+static	uint32_t	hookErrors ;
+
+#define	CHECK(expr)		check ((expr), #expr, __LINE__)
+
+static	void	check (bool bOk, const char * text, int line)
+{
+	if (! bOk)
+	{
+		printf ("  FAILED line %d: %s\n", line, text) ;
+		failCount++ ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+
+static	bool	isFilled (uint32_t address, uint32_t size, uint8_t value)
+{
+	uint8_t		buffer [W25Q_SECTOR_SIZE] ;
+	uint32_t	ii, nn ;
+
+	while (size != 0)
+	{
+		nn = (size > sizeof (buffer)) ? sizeof (buffer) : size ;
+		W25Q_SpiTake () ;
+		W25Q_Read (buffer, address, nn) ;
+		W25Q_SpiGive () ;
+		for (ii = 0 ; ii < nn ; ii++)
+		{
+			if (buffer [ii] != value)
+			{
+				return false ;
+			}
+		}
+		address += nn ;
+		size    -= nn ;
+	}
+	return true ;
+}
+
+static	void	eraseSector (uint32_t address)
+{
+	W25Q_SpiTake () ;
+	W25Q_EraseSector (address) ;
+	W25Q_SpiGive () ;
+}
+
+static	void	writeFill (uint32_t address, uint32_t size, uint8_t value)
+{
+	uint8_t		buffer [W25Q_SECTOR_SIZE] ;
+
+	memset (buffer, value, size) ;
+	W25Q_SpiTake () ;
+	W25Q_Write (buffer, address, size) ;
+	W25Q_SpiGive () ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	testNor (void)
+{
+	w25qEmuStat_t	stat ;
+	uint8_t			value ;
+
+	printf ("NOR semantics\n") ;
+	eraseSector (0) ;
+	CHECK (isFilled (0, W25Q_SECTOR_SIZE, 0xFF)) ;
+
+	W25QEmu_ClearStat () ;
+	writeFill (0, 1, 0x0F) ;
+	writeFill (0, 1, 0x07) ;			// 1 to 0 only: allowed
+	W25QEmu_GetStat (& stat) ;
+	CHECK (stat.norViolation == 0) ;
+
+	writeFill (0, 1, 0xF0) ;			// 0 to 1: not possible without erase
+	W25QEmu_GetStat (& stat) ;
+	CHECK (stat.norViolation == 1) ;
+	W25Q_SpiTake () ;
+	W25Q_Read (& value, 0, 1) ;
+	W25Q_SpiGive () ;
+	CHECK (value == 0x00) ;
+
+	eraseSector (0) ;
+	CHECK (isFilled (0, W25Q_SECTOR_SIZE, 0xFF)) ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	testPageWrap (void)
+{
+	w25qEmuStat_t	stat ;
+	uint8_t			buffer [32] ;
+
+	printf ("Page program wrap\n") ;
+	eraseSector (0) ;
+	W25QEmu_ClearStat () ;
+
+	// 32 bytes at 16 bytes from the end of the page: 16 bytes are written at the beginning of the page
+	memset (buffer, 0x55, sizeof (buffer)) ;
+	W25Q_SpiTake () ;
+	W25Q_WritePage (buffer, W25Q_PAGE_SIZE - 16u, sizeof (buffer)) ;
+	W25Q_SpiGive () ;
+
+	W25QEmu_GetStat (& stat) ;
+	CHECK (stat.pageWrap == 1) ;
+	CHECK (isFilled (0, 16, 0x55)) ;
+	CHECK (isFilled (16, W25Q_PAGE_SIZE - 32u, 0xFF)) ;
+	CHECK (isFilled (W25Q_PAGE_SIZE - 16u, 16, 0x55)) ;
+	CHECK (isFilled (W25Q_PAGE_SIZE, W25Q_PAGE_SIZE, 0xFF)) ;	// The next page is untouched
+
+	// W25Q_Write() splits at the page boundaries
+	eraseSector (0) ;
+	W25QEmu_ClearStat () ;
+	writeFill (W25Q_PAGE_SIZE - 16u, 32, 0x55) ;
+	W25QEmu_GetStat (& stat) ;
+	CHECK (stat.pageWrap == 0  &&  stat.programCount == 2) ;
+	CHECK (isFilled (0, W25Q_PAGE_SIZE - 16u, 0xFF)) ;
+	CHECK (isFilled (W25Q_PAGE_SIZE - 16u, 32, 0x55)) ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	testStream (void)
+{
+	uint8_t		buffer [W25Q_PAGE_SIZE] ;
+	uint8_t		part [100] ;
+	uint32_t	ii, nn ;
+	bool		bOk = true ;
+
+	printf ("Stream read\n") ;
+	eraseSector (0) ;
+	eraseSector (FLASH_SIZE - W25Q_SECTOR_SIZE) ;
+	for (ii = 0 ; ii < sizeof (buffer) ; ii++)
+	{
+		buffer [ii] = (uint8_t) ii ;
+	}
+	W25Q_SpiTake () ;
+	W25Q_Write (buffer, 0, sizeof (buffer)) ;
+	W25Q_Write (buffer, FLASH_SIZE - sizeof (buffer), sizeof (buffer)) ;
+
+	// Parts of odd sizes, across the end of the flash
+	W25Q_ReadStreamStart (FLASH_SIZE - sizeof (buffer) + 10u) ;
+	for (ii = 0 ; ii < 3 ; ii++)
+	{
+		W25Q_ReadStream (part, sizeof (part)) ;
+		for (nn = 0 ; nn < sizeof (part) ; nn++)
+		{
+			if (part [nn] != (uint8_t) (10u + ii * sizeof (part) + nn))
+			{
+				bOk = false ;
+			}
+		}
+	}
+	W25Q_ReadStreamEnd () ;
+	W25Q_SpiGive () ;
+	CHECK (bOk) ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	testPowerFail (void)
+{
+	uint8_t		buffer [W25Q_PAGE_SIZE] ;
+	uint32_t	ii, count ;
+
+	printf ("Power fail\n") ;
+	eraseSector (0) ;
+	eraseSector (W25Q_SECTOR_SIZE) ;
+
+	// The 2nd program is interrupted, the 3rd is ignored
+	W25QEmu_SetPowerFail (2) ;
+	writeFill (0, W25Q_PAGE_SIZE, 0x00) ;
+	CHECK (! W25QEmu_PowerLost ()) ;
+	writeFill (W25Q_PAGE_SIZE, W25Q_PAGE_SIZE, 0x00) ;
+	CHECK (W25QEmu_PowerLost ()) ;
+	writeFill (2 * W25Q_PAGE_SIZE, W25Q_PAGE_SIZE, 0x00) ;
+
+	CHECK (isFilled (0, W25Q_PAGE_SIZE, 0x00)) ;
+	W25Q_SpiTake () ;
+	W25Q_Read (buffer, W25Q_PAGE_SIZE, W25Q_PAGE_SIZE) ;
+	W25Q_SpiGive () ;
+	for (count = 0 ; count < W25Q_PAGE_SIZE  &&  buffer [count] == 0x00 ; count++)
+	{
+	}
+	for (ii = count ; ii < W25Q_PAGE_SIZE ; ii++)
+	{
+		CHECK (buffer [ii] == 0xFF) ;	// Partial program: a prefix of the page
+	}
+	CHECK (count < W25Q_PAGE_SIZE) ;
+	CHECK (isFilled (2 * W25Q_PAGE_SIZE, W25Q_PAGE_SIZE, 0xFF)) ;
+
+	// The erases are also ignored until the power is back
+	eraseSector (0) ;
+	CHECK (isFilled (0, W25Q_PAGE_SIZE, 0x00)) ;
+
+	W25QEmu_PowerOn () ;
+	CHECK (! W25QEmu_PowerLost ()) ;
+	eraseSector (0) ;
+	CHECK (isFilled (0, W25Q_SECTOR_SIZE, 0xFF)) ;
+
+	// Interrupted erase: the sector is not fully erased
+	writeFill (0, W25Q_SECTOR_SIZE, 0x00) ;
+	W25QEmu_SetPowerFail (1) ;
+	eraseSector (0) ;
+	CHECK (W25QEmu_PowerLost ()) ;
+	CHECK (! isFilled (0, W25Q_SECTOR_SIZE, 0xFF)) ;
+	W25QEmu_PowerOn () ;
+	eraseSector (0) ;
+	CHECK (isFilled (0, W25Q_SECTOR_SIZE, 0xFF)) ;
+}
+
+//--------------------------------------------------------------------------------
+//	The hook is another task which reads the flash while the erase is in progress
+
+static	void	readHook (void)
+{
+	uint8_t		buffer [64] ;
+	uint32_t	ii ;
+
+	hookCount++ ;
+	W25Q_SpiTakeRead (HOOK_ADDR, sizeof (buffer)) ;
+	W25Q_Read (buffer, HOOK_ADDR, sizeof (buffer)) ;
+	W25Q_SpiGiveRead () ;
+	for (ii = 0 ; ii < sizeof (buffer) ; ii++)
+	{
+		if (buffer [ii] != 0xA5)
+		{
+			hookErrors++ ;
+			break ;
+		}
+	}
+}
+
+static	void	testSuspend (void)
+{
+	w25qEmuStat_t	stat ;
+	uint64_t		time ;
+
+	printf ("Erase suspend\n") ;
+	eraseSector (HOOK_ADDR) ;
+	writeFill (HOOK_ADDR, 64, 0xA5) ;
+	writeFill (ERASE_ADDR, W25Q_SECTOR_SIZE, 0x00) ;
+
+	W25QEmu_ClearStat () ;
+	W25QEmu_SetPollHook (readHook) ;
+	time = W25QEmu_GetTime () ;
+	W25Q_SpiTake () ;
+	W25Q_EraseBlock64 (ERASE_ADDR) ;
+	W25Q_SpiGive () ;
+	time = W25QEmu_GetTime () - time ;
+	W25QEmu_SetPollHook (NULL) ;
+
+	W25QEmu_GetStat (& stat) ;
+	CHECK (hookCount != 0  &&  hookErrors == 0) ;
+	CHECK (stat.suspendCount == hookCount) ;
+	CHECK (stat.suspendedRead == 0) ;
+	CHECK (stat.busyTime >= 150000u) ;					// tBlock64Erase
+	CHECK (time >= stat.busyTime) ;
+	CHECK (isFilled (ERASE_ADDR, 64u * 1024u, 0xFF)) ;	// The erase is completed
+	printf ("  %u reads during the erase, erase time %.1f ms\n", hookCount, (double) time / 1e3) ;
+}
+
+//--------------------------------------------------------------------------------
+
+int		main (void)
+{
+	remove (FLASH_FILE) ;
+	if (! W25QEmu_Open (FLASH_FILE, FLASH_SIZE))
+	{
+		fprintf (stderr, "Can't open %s\n", FLASH_FILE) ;
+		return 1 ;
+	}
+	W25Q_Init () ;
+	W25Q_SpiTake () ;
+	CHECK (W25Q_ReadDeviceId () == 0xEF4014u) ;
+	W25Q_SpiGive () ;
+
+	testNor () ;
+	testPageWrap () ;
+	testStream () ;
+	testPowerFail () ;
+	testSuspend () ;
+
+	W25QEmu_Close () ;
+	remove (FLASH_FILE) ;
+	printf ("%s\n", (failCount == 0) ? "OK" : "FAILED") ;
+	return (failCount == 0) ? 0 : 1 ;
+}
+
+//--------------------------------------------------------------------------------
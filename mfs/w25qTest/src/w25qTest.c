@@ -0,0 +1,279 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	w25qTest.c	Host test of the flash sharing of AASun/Application/w25q.c
+
+				The real w25q.c runs on the SPI side of the emulated flash (w25qEmu.c with
+				W25QEMU_SPI 1): the commands, the erase suspend 0x75, resume 0x7A and the SR2
+				SUS bit are those sent to the W25Q64. The tasks are threads (aaShim.c):
+				- writer   the flash owner: erase the record sector, then write the record
+				- checker  the flash owner: reads the record, it must never be partially erased or written
+				- reader   2 threads, W25Q_SpiTakeRead() outside the record sector, as the MFS:
+						   they suspend the erase of the writer, the data must be constant
+				- overlap  W25Q_SpiTakeRead() of the record sector: waits for the end of the erase
+				The test fails if a record is inconsistent, if a read of the area being erased
+				is done while the erase is suspended, or if a command is sent while the flash is busy.
+
+				Build on Linux, from this directory:
+					gcc -O2 -Wall -DW25QEMU_SPI=1 -Iaa -I../../utils -I../../../AASun/Application -o w25qTest w25qTest.c aaShim.c ../../utils/w25qEmu.c ../../../AASun/Application/w25q.c -lpthread
+
+				Usage:
+					w25qTest [recordCount]		Default 200 records
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+
+#include	"aa.h"
+#include	"w25q.h"
+#include	"w25qEmu.h"
+
+//--------------------------------------------------------------------------------
+
+#define	FLASH_FILE		"w25qTest.bin"
+#define	FLASH_SIZE		(1024u * 1024u)
+
+#define	REC_ADDR		0x000000u			// The sector of the record of the owner
+#define	REC_SIZE		1024u
+#define	FS_ADDR			0x010000u			// The read only area of the readers
+#define	FS_SIZE			0x010000u
+#define	READ_SIZE		512u
+
+#define	READER_COUNT	2
+
+static	volatile bool	bDone ;
+static	uint32_t		recordCount = 200 ;
+static	uint32_t		errorCount ;		// Inconsistent reads
+static	uint32_t		checkCount ;
+static	uint32_t		readCount ;
+static	uint32_t		overlapCount ;
+static	pthread_mutex_t	countMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+//--------------------------------------------------------------------------------
+
+static	uint8_t	fsByte (uint32_t address)
+{
+	return (uint8_t) ((address * 7u) ^ (address >> 8)) ;
+}
+
+static	void	recordBuild (uint8_t * pRec, uint32_t seq)
+{
+	uint32_t	ii ;
+
+	for (ii = 0 ; ii < REC_SIZE ; ii++)
+	{
+		pRec [ii] = (uint8_t) (seq + ii) ;
+	}
+	memcpy (pRec, & seq, sizeof (seq)) ;
+	memcpy (pRec + REC_SIZE - sizeof (seq), & seq, sizeof (seq)) ;
+}
+
+//	Returns false if the record is not a complete record
+
+static	bool	recordCheck (const uint8_t * pRec)
+{
+	uint8_t		ref [REC_SIZE] ;
+	uint32_t	seq ;
+
+	memcpy (& seq, pRec, sizeof (seq)) ;
+	recordBuild (ref, seq) ;
+	return memcmp (pRec, ref, REC_SIZE) == 0 ;
+}
+
+static	void	countAdd (uint32_t * pCount, bool bError)
+{
+	pthread_mutex_lock (& countMutex) ;
+	(* pCount)++ ;
+	if (bError)
+	{
+		errorCount++ ;
+	}
+	pthread_mutex_unlock (& countMutex) ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	* writerTask (void * arg)
+{
+	uint8_t		rec [REC_SIZE] ;
+	uint32_t	seq ;
+
+	(void) arg ;
+	for (seq = 1 ; seq <= recordCount ; seq++)
+	{
+		recordBuild (rec, seq) ;
+		W25Q_SpiTake () ;
+		W25Q_EraseSector (REC_ADDR) ;
+		W25Q_Write (rec, REC_ADDR, REC_SIZE) ;
+		W25Q_SpiGive () ;
+		aaTaskDelay (1) ;
+	}
+	bDone = true ;
+	return NULL ;
+}
+
+static	void	* checkerTask (void * arg)
+{
+	uint8_t		rec [REC_SIZE] ;
+	bool		bError ;
+
+	(void) arg ;
+	while (! bDone)
+	{
+		W25Q_SpiTake () ;
+		W25Q_Read (rec, REC_ADDR, REC_SIZE) ;
+		W25Q_SpiGive () ;
+		bError = ! recordCheck (rec) ;
+		if (bError)
+		{
+			fprintf (stderr, "Checker: inconsistent record\n") ;
+		}
+		countAdd (& checkCount, bError) ;
+		aaTaskDelay (2) ;
+	}
+	return NULL ;
+}
+
+static	void	* readerTask (void * arg)
+{
+	uint8_t		buffer [READ_SIZE] ;
+	uint32_t	address = FS_ADDR + (uint32_t) (uintptr_t) arg * READ_SIZE ;
+	uint32_t	ii ;
+	bool		bError ;
+
+	while (! bDone)
+	{
+		W25Q_SpiTakeRead (address, READ_SIZE) ;
+		W25Q_Read (buffer, address, READ_SIZE) ;
+		W25Q_SpiGiveRead () ;
+
+		bError = false ;
+		for (ii = 0 ; ii < READ_SIZE ; ii++)
+		{
+			if (buffer [ii] != fsByte (address + ii))
+			{
+				bError = true ;
+			}
+		}
+		if (bError)
+		{
+			fprintf (stderr, "Reader: wrong data at 0x%06X\n", address) ;
+		}
+		countAdd (& readCount, bError) ;
+
+		address += READER_COUNT * READ_SIZE ;
+		if (address + READ_SIZE > FS_ADDR + FS_SIZE)
+		{
+			address = FS_ADDR + (uint32_t) (uintptr_t) arg * READ_SIZE ;
+		}
+		aaTaskDelay (1) ;
+	}
+	return NULL ;
+}
+
+static	void	* overlapTask (void * arg)
+{
+	uint8_t		rec [REC_SIZE] ;
+	bool		bError ;
+
+	(void) arg ;
+	while (! bDone)
+	{
+		W25Q_SpiTakeRead (REC_ADDR, REC_SIZE) ;
+		W25Q_Read (rec, REC_ADDR, REC_SIZE) ;
+		W25Q_SpiGiveRead () ;
+		bError = ! recordCheck (rec) ;
+		if (bError)
+		{
+			fprintf (stderr, "Overlap: inconsistent record\n") ;
+		}
+		countAdd (& overlapCount, bError) ;
+		aaTaskDelay (3) ;
+	}
+	return NULL ;
+}
+
+//--------------------------------------------------------------------------------
+
+int		main (int argc, char ** argv)
+{
+	pthread_t		threads [READER_COUNT + 3] ;
+	uint32_t		threadCount = 0 ;
+	uint8_t			buffer [W25Q_PAGE_SIZE] ;
+	uint32_t		address, ii ;
+	w25qEmuStat_t	stat ;
+	bool			bOk ;
+
+	if (argc > 1)
+	{
+		recordCount = (uint32_t) strtoul (argv [1], NULL, 0) ;
+	}
+	if (! W25QEmu_Open (FLASH_FILE, FLASH_SIZE))
+	{
+		fprintf (stderr, "Can't open %s\n", FLASH_FILE) ;
+		return 1 ;
+	}
+
+	// The initial content: the read only area and the record 0
+	W25Q_Init () ;
+	W25Q_SpiTake () ;
+	printf ("Device id: %06X\n", W25Q_ReadDeviceId ()) ;
+	W25Q_EraseBlock64 (FS_ADDR) ;
+	for (address = FS_ADDR ; address < FS_ADDR + FS_SIZE ; address += W25Q_PAGE_SIZE)
+	{
+		for (ii = 0 ; ii < W25Q_PAGE_SIZE ; ii++)
+		{
+			buffer [ii] = fsByte (address + ii) ;
+		}
+		W25Q_WritePage (buffer, address, W25Q_PAGE_SIZE) ;
+	}
+	{
+		uint8_t		rec [REC_SIZE] ;
+
+		recordBuild (rec, 0) ;
+		W25Q_EraseSector (REC_ADDR) ;
+		W25Q_Write (rec, REC_ADDR, REC_SIZE) ;
+	}
+	W25Q_SpiGive () ;
+	W25QEmu_ClearStat () ;
+
+	pthread_create (& threads [threadCount++], NULL, writerTask,  NULL) ;
+	pthread_create (& threads [threadCount++], NULL, checkerTask, NULL) ;
+	pthread_create (& threads [threadCount++], NULL, overlapTask, NULL) ;
+	for (ii = 0 ; ii < READER_COUNT ; ii++)
+	{
+		pthread_create (& threads [threadCount++], NULL, readerTask, (void *) (uintptr_t) ii) ;
+	}
+	for (ii = 0 ; ii < threadCount ; ii++)
+	{
+		pthread_join (threads [ii], NULL) ;
+	}
+
+	W25QEmu_GetStat (& stat) ;
+	W25QEmu_Close () ;
+
+	printf ("Records     %u\n", recordCount) ;
+	printf ("Checks      %u\n", checkCount) ;
+	printf ("Reads       %u\n", readCount) ;
+	printf ("Overlaps    %u\n", overlapCount) ;
+	printf ("Erases      %u\n", stat.eraseCount) ;
+	printf ("Suspends    %u\n", stat.suspendCount) ;
+	printf ("Errors      %u inconsistent, %u suspended reads, %u busy commands, %u NOR violations\n",
+			errorCount, stat.suspendedRead, stat.busyCommand, stat.norViolation) ;
+
+	bOk = errorCount == 0  &&  stat.suspendedRead == 0  &&  stat.busyCommand == 0  &&
+		  stat.norViolation == 0  &&  stat.suspendCount != 0 ;
+	printf ("%s\n", bOk ? "OK" : "FAILED") ;
+	return bOk ? 0 : 1 ;
+}
+
+//--------------------------------------------------------------------------------
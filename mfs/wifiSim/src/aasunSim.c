@@ -0,0 +1,494 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	aasunSim.c	AASun endpoint of the WIFI link: the real AASun/W5500/wifiFrame.c over a host I/O
+
+				wifiFrame.c has the frames and the state machine of wifi.c. Its I/O and its
+				handlers are implemented here (see wifiFrame.h):
+				- The RX DMA is a thread which writes the received bytes in circle in the RX buffer.
+				  The critical section of wifiIoRxRewind() is a mutex.
+				- The TX is done at once: the relay of simLink.c gives the bytes their UART time.
+				  A new baud rate is given to the relay before the TX of the answer to WM_ID_BAUD,
+				  it is used at the end of this TX, as the USART of AASun.
+
+				The handlers are models:
+				- GET CGI: the URI is "seq=<n>&size=<n>", the response is simCgiByte(),
+				  written as by wifiStream, so it can be larger than a frame
+				- POST CGI: a small JSON response
+				- WM_ID_GET_FS: the file system image, or a pattern
+				- Telnet: the console echoes the received chars. The ring buffers have the
+				  sizes of wizLan.c: 512 bytes for the input, 1024 bytes for the output.
+				- WM_ID_LIVE: a new snapshot once per second
+
+	When		Who	What
+	10/18/26	ac	Creation
+	10/18/26	ac	The fragments have the wifiPartMsg_t trailer
+	10/18/26	ac	The real wifiFrame.c replaces the model of the state machine
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<pthread.h>
+
+#include	"wifiFrame.h"	// From AASun/W5500
+#include	"wifiSim.h"
+#include	"esp_log.h"		// For the trace level
+
+//--------------------------------------------------------------------------------
+
+#define		LIVE_PERIOD		1000			// The live values snapshot changes once per second
+#define		LIVE_SIZE		600				// Size of the snapshot.cgi JSON
+
+#define		CON_RX_SIZE		512				// As SOCK_RX_SIZE of wizLan.c
+#define		CON_TX_SIZE		1024			// As SOCK_TX_SIZE of wizLan.c
+
+#define		FS_PATTERN_SIZE	(256 * 1024)	// Default size of the pattern file system
+
+// The RX DMA
+static		pthread_mutex_t	rxMutex = PTHREAD_MUTEX_INITIALIZER ;	// The critical section with the RX DMA
+static		uint8_t			* pRxBuffer ;		// NULL: the RX is stopped
+static		uint32_t		rxDmaPos ;			// Offset of the next byte written by the RX DMA
+
+// The telnet console: a ring buffer in each direction
+typedef struct
+{
+	uint8_t		* pBuffer ;
+	uint32_t	size ;
+	uint32_t	read ;
+	uint32_t	count ;
+
+} simRing_t ;
+
+static		uint8_t			conRxBuffer [CON_RX_SIZE] ;
+static		uint8_t			conTxBuffer [CON_TX_SIZE] ;
+static		simRing_t		conRx = { conRxBuffer, CON_RX_SIZE, 0, 0 } ;	// Input of the console
+static		simRing_t		conTx = { conTxBuffer, CON_TX_SIZE, 0, 0 } ;	// Output of the console
+
+static		aasunSimCfg_t	simCfg ;
+static		uint8_t			* pFsImage ;
+
+// The counters of the I/O and of the models, the others are in wifiFrame.c
+static struct
+{
+	uint32_t	overruns ;			// The RX DMA has overwritten unread bytes
+	uint32_t	telnetIn ;			// Bytes received from telnet
+	uint32_t	telnetOut ;			// Bytes sent to telnet
+	uint32_t	telnetLost ;		// Bytes received without room in the console input
+
+} simStat ;
+
+//--------------------------------------------------------------------------------
+
+static	uint32_t	rbGetWriteCount (simRing_t * pRing)
+{
+	return pRing->size - pRing->count ;
+}
+
+static	void	rbPut (simRing_t * pRing, uint8_t cc)
+{
+	pRing->pBuffer [(pRing->read + pRing->count) % pRing->size] = cc ;
+	pRing->count++ ;
+}
+
+static	uint8_t	rbGet (simRing_t * pRing)
+{
+	uint8_t		cc = pRing->pBuffer [pRing->read] ;
+
+	pRing->read = (pRing->read + 1u) % pRing->size ;
+	pRing->count-- ;
+	return cc ;
+}
+
+//--------------------------------------------------------------------------------
+//	The RX DMA: the received bytes are written in circle in the RX buffer
+//	While the RX is stopped they are lost
+
+static	void *	rxDmaThread (void * pParam)
+{
+	uint8_t		buffer [64] ;
+	uint32_t	len ;
+	uint32_t	ii ;
+
+	(void) pParam ;
+
+	while ((len = (uint32_t) simLinkRead (SIM_AASUN, buffer, sizeof (buffer))) != 0)
+	{
+		if (wifiRxlength () + len >= WBUF_SIZE)
+		{
+			simStat.overruns++ ;		// The ESP32 doesn't follow the rule of the RX buffer
+		}
+		pthread_mutex_lock (& rxMutex) ;
+		for (ii = 0 ; ii < len  &&  pRxBuffer != NULL ; ii++)
+		{
+			pRxBuffer [rxDmaPos] = buffer [ii] ;
+			rxDmaPos = (rxDmaPos + 1u) & WBUF_MASK ;
+		}
+		pthread_mutex_unlock (& rxMutex) ;
+	}
+	return NULL ;
+}
+
+//--------------------------------------------------------------------------------
+//	The I/O of wifiFrame.c
+
+void	wifiIoTxStart (void * address, uint32_t size)
+{
+	simLinkWrite (SIM_AASUN, address, size) ;
+}
+
+bool	wifiIoTxEnd (void)
+{
+	return true ;
+}
+
+void	wifiIoRxStart (void * pBuffer)
+{
+	pthread_mutex_lock (& rxMutex) ;
+	pRxBuffer = pBuffer ;
+	rxDmaPos  = 0 ;
+	pthread_mutex_unlock (& rxMutex) ;
+}
+
+void	wifiIoRxStop (void)
+{
+	pthread_mutex_lock (& rxMutex) ;
+	pRxBuffer = NULL ;
+	pthread_mutex_unlock (& rxMutex) ;
+}
+
+uint32_t	wifiIoRxOffset (void)
+{
+	uint32_t	offset ;
+
+	pthread_mutex_lock (& rxMutex) ;
+	offset = rxDmaPos ;
+	pthread_mutex_unlock (& rxMutex) ;
+	return offset ;
+}
+
+bool	wifiIoRxRewind (uint32_t readOffset)
+{
+	bool	bRewind ;
+
+	pthread_mutex_lock (& rxMutex) ;
+	bRewind = rxDmaPos == readOffset ;
+	if (bRewind)
+	{
+		rxDmaPos = 0 ;
+	}
+	pthread_mutex_unlock (& rxMutex) ;
+	return bRewind ;
+}
+
+void	wifiIoSetBaud (uint32_t baud)
+{
+	simLinkSetBaud (SIM_AASUN, baud) ;
+}
+
+bool	wifiIoBaudNext (uint32_t baud)
+{
+	simLinkSetBaudNext (SIM_AASUN, baud) ;
+	return true ;
+}
+
+uint32_t	wifiIoTick (void)
+{
+	return (uint32_t) (simTimeUs () / 1000u) ;
+}
+
+void	wifiIoDelay (uint32_t ms)
+{
+	usleep (ms * 1000u) ;
+}
+
+void	wifiIoTrace (const char * pFormat, uint32_t value)
+{
+	if (simLogLevel < ESP_LOG_INFO)
+	{
+		return ;
+	}
+	flockfile (stdout) ;
+	printf ("I (%u) AASun: ", wifiIoTick ()) ;
+	printf (pFormat, value) ;
+	funlockfile (stdout) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Telnet
+
+// The console: echo the input while there is room for the output
+static	void	consoleRun (void)
+{
+	while (conRx.count != 0  &&  rbGetWriteCount (& conTx) != 0)
+	{
+		rbPut (& conTx, rbGet (& conRx)) ;
+	}
+}
+
+uint32_t	wifiAppTelnetRecv (const uint8_t * pData, uint32_t size)
+{
+	uint32_t	ii ;
+
+	for (ii = 0 ; ii < size ; ii++)
+	{
+		if (rbGetWriteCount (& conRx) == 0)
+		{
+			// The ESP32 has sent more than its credit. wifi.c waits 100 ms for the console, then drops
+			simStat.telnetLost += size - ii ;
+			break ;
+		}
+		rbPut (& conRx, pData [ii]) ;
+	}
+	simStat.telnetIn += ii ;
+	return rbGetWriteCount (& conRx) ;
+}
+
+uint32_t	wifiAppTelnetCount (void)
+{
+	return conTx.count ;
+}
+
+void	wifiAppTelnetRead (uint8_t * pData, uint32_t size)
+{
+	uint32_t	ii ;
+
+	for (ii = 0 ; ii < size ; ii++)
+	{
+		pData [ii] = rbGet (& conTx) ;
+	}
+	simStat.telnetOut += size ;
+}
+
+bool	wifiAppTelnetStart (void)
+{
+	return true ;
+}
+
+void	wifiAppTelnetStop (void)
+{
+}
+
+//--------------------------------------------------------------------------------
+//	CGI: the GET response is written as by wifiStream, so it can be larger than txBuff
+
+static	uint32_t	cgiGet (wifiReqMsgCgi_t * pCgiMess, uint32_t * pSize)
+{
+	uint8_t				* pData = wifiTxData () ;
+	wifiRespMsgCgi_t	* pMess = (wifiRespMsgCgi_t *) pData ;
+	uint8_t				* pMem  = (uint8_t *) pMess->resp ;
+	uint32_t			memSize = dataPartMax - wifiRespMsgCgiSize ;
+	uint32_t			memLen  = 0 ;
+	uint32_t			seq     = 0 ;
+	uint32_t			size    = 0 ;
+	uint32_t			ii ;
+	char				uri [64] ;
+
+	// The URI data is not terminated in the RX buffer
+	ii = (pCgiMess->uriSize < sizeof (uri)) ? pCgiMess->uriSize : sizeof (uri) - 1u ;
+	memcpy (uri, pCgiMess->uri, ii) ;
+	uri [ii] = 0 ;
+	if (sscanf (uri, "seq=%u&size=%u", & seq, & size) != 2  ||  size > WIFIMSG_MSG_MAX - wifiRespMsgCgiSize)
+	{
+		return WM_ID_ERROR_404 ;
+	}
+	if (simCfg.cgiWorkUs != 0)
+	{
+		usleep (simCfg.cgiWorkUs) ;
+	}
+
+	strcpy (pMess->contentType, contentTypeJson) ;
+	for (ii = 0 ; ii < size ; ii++)
+	{
+		if (memLen == memSize)
+		{
+			// txBuff is full: send it as a fragment, as wifiStreamFlush
+			if (pMem == (uint8_t *) pMess->resp)
+			{
+				pMess->respSize = WM_RESP_SIZE_PART ;
+			}
+			if (! wifiTxPart ((uint32_t) ((pMem + memLen) - pData)))
+			{
+				return WM_ID_ERROR_404 ;
+			}
+			pMem    = pData ;
+			memSize = dataPartMax ;
+			memLen  = 0 ;
+		}
+		pMem [memLen++] = simCgiByte (seq, ii) ;
+	}
+
+	if (pMem == (uint8_t *) pMess->resp)
+	{
+		pMess->respSize = memLen ;
+		* pSize = wifiRespMsgCgiSize + memLen ;
+	}
+	else
+	{
+		* pSize = memLen ;
+	}
+	return WM_ID_CGI_RESP ;
+}
+
+uint32_t	wifiAppCgi (wifiReqMsgCgi_t * pCgiMess, uint32_t * pSize)
+{
+	static	const char	resp [] = "{\"result\":\"ok\"}" ;
+	wifiRespMsgCgi_t	* pMess = (wifiRespMsgCgi_t *) wifiTxData () ;
+
+	* pSize = 0 ;
+	if (pCgiMess->type == WM_TYPE_GET)
+	{
+		return cgiGet (pCgiMess, pSize) ;
+	}
+	pMess->respSize = sizeof (resp) - 1u ;
+	strcpy (pMess->contentType, contentTypeJson) ;
+	memcpy (pMess->resp, resp, sizeof (resp) - 1u) ;
+	* pSize = wifiRespMsgCgiSize + sizeof (resp) - 1u ;
+	return WM_ID_CGI_RESP ;
+}
+
+//--------------------------------------------------------------------------------
+//	The live values
+
+uint32_t	wifiAppLiveGeneration (void)
+{
+	return wifiIoTick () / LIVE_PERIOD ;
+}
+
+uint32_t	wifiAppLive (wifiRespMsgCgi_t * pMess, uint32_t maxSize)
+{
+	(void) maxSize ;
+
+	memset (pMess->resp, '0', LIVE_SIZE) ;
+	pMess->respSize = LIVE_SIZE ;
+	strcpy (pMess->contentType, contentTypeJson) ;
+	return LIVE_SIZE ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	wifiAppInfo (const wifiGetInfoMsg_t * pReq, wifiInfoMsg_t * pInfo)
+{
+	(void) pReq ;
+
+	pInfo->fsSize    = simCfg.fsSize ;
+	pInfo->ipAddress = 0x0B01A8C0 ;		// 192.168.1.11
+	pInfo->ipMask    = 0x00FFFFFF ;
+}
+
+uint32_t	wifiAppFsSize (void)
+{
+	return simCfg.fsSize ;
+}
+
+void	wifiAppFsRead (uint8_t * pData, uint32_t offset, uint32_t size)
+{
+	memcpy (pData, pFsImage + offset, size) ;
+}
+
+void	wifiAppDate (struct tm * pTime)
+{
+	(void) pTime ;
+}
+
+void	wifiAppLinkState (bool bUp)
+{
+	(void) bUp ;
+}
+
+//--------------------------------------------------------------------------------
+//	The low priority task of AASun: wifiNext() in a loop
+
+static	void *	aasunThread (void * pParam)
+{
+	(void) pParam ;
+
+	while (1)
+	{
+		consoleRun () ;
+		if (! wifiNext ())
+		{
+			usleep (200) ;		// Nothing to do: let the other tasks run
+		}
+	}
+	return NULL ;
+}
+
+//--------------------------------------------------------------------------------
+//	Load or build the file system, then start the model
+
+bool	aasunSimStart (const aasunSimCfg_t * pCfg)
+{
+	pthread_t	thread ;
+	FILE		* pFile ;
+	uint32_t	ii ;
+
+	simCfg = * pCfg ;
+	if (simCfg.pFsFile != NULL)
+	{
+		pFile = fopen (simCfg.pFsFile, "rb") ;
+		if (pFile == NULL)
+		{
+			perror (simCfg.pFsFile) ;
+			return false ;
+		}
+		fseek (pFile, 0, SEEK_END) ;
+		simCfg.fsSize = (uint32_t) ftell (pFile) ;
+		fseek (pFile, 0, SEEK_SET) ;
+		pFsImage = malloc (simCfg.fsSize) ;
+		if (fread (pFsImage, 1, simCfg.fsSize, pFile) != simCfg.fsSize)
+		{
+			fclose (pFile) ;
+			fprintf (stderr, "Can't read %s\n", simCfg.pFsFile) ;
+			return false ;
+		}
+		fclose (pFile) ;
+	}
+	else
+	{
+		if (simCfg.fsSize == 0)
+		{
+			simCfg.fsSize = FS_PATTERN_SIZE ;
+		}
+		pFsImage = malloc (simCfg.fsSize) ;
+		for (ii = 0 ; ii < simCfg.fsSize ; ii++)
+		{
+			pFsImage [ii] = (uint8_t) ((ii >> 8) ^ (ii * 31u)) ;
+		}
+	}
+
+	wifiFrameStart () ;
+	pthread_create (& thread, NULL, rxDmaThread, NULL) ;
+	pthread_detach (thread) ;
+	pthread_create (& thread, NULL, aasunThread, NULL) ;
+	pthread_detach (thread) ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+
+const uint8_t *	aasunSimFs (uint32_t * pSize)
+{
+	* pSize = simCfg.fsSize ;
+	return pFsImage ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	aasunSimStat (void)
+{
+	const wifiFrameStat_t	* pStat = wifiFrameGetStat () ;
+
+	printf ("AASun: frames %u, CRC errors %u, RX timeouts %u, skipped %u bytes, overruns %u, syncs %u\n",
+			pStat->frames, pStat->crcErrors, pStat->rxTimeouts, pStat->skipped, simStat.overruns, pStat->syncs) ;
+	printf ("       parts %u, lives %u, baud %u (changes %u, returns %u), telnet in %u out %u lost %u\n",
+			pStat->parts, pStat->lives, simLinkGetBaud (SIM_AASUN), pStat->baudChanges, pStat->baudReturns,
+			simStat.telnetIn, simStat.telnetOut, simStat.telnetLost) ;
+}
+
+//--------------------------------------------------------------------------------
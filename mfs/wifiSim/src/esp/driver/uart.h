@@ -0,0 +1,68 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	uart.h		Host shim of the ESP-IDF UART driver used by wifiLink.c
+				The UART is one side of the simulated link (see espShim.c and simLink.c)
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_UART_H_
+#define SIM_UART_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<stddef.h>
+#include	"freertos/FreeRTOS.h"
+#include	"freertos/queue.h"
+
+typedef	int		esp_err_t ;
+#define	ESP_OK		0
+#define	ESP_FAIL	-1
+
+typedef	int		uart_port_t ;
+#define	UART_NUM_1	1
+
+typedef enum
+{
+	UART_DATA,
+	UART_BREAK,
+	UART_BUFFER_FULL,
+	UART_FIFO_OVF,
+	UART_FRAME_ERR,
+	UART_PARITY_ERR,
+	UART_DATA_BREAK,
+	UART_PATTERN_DET,
+	UART_EVENT_MAX
+
+} uart_event_type_t ;
+
+typedef struct
+{
+	uart_event_type_t	type ;
+	size_t				size ;
+	bool				timeout_flag ;
+
+} uart_event_t ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t	uart_set_baudrate			(uart_port_t port, uint32_t baud) ;
+int			uart_read_bytes				(uart_port_t port, void * pBuffer, uint32_t size, TickType_t timeout) ;
+int			uart_write_bytes			(uart_port_t port, const void * pData, size_t size) ;
+esp_err_t	uart_get_buffered_data_len	(uart_port_t port, size_t * pSize) ;
+esp_err_t	uart_flush_input			(uart_port_t port) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_UART_H_
@@ -0,0 +1,20 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	esp_http_server.h	Host shim: only the types named by global.h
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_ESP_HTTP_SERVER_H_
+#define SIM_ESP_HTTP_SERVER_H_
+//--------------------------------------------------------------------------------
+
+typedef	void *		httpd_handle_t ;
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_ESP_HTTP_SERVER_H_
@@ -0,0 +1,39 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	esp_log.h	Host shim of the ESP-IDF log: printed if the level is enabled (see espShim.c)
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_ESP_LOG_H_
+#define SIM_ESP_LOG_H_
+//--------------------------------------------------------------------------------
+
+#define	ESP_LOG_ERROR		1
+#define	ESP_LOG_WARN		2
+#define	ESP_LOG_INFO		3
+#define	ESP_LOG_DEBUG		4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void	simLog		(int level, const char * pTag, const char * pFormat, ...)
+					 __attribute__ ((format (printf, 3, 4))) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#define	ESP_LOGE(tag, format, ...)	simLog (ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define	ESP_LOGW(tag, format, ...)	simLog (ESP_LOG_WARN,  tag, format, ##__VA_ARGS__)
+#define	ESP_LOGI(tag, format, ...)	simLog (ESP_LOG_INFO,  tag, format, ##__VA_ARGS__)
+#define	ESP_LOGD(tag, format, ...)	simLog (ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_ESP_LOG_H_
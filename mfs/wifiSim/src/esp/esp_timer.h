@@ -0,0 +1,30 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	esp_timer.h	Host shim of the ESP-IDF high resolution timer (see espShim.c)
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_ESP_TIMER_H_
+#define SIM_ESP_TIMER_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int64_t		esp_timer_get_time		(void) ;		// us since the start
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_ESP_TIMER_H_
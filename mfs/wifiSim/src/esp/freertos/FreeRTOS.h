@@ -0,0 +1,36 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	FreeRTOS.h	Host shim of the FreeRTOS API used by wifiLink.c (see espShim.c)
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_FREERTOS_H_
+#define SIM_FREERTOS_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<stddef.h>
+
+typedef	uint32_t		TickType_t ;
+typedef	int				BaseType_t ;
+typedef	unsigned int	UBaseType_t ;
+
+#define	configTICK_RATE_HZ		100			// As CONFIG_FREERTOS_HZ of the ESP32 sdkconfig
+#define	portTICK_PERIOD_MS		(1000 / configTICK_RATE_HZ)
+#define	portMAX_DELAY			((TickType_t) 0xFFFFFFFF)
+#define	pdMS_TO_TICKS(ms)		((TickType_t) (ms) / portTICK_PERIOD_MS)
+
+#define	pdFALSE					0
+#define	pdTRUE					1
+#define	pdFAIL					pdFALSE
+#define	pdPASS					pdTRUE
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_FREERTOS_H_
@@ -0,0 +1,36 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	queue.h		Host shim of the FreeRTOS queues (see espShim.c)
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_QUEUE_H_
+#define SIM_QUEUE_H_
+//--------------------------------------------------------------------------------
+
+#include	"freertos/FreeRTOS.h"
+
+typedef	struct simQueue_s *	QueueHandle_t ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+QueueHandle_t	xQueueCreate			(UBaseType_t length, UBaseType_t itemSize) ;
+BaseType_t		xQueueSend				(QueueHandle_t queue, const void * pItem, TickType_t timeout) ;
+BaseType_t		xQueueReceive			(QueueHandle_t queue, void * pItem, TickType_t timeout) ;
+BaseType_t		xQueueReset				(QueueHandle_t queue) ;
+UBaseType_t		uxQueueMessagesWaiting	(QueueHandle_t queue) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_QUEUE_H_
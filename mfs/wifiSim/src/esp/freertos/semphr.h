@@ -0,0 +1,37 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	semphr.h	Host shim of the FreeRTOS semaphores
+				As in FreeRTOS a semaphore is a queue of items of size 0
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_SEMPHR_H_
+#define SIM_SEMPHR_H_
+//--------------------------------------------------------------------------------
+
+#include	"freertos/queue.h"
+
+typedef	QueueHandle_t	SemaphoreHandle_t ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SemaphoreHandle_t	xSemaphoreCreateMutex	(void) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#define	xSemaphoreCreateBinary()			xQueueCreate (1, 0)
+#define	xSemaphoreTake(sem, timeout)		xQueueReceive (sem, NULL, timeout)
+#define	xSemaphoreGive(sem)					xQueueSend (sem, NULL, 0)
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_SEMPHR_H_
@@ -0,0 +1,39 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	task.h		Host shim of the FreeRTOS tasks: POSIX threads (see espShim.c)
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined SIM_TASK_H_
+#define SIM_TASK_H_
+//--------------------------------------------------------------------------------
+
+#include	"freertos/FreeRTOS.h"
+
+typedef	struct simTask_s *	TaskHandle_t ;
+typedef	void	(* TaskFunction_t)	(void * pParam) ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+BaseType_t		xTaskCreate					(TaskFunction_t fn, const char * pName, uint32_t stackSize,
+											 void * pParam, UBaseType_t priority, TaskHandle_t * pHandle) ;
+TaskHandle_t	xTaskGetCurrentTaskHandle	(void) ;
+TickType_t		xTaskGetTickCount			(void) ;
+void			vTaskDelay					(TickType_t ticks) ;
+BaseType_t		xTaskNotifyGive				(TaskHandle_t task) ;
+uint32_t		ulTaskNotifyTake			(BaseType_t bClear, TickType_t timeout) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// SIM_TASK_H_
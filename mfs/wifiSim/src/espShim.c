@@ -0,0 +1,462 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	espShim.c	Host shim of the FreeRTOS and ESP-IDF API used by wifiLink.c
+
+				The tasks are POSIX threads, the queues and semaphores use a mutex and
+				a condition variable. A semaphore is a queue of items of size 0, as in FreeRTOS.
+				The tick is 10 ms as on the ESP32 (CONFIG_FREERTOS_HZ 100).
+				There are no priorities: the threads run in parallel.
+
+				The UART driver: a thread reads the bytes of the ESP32 side of the link to
+				the RX buffer of the driver and posts the events to the queue read by wifiLink.c.
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<stdarg.h>
+#include	<string.h>
+#include	<time.h>
+#include	<unistd.h>
+#include	<pthread.h>
+
+#include	"freertos/FreeRTOS.h"
+#include	"freertos/task.h"
+#include	"freertos/semphr.h"
+#include	"esp_log.h"
+#include	"esp_timer.h"
+#include	"driver/uart.h"
+
+#include	"wifiSim.h"
+
+//--------------------------------------------------------------------------------
+
+#define	UART_FIFO_SIZE		128		// Bytes read at once by the driver: the RX FIFO of the ESP32-C3
+
+struct simQueue_s
+{
+	pthread_mutex_t		mutex ;
+	pthread_cond_t		cond ;			// Signaled when an item is added or removed
+	uint32_t			length ;
+	uint32_t			itemSize ;		// 0 for a semaphore
+	uint32_t			count ;			// Count of items in the queue
+	uint32_t			head ;			// Index of the oldest item
+	uint8_t				* pItems ;
+} ;
+
+struct simTask_s
+{
+	pthread_t			thread ;
+	TaskFunction_t		fn ;
+	void				* pParam ;
+	pthread_mutex_t		mutex ;
+	pthread_cond_t		cond ;
+	uint32_t			notify ;		// The notification value
+	char				name [16] ;
+} ;
+
+static	__thread struct simTask_s	* pCurrentTask ;
+
+int		simLogLevel = ESP_LOG_WARN ;
+
+//--------------------------------------------------------------------------------
+//	The condition variables use the monotonic clock, as simTimeUs
+
+static	void	condInit (pthread_cond_t * pCond)
+{
+	pthread_condattr_t	attr ;
+
+	pthread_condattr_init (& attr) ;
+	pthread_condattr_setclock (& attr, CLOCK_MONOTONIC) ;
+	pthread_cond_init (pCond, & attr) ;
+	pthread_condattr_destroy (& attr) ;
+}
+
+// The absolute time of the end of a wait of timeout ticks
+static	void	tickDeadline (TickType_t timeout, struct timespec * pTime)
+{
+	uint64_t	ms = (uint64_t) timeout * portTICK_PERIOD_MS ;
+
+	clock_gettime (CLOCK_MONOTONIC, pTime) ;
+	pTime->tv_sec  += (time_t) (ms / 1000u) ;
+	pTime->tv_nsec += (long) (ms % 1000u) * 1000000 ;
+	if (pTime->tv_nsec >= 1000000000)
+	{
+		pTime->tv_sec++ ;
+		pTime->tv_nsec -= 1000000000 ;
+	}
+}
+
+// Wait for the condition, with the mutex locked. Returns false at the deadline
+static	bool	condWait (pthread_cond_t * pCond, pthread_mutex_t * pMutex, TickType_t timeout, const struct timespec * pTime)
+{
+	if (timeout == portMAX_DELAY)
+	{
+		pthread_cond_wait (pCond, pMutex) ;
+		return true ;
+	}
+	return timeout != 0  &&  pthread_cond_timedwait (pCond, pMutex, pTime) == 0 ;
+}
+
+//--------------------------------------------------------------------------------
+//	Queues and semaphores
+
+QueueHandle_t	xQueueCreate (UBaseType_t length, UBaseType_t itemSize)
+{
+	struct simQueue_s	* pQueue = calloc (1, sizeof (struct simQueue_s)) ;
+
+	pthread_mutex_init (& pQueue->mutex, NULL) ;
+	condInit (& pQueue->cond) ;
+	pQueue->length   = length ;
+	pQueue->itemSize = itemSize ;
+	if (itemSize != 0)
+	{
+		pQueue->pItems = malloc (length * itemSize) ;
+	}
+	return pQueue ;
+}
+
+SemaphoreHandle_t	xSemaphoreCreateMutex (void)
+{
+	QueueHandle_t	mutex = xQueueCreate (1, 0) ;
+
+	mutex->count = 1 ;		// Available
+	return mutex ;
+}
+
+BaseType_t	xQueueSend (QueueHandle_t queue, const void * pItem, TickType_t timeout)
+{
+	struct timespec	deadline ;
+
+	tickDeadline (timeout, & deadline) ;
+	pthread_mutex_lock (& queue->mutex) ;
+	while (queue->count == queue->length)
+	{
+		if (! condWait (& queue->cond, & queue->mutex, timeout, & deadline))
+		{
+			pthread_mutex_unlock (& queue->mutex) ;
+			return pdFAIL ;
+		}
+	}
+	if (queue->itemSize != 0)
+	{
+		memcpy (queue->pItems + ((queue->head + queue->count) % queue->length) * queue->itemSize, pItem, queue->itemSize) ;
+	}
+	queue->count++ ;
+	pthread_cond_broadcast (& queue->cond) ;
+	pthread_mutex_unlock (& queue->mutex) ;
+	return pdPASS ;
+}
+
+BaseType_t	xQueueReceive (QueueHandle_t queue, void * pItem, TickType_t timeout)
+{
+	struct timespec	deadline ;
+
+	tickDeadline (timeout, & deadline) ;
+	pthread_mutex_lock (& queue->mutex) ;
+	while (queue->count == 0)
+	{
+		if (! condWait (& queue->cond, & queue->mutex, timeout, & deadline))
+		{
+			pthread_mutex_unlock (& queue->mutex) ;
+			return pdFALSE ;
+		}
+	}
+	if (queue->itemSize != 0)
+	{
+		memcpy (pItem, queue->pItems + queue->head * queue->itemSize, queue->itemSize) ;
+	}
+	queue->head = (queue->head + 1u) % queue->length ;
+	queue->count-- ;
+	pthread_cond_broadcast (& queue->cond) ;
+	pthread_mutex_unlock (& queue->mutex) ;
+	return pdTRUE ;
+}
+
+BaseType_t	xQueueReset (QueueHandle_t queue)
+{
+	pthread_mutex_lock (& queue->mutex) ;
+	queue->count = 0 ;
+	queue->head  = 0 ;
+	pthread_cond_broadcast (& queue->cond) ;
+	pthread_mutex_unlock (& queue->mutex) ;
+	return pdPASS ;
+}
+
+UBaseType_t	uxQueueMessagesWaiting (QueueHandle_t queue)
+{
+	UBaseType_t	count ;
+
+	pthread_mutex_lock (& queue->mutex) ;
+	count = queue->count ;
+	pthread_mutex_unlock (& queue->mutex) ;
+	return count ;
+}
+
+//--------------------------------------------------------------------------------
+//	Tasks
+
+static	struct simTask_s *	taskNew (const char * pName)
+{
+	struct simTask_s	* pTask = calloc (1, sizeof (struct simTask_s)) ;
+
+	pthread_mutex_init (& pTask->mutex, NULL) ;
+	condInit (& pTask->cond) ;
+	snprintf (pTask->name, sizeof (pTask->name), "%s", pName) ;
+	return pTask ;
+}
+
+static	void *	taskStart (void * pParam)
+{
+	struct simTask_s	* pTask = (struct simTask_s *) pParam ;
+
+	pCurrentTask = pTask ;
+	pTask->fn (pTask->pParam) ;
+	return NULL ;
+}
+
+BaseType_t	xTaskCreate (TaskFunction_t fn, const char * pName, uint32_t stackSize,
+						 void * pParam, UBaseType_t priority, TaskHandle_t * pHandle)
+{
+	struct simTask_s	* pTask = taskNew (pName) ;
+
+	(void) stackSize ;
+	(void) priority ;
+
+	pTask->fn     = fn ;
+	pTask->pParam = pParam ;
+	if (pHandle != NULL)
+	{
+		* pHandle = pTask ;
+	}
+	if (pthread_create (& pTask->thread, NULL, taskStart, pTask) != 0)
+	{
+		return pdFAIL ;
+	}
+	pthread_detach (pTask->thread) ;
+	return pdPASS ;
+}
+
+// A thread not created by xTaskCreate gets its task at its 1st call
+TaskHandle_t	xTaskGetCurrentTaskHandle (void)
+{
+	if (pCurrentTask == NULL)
+	{
+		pCurrentTask = taskNew ("main") ;
+		pCurrentTask->thread = pthread_self () ;
+	}
+	return pCurrentTask ;
+}
+
+TickType_t	xTaskGetTickCount (void)
+{
+	return (TickType_t) (simTimeUs () / (portTICK_PERIOD_MS * 1000u)) ;
+}
+
+void	vTaskDelay (TickType_t ticks)
+{
+	if (ticks == 0)
+	{
+		sched_yield () ;
+		return ;
+	}
+	usleep (ticks * portTICK_PERIOD_MS * 1000u) ;
+}
+
+BaseType_t	xTaskNotifyGive (TaskHandle_t task)
+{
+	pthread_mutex_lock (& task->mutex) ;
+	task->notify++ ;
+	pthread_cond_signal (& task->cond) ;
+	pthread_mutex_unlock (& task->mutex) ;
+	return pdPASS ;
+}
+
+uint32_t	ulTaskNotifyTake (BaseType_t bClear, TickType_t timeout)
+{
+	struct simTask_s	* pTask = xTaskGetCurrentTaskHandle () ;
+	struct timespec		deadline ;
+	uint32_t			value ;
+
+	tickDeadline (timeout, & deadline) ;
+	pthread_mutex_lock (& pTask->mutex) ;
+	while (pTask->notify == 0)
+	{
+		if (! condWait (& pTask->cond, & pTask->mutex, timeout, & deadline))
+		{
+			break ;
+		}
+	}
+	value = pTask->notify ;
+	if (value != 0)
+	{
+		pTask->notify = (bClear != pdFALSE) ? 0 : value - 1u ;
+	}
+	pthread_mutex_unlock (& pTask->mutex) ;
+	return value ;
+}
+
+//--------------------------------------------------------------------------------
+
+int64_t	esp_timer_get_time (void)
+{
+	return (int64_t) simTimeUs () ;
+}
+
+void	simLog (int level, const char * pTag, const char * pFormat, ...)
+{
+	static	const char	letters [] = "?EWID" ;
+	va_list				args ;
+
+	if (level > simLogLevel)
+	{
+		return ;
+	}
+	va_start (args, pFormat) ;
+	flockfile (stdout) ;
+	printf ("%c (%llu) %s: ", letters [level], (unsigned long long) (simTimeUs () / 1000u), pTag) ;
+	vprintf (pFormat, args) ;
+	putchar ('\n') ;
+	funlockfile (stdout) ;
+	va_end (args) ;
+}
+
+//--------------------------------------------------------------------------------
+//	The UART driver
+
+static	QueueHandle_t		uartQueue ;
+static	pthread_mutex_t		uartMutex = PTHREAD_MUTEX_INITIALIZER ;
+static	uint8_t				* uartRxBuf ;		// Circular RX buffer of the driver
+static	uint32_t			uartRxSize ;
+static	uint32_t			uartRxRead ;		// Index of the oldest byte
+static	uint32_t			uartRxCount ;		// Count of bytes in uartRxBuf
+static	uint32_t			uartOverflows ;
+static	uint32_t			uartLostEvents ;	// The event queue was full
+
+static	void	uartPost (uart_event_type_t type, size_t size)
+{
+	uart_event_t	event ;
+
+	memset (& event, 0, sizeof (event)) ;
+	event.type = type ;
+	event.size = size ;
+	if (xQueueSend (uartQueue, & event, 0) != pdPASS)
+	{
+		uartLostEvents++ ;		// As the ESP-IDF driver: the bytes remain in the buffer
+	}
+}
+
+// The interrupt handler: from the RX FIFO to the RX buffer
+static	void *	uartRxThread (void * pParam)
+{
+	uint8_t		fifo [UART_FIFO_SIZE] ;
+	uint32_t	len ;
+	uint32_t	ii ;
+
+	(void) pParam ;
+
+	while ((len = (uint32_t) simLinkRead (SIM_ESP, fifo, sizeof (fifo))) != 0)
+	{
+		pthread_mutex_lock (& uartMutex) ;
+		if (uartRxCount + len > uartRxSize)
+		{
+			// The driver discards the FIFO
+			uartOverflows++ ;
+			pthread_mutex_unlock (& uartMutex) ;
+			uartPost (UART_BUFFER_FULL, 0) ;
+			continue ;
+		}
+		for (ii = 0 ; ii < len ; ii++)
+		{
+			uartRxBuf [(uartRxRead + uartRxCount + ii) % uartRxSize] = fifo [ii] ;
+		}
+		uartRxCount += len ;
+		pthread_mutex_unlock (& uartMutex) ;
+		uartPost (UART_DATA, len) ;
+	}
+	return NULL ;
+}
+
+//--------------------------------------------------------------------------------
+//	Install the driver, as uart_driver_install()
+//	Returns the event queue
+
+QueueHandle_t	espUartInit (uint32_t rxBufSize, uint32_t queueSize)
+{
+	pthread_t	thread ;
+
+	uartRxSize = rxBufSize ;
+	uartRxBuf  = malloc (rxBufSize) ;
+	uartQueue  = xQueueCreate (queueSize, sizeof (uart_event_t)) ;
+	pthread_create (& thread, NULL, uartRxThread, NULL) ;
+	pthread_detach (thread) ;
+	return uartQueue ;
+}
+
+void	espUartStat (void)
+{
+	printf ("ESP32 UART: %u RX buffer overflows, %u events lost\n", uartOverflows, uartLostEvents) ;
+}
+
+esp_err_t	uart_set_baudrate (uart_port_t port, uint32_t baud)
+{
+	(void) port ;
+	simLinkSetBaud (SIM_ESP, baud) ;
+	return ESP_OK ;
+}
+
+int		uart_read_bytes (uart_port_t port, void * pBuffer, uint32_t size, TickType_t timeout)
+{
+	uint8_t		* pBytes = (uint8_t *) pBuffer ;
+	uint32_t	len ;
+	uint32_t	ii ;
+
+	(void) port ;
+	(void) timeout ;		// wifiLink.c reads only the buffered bytes
+
+	pthread_mutex_lock (& uartMutex) ;
+	len = (size < uartRxCount) ? size : uartRxCount ;
+	for (ii = 0 ; ii < len ; ii++)
+	{
+		pBytes [ii] = uartRxBuf [(uartRxRead + ii) % uartRxSize] ;
+	}
+	uartRxRead   = (uartRxRead + len) % uartRxSize ;
+	uartRxCount -= len ;
+	pthread_mutex_unlock (& uartMutex) ;
+	return (int) len ;
+}
+
+int		uart_write_bytes (uart_port_t port, const void * pData, size_t size)
+{
+	(void) port ;
+	simLinkWrite (SIM_ESP, pData, (uint32_t) size) ;
+	return (int) size ;
+}
+
+esp_err_t	uart_get_buffered_data_len (uart_port_t port, size_t * pSize)
+{
+	(void) port ;
+	pthread_mutex_lock (& uartMutex) ;
+	* pSize = uartRxCount ;
+	pthread_mutex_unlock (& uartMutex) ;
+	return ESP_OK ;
+}
+
+esp_err_t	uart_flush_input (uart_port_t port)
+{
+	(void) port ;
+	pthread_mutex_lock (& uartMutex) ;
+	uartRxRead  = 0 ;
+	uartRxCount = 0 ;
+	pthread_mutex_unlock (& uartMutex) ;
+	return ESP_OK ;
+}
+
+//--------------------------------------------------------------------------------
@@ -0,0 +1,392 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	simLink.c	The simulated UART link between AASun and the ESP32
+
+				Each endpoint has a byte stream: a socketpair or a pseudo-terminal pair,
+				whose other end is read by a relay thread which forwards the bytes to
+				the other endpoint. The relay injects the faults: lost bytes, garbage,
+				and stops of a direction (the inter-byte timeouts). With the pacing, the
+				bytes take the time of their transfer at the baud rate of the sender.
+
+				The baud rate of each side is known: the bytes written while the two
+				sides don't use the same rate are garbled, as with a real UART, and
+				above simFault_t.baudMax the line corrupts 1% of the bytes. So the
+				baud rate negotiation and its fallbacks are tested too.
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+
+#define	_GNU_SOURCE			// For posix_openpt, cfmakeraw
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<errno.h>
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	<time.h>
+#include	<pthread.h>
+#include	<termios.h>
+#include	<sys/socket.h>
+
+#include	"wifiMsg.h"		// From http/main, for WIFIMSG_BBR
+#include	"wifiSim.h"
+
+//--------------------------------------------------------------------------------
+
+#define	RELAY_CHUNK			64			// Bytes forwarded at once: the granularity of the pacing
+#define	RELAY_GARBAGE_MAX	8			// Max count of random bytes inserted at once
+#define	LINE_ERROR_RATE		10000		// Bytes corrupted per million above baudMax
+
+typedef struct
+{
+	int				fd ;			// The byte stream of the endpoint
+	int				relayFd ;		// The other end of this stream, used by the relay
+	uint32_t		baud ;			// The current baud rate of the endpoint UART
+	uint32_t		baudNext ;		// Not 0: the baud rate to use at the end of the next write
+	uint32_t		random ;		// State of the random generator of the writer
+	pthread_mutex_t	writeMutex ;
+	simLinkStat_t	stat ;			// The direction from this side
+
+} simSide_t ;
+
+static	simSide_t		simSides [2] ;
+static	simFault_t		simFault ;
+static	pthread_mutex_t	statMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+//--------------------------------------------------------------------------------
+//	Time since the first call, us
+
+uint64_t	simTimeUs (void)
+{
+	static	struct timespec	start ;
+	struct timespec			now ;
+
+	clock_gettime (CLOCK_MONOTONIC, & now) ;
+	if (start.tv_sec == 0  &&  start.tv_nsec == 0)
+	{
+		start = now ;
+	}
+	return (uint64_t) (now.tv_sec - start.tv_sec) * 1000000u + (now.tv_nsec - start.tv_nsec) / 1000 ;
+}
+
+//--------------------------------------------------------------------------------
+//	xorshift32: fast and reproducible with the same seed
+
+uint32_t	simRandom (uint32_t * pState)
+{
+	uint32_t	xx = * pState ;
+
+	xx ^= xx << 13 ;
+	xx ^= xx >> 17 ;
+	xx ^= xx << 5 ;
+	* pState = xx ;
+	return xx ;
+}
+
+// True with a probability of rate per million
+static	bool	simChance (uint32_t * pState, uint32_t rate)
+{
+	return rate != 0  &&  (simRandom (pState) % 1000000u) < rate ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	bool	writeAll (int fd, const uint8_t * pData, uint32_t size)
+{
+	ssize_t		len ;
+
+	while (size != 0)
+	{
+		len = write (fd, pData, size) ;
+		if (len < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue ;
+			}
+			return false ;
+		}
+		pData += len ;
+		size  -= (uint32_t) len ;
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Create the byte stream of an endpoint
+
+static	bool	linkPair (uint32_t transport, simSide_t * pSide)
+{
+	struct termios	tio ;
+	int				fds [2] ;
+	int				master ;
+
+	if (transport == SIM_TRANSPORT_SOCKET)
+	{
+		if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		{
+			perror ("socketpair") ;
+			return false ;
+		}
+		pSide->fd      = fds [0] ;
+		pSide->relayFd = fds [1] ;
+		return true ;
+	}
+
+	// Pseudo-terminal: the endpoint uses the slave, as a serial port, the relay uses the master
+	master = posix_openpt (O_RDWR | O_NOCTTY) ;
+	if (master < 0  ||  grantpt (master) != 0  ||  unlockpt (master) != 0)
+	{
+		perror ("posix_openpt") ;
+		return false ;
+	}
+	pSide->fd = open (ptsname (master), O_RDWR | O_NOCTTY) ;
+	if (pSide->fd < 0)
+	{
+		perror (ptsname (master)) ;
+		return false ;
+	}
+	tcgetattr (pSide->fd, & tio) ;
+	cfmakeraw (& tio) ;
+	tio.c_cc [VMIN]  = 1 ;
+	tio.c_cc [VTIME] = 0 ;
+	tcsetattr (pSide->fd, TCSANOW, & tio) ;
+	pSide->relayFd = master ;
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+//	Forward the bytes written by a side to the other side, with the faults
+
+static	void *	relayThread (void * pParam)
+{
+	uint32_t		side     = (uint32_t) (uintptr_t) pParam ;
+	simSide_t		* pFrom  = & simSides [side] ;
+	simSide_t		* pTo    = & simSides [side ^ 1u] ;
+	uint32_t		random   = simFault.seed * 2u + side + 1u ;
+	uint64_t		lineTime = 0 ;		// End of the transfer of the bytes already forwarded, us
+	uint8_t			inBuf  [RELAY_CHUNK] ;
+	uint8_t			outBuf [RELAY_CHUNK * (RELAY_GARBAGE_MAX + 1)] ;
+	uint32_t		outLen ;
+	uint32_t		count ;
+	uint64_t		now ;
+	ssize_t			len ;
+	ssize_t			ii ;
+
+	while (1)
+	{
+		len = read (pFrom->relayFd, inBuf, sizeof (inBuf)) ;
+		if (len <= 0)
+		{
+			if (len < 0  &&  errno == EINTR)
+			{
+				continue ;
+			}
+			break ;
+		}
+
+		outLen = 0 ;
+		pthread_mutex_lock (& statMutex) ;
+		pFrom->stat.bytes += (uint64_t) len ;
+		pthread_mutex_unlock (& statMutex) ;
+		for (ii = 0 ; ii < len ; ii++)
+		{
+			if (simChance (& random, simFault.delayRate))
+			{
+				// The direction stops: forward what is before, then wait
+				writeAll (pTo->relayFd, outBuf, outLen) ;
+				outLen = 0 ;
+				usleep (simFault.delayMs * 1000u) ;
+				pthread_mutex_lock (& statMutex) ;
+				pFrom->stat.delays++ ;
+				pthread_mutex_unlock (& statMutex) ;
+			}
+			if (simChance (& random, simFault.garbageRate))
+			{
+				count = 1u + simRandom (& random) % RELAY_GARBAGE_MAX ;
+				pthread_mutex_lock (& statMutex) ;
+				pFrom->stat.garbage += count ;
+				pthread_mutex_unlock (& statMutex) ;
+				while (count-- != 0)
+				{
+					outBuf [outLen++] = (uint8_t) simRandom (& random) ;
+				}
+			}
+			if (simChance (& random, simFault.dropRate))
+			{
+				pthread_mutex_lock (& statMutex) ;
+				pFrom->stat.dropped++ ;
+				pthread_mutex_unlock (& statMutex) ;
+				continue ;
+			}
+			outBuf [outLen++] = inBuf [ii] ;
+		}
+
+		if (simFault.bPacing  &&  outLen != 0)
+		{
+			// 10 bits per byte: start, 8 data, stop
+			now = simTimeUs () ;
+			if (lineTime < now)
+			{
+				lineTime = now ;
+			}
+			lineTime += ((uint64_t) outLen * 10000000u) / pFrom->baud ;
+			if (lineTime > now + 100u)
+			{
+				usleep ((useconds_t) (lineTime - now)) ;
+			}
+		}
+		if (! writeAll (pTo->relayFd, outBuf, outLen))
+		{
+			break ;
+		}
+	}
+	return NULL ;
+}
+
+//--------------------------------------------------------------------------------
+//	Create the byte streams of the two endpoints
+
+bool	simLinkOpen (uint32_t transport, const simFault_t * pFault)
+{
+	uint32_t	ii ;
+
+	simTimeUs () ;		// The origin of the time
+	simFault = * pFault ;
+	if (simFault.seed == 0)
+	{
+		simFault.seed = 1 ;		// xorshift32 doesn't leave 0
+	}
+	for (ii = 0 ; ii < 2 ; ii++)
+	{
+		if (! linkPair (transport, & simSides [ii]))
+		{
+			return false ;
+		}
+		simSides [ii].baud   = WIFIMSG_BBR ;
+		simSides [ii].random = simFault.seed * 2u + ii + 101u ;
+		pthread_mutex_init (& simSides [ii].writeMutex, NULL) ;
+	}
+	return true ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	simLinkStart (void)
+{
+	pthread_t	thread ;
+	uintptr_t	ii ;
+
+	for (ii = 0 ; ii < 2 ; ii++)
+	{
+		pthread_create (& thread, NULL, relayThread, (void *) ii) ;
+		pthread_detach (thread) ;
+	}
+}
+
+//--------------------------------------------------------------------------------
+//	Read the bytes received by a side, wait for at least 1 byte
+//	Returns the count of bytes, 0 if the link is closed
+
+int		simLinkRead (uint32_t side, void * pBuffer, uint32_t size)
+{
+	ssize_t		len ;
+
+	do
+	{
+		len = read (simSides [side].fd, pBuffer, size) ;
+	} while (len < 0  &&  errno == EINTR) ;
+
+	return (len < 0) ? 0 : (int) len ;
+}
+
+//--------------------------------------------------------------------------------
+//	Send bytes from a side, at its current baud rate
+
+void	simLinkWrite (uint32_t side, const void * pData, uint32_t size)
+{
+	simSide_t		* pSide = & simSides [side] ;
+	const uint8_t	* pBytes = (const uint8_t *) pData ;
+	uint8_t			buffer [256] ;
+	uint32_t		garbled = 0 ;
+	uint32_t		chunk ;
+	uint32_t		ii ;
+	bool			bMismatch ;
+	bool			bTooFast ;
+
+	pthread_mutex_lock (& pSide->writeMutex) ;
+	bMismatch = pSide->baud != simSides [side ^ 1u].baud ;
+	bTooFast  = pSide->baud > simFault.baudMax ;
+	if (! bMismatch  &&  ! bTooFast)
+	{
+		writeAll (pSide->fd, pBytes, size) ;
+		size = 0 ;
+	}
+
+	// The receiver samples the bits at a wrong time
+	while (size != 0)
+	{
+		chunk = (size < sizeof (buffer)) ? size : sizeof (buffer) ;
+		for (ii = 0 ; ii < chunk ; ii++)
+		{
+			buffer [ii] = pBytes [ii] ;
+			if (bMismatch  ||  simChance (& pSide->random, LINE_ERROR_RATE))
+			{
+				buffer [ii] ^= (uint8_t) (1u + simRandom (& pSide->random) % 255u) ;
+				garbled++ ;
+			}
+		}
+		writeAll (pSide->fd, buffer, chunk) ;
+		pBytes += chunk ;
+		size   -= chunk ;
+	}
+	if (pSide->baudNext != 0)
+	{
+		// As the USART of AASun: the new baud rate at the end of the TX, before the peer can answer
+		pSide->baud     = pSide->baudNext ;
+		pSide->baudNext = 0 ;
+	}
+	pthread_mutex_unlock (& pSide->writeMutex) ;
+
+	pthread_mutex_lock (& statMutex) ;
+	pSide->stat.garbled += garbled ;
+	pthread_mutex_unlock (& statMutex) ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	simLinkSetBaud (uint32_t side, uint32_t baud)
+{
+	pthread_mutex_lock (& simSides [side].writeMutex) ;
+	simSides [side].baud = baud ;
+	pthread_mutex_unlock (& simSides [side].writeMutex) ;
+}
+
+void	simLinkSetBaudNext (uint32_t side, uint32_t baud)
+{
+	pthread_mutex_lock (& simSides [side].writeMutex) ;
+	simSides [side].baudNext = baud ;
+	pthread_mutex_unlock (& simSides [side].writeMutex) ;
+}
+
+uint32_t	simLinkGetBaud (uint32_t side)
+{
+	return simSides [side].baud ;
+}
+
+//--------------------------------------------------------------------------------
+
+void	simLinkGetStat (uint32_t side, simLinkStat_t * pStat)
+{
+	pthread_mutex_lock (& statMutex) ;
+	* pStat = simSides [side].stat ;
+	pthread_mutex_unlock (& statMutex) ;
+}
+
+//--------------------------------------------------------------------------------
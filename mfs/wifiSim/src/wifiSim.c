@@ -0,0 +1,559 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	wifiSim.c	Host test harness of the WIFI link between AASun and the ESP32
+
+				The ESP32 side is the real http/main/wifiLink.c over the FreeRTOS/UART shim of
+				espShim.c, the AASun side is the real AASun/W5500/wifiFrame.c over the I/O of aasunSim.c.
+				They are connected through socketpairs or pseudo-terminals and a relay which injects the faults (simLink.c).
+
+				After the synchronization and the baud rate negotiation, client tasks send a mix
+				of requests through wifiLinkExchange() for the given time:
+				- cgi     GET CGI, the response is checked (fragmented if larger than a frame)
+				- fs      WM_ID_GET_FS of WIFI_FS_CHUNK bytes, checked against the file system image
+				- telnet  Telnet data, the operation ends when its echo is received by the poller
+				A poller task sends WM_ID_REQ as wifiRequest() of http.c: telnet credit, live values.
+				Then the latencies and throughputs of each type, and the counters of the link are displayed.
+				The exit code is 1 if a wrong response is accepted as the ESP32 code does, or if nothing succeeded.
+
+				Build on Linux, from this directory:
+					gcc -O2 -Wall -Wno-format -Iesp -I../../../http/main -I../../../AASun/W5500 -o wifiSim wifiSim.c simLink.c aasunSim.c espShim.c \
+						../../../http/main/wifiLink.c ../../../AASun/W5500/wifiFrame.c -lpthread
+				-Wno-format: wifiLink.c prints uint32_t with %lu, as on the ESP32
+
+				Examples:
+					wifiSim -s 10 -n 4 -m 60,20,20
+					wifiSim -t pty -d 20 -g 20 -j 5 -J 100		Faults: 20 ppm drops and garbage, stops of 100 ms
+					wifiSim -b 1000000							The line doesn't support 2 Mbaud: fallback to 1 Mbaud
+
+	When		Who	What
+	10/18/26	ac	Creation
+	10/18/26	ac	The AASun side is the real wifiFrame.c
+
+----------------------------------------------------------------------
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<getopt.h>
+#include	<pthread.h>
+
+#include	"freertos/FreeRTOS.h"
+#include	"freertos/task.h"
+#include	"freertos/semphr.h"
+
+#include	"global.h"		// From http/main
+#include	"wifiSim.h"
+
+//--------------------------------------------------------------------------------
+
+#define	BENCH_CGI			0
+#define	BENCH_FS			1
+#define	BENCH_TELNET		2		// Telnet data and its echo
+#define	BENCH_REQ			3		// WM_ID_REQ of the poller
+#define	BENCH_TYPES			4
+
+#define	SAMPLE_MAX			100000	// Latencies kept per type, for the percentiles
+#define	CLIENT_MAX			16
+#define	TELNET_ECHO_TMO		(2000 / portTICK_PERIOD_MS)
+#define	POLL_TMO			(100 / portTICK_PERIOD_MS)		// REQUEST_TMO_FAST of http.c: Telnet is on
+#define	POLL_TMO_TELNET		(WIFI_TELNET_COALESCE_TMO / portTICK_PERIOD_MS)
+
+typedef struct
+{
+	const char			* pName ;
+	pthread_mutex_t		mutex ;
+	uint32_t			ops ;			// Successful operations
+	uint32_t			fails ;			// Failed exchanges: timeout, no room, CRC error, rejected response
+	uint32_t			errors ;		// Wrong responses that the ESP32 code would accept
+	uint64_t			bytes ;			// Payload bytes of the successful operations
+	uint32_t			sampleCount ;
+	uint32_t			samples [SAMPLE_MAX] ;	// Latencies, us
+
+} benchStat_t ;
+
+static	benchStat_t		benchStats [BENCH_TYPES] =
+{
+	{ .pName = "cgi",    .mutex = PTHREAD_MUTEX_INITIALIZER },
+	{ .pName = "fs",     .mutex = PTHREAD_MUTEX_INITIALIZER },
+	{ .pName = "telnet", .mutex = PTHREAD_MUTEX_INITIALIZER },
+	{ .pName = "req",    .mutex = PTHREAD_MUTEX_INITIALIZER },
+} ;
+
+// The options
+static	uint32_t		optTransport = SIM_TRANSPORT_SOCKET ;
+static	uint32_t		optSeconds   = 10 ;
+static	uint32_t		optClients   = 4 ;
+static	uint32_t		optMix [3]   = { 60, 20, 20 } ;		// cgi, fs, telnet percents
+static	uint32_t		optCgiSize   = 1500 ;
+static	uint32_t		optTelnetSize = 64 ;
+static	simFault_t		optFault     = { 0, 0, 0, 50, WIFIMSG_BBR_MAX, true, 1 } ;
+static	aasunSimCfg_t	optAasun ;
+
+static	volatile bool	bStop ;
+static	uint32_t		clientsRunning ;
+static	pthread_mutex_t	runMutex = PTHREAD_MUTEX_INITIALIZER ;
+static	uint32_t		cgiSeq ;
+static	uint32_t		livesReceived ;
+
+// The telnet session: the data sent and the echo received by the poller
+static	SemaphoreHandle_t	telnetMutex ;		// One telnet operation at a time
+static	pthread_mutex_t		echoMutex = PTHREAD_MUTEX_INITIALIZER ;
+static	uint64_t			telnetSent ;		// Bytes sent to AASun
+static	uint64_t			telnetEcho ;		// Bytes received from AASun, and lost
+static	uint64_t			telnetLost ;		// Echo bytes not received, at the timeout of an operation
+static	uint32_t			telnetCredit = WBUF_SIZE - sizeof (wifiMsgHdr_t) ;
+
+//--------------------------------------------------------------------------------
+
+static	void	benchAdd (uint32_t type, bool bOk, bool bError, uint32_t bytes, uint64_t startUs)
+{
+	benchStat_t	* pStat = & benchStats [type] ;
+	uint64_t	latency = simTimeUs () - startUs ;
+
+	pthread_mutex_lock (& pStat->mutex) ;
+	if (bError)
+	{
+		pStat->errors++ ;
+	}
+	else if (! bOk)
+	{
+		pStat->fails++ ;
+	}
+	else
+	{
+		pStat->ops++ ;
+		pStat->bytes += bytes ;
+		if (pStat->sampleCount < SAMPLE_MAX)
+		{
+			pStat->samples [pStat->sampleCount++] = (uint32_t) latency ;
+		}
+	}
+	pthread_mutex_unlock (& pStat->mutex) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Called by wifiLink.c for WM_ID_LIVE, as http.c
+
+void	wifiLivePut (const wifiMsgHdr_t * pHdr)
+{
+	(void) pHdr ;
+	__atomic_add_fetch (& livesReceived, 1, __ATOMIC_RELAXED) ;
+}
+
+//--------------------------------------------------------------------------------
+//	GET CGI: the response has optCgiSize bytes of simCgiByte()
+
+static	void	benchCgi (wifiMsgHdr_t * pHdr)
+{
+	wifiReqMsgCgi_t		* pReq  = (wifiReqMsgCgi_t *) pHdr->message ;
+	wifiRespMsgCgi_t	* pResp = (wifiRespMsgCgi_t *) pHdr->message ;
+	uint32_t			seq = __atomic_add_fetch (& cgiSeq, 1, __ATOMIC_RELAXED) ;
+	uint64_t			start = simTimeUs () ;
+	uint32_t			size ;
+	uint32_t			ii ;
+	bool				bOk ;
+
+	pHdr->msgId   = WM_ID_CGI ;
+	pReq->type    = WM_TYPE_GET ;
+	strcpy (pReq->uriName, "bench.cgi") ;
+	pReq->uriSize = (uint16_t) sprintf (pReq->uri, "seq=%u&size=%u", seq, optCgiSize) ;
+	pHdr->dataLength = (uint16_t) (wifiReqMsgCgiSize + pReq->uriSize) ;
+
+	bOk = wifiLinkExchange (pHdr, wifiHdrSize + WIFI_CGI_RESP_MAX, WIFI_LINK_TMO) ;
+	if (! bOk)
+	{
+		benchAdd (BENCH_CGI, false, false, 0, start) ;
+		return ;
+	}
+
+	// As cgi_response_check() of http.c
+	size = (pResp->respSize == WM_RESP_SIZE_PART) ? pHdr->dataLength - wifiRespMsgCgiSize : pResp->respSize ;
+	if (pHdr->msgId != WM_ID_CGI_RESP  ||  size != optCgiSize)
+	{
+		benchAdd (BENCH_CGI, false, true, 0, start) ;
+		return ;
+	}
+	for (ii = 0 ; ii < size ; ii++)
+	{
+		if ((uint8_t) pResp->resp [ii] != simCgiByte (seq, ii))
+		{
+			benchAdd (BENCH_CGI, false, true, 0, start) ;
+			return ;
+		}
+	}
+	benchAdd (BENCH_CGI, true, false, size, start) ;
+}
+
+//--------------------------------------------------------------------------------
+//	WM_ID_GET_FS of WIFI_FS_CHUNK bytes at a random offset
+
+static	void	benchFs (wifiMsgHdr_t * pHdr, uint32_t * pRandom)
+{
+	wifiPageMsg_t	* pReq = (wifiPageMsg_t *) pHdr->message ;
+	uint32_t		fsSize ;
+	const uint8_t	* pFs = aasunSimFs (& fsSize) ;
+	uint64_t		start = simTimeUs () ;
+	uint32_t		offset = 0 ;
+	uint32_t		size = (fsSize < WIFI_FS_CHUNK) ? fsSize : WIFI_FS_CHUNK ;
+
+	if (fsSize > size)
+	{
+		offset = (simRandom (pRandom) % ((fsSize - size) / WIFIMSG_PAGE_CHUNK + 1u)) * WIFIMSG_PAGE_CHUNK ;
+	}
+	pHdr->msgId      = WM_ID_GET_FS ;
+	pHdr->dataLength = wifiPageMsgSize ;
+	pReq->offset     = offset ;
+	pReq->size       = size ;
+
+	if (! wifiLinkExchange (pHdr, wifiHdrSize + WIFI_FS_CHUNK, WIFI_LINK_TMO))
+	{
+		benchAdd (BENCH_FS, false, false, 0, start) ;
+		return ;
+	}
+	if (pHdr->msgId != WM_ID_FS  ||  pHdr->dataLength != size)
+	{
+		// A fragment is lost: rejected by fsRead() of http.c
+		benchAdd (BENCH_FS, false, false, 0, start) ;
+		return ;
+	}
+	if (memcmp (pHdr->message, pFs + offset, size) != 0)
+	{
+		benchAdd (BENCH_FS, false, true, 0, start) ;
+		return ;
+	}
+	benchAdd (BENCH_FS, true, false, size, start) ;
+}
+
+//--------------------------------------------------------------------------------
+//	Telnet: send optTelnetSize bytes as telnet.c, within the credit, then wait for their echo
+
+static	void	benchTelnet (wifiMsgHdr_t * pHdr)
+{
+	uint64_t	start ;
+	uint64_t	target ;
+	uint32_t	remain = optTelnetSize ;
+	uint32_t	len ;
+	TickType_t	startTick ;
+	bool		bOk = true ;
+
+	xSemaphoreTake (telnetMutex, portMAX_DELAY) ;
+	start = simTimeUs () ;		// The wait for the session is not measured
+	while (remain != 0  &&  ! bStop)
+	{
+		len = (remain < telnetCredit) ? remain : telnetCredit ;
+		pHdr->msgId      = WM_ID_TELNET ;
+		pHdr->dataLength = (uint16_t) len ;		// 0: an empty probe for a new credit
+		memset (pHdr->message, 'a' + (int) (remain % 26u), len) ;
+		if (! message_exchange (pHdr)  ||  pHdr->msgId != WM_ID_ACK)
+		{
+			bOk = false ;
+			break ;
+		}
+		if (pHdr->dataLength >= wifiTelnetAckMsgSize)
+		{
+			telnetCredit = ((wifiTelnetAckMsg_t *) pHdr->message)->credit ;
+		}
+		remain -= len ;
+		pthread_mutex_lock (& echoMutex) ;
+		telnetSent += len ;
+		pthread_mutex_unlock (& echoMutex) ;
+		if (len == 0)
+		{
+			vTaskDelay (POLL_TMO_TELNET) ;		// The console is busy
+		}
+	}
+
+	// Wait for the echo, through the poller
+	pthread_mutex_lock (& echoMutex) ;
+	target = telnetSent ;
+	pthread_mutex_unlock (& echoMutex) ;
+	startTick = xTaskGetTickCount () ;
+	while (bOk)
+	{
+		pthread_mutex_lock (& echoMutex) ;
+		if (telnetEcho >= target)
+		{
+			pthread_mutex_unlock (& echoMutex) ;
+			break ;
+		}
+		if (bStop)
+		{
+			pthread_mutex_unlock (& echoMutex) ;
+			xSemaphoreGive (telnetMutex) ;
+			return ;		// End of the benchmark: not measured
+		}
+		if ((xTaskGetTickCount () - startTick) >= TELNET_ECHO_TMO)
+		{
+			// A response with telnet data was lost: the session restarts from here
+			telnetLost += target - telnetEcho ;
+			telnetEcho  = target ;
+			bOk = false ;
+		}
+		pthread_mutex_unlock (& echoMutex) ;
+		usleep (1000) ;
+	}
+	xSemaphoreGive (telnetMutex) ;
+	benchAdd (BENCH_TELNET, bOk, false, optTelnetSize, start) ;
+}
+
+//--------------------------------------------------------------------------------
+//	The poller: wifiRequest() of http.c
+
+static	void	pollerTask (void * pParam)
+{
+	wifiMsgHdr_t	* pHdr = malloc (WBUF_SIZE) ;
+	uint64_t		start ;
+	uint32_t		credit ;
+	bool			bSoon = false ;
+	bool			bOk ;
+
+	(void) pParam ;
+
+	while (! bStop)
+	{
+		vTaskDelay (bSoon ? POLL_TMO_TELNET : POLL_TMO) ;
+
+		credit = (wifiLinkInFlight () != 0) ? WIFI_TELNET_CREDIT_BUSY : dataMessageMax ;
+		pHdr->msgId      = WM_ID_REQ ;
+		pHdr->dataLength = wifiReqMsgSize ;
+		((wifiReqMsg_t *) pHdr->message)->flags        = WM_REQ_LIVE ;
+		((wifiReqMsg_t *) pHdr->message)->telnetCredit = credit ;
+		start = simTimeUs () ;
+		bOk   = message_exchange (pHdr) ;
+		bSoon = false ;
+		if (bOk  &&  pHdr->msgId == WM_ID_TELNET)
+		{
+			bSoon = pHdr->dataLength >= credit ;
+			pthread_mutex_lock (& echoMutex) ;
+			telnetEcho += pHdr->dataLength ;
+			pthread_mutex_unlock (& echoMutex) ;
+		}
+		benchAdd (BENCH_REQ, bOk, false, bOk ? pHdr->dataLength : 0, start) ;
+	}
+	free (pHdr) ;
+	pthread_mutex_lock (& runMutex) ;
+	clientsRunning-- ;
+	pthread_mutex_unlock (& runMutex) ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	clientTask (void * pParam)
+{
+	uint32_t		random = optFault.seed * 7919u + (uint32_t) (uintptr_t) pParam ;
+	uint32_t		bufSize = wifiHdrSize + ((WIFI_FS_CHUNK > WIFI_CGI_RESP_MAX) ? WIFI_FS_CHUNK : WIFI_CGI_RESP_MAX) ;
+	wifiMsgHdr_t	* pHdr = malloc (bufSize) ;
+	uint32_t		rr ;
+
+	while (! bStop)
+	{
+		rr = simRandom (& random) % 100u ;
+		if (rr < optMix [0])
+		{
+			benchCgi (pHdr) ;
+		}
+		else if (rr < optMix [0] + optMix [1])
+		{
+			benchFs (pHdr, & random) ;
+		}
+		else if (rr < optMix [0] + optMix [1] + optMix [2])
+		{
+			benchTelnet (pHdr) ;
+		}
+		else
+		{
+			vTaskDelay (1) ;		// Idle part of the mix
+		}
+	}
+	free (pHdr) ;
+	pthread_mutex_lock (& runMutex) ;
+	clientsRunning-- ;
+	pthread_mutex_unlock (& runMutex) ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	int		sampleCompare (const void * p1, const void * p2)
+{
+	uint32_t	v1 = * (const uint32_t *) p1 ;
+	uint32_t	v2 = * (const uint32_t *) p2 ;
+
+	return (v1 > v2) - (v1 < v2) ;
+}
+
+static	void	benchReport (double seconds)
+{
+	benchStat_t		* pStat ;
+	simLinkStat_t	linkStat ;
+	uint64_t		sum ;
+	uint64_t		totalBytes = 0 ;
+	uint32_t		totalOps = 0 ;
+	uint32_t		ii ;
+	uint32_t		jj ;
+	char			buffer [512] ;
+
+	printf ("\n%-7s %8s %6s %6s %9s %8s %8s %8s %8s %8s\n",
+			"type", "ops", "fails", "errors", "KB/s", "avg ms", "p50 ms", "p90 ms", "p99 ms", "max ms") ;
+	for (ii = 0 ; ii < BENCH_TYPES ; ii++)
+	{
+		pStat = & benchStats [ii] ;
+		qsort (pStat->samples, pStat->sampleCount, sizeof (uint32_t), sampleCompare) ;
+		sum = 0 ;
+		for (jj = 0 ; jj < pStat->sampleCount ; jj++)
+		{
+			sum += pStat->samples [jj] ;
+		}
+#define	PCT(pc)		((pStat->sampleCount == 0) ? 0.0 : pStat->samples [(pStat->sampleCount - 1u) * (pc) / 100u] / 1000.0)
+		printf ("%-7s %8u %6u %6u %9.1f %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+				pStat->pName, pStat->ops, pStat->fails, pStat->errors, pStat->bytes / 1024.0 / seconds,
+				(pStat->sampleCount == 0) ? 0.0 : (double) sum / pStat->sampleCount / 1000.0,
+				PCT (50), PCT (90), PCT (99), PCT (100)) ;
+#undef	PCT
+		if (ii != BENCH_REQ)
+		{
+			totalOps   += pStat->ops ;
+			totalBytes += pStat->bytes ;
+		}
+	}
+	printf ("Total: %.1f ops/s, %.1f KB/s of payload, %u live values, telnet echo lost %llu/%llu bytes\n",
+			totalOps / seconds, totalBytes / 1024.0 / seconds, livesReceived,
+			(unsigned long long) telnetLost, (unsigned long long) telnetSent) ;
+
+	for (ii = 0 ; ii < 2 ; ii++)
+	{
+		simLinkGetStat (ii, & linkStat) ;
+		printf ("Line %s: %llu bytes (%.0f%% of %u baud), dropped %llu, garbage %llu, delays %llu, garbled %llu\n",
+				(ii == SIM_ESP) ? "ESP32->AASun" : "AASun->ESP32", (unsigned long long) linkStat.bytes,
+				linkStat.bytes * 1000.0 / seconds / simLinkGetBaud (ii), simLinkGetBaud (ii),
+				(unsigned long long) linkStat.dropped, (unsigned long long) linkStat.garbage,
+				(unsigned long long) linkStat.delays, (unsigned long long) linkStat.garbled) ;
+	}
+	wifiLinkStatJson (buffer, sizeof (buffer)) ;
+	printf ("ESP32 link: %s\n", buffer) ;
+	espUartStat () ;
+	aasunSimStat () ;
+}
+
+//--------------------------------------------------------------------------------
+
+static	void	usage (void)
+{
+	printf ("Usage: wifiSim [options]\n") ;
+	printf ("  -t socket|pty  Transport between the endpoints and the relay (socket)\n") ;
+	printf ("  -s seconds     Duration of the benchmark (10)\n") ;
+	printf ("  -n clients     Count of client tasks, max %u (4)\n", CLIENT_MAX) ;
+	printf ("  -m c,f,t       Percents of cgi, fs and telnet operations (60,20,20)\n") ;
+	printf ("  -c size        Size of the CGI responses (1500)\n") ;
+	printf ("  -T size        Size of the telnet operations (64)\n") ;
+	printf ("  -d ppm         Dropped bytes per million\n") ;
+	printf ("  -g ppm         Garbage insertions per million bytes\n") ;
+	printf ("  -j ppm         Stops of a direction per million bytes\n") ;
+	printf ("  -J ms          Duration of the stops (50)\n") ;
+	printf ("  -b baud        Max reliable baud rate of the line (%u)\n", WIFIMSG_BBR_MAX) ;
+	printf ("  -P             No pacing: the bytes don't take their UART time, the ESP32 UART buffer can overflow\n") ;
+	printf ("  -f file        File system image for WM_ID_GET_FS (a pattern of 256 KB)\n") ;
+	printf ("  -w us          Time of AASun to build a CGI response (0)\n") ;
+	printf ("  -r seed        Seed of the random generators (1)\n") ;
+	printf ("  -v             More logs of wifiLink.c, can be repeated\n") ;
+}
+
+//--------------------------------------------------------------------------------
+
+int		main (int argc, char * argv [])
+{
+	QueueHandle_t	uartQueue ;
+	uint64_t		start ;
+	double			seconds ;
+	uint32_t		ii ;
+	int				opt ;
+
+	while ((opt = getopt (argc, argv, "t:s:n:m:c:T:d:g:j:J:b:Pf:w:r:vh")) != -1)
+	{
+		switch (opt)
+		{
+			case 't':	optTransport = (strcmp (optarg, "pty") == 0) ? SIM_TRANSPORT_PTY : SIM_TRANSPORT_SOCKET ;	break ;
+			case 's':	optSeconds   = strtoul (optarg, NULL, 0) ;			break ;
+			case 'n':	optClients   = strtoul (optarg, NULL, 0) ;			break ;
+			case 'c':	optCgiSize   = strtoul (optarg, NULL, 0) ;			break ;
+			case 'T':	optTelnetSize = strtoul (optarg, NULL, 0) ;			break ;
+			case 'd':	optFault.dropRate    = strtoul (optarg, NULL, 0) ;	break ;
+			case 'g':	optFault.garbageRate = strtoul (optarg, NULL, 0) ;	break ;
+			case 'j':	optFault.delayRate   = strtoul (optarg, NULL, 0) ;	break ;
+			case 'J':	optFault.delayMs     = strtoul (optarg, NULL, 0) ;	break ;
+			case 'b':	optFault.baudMax     = strtoul (optarg, NULL, 0) ;	break ;
+			case 'P':	optFault.bPacing     = false ;						break ;
+			case 'r':	optFault.seed        = strtoul (optarg, NULL, 0) ;	break ;
+			case 'f':	optAasun.pFsFile     = optarg ;						break ;
+			case 'w':	optAasun.cgiWorkUs   = strtoul (optarg, NULL, 0) ;	break ;
+			case 'v':	simLogLevel++ ;										break ;
+
+			case 'm':
+				if (sscanf (optarg, "%u,%u,%u", & optMix [0], & optMix [1], & optMix [2]) != 3  ||
+					optMix [0] + optMix [1] + optMix [2] > 100)
+				{
+					fprintf (stderr, "Bad mix: %s\n", optarg) ;
+					return 2 ;
+				}
+				break ;
+
+			default:
+				usage () ;
+				return 2 ;
+		}
+	}
+	if (optClients == 0  ||  optClients > CLIENT_MAX  ||  optCgiSize > WIFI_CGI_RESP_MAX - wifiRespMsgCgiSize)
+	{
+		fprintf (stderr, "Bad count of clients or CGI size\n") ;
+		return 2 ;
+	}
+
+	// The link, AASun, then the ESP32 as setup_server()
+	if (! simLinkOpen (optTransport, & optFault)  ||  ! aasunSimStart (& optAasun))
+	{
+		return 2 ;
+	}
+	simLinkStart () ;
+	uartQueue   = espUartInit (UART_RX_BUF_SIZE, UART_EVENT_QUEUE) ;
+	telnetMutex = xSemaphoreCreateMutex () ;
+
+	start = simTimeUs () ;
+	wifiLinkInit (uartQueue) ;
+	printf ("Synchronized at %u baud in %.0f ms (%s, faults drop %u garbage %u stop %u ppm)\n",
+			simLinkGetBaud (SIM_ESP), (simTimeUs () - start) / 1000.0,
+			(optTransport == SIM_TRANSPORT_PTY) ? "pty" : "socketpair",
+			optFault.dropRate, optFault.garbageRate, optFault.delayRate) ;
+
+	// The benchmark
+	clientsRunning = optClients + 1u ;
+	start = simTimeUs () ;
+	xTaskCreate (pollerTask, "poller", 4096, NULL, 5, NULL) ;
+	for (ii = 0 ; ii < optClients ; ii++)
+	{
+		xTaskCreate (clientTask, "client", 4096, (void *) (uintptr_t) ii, 5, NULL) ;
+	}
+	sleep (optSeconds) ;
+	bStop = true ;
+	for (ii = 0 ; ii < 500  &&  clientsRunning != 0 ; ii++)
+	{
+		usleep (10000) ;		// The exchanges in progress end at their timeout
+	}
+	seconds = (simTimeUs () - start) / 1000000.0 ;
+
+	benchReport (seconds) ;
+
+	for (ii = 0 ; ii < BENCH_TYPES ; ii++)
+	{
+		if (benchStats [ii].errors != 0)
+		{
+			return 1 ;
+		}
+	}
+	return (benchStats [BENCH_CGI].ops + benchStats [BENCH_FS].ops + benchStats [BENCH_TELNET].ops == 0) ? 1 : 0 ;
+}
+
+//--------------------------------------------------------------------------------
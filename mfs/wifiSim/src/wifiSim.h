@@ -0,0 +1,102 @@
+/*
+----------------------------------------------------------------------
+
+	Alain Chebrou
+
+	wifiSim.h	Host test harness of the WIFI link between AASun and the ESP32
+
+	When		Who	What
+	10/18/26	ac	Creation
+
+----------------------------------------------------------------------
+*/
+#if ! defined WIFISIM_H_
+#define WIFISIM_H_
+//--------------------------------------------------------------------------------
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	"freertos/queue.h"	// For espUartInit
+
+// The sides of the link. For the relay and the statistics, a direction is named by its sender
+#define	SIM_ESP					0		// ESP32: the real wifiLink.c over the shim of espShim.c
+#define	SIM_AASUN				1		// AASun: the real wifiFrame.c over the I/O of aasunSim.c
+
+// The transports between each endpoint and the relay
+#define	SIM_TRANSPORT_SOCKET	0		// socketpair()
+#define	SIM_TRANSPORT_PTY		1		// Pseudo-terminal pair in raw mode
+
+// The faults injected by the relay. The rates are per million bytes
+typedef struct
+{
+	uint32_t		dropRate ;		// A byte is lost
+	uint32_t		garbageRate ;	// 1 to 8 random bytes are inserted
+	uint32_t		delayRate ;		// The direction stops for delayMs
+	uint32_t		delayMs ;
+	uint32_t		baudMax ;		// Above this baud rate the line corrupts 1% of the bytes
+	bool			bPacing ;		// The bytes take the time of their UART transfer
+	uint32_t		seed ;
+
+} simFault_t ;
+
+// The counters of a direction of the link
+typedef struct
+{
+	uint64_t		bytes ;			// Bytes received by the relay
+	uint64_t		dropped ;
+	uint64_t		garbage ;		// Random bytes inserted
+	uint64_t		delays ;
+	uint64_t		garbled ;		// Bytes corrupted by a wrong baud rate
+
+} simLinkStat_t ;
+
+// The configuration of the AASun handlers
+typedef struct
+{
+	const char		* pFsFile ;		// The file system image, or NULL for a pattern of fsSize bytes
+	uint32_t		fsSize ;
+	uint32_t		cgiWorkUs ;		// Time to build a CGI response
+
+} aasunSimCfg_t ;
+
+//--------------------------------------------------------------------------------
+//	The content of the simulated CGI responses: the harness checks what it receives
+
+static inline uint8_t	simCgiByte (uint32_t seq, uint32_t index)
+{
+	return (uint8_t) ('a' + ((seq * 7u + index) % 26u)) ;
+}
+
+//--------------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// In simLink.c
+uint64_t		simTimeUs			(void) ;
+bool			simLinkOpen			(uint32_t transport, const simFault_t * pFault) ;
+void			simLinkStart		(void) ;
+int				simLinkRead			(uint32_t side, void * pBuffer, uint32_t size) ;
+void			simLinkWrite		(uint32_t side, const void * pData, uint32_t size) ;
+void			simLinkSetBaud		(uint32_t side, uint32_t baud) ;
+void			simLinkSetBaudNext	(uint32_t side, uint32_t baud) ;
+uint32_t		simLinkGetBaud		(uint32_t side) ;
+void			simLinkGetStat		(uint32_t side, simLinkStat_t * pStat) ;
+uint32_t		simRandom			(uint32_t * pState) ;
+
+// In espShim.c
+extern	int		simLogLevel ;
+QueueHandle_t	espUartInit			(uint32_t rxBufSize, uint32_t queueSize) ;
+void			espUartStat			(void) ;
+
+// In aasunSim.c
+bool			aasunSimStart		(const aasunSimCfg_t * pCfg) ;
+const uint8_t *	aasunSimFs			(uint32_t * pSize) ;
+void			aasunSimStat		(void) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+//--------------------------------------------------------------------------------
+#endif	// WIFISIM_H_